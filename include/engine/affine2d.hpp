@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <SDL3/SDL.h>
+#include <glm/mat4x4.hpp>
+
+// defines an `affine2d` type to hold basic 2D transformations:
+//  - translation
+//  - scaling
+//  - rotation
+//
+// as a 2x3 matrix, the last row of the 3x3 matrix is always [0 0 1]:
+//   | a c tx |
+//   | b d ty |
+//
+// Also provides operator overloading for:
+//  - affine2d * affine2d = affine2d
+//  - affine2d * SDL_FPoint = SDL_FPoint
+//  - affine2d * SDL_FRect = SDL_FRect, the bounding box of the transformed rect
+struct affine2d
+{
+    float a{1.0f}, b{0.0f}, c{0.0f}, d{1.0f};
+    float tx{0.0f}, ty{0.0f};
+
+    constexpr affine2d() = default;
+    constexpr affine2d(float a, float b, float c, float d, float tx, float ty)
+        : a{a}, b{b}, c{c}, d{d}, tx{tx}, ty{ty} {};
+    // diagonal matrix, like `glm::mat4x4(1.0f)`
+    explicit constexpr affine2d(float diagonal) : a{diagonal}, d{diagonal} {};
+
+    static constexpr affine2d translation(float x, float y)
+    {
+        return affine2d{1.0f, 0.0f, 0.0f, 1.0f, x, y};
+    }
+
+    // XY part of a matrix applied to points of the z=0 plane
+    static affine2d from_mat4(const glm::mat4x4 &m)
+    {
+        return affine2d{m[0][0], m[0][1], m[1][0], m[1][1], m[3][0], m[3][1]};
+    }
+
+    glm::mat4x4 to_mat4() const
+    {
+        auto m = glm::mat4x4(1.0f);
+        m[0][0] = a;
+        m[0][1] = b;
+        m[1][0] = c;
+        m[1][1] = d;
+        m[3][0] = tx;
+        m[3][1] = ty;
+        return m;
+    }
+};
+
+inline affine2d operator*(const affine2d &lhs, const affine2d &rhs)
+{
+    return affine2d{
+        lhs.a * rhs.a + lhs.c * rhs.b,
+        lhs.b * rhs.a + lhs.d * rhs.b,
+        lhs.a * rhs.c + lhs.c * rhs.d,
+        lhs.b * rhs.c + lhs.d * rhs.d,
+        lhs.a * rhs.tx + lhs.c * rhs.ty + lhs.tx,
+        lhs.b * rhs.tx + lhs.d * rhs.ty + lhs.ty,
+    };
+}
+
+inline SDL_FPoint operator*(const affine2d &m, const SDL_FPoint &p)
+{
+    return SDL_FPoint{
+        m.a * p.x + m.c * p.y + m.tx,
+        m.b * p.x + m.d * p.y + m.ty,
+    };
+}
+
+inline SDL_FRect operator*(const affine2d &m, const SDL_FRect &rect)
+{
+    // transformed center and extents projected on each axis
+    auto hw = rect.w * 0.5f;
+    auto hh = rect.h * 0.5f;
+    auto center = m * SDL_FPoint{rect.x + hw, rect.y + hh};
+    auto ex = std::abs(m.a) * hw + std::abs(m.c) * hh;
+    auto ey = std::abs(m.b) * hw + std::abs(m.d) * hh;
+
+    return SDL_FRect{center.x - ex, center.y - ey, ex + ex, ey + ey};
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// heap allocations made through `operator new`, counted when the engine is
+// built with `ENGINE_ALLOC_STATS`, zero otherwise. SDL's own allocations
+// are not counted.
+//
+// Every thread counts its own allocations. The threads running the frame,
+// the main thread and the job system workers, also add theirs to the
+// frame totals, and an `ALLOCATION_ZONE("name")` counts the allocations
+// the calling thread makes in the rest of the enclosing scope. The jobs a
+// zone submits to other threads count in the frame but not in the zone.
+
+struct allocation_counts
+{
+    std::uint64_t count{0};
+    std::uint64_t bytes{0};
+};
+
+inline allocation_counts operator-(const allocation_counts &lhs, const allocation_counts &rhs)
+{
+    return allocation_counts{.count = lhs.count - rhs.count, .bytes = lhs.bytes - rhs.bytes};
+}
+
+// since the calling thread started
+allocation_counts thread_allocations();
+// of every thread which called `track_frame_allocations`
+allocation_counts frame_thread_allocations();
+// the allocations of the calling thread count in the frame totals
+void track_frame_allocations();
+
+struct allocation_zone_stats
+{
+    const char *name;
+    allocation_counts last;
+    // frames the zone allocated in since the start
+    std::uint64_t allocating_frames{0};
+};
+
+class allocation_tracker
+{
+public:
+    // frame boundaries, from the main thread
+    void begin_frame();
+    void end_frame();
+
+    // thread safe
+    void record(const char *name, const allocation_counts &counts);
+
+    // of the last frame
+    const allocation_counts &frame() const { return m_frame; };
+    // main thread only, between frames
+    const std::vector<allocation_zone_stats> &zones() const { return m_zones; };
+
+private:
+    allocation_zone_stats &zone(const char *name);
+
+    std::mutex m_mutex;
+    std::vector<allocation_zone_stats> m_zones;
+    // counts of the frame being run, by zone index
+    std::vector<allocation_counts> m_current;
+    allocation_counts m_frame_begin;
+    allocation_counts m_frame;
+};
+
+// tracker of the process
+allocation_tracker &get_allocation_tracker();
+
+class allocation_scope
+{
+public:
+    explicit allocation_scope(const char *name) : m_name{name}, m_begin{thread_allocations()} {};
+    ~allocation_scope() { get_allocation_tracker().record(m_name, thread_allocations() - m_begin); };
+
+    allocation_scope(const allocation_scope &) = delete;
+    allocation_scope &operator=(const allocation_scope &) = delete;
+
+private:
+    const char *m_name;
+    allocation_counts m_begin;
+};
+
+#define ENGINE_ALLOCATION_CONCAT_IMPL(a, b) a##b
+#define ENGINE_ALLOCATION_CONCAT(a, b) ENGINE_ALLOCATION_CONCAT_IMPL(a, b)
+
+#ifdef ENGINE_ALLOC_STATS
+#define ALLOCATION_ZONE(name) allocation_scope ENGINE_ALLOCATION_CONCAT(allocation_zone_, __LINE__)(name)
+#else
+#define ALLOCATION_ZONE(name)
+#endif
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <entt/entt.hpp>
+#include "engine/skyline_packer.hpp"
+#include "engine/spsc_queue.hpp"
+
+// textures loaded in the background: the images are decoded on threads of
+// their own, packed into atlas pages and uploaded by the render thread a
+// few rows at a time, within a budget of bytes per frame. The frames never
+// wait on a texture, the sprites are drawn plain until theirs is ready.
+//
+//   auto knight = get_asset_manager().load("assets/pieces/wn.bmp");
+//   registry.emplace<sprite_asset>(entity, sprite_asset{.texture = knight});
+//
+// Images are BMP files, decoded by SDL. The textures of a page share one
+// `SDL_Texture`, their sprites are batched together.
+
+class asset_manager;
+
+// counted reference to a texture of the asset manager, the texture is
+// dropped with its last handle. From the main thread, or from the systems
+// while it runs them
+class texture_handle
+{
+public:
+    texture_handle() = default;
+    texture_handle(const texture_handle &other);
+    texture_handle(texture_handle &&other) noexcept;
+    texture_handle &operator=(texture_handle other) noexcept;
+    ~texture_handle();
+
+    bool valid() const { return m_manager != nullptr; };
+    // uploaded, `texture` and `region` can be drawn
+    bool ready() const;
+    // the image could not be decoded or uploaded
+    bool failed() const;
+
+    // atlas page of the texture, nullptr until ready
+    SDL_Texture *texture() const;
+    // texels of the texture in its page
+    SDL_FRect region() const;
+
+private:
+    friend class asset_manager;
+    texture_handle(asset_manager *manager, Uint32 index);
+
+    asset_manager *m_manager{nullptr};
+    Uint32 m_index{0};
+};
+
+// sets the texture of the `sprite` of the entity once it is ready, see
+// `sprite_asset_system`
+struct sprite_asset
+{
+    texture_handle texture;
+    // replaces the tint of the sprite with the texture
+    SDL_FColor tint{1.0f, 1.0f, 1.0f, 1.0f};
+    bool applied{false};
+};
+
+void sprite_asset_system(entt::registry &registry);
+
+struct asset_config
+{
+    // side of an atlas page in texels, larger images get a page of their own
+    int page_size{2048};
+    // transparent texels around every texture, the filtering of one texture
+    // does not sample its neighbours
+    int padding{1};
+    int decode_threads{2};
+    // bytes uploaded per frame at most
+    std::size_t upload_budget{std::size_t{4} << 20};
+};
+
+struct asset_stats
+{
+    std::size_t requested{0};
+    // decoding or uploading
+    std::size_t loading{0};
+    std::size_t ready{0};
+    std::size_t failed{0};
+    std::size_t pages{0};
+    Uint64 bytes_uploaded{0};
+    // `SDL_UpdateTexture` calls, a texture is uploaded in several slices
+    // when it does not fit in the budget of a frame
+    Uint64 upload_slices{0};
+    // summed over the decode threads
+    double decode_ms{0.0};
+    // on the render thread
+    double upload_ms{0.0};
+    // from the first load to the last texture ready, of the last loads made
+    // while nothing was loading
+    double load_ms{0.0};
+};
+
+class asset_manager
+{
+public:
+    explicit asset_manager(const asset_config &config = {});
+    ~asset_manager();
+
+    asset_manager(const asset_manager &) = delete;
+    asset_manager &operator=(const asset_manager &) = delete;
+
+    // starts decoding at once, the same path gives the same texture
+    texture_handle load(const std::string &path);
+
+    // from the render thread, once per frame before drawing: packs the
+    // decoded images and uploads them within the budget
+    void update(SDL_Renderer *renderer);
+
+    // joins the decode threads and destroys the textures, before the
+    // renderer. The handles left are not ready anymore
+    void shutdown();
+
+    const asset_stats &stats() const { return m_stats; };
+
+private:
+    friend class texture_handle;
+
+    enum class asset_state : Uint8
+    {
+        free,
+        decoding,
+        uploading,
+        ready,
+        failed,
+    };
+
+    struct asset
+    {
+        std::string path;
+        asset_state state{asset_state::free};
+        Uint32 references{0};
+        // decoded with its padding, until uploaded
+        SDL_Surface *surface{nullptr};
+        int page{-1};
+        // of the surface in the page, padding included
+        SDL_Rect rect{0, 0, 0, 0};
+        int uploaded_rows{0};
+    };
+
+    struct page
+    {
+        SDL_Texture *texture{nullptr};
+        internal::skyline_packer packer;
+        // textures still referenced, the page is packed again from scratch
+        // once there are none
+        std::size_t live{0};
+    };
+
+    struct request
+    {
+        Uint32 index;
+        std::string path;
+    };
+
+    struct decoded
+    {
+        Uint32 index{0};
+        SDL_Surface *surface{nullptr};
+        Uint64 decode_ns{0};
+    };
+
+    static constexpr std::size_t result_capacity = 64;
+
+    struct decoder
+    {
+        std::thread thread;
+        spsc_queue<decoded, result_capacity> results;
+    };
+
+    void decode(decoder &d);
+    SDL_Surface *decode_image(const std::string &path) const;
+
+    void acquire(Uint32 index);
+    void release(Uint32 index);
+    // the asset is unused, its slot can be reused
+    void drop(Uint32 index);
+
+    void place(Uint32 index, SDL_Surface *surface);
+    void upload(SDL_Renderer *renderer);
+    void finish(asset &a, asset_state state);
+
+    asset_config m_config;
+    std::vector<asset> m_assets;
+    std::vector<Uint32> m_free;
+    std::unordered_map<std::string, Uint32> m_indices;
+    std::vector<page> m_pages;
+    // placed and waiting for their rows to be uploaded, in order
+    std::deque<Uint32> m_uploads;
+
+    // started on the first load
+    std::vector<std::unique_ptr<decoder>> m_decoders;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<request> m_requests;
+    std::atomic<bool> m_stop{false};
+    bool m_shutdown{false};
+
+    asset_stats m_stats;
+    Uint64 m_load_begin_ns{0};
+};
+
+// asset manager of the process
+asset_manager &get_asset_manager();
+
+namespace internal
+{
+    void asset_setup_system(entt::registry &registry);
+}
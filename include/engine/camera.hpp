@@ -1,20 +1,24 @@
 #pragma once
 
 #include <functional>
-#include <queue>
+#include <vector>
 #include <SDL3/SDL.h>
 #include "engine/game_objects.hpp"
+#include "engine/rect_kernels.hpp"
 
 struct drawable
 {
+    // deeper drawables are drawn first. Only the range of an Sint16 is
+    // ordered, the draw commands keep 16 bits of it
     Sint64 depth;
     SDL_FRect bounding_box;
+    // drawables sharing a material (texture, blend mode...) at the same depth
+    // are drawn consecutively
+    Uint16 material{0};
+    // receives the local to screen matrix, as a 4x4 matrix in every build.
+    // The cameras keep what was drawn across frames: a callback drawing
+    // something new must be signaled with `registry.patch<drawable>`
     std::function<void(SDL_Renderer *, glm::mat4, float)> draw;
-
-    struct compare
-    {
-        bool operator()(const drawable &lhs, const drawable &rhs) const;
-    };
 };
 
 struct camera
@@ -36,40 +40,79 @@ namespace internal
 
     struct bounding_box
     {
+        // union of the drawable and of its children, used for culling
         SDL_FRect rect;
+        // the drawable alone, what it covers on screen
+        SDL_FRect own{0.0f, 0.0f, 0.0f, 0.0f};
     };
 
-    struct draw_call
+    // world space regions whose pixels changed since the last frame, from
+    // the drawables that moved, changed or were removed. Stored in the
+    // registry context and consumed by the `render_system`
+    struct render_damage
     {
-        drawable m_drawable;
-        glm::mat4x4 world_transform;
+        std::vector<SDL_FRect> rects;
+    };
+
+    static void damage_drawable(entt::registry &registry, entt::entity entity);
 
-        struct compare
-        {
-            bool operator()(const draw_call &lhs, const draw_call &rhs) const;
-        };
+    // drawables whose bounding box is recomputed this frame, reused across
+    // frames by the `bounding_box_system`
+    struct bounding_box_batch
+    {
+        std::vector<entt::entity> entities;
+        // drawables dirty before the propagation to their ancestors, their
+        // own bounding box is damaged
+        std::vector<entt::entity> changed;
+        affine_array transforms;
+        rect_array rects;
+        rect_array result;
     };
 
+    // a draw command is a packed sort key, sorting the commands in ascending
+    // order gives the draw order:
+    //  - bits 48..63: depth, the deepest drawables first, in [INT16_MIN, INT16_MAX]
+    //  - bits 32..47: material
+    //  - bits  0..31: entity, to draw the same way every frame
+    using draw_command = Uint64;
+
+    draw_command make_draw_command(Sint64 depth, Uint16 material, entt::entity entity);
+    entt::entity draw_command_entity(draw_command command);
+
+    // the texture of a camera is kept across frames, only the damaged
+    // regions of its view are drawn again
     struct draw_target
     {
-        using draw_queue_type = std::priority_queue<
-            draw_call,
-            std::vector<draw_call>,
-            draw_call::compare>;
-
-        draw_queue_type queue;
-        SDL_Texture *target;
+        // reused across frames, cleared but never shrunk
+        std::vector<SDL_FRect> regions;
+        SDL_Texture *target{nullptr};
+
+        // world space view of the texture content, the whole view is drawn
+        // again when it moves or when the content is not valid
+        SDL_FRect world_view{0.0f, 0.0f, 0.0f, 0.0f};
+        bool valid{false};
+        // draw calls of the last full redraw, for the statistics
+        std::size_t full_draw_calls{0};
     };
 
+    // damaged regions merged beyond this count redraw the whole view
+    constexpr std::size_t max_damage_regions = 16;
+
     static void construct_draw_target(entt::registry &registry, entt::entity entity);
 
     static void destroy_draw_target(entt::registry &registry, entt::entity entity);
+    // an entity leaving the hierarchy is not drawn anymore, as before it
+    // joined it
+    static void destroy_bounding_box(entt::registry &registry, entt::entity entity);
     void camera_setup_system(entt::registry &registry);
+    // the content of the textures is lost (e.g. `SDL_EVENT_RENDER_TARGETS_RESET`)
+    void invalidate_draw_targets(entt::registry &registry);
     static SDL_Texture *prepare_draw_target_texture(
         SDL_Renderer *renderer,
         SDL_Texture *target,
         SDL_FRect view);
 
+    // draws every camera to its viewport, the caller presents the frame
     void render_system(
         entt::registry &registry,
         SDL_Renderer *renderer,
@@ -77,6 +120,7 @@ namespace internal
 };
 
 SDL_FRect transform_rect(glm::mat4x4 transform, SDL_FRect rect);
+SDL_FRect transform_rect(const affine2d &transform, SDL_FRect rect);
 
 // Convert SDL_FPoint to glm::vec4 (homogeneous coordinates)
 inline glm::vec4 to_vec4(const SDL_FPoint &p, float z = 0.0f, float w = 1.0f)
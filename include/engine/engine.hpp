@@ -1,5 +1,7 @@
 #pragma once
 
+// default frame cap, ENGINE_FRAME_CAP overrides it (0 for no cap) and
+// ENGINE_VSYNC=1 paces the frames on the display instead
 #define FPS 60
 
 #define SDL_MAIN_USE_CALLBACKS 1 /* use the callbacks instead of main() */
@@ -8,6 +10,7 @@
 #include <entt/entt.hpp>
 
 #include "scene.hpp"
+#include "frame_scheduler.hpp"
 
 typedef struct
 {
@@ -16,5 +19,5 @@ typedef struct
     bool is_running;
     Scene *scene;
 
-    Uint64 last_frame_end;
+    frame_scheduler scheduler;
 } AppState;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// linear allocator for the memory a frame needs and drops by its end:
+// allocating bumps an offset, deallocating does nothing and `reset` frees
+// everything at once, at the end of `SDL_AppIterate`.
+//
+//   auto ids = std::pmr::vector<entt::entity>{&get_frame_arena()};
+//
+// Thread safe: the systems running on the job system share the arena. A
+// frame needing more than the block is served from extra blocks, and the
+// next `reset` grows the block to fit it: in a steady state the arena does
+// not reach the heap.
+class frame_arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t default_capacity = std::size_t{1} << 20;
+
+    explicit frame_arena(std::size_t capacity = default_capacity,
+                         std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+    ~frame_arena() override;
+
+    frame_arena(const frame_arena &) = delete;
+    frame_arena &operator=(const frame_arena &) = delete;
+
+    // nothing allocated since the previous reset is used anymore
+    void reset();
+
+    // bytes allocated since the previous reset, extra blocks included
+    std::size_t used() const;
+    std::size_t capacity() const { return m_capacity; };
+    // most bytes used by a frame
+    std::size_t peak() const { return m_peak; };
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *, std::size_t, std::size_t) override {};
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; };
+
+    void *allocate_extra(std::size_t bytes, std::size_t alignment);
+
+    struct block
+    {
+        std::byte *data;
+        std::size_t size;
+        std::size_t alignment;
+    };
+
+    std::pmr::memory_resource *m_upstream;
+    std::byte *m_block{nullptr};
+    std::size_t m_capacity{0};
+    std::atomic<std::size_t> m_offset{0};
+
+    // when the block is full
+    std::mutex m_mutex;
+    std::vector<block> m_extra;
+    std::size_t m_extra_offset{0};
+    std::size_t m_extra_used{0};
+
+    // main thread only
+    std::size_t m_peak{0};
+};
+
+// arena of the process, reset by the main loop
+frame_arena &get_frame_arena();
+
+template <typename T>
+using frame_allocator = std::pmr::polymorphic_allocator<T>;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <SDL3/SDL.h>
+
+// timings of the current frame, stored in the registry context:
+// `registry.ctx().get<frame_time>()`
+struct frame_time
+{
+    // duration of a simulation step, every `Scene::update` advances the
+    // simulation by this much, seconds
+    float fixed_delta_time{1.0f / 60.0f};
+    // real time since the previous frame, seconds
+    float delta_time{0.0f};
+    // position of the rendered frame between the last two simulation steps,
+    // the render system interpolates the world matrices with it
+    float alpha{1.0f};
+    // simulation steps since the start
+    Uint64 steps{0};
+};
+
+// frame time statistics over the last `frame_scheduler::window` frames,
+// stored in the registry context next to the `frame_time`
+struct frame_stats
+{
+    Uint64 frames{0};
+    double frame_ms{0.0};
+    double average_ms{0.0};
+    double min_ms{0.0};
+    double max_ms{0.0};
+    // standard deviation of the frame times
+    double jitter_ms{0.0};
+    // frames which missed their deadline by more than a frame
+    Uint64 late_frames{0};
+    // simulation steps skipped to let a slow frame catch up
+    Uint64 dropped_steps{0};
+    // simulation steps run by the last frame
+    int steps{0};
+};
+
+struct frame_scheduler_config
+{
+    // duration of a simulation step, seconds
+    double fixed_step{1.0 / 60.0};
+    // frames per second, 0 does not limit the frame rate
+    double frame_cap{60.0};
+    // the presentation waits for the display refresh, the scheduler does
+    // not wait on its own
+    bool vsync{false};
+    // steps run by a single frame at most, the time beyond is dropped
+    int max_steps{5};
+    // the OS wakes threads up late, the end of the wait spins instead
+    Uint64 spin_ns{2'000'000};
+};
+
+// fixed timestep loop: the simulation advances by steps of a fixed
+// duration, as many as the elapsed time requires, and the frames are
+// rendered in between the last two steps.
+//
+//   auto steps = scheduler.begin_frame();
+//   // ... `steps` simulation steps, then render
+//   scheduler.end_frame();
+class frame_scheduler
+{
+public:
+    static constexpr std::size_t window = 120;
+
+    explicit frame_scheduler(const frame_scheduler_config &config = {});
+
+    const frame_scheduler_config &config() const { return m_config; };
+    void set_config(const frame_scheduler_config &config);
+
+    // measure the time since the previous frame, returns the number of
+    // simulation steps to run
+    int begin_frame();
+    // wait until the next frame is due, after presenting the frame
+    void end_frame();
+
+    frame_time time() const;
+    const frame_stats &stats() const { return m_stats; };
+
+private:
+    void update_stats(Uint64 interval_ns);
+    void wait_until(Uint64 deadline_ns) const;
+
+    frame_scheduler_config m_config;
+    Uint64 m_step_ns;
+    Uint64 m_period_ns;
+
+    Uint64 m_frame_begin_ns{0};
+    Uint64 m_deadline_ns{0};
+    Uint64 m_accumulator_ns{0};
+    Uint64 m_steps{0};
+    float m_delta_time{0.0f};
+
+    std::array<double, window> m_frame_ms{};
+    frame_stats m_stats;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <utility>
+#include <vector>
 #include <SDL3/SDL.h>
 #include <entt/entt.hpp>
 
@@ -9,16 +11,13 @@
 #include <glm/vec3.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-// defines a `mat3x3` type to hold basic 2D transformations:
-//  - translation
-//  - scaling
-//  - rotation
-//
-// Also provides operator overloading for:
-//  - mat3x3 * mat3x3 = mat3x3
-//  - mat3x3 * SDL_FPoint = SDL_FPoint
-//  - mat3x3 * SDL_FRect = SDL_FRect
+#include "engine/affine2d.hpp"
 
+// NB: changes are tracked through the registry signals, modify the component
+// with `registry.patch<local_transform>` or `registry.replace<local_transform>`
+// so the world matrix gets recomputed.
+// NB: with `ENGINE_TRANSFORM_2D` only x and y of the position and scale,
+// and the roll, are used.
 struct local_transform
 {
     glm::vec3 position{0.0f}; // x, y, z
@@ -26,24 +25,181 @@ struct local_transform
     glm::vec3 rotation{0.0f}; // Euler angles in radians (pitch, yaw, roll)
 };
 
+// world transforms of the hierarchy and of the render system. The engine is
+// 2D, `ENGINE_TRANSFORM_2D` stores them as 2x3 affine matrices (24 bytes)
+// instead of 4x4 matrices (64 bytes).
+#ifdef ENGINE_TRANSFORM_2D
+using world_transform = affine2d;
+#else
+using world_transform = glm::mat4x4;
+#endif
+
+// an invalid parent entity, or one that would create a cycle, makes the entity
+// a root of the hierarchy
 struct parent
 {
     entt::entity entity{entt::null};
 };
 
+// per-frame statistics of the transform systems, stored in the registry
+// context: `registry.ctx().get<transform_stats>()`
+struct transform_stats
+{
+    // number of world matrices recomputed by the last `local_to_world_system`
+    std::size_t recomputed{0};
+};
+
 namespace internal
 {
     struct local_to_world
     {
-        glm::mat4x4 mat;
+        world_transform mat{1.0f};
+    };
+
+    // node of the transform hierarchy, children are linked in an intrusive
+    // list. The pool is sorted by depth, and the `local_to_world` pool
+    // along with it, so that iterating it visits parents before children:
+    // world matrices are propagated with a forward sweep and bounding boxes
+    // are merged with a backward sweep.
+    struct hierarchy
+    {
+        entt::entity parent{entt::null};
+        entt::entity first_child{entt::null};
+        entt::entity prev_sibling{entt::null};
+        entt::entity next_sibling{entt::null};
+        std::uint32_t depth{0};
+    };
+
+    // set whenever a depth changes, the pools are sorted again on the next
+    // `local_to_world_system`
+    struct hierarchy_order
+    {
+        bool unsorted{false};
+    };
+
+    // the hierarchy split for the jobs of the transform systems, refreshed
+    // by the `local_to_world_system`. The nodes of a depth are contiguous in
+    // the sorted pool and depend only on the depth above, each depth is
+    // processed in parallel chunks. The jobs only modify components: what
+    // would add components is flagged and applied once they are done
+    struct transform_jobs
+    {
+        // smaller hierarchies are processed by the calling thread alone
+        static constexpr std::size_t min_parallel_nodes = 4096;
+        static constexpr std::size_t grain = 1024;
+
+        enum flag : std::uint8_t
+        {
+            recomputed = 1,
+            // descendant of a dirty entity, tagged dirty once the jobs are
+            // done
+            dirtied = 2,
+            // has no `motion` yet, `previous` holds its matrix before the step
+            new_motion = 4,
+        };
+
+        // the pool in iteration order, parents first
+        std::vector<entt::entity> entities;
+        // index in `entities` of the first node of each depth, and the end
+        std::vector<std::size_t> levels;
+        // by index in the pool
+        std::vector<std::uint8_t> flags;
+        std::vector<world_transform> previous;
+    };
+
+    // tag for entities whose world matrix is out of date
+    struct dirty_transform
+    {
     };
 
-    struct children
+    // world matrix before the last simulation step of the entities that
+    // moved, the render system draws them in between. It is removed by the
+    // render system once the entity was drawn settled
+    struct motion
     {
-        std::unordered_set<entt::entity> entities;
+        world_transform previous{1.0f};
+        // moved during the last step, otherwise `previous` is the current
+        // world matrix
+        bool moved{false};
+        // created during the last step, drawn where it is
+        bool snap{false};
+        // world bounding box where the render system last drew the entity
+        SDL_FRect drawn{0.0f, 0.0f, 0.0f, 0.0f};
     };
+
+    // entities whose `local_transform` or `parent` was constructed, updated
+    // or destroyed since the last `parent_system`. The signals only record
+    // them: components cannot be emplaced on an entity being destroyed
+    struct hierarchy_changes
+    {
+        std::vector<entt::entity> entities;
+    };
+
+    void mark_transform_dirty(entt::registry &registry, entt::entity entity);
+    static void record_hierarchy_change(entt::registry &registry, entt::entity entity);
+    static void destroy_hierarchy_node(entt::registry &registry, entt::entity entity);
+    void transform_setup_system(entt::registry &registry);
 }
 
 void parent_system(entt::registry &registry);
 void local_to_world_system(entt::registry &registry);
 glm::mat4 make_transform(const local_transform &t);
+affine2d make_affine_transform(const local_transform &t);
+
+inline world_transform make_world_transform(const local_transform &t)
+{
+#ifdef ENGINE_TRANSFORM_2D
+    return make_affine_transform(t);
+#else
+    return make_transform(t);
+#endif
+}
+
+inline world_transform make_world_translation(float x, float y)
+{
+#ifdef ENGINE_TRANSFORM_2D
+    return affine2d::translation(x, y);
+#else
+    return glm::translate(glm::mat4x4(1.0f), glm::vec3(x, y, 0.0f));
+#endif
+}
+
+// point of the z=0 plane transformed by either kind of matrix
+inline SDL_FPoint transform_point(const glm::mat4x4 &m, SDL_FPoint p)
+{
+    auto v = m * glm::vec4(p.x, p.y, 0.0f, 1.0f);
+    return SDL_FPoint{v.x, v.y};
+}
+
+inline SDL_FPoint transform_point(const affine2d &m, SDL_FPoint p)
+{
+    return m * p;
+}
+
+// linear interpolation of the matrices, from `from` at t=0 to `to` at t=1
+inline glm::mat4x4 interpolate_transform(const glm::mat4x4 &from, const glm::mat4x4 &to, float t)
+{
+    return from + (to - from) * t;
+}
+
+inline affine2d interpolate_transform(const affine2d &from, const affine2d &to, float t)
+{
+    return affine2d{
+        from.a + (to.a - from.a) * t,
+        from.b + (to.b - from.b) * t,
+        from.c + (to.c - from.c) * t,
+        from.d + (to.d - from.d) * t,
+        from.tx + (to.tx - from.tx) * t,
+        from.ty + (to.ty - from.ty) * t,
+    };
+}
+
+inline glm::mat4x4 to_mat4(const glm::mat4x4 &m)
+{
+    return m;
+}
+
+inline glm::mat4x4 to_mat4(const affine2d &m)
+{
+    return m.to_mat4();
+}
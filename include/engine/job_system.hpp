@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// pool of worker threads running short jobs, one thread per core counting
+// the thread which created the pool.
+//
+// Every thread of the pool has its own deque of jobs: it pushes and pops
+// at the bottom, the other threads steal from the top when theirs is
+// empty. A thread waiting on jobs runs jobs meanwhile, so jobs may submit
+// and wait on other jobs. Idle workers sleep until a job is submitted.
+//
+// Jobs are not allocated: the caller owns them until `wait` returns.
+
+struct job
+{
+    void (*run)(void *context, std::size_t begin, std::size_t end);
+    void *context;
+    std::size_t begin;
+    std::size_t end;
+    // decremented once the job has run
+    std::atomic<int> *pending;
+};
+
+struct job_stats
+{
+    std::uint64_t executed{0};
+    // run by another thread than the one which submitted them
+    std::uint64_t stolen{0};
+};
+
+namespace internal
+{
+    struct work_deque;
+}
+
+class job_system
+{
+public:
+    // jobs of a `parallel_for` at most
+    static constexpr std::size_t max_chunks = 256;
+
+    // 0 for one thread per core
+    explicit job_system(int threads = 0);
+    ~job_system();
+
+    job_system(const job_system &) = delete;
+    job_system &operator=(const job_system &) = delete;
+
+    // not while jobs run, from the thread which created the pool
+    void set_threads(int threads);
+    // the workers and the thread which created the pool
+    int threads() const { return int(m_deques.size()); };
+
+    // from the thread which created the pool or from a job, any other
+    // thread runs `j` at once
+    void submit(job &j);
+    // runs jobs until `pending` drops to 0
+    void wait(std::atomic<int> &pending);
+
+    // `body(begin, end)` over [0, count) in chunks of `grain` items or
+    // more, the calling thread runs the first chunk itself
+    template <typename F>
+    void parallel_for(std::size_t count, std::size_t grain, const F &body);
+
+    job_stats stats() const;
+
+private:
+    void start(int threads);
+    void stop();
+    void work(int index);
+    // own jobs first, then stolen ones
+    job *find_job(int index);
+    void execute(job *j, int index);
+    // index of the deque of the calling thread, -1 outside the pool
+    int current_index() const;
+
+    std::vector<std::unique_ptr<internal::work_deque>> m_deques;
+    std::vector<std::thread> m_workers;
+
+    // jobs submitted and not yet taken, the workers sleep while there are
+    // none
+    std::atomic<int> m_queued{0};
+    std::atomic<int> m_sleeping{0};
+    std::atomic<bool> m_stop{false};
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+};
+
+// pool of the process, sized on first use
+job_system &get_job_system();
+
+template <typename F>
+void job_system::parallel_for(std::size_t count, std::size_t grain, const F &body)
+{
+    grain = std::max<std::size_t>({grain, 1, (count + max_chunks - 1) / max_chunks});
+    auto chunks = (count + grain - 1) / grain;
+    if (chunks <= 1 || threads() == 1)
+    {
+        if (count > 0)
+        {
+            body(std::size_t{0}, count);
+        }
+        return;
+    }
+
+    auto run = [](void *context, std::size_t begin, std::size_t end)
+    {
+        (*static_cast<const F *>(context))(begin, end);
+    };
+    auto *context = const_cast<void *>(static_cast<const void *>(&body));
+
+    std::array<job, max_chunks> jobs;
+    auto pending = std::atomic<int>{int(chunks - 1)};
+    for (std::size_t i = 1; i < chunks; ++i)
+    {
+        jobs[i] = job{run, context, i * grain, std::min(count, (i + 1) * grain), &pending};
+        submit(jobs[i]);
+    }
+    body(std::size_t{0}, grain);
+    wait(pending);
+}
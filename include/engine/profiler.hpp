@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <SDL3/SDL.h>
+
+// scoped profiler: a `PROFILE_ZONE("name")` measures the rest of the
+// enclosing scope. Zones are recorded from any thread into a lock-free ring
+// of samples, which keeps the last `frame_profiler::capacity` samples.
+//
+// `ENGINE_PROFILER` (the CMake option, ON by default) records the zones,
+// without it they compile to nothing.
+
+struct profile_sample
+{
+    // string literal, zones with equal names are aggregated together
+    const char *name;
+    Uint64 begin_ns;
+    Uint64 end_ns;
+    Uint64 frame;
+    SDL_ThreadID thread;
+    // nesting level of the zone on its thread
+    Uint32 depth;
+};
+
+// timings of a zone over the last frames, summed over the frame
+struct profile_zone_stats
+{
+    const char *name;
+    double last_ms{0.0};
+    double average_ms{0.0};
+    // over the last `frame_profiler::peak_window` frames
+    double peak_ms{0.0};
+    double window_peak_ms{0.0};
+};
+
+class frame_profiler
+{
+public:
+    static constexpr std::size_t capacity = std::size_t{1} << 16;
+    static constexpr Uint64 peak_window = 60;
+
+    frame_profiler();
+
+    // frame boundaries, from the main thread
+    void begin_frame();
+    void end_frame();
+
+    // thread safe, never blocks
+    void record(const char *name, Uint64 begin_ns, Uint64 end_ns, Uint32 depth);
+
+    // copy of the samples still in the ring, oldest first
+    void snapshot(std::vector<profile_sample> &result) const;
+
+    const std::vector<profile_zone_stats> &zones() const { return m_zones; };
+    double frame_ms() const { return m_frame_ms; };
+    double average_frame_ms() const { return m_average_frame_ms; };
+
+    void toggle_overlay() { m_overlay = !m_overlay; };
+    // per zone timings in the top-left corner of the current render target
+    void draw_overlay(SDL_Renderer *renderer) const;
+
+    // one line per sample: frame, thread, depth, zone, begin and duration
+    bool write_csv(const char *path) const;
+    // Chrome trace event format, for chrome://tracing or Perfetto
+    bool write_chrome_trace(const char *path) const;
+
+private:
+    struct slot
+    {
+        // index of the sample + 1 once written, 0 while being written
+        std::atomic<Uint64> sequence{0};
+        profile_sample sample;
+    };
+
+    bool read(Uint64 index, profile_sample &sample) const;
+    profile_zone_stats &zone(const char *name);
+
+    std::unique_ptr<slot[]> m_slots;
+    std::atomic<Uint64> m_head{0};
+    std::atomic<Uint64> m_frame{0};
+
+    // main thread only
+    Uint64 m_frame_begin_ns{0};
+    Uint64 m_frame_first_sample{0};
+    std::vector<profile_zone_stats> m_zones;
+    double m_frame_ms{0.0};
+    double m_average_frame_ms{0.0};
+    bool m_overlay{false};
+};
+
+// profiler of the process
+frame_profiler &get_profiler();
+
+class profile_scope
+{
+public:
+    explicit profile_scope(const char *name);
+    ~profile_scope();
+
+    profile_scope(const profile_scope &) = delete;
+    profile_scope &operator=(const profile_scope &) = delete;
+
+private:
+    const char *m_name;
+    Uint64 m_begin_ns;
+    Uint32 m_depth;
+};
+
+#define ENGINE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ENGINE_PROFILE_CONCAT(a, b) ENGINE_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef ENGINE_PROFILER
+#define PROFILE_ZONE(name) profile_scope ENGINE_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <SDL3/SDL.h>
+#include <glm/mat4x4.hpp>
+#include "engine/affine2d.hpp"
+
+// Batched transforms of rectangles, used by the bounding box system and by
+// the sprite batches. The data is laid out as structure of arrays so that
+// the kernels process 4 (SSE2) or 8 (AVX) rectangles per iteration, the
+// instruction set is selected at runtime with a scalar fallback.
+
+namespace internal
+{
+    // 2D affine transforms, the XY part of a `glm::mat4x4` applied to points
+    // of the z=0 plane:
+    //   x' = a * x + c * y + tx
+    //   y' = b * x + d * y + ty
+    struct affine_array
+    {
+        std::vector<float> a, b, c, d, tx, ty;
+
+        void push_back(const glm::mat4x4 &m);
+        void push_back(const affine2d &m);
+        void clear();
+        std::size_t size() const { return a.size(); };
+    };
+
+    struct rect_array
+    {
+        std::vector<float> x, y, w, h;
+
+        void push_back(const SDL_FRect &rect);
+        void resize(std::size_t count);
+        void clear();
+        std::size_t size() const { return x.size(); };
+        SDL_FRect operator[](std::size_t i) const { return SDL_FRect{x[i], y[i], w[i], h[i]}; };
+    };
+
+    // transformed corners of quads: top-left, top-right, bottom-right,
+    // bottom-left
+    struct quad_array
+    {
+        std::vector<float> x[4], y[4];
+
+        void resize(std::size_t count);
+    };
+
+    enum class simd_level
+    {
+        scalar,
+        sse2,
+        avx,
+    };
+
+    // best level supported by the CPU, detected once
+    simd_level detect_simd_level();
+    const char *simd_level_name(simd_level level);
+
+    // axis aligned bounding boxes of the transformed rectangles, element-wise
+    void transform_rects(
+        const affine_array &transforms,
+        const rect_array &rects,
+        rect_array &result,
+        simd_level level = detect_simd_level());
+
+    // transformed corners of the rectangles, element-wise
+    void transform_quads(
+        const affine_array &transforms,
+        const rect_array &rects,
+        quad_array &result,
+        simd_level level = detect_simd_level());
+}
@@ -4,10 +4,44 @@
  * @brief The Scene class holds all assets to manage and render the visual
  * and non-visual entities within the displayed scene on screen
  */
+#include <utility>
 #include <SDL3/SDL.h>
 #include <entt/entt.hpp>
+#include "engine/assets.hpp"
 #include "engine/game_objects.hpp"
 #include "engine/camera.hpp"
+#include "engine/sprite.hpp"
+#include "engine/frame_scheduler.hpp"
+#include "engine/job_system.hpp"
+#include "engine/spatial_grid.hpp"
+#include "engine/system_scheduler.hpp"
+
+namespace internal
+{
+    // the systems of every scene: each depends on the previous one, they
+    // split their own work between the threads
+    inline void add_scene_systems(system_scheduler &systems)
+    {
+        systems.add("parent_system", system_access{}.exclusive(), parent_system);
+        systems.add("sprite_asset_system",
+                    system_access{}
+                        .write<sprite_asset, sprite, drawable, internal::sprite_materials, internal::dirty_transform>(),
+                    sprite_asset_system);
+        systems.add("local_to_world_system",
+                    system_access{}
+                        .read<local_transform>()
+                        .write<internal::hierarchy, internal::local_to_world, internal::motion,
+                               internal::dirty_transform, internal::hierarchy_order, internal::transform_jobs,
+                               transform_stats>(),
+                    local_to_world_system);
+        systems.add("bounding_box_system",
+                    system_access{}
+                        .read<internal::hierarchy, internal::local_to_world, internal::transform_jobs, drawable>()
+                        .write<internal::bounding_box, internal::dirty_transform, internal::render_damage,
+                               internal::bounding_box_batch, internal::spatial_grid>(),
+                    bounding_box_system);
+    }
+}
 
 class Scene
 {
@@ -16,14 +50,42 @@ public:
     Scene()
     {
         internal::camera_setup_system(m_registry);
+        internal::transform_setup_system(m_registry);
+        internal::asset_setup_system(m_registry);
+        m_registry.ctx().emplace<frame_time>();
+        m_registry.ctx().emplace<frame_stats>();
+
+        internal::add_scene_systems(m_systems);
+    };
+    // scenes are deleted through `Scene *`. `clean` runs the base version
+    // from here, the derived scenes release their own resources in their
+    // destructors
+    virtual ~Scene()
+    {
+        clean();
+        delete m_next_scene;
     };
-    ~Scene() { clean(); };
 
     void registry_updates()
     {
-        parent_system(m_registry);
-        local_to_world_system(m_registry);
-        bounding_box_system(m_registry);
+        m_systems.run(m_registry, get_job_system());
+    };
+
+    // timings of the frame about to run, see `frame_time`
+    void set_frame_time(const frame_time &time, const frame_stats &stats)
+    {
+        m_registry.ctx().get<frame_time>() = time;
+        m_registry.ctx().get<frame_stats>() = stats;
+    };
+
+    // the scene replacing this one, taken by the main loop after the update
+    // steps of a frame. The main loop then deletes this scene
+    Scene *take_next_scene() { return std::exchange(m_next_scene, nullptr); };
+
+    // the content of the camera textures was lost, draw them entirely
+    void invalidate_render_targets()
+    {
+        internal::invalidate_draw_targets(m_registry);
     };
 
     // initialize assets and entities
@@ -31,6 +93,8 @@ public:
 
     // delegates to the game loop
     virtual void handle_event(SDL_Event *event) = 0;
+    // a simulation step of `frame_time::fixed_delta_time`, called as many
+    // times per frame as the elapsed time requires
     virtual void update() = 0;
     virtual void render(SDL_Renderer *renderer) = 0;
 
@@ -38,6 +102,20 @@ public:
     virtual void clean() {};
 
 protected:
+    // switches to `next` at the end of the frame's update, owned by the
+    // engine from here on
+    void change_scene(Scene *next)
+    {
+        delete m_next_scene;
+        m_next_scene = next;
+    };
+
     // EnTT registry to register and manage all entities
     entt::registry m_registry;
+    // run by `registry_updates`, scenes add their own systems with what
+    // they read and write
+    system_scheduler m_systems;
+
+private:
+    Scene *m_next_scene{nullptr};
 };
\ No newline at end of file
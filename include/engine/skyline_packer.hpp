@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <SDL3/SDL.h>
+
+namespace internal
+{
+    // packs rectangles into a texture atlas, bottom-left first. The packed
+    // area is described by its skyline, the top edge of the rectangles
+    // packed so far: a rectangle goes where the skyline under it is the
+    // lowest, the space left below the skyline is not used anymore.
+    //
+    // Rectangles cannot be freed one by one, `reset` empties the atlas.
+    class skyline_packer
+    {
+    public:
+        explicit skyline_packer(int width = 0, int height = 0) { reset(width, height); };
+
+        void reset(int width, int height);
+
+        // position of the top-left corner of a `w` x `h` rectangle, false
+        // when it does not fit anymore
+        bool pack(int w, int h, SDL_Point &position);
+
+        int width() const { return m_width; };
+        int height() const { return m_height; };
+        // fraction of the atlas area covered by packed rectangles
+        float occupancy() const;
+
+    private:
+        struct segment
+        {
+            int x;
+            int y;
+            int w;
+        };
+
+        // top of a `w` x `h` rectangle laid on the skyline from the
+        // segment `index` on, -1 when it does not fit
+        int fit(std::size_t index, int w, int h) const;
+
+        std::vector<segment> m_skyline;
+        int m_width{0};
+        int m_height{0};
+        Uint64 m_used{0};
+    };
+}
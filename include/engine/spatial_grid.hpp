@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <entt/entt.hpp>
+
+namespace internal
+{
+    // uniform grid over the world bounding boxes of the drawables, used to
+    // cull the drawables of every camera without testing all of them.
+    //
+    // An entity is stored in every cell its bounding box overlaps, entities
+    // spanning too many cells are kept in a separate list which every query
+    // returns.
+    class spatial_grid
+    {
+    public:
+        explicit spatial_grid(float cell_size = 256.0f) : m_cell_size{cell_size} {};
+
+        // insert the entity or move it to its new bounding box, an empty
+        // bounding box removes it
+        void update(entt::entity entity, const SDL_FRect &rect);
+        void remove(entt::entity entity);
+
+        // append to `result` every entity whose cells overlap `rect`, each
+        // entity at most once. The caller still has to test the actual
+        // bounding boxes
+        void query(const SDL_FRect &rect, std::pmr::vector<entt::entity> &result);
+
+        std::size_t size() const { return m_records.size(); };
+
+    private:
+        // cells spanned by a bounding box, inclusive
+        struct cell_range
+        {
+            Sint32 min_x;
+            Sint32 min_y;
+            Sint32 max_x;
+            Sint32 max_y;
+        };
+
+        struct record
+        {
+            cell_range range;
+            bool oversized;
+            // last query that returned the entity
+            Uint32 stamp;
+        };
+
+        // entities spanning more cells are not stored in the cells
+        static constexpr Sint64 max_cells = 64;
+
+        cell_range cells_of(const SDL_FRect &rect) const;
+        static Uint64 cell_key(Sint32 x, Sint32 y);
+        void insert_cells(entt::entity entity, const record &r);
+        void erase_cells(entt::entity entity, const record &r);
+
+        using cell_map = std::unordered_map<Uint64, std::vector<entt::entity>>;
+
+        float m_cell_size;
+        cell_map m_cells;
+        // cells emptied by moving entities, reused with their node and
+        // their capacity for the cells entered next: moving entities do not
+        // allocate once the number of populated cells is stable
+        std::vector<cell_map::node_type> m_spare_cells;
+        std::vector<entt::entity> m_oversized;
+        entt::storage<record> m_records;
+        Uint32 m_stamp{0};
+    };
+
+    // keep the grid in sync with the lifetime of the bounding boxes
+    static void remove_from_spatial_grid(entt::registry &registry, entt::entity entity);
+    void spatial_grid_setup_system(entt::registry &registry, float cell_size = 256.0f);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <entt/entt.hpp>
+#include "engine/game_objects.hpp"
+#include "engine/rect_kernels.hpp"
+
+// textured quad drawn by the engine itself: consecutive sprites sharing a
+// texture are submitted with a single `SDL_RenderGeometry` call.
+//
+// The entity gets a `drawable` mirroring the sprite, used for culling and
+// for the draw order, modify the sprite through `registry.patch<sprite>` to
+// keep both in sync. Removing the sprite removes the drawable.
+struct sprite
+{
+    // nullptr draws a plain quad of the `tint` color
+    SDL_Texture *texture{nullptr};
+    // region of the texture (e.g. in an atlas) in texels, an empty region
+    // maps the whole texture
+    SDL_FRect region{0.0f, 0.0f, 0.0f, 0.0f};
+    // quad in local space
+    SDL_FRect rect{0.0f, 0.0f, 0.0f, 0.0f};
+    SDL_FColor tint{1.0f, 1.0f, 1.0f, 1.0f};
+    Sint64 depth{0};
+};
+
+// per-frame statistics of the render system, stored in the registry
+// context: `registry.ctx().get<render_stats>()`
+struct render_stats
+{
+    // `drawable::draw` callbacks and `SDL_RenderGeometry` submissions
+    std::size_t draw_calls{0};
+    std::size_t sprites{0};
+
+    // retained rendering: cameras without damage are not drawn again, the
+    // others only draw their damaged regions
+    std::size_t cameras_skipped{0};
+    std::size_t cameras_redrawn{0};
+    std::size_t regions{0};
+    float pixels_redrawn{0.0f};
+    float pixels_saved{0.0f};
+    // compared to the last full redraw of each camera
+    std::size_t draw_calls_saved{0};
+};
+
+namespace internal
+{
+    // sprites waiting to be submitted, reused across frames. Their corners
+    // are transformed together when the batch is flushed
+    struct sprite_batch
+    {
+        SDL_Texture *texture{nullptr};
+        float texture_w{1.0f};
+        float texture_h{1.0f};
+
+        affine_array transforms;
+        rect_array rects;
+        // texture coordinates of the top-left and bottom-right corners
+        std::vector<SDL_FRect> tex_coords;
+        std::vector<SDL_FColor> tints;
+
+        quad_array corners;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    // material id of every texture used by a sprite, so that the draw
+    // commands of a texture are sorted next to each other. At most
+    // `SDL_MAX_UINT16` textures get an id of their own
+    struct sprite_materials
+    {
+        std::unordered_map<SDL_Texture *, Uint16> ids;
+    };
+
+    static void sync_sprite_drawable(entt::registry &registry, entt::entity entity);
+    static void remove_sprite_drawable(entt::registry &registry, entt::entity entity);
+    void sprite_setup_system(entt::registry &registry);
+
+    // append the sprite to the batch, submitting the batch first when the
+    // texture changes
+    void push_sprite(
+        sprite_batch &batch,
+        render_stats &stats,
+        SDL_Renderer *renderer,
+        const sprite &c_sprite,
+        const world_transform &transform);
+    void flush_sprites(sprite_batch &batch, render_stats &stats, SDL_Renderer *renderer);
+}
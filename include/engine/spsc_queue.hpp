@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// bounded queue between exactly one producer thread and one consumer
+// thread, without locks: each side only writes its own index. Neither
+// `try_push` nor `try_pop` blocks, they fail on a full or empty queue.
+//
+// The values live in a fixed ring, moved in and out: `T` must be default
+// constructible and `Capacity` a power of two.
+
+template <typename T, std::size_t Capacity>
+class spsc_queue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // producer
+    bool try_push(T &&value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head_cache == Capacity)
+        {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (tail - m_head_cache == Capacity)
+            {
+                return false;
+            }
+        }
+
+        m_values[tail & (Capacity - 1)] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T &value)
+    {
+        auto copy = value;
+        return try_push(std::move(copy));
+    }
+
+    // consumer
+    bool try_pop(T &value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail_cache)
+        {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tail_cache)
+            {
+                return false;
+            }
+        }
+
+        value = std::move(m_values[head & (Capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate from any thread, exact from the consumer when empty
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr std::size_t capacity() { return Capacity; };
+
+private:
+    // the indices only grow, their difference is the size. Each side keeps
+    // a copy of the other's index and reloads it only when the queue looks
+    // full or empty, the shared cache lines are touched less often
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    std::size_t m_tail_cache{0};
+
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_head_cache{0};
+
+    alignas(64) std::array<T, Capacity> m_values;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <entt/entt.hpp>
+#include "engine/job_system.hpp"
+
+// what a system touches: the components and the registry context values it
+// reads and writes. Writing a component includes emplacing and removing it
+// on existing entities, as long as its storage exists. A `structural`
+// system creates or destroys entities, or storages: it runs alone.
+struct system_access
+{
+    std::vector<entt::id_type> reads;
+    std::vector<entt::id_type> writes;
+    bool structural{false};
+
+    template <typename... T>
+    system_access &read()
+    {
+        (reads.push_back(entt::type_hash<T>::value()), ...);
+        return *this;
+    }
+
+    template <typename... T>
+    system_access &write()
+    {
+        (writes.push_back(entt::type_hash<T>::value()), ...);
+        return *this;
+    }
+
+    system_access &exclusive()
+    {
+        structural = true;
+        return *this;
+    }
+
+    // one writes what the other reads or writes
+    bool conflicts(const system_access &other) const;
+};
+
+// runs the systems of a scene once per step on the job system. Systems
+// which do not conflict run at the same time, conflicting ones in the order
+// they were added: the result is the one of running them one after the
+// other in that order.
+//
+//   scheduler.add("movement", system_access{}.read<velocity>().write<local_transform>(), movement_system);
+//   scheduler.run(registry, get_job_system());
+//
+// A system may split its own work with `job_system::parallel_for`.
+class system_scheduler
+{
+public:
+    using system = std::function<void(entt::registry &)>;
+
+    // `name` is a string literal. Not while running
+    void add(const char *name, const system_access &access, system update);
+
+    void run(entt::registry &registry, job_system &jobs);
+
+    std::size_t size() const { return m_nodes.size(); };
+    // most systems running at the same time during the last `run`
+    int last_width() const { return m_width; };
+
+private:
+    struct node
+    {
+        const char *name;
+        system_access access;
+        system update;
+        // systems added later which wait on this one
+        std::vector<std::size_t> dependents;
+        int dependencies{0};
+        std::atomic<int> remaining{0};
+        job task{};
+        system_scheduler *owner{nullptr};
+    };
+
+    static void run_node(void *context, std::size_t begin, std::size_t end);
+
+    std::vector<std::unique_ptr<node>> m_nodes;
+    // set while running
+    entt::registry *m_registry{nullptr};
+    job_system *m_jobs{nullptr};
+    std::atomic<int> m_pending{0};
+    std::atomic<int> m_running{0};
+    std::atomic<int> m_peak{0};
+    int m_width{0};
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include "game/chess/bitboard.hpp"
+
+// attack tables. Sliding attacks are looked up either with magic
+// multiplication or with the BMI2 PEXT instruction, selected at runtime:
+// PEXT when the CPU executes it fast, magics otherwise.
+//
+// `init_attacks` builds the tables, every `position` calls it.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHESS_HAS_PEXT 1
+#else
+#define CHESS_HAS_PEXT 0
+#endif
+
+namespace chess
+{
+    enum class slider_backend
+    {
+        magic,
+        pext,
+    };
+
+    // thread safe, the tables are built once
+    void init_attacks();
+
+    slider_backend active_slider_backend();
+    const char *slider_backend_name(slider_backend backend);
+    // false when the CPU does not support the backend
+    bool set_slider_backend(slider_backend backend);
+
+    namespace internal
+    {
+        struct slider_table
+        {
+            bitboard mask;
+            bitboard magic;
+            const bitboard *magic_attacks;
+            const bitboard *pext_attacks;
+            unsigned shift;
+        };
+
+        extern std::array<slider_table, 64> rook_tables;
+        extern std::array<slider_table, 64> bishop_tables;
+        extern std::array<std::array<bitboard, 64>, 2> pawn_table;
+        extern std::array<bitboard, 64> knight_table;
+        extern std::array<bitboard, 64> king_table;
+        extern std::array<std::array<bitboard, 64>, 64> between_table;
+        extern std::array<std::array<bitboard, 64>, 64> line_table;
+        extern bool use_pext;
+
+        inline bitboard pext(bitboard source, bitboard mask)
+        {
+#if CHESS_HAS_PEXT && defined(_MSC_VER)
+            return _pext_u64(source, mask);
+#elif CHESS_HAS_PEXT
+            // inline assembly does not require compiling the caller for BMI2
+            bitboard result;
+            asm("pextq %2, %1, %0" : "=r"(result) : "r"(source), "r"(mask));
+            return result;
+#else
+            (void)source;
+            (void)mask;
+            return 0;
+#endif
+        }
+
+        inline bitboard slider_attacks(const slider_table &table, bitboard occupied)
+        {
+#if CHESS_HAS_PEXT
+            if (use_pext)
+            {
+                return table.pext_attacks[pext(occupied, table.mask)];
+            }
+#endif
+            return table.magic_attacks[((occupied & table.mask) * table.magic) >> table.shift];
+        }
+    }
+
+    inline bitboard pawn_attacks(color c, square s)
+    {
+        return internal::pawn_table[c][s];
+    }
+
+    inline bitboard knight_attacks(square s)
+    {
+        return internal::knight_table[s];
+    }
+
+    inline bitboard king_attacks(square s)
+    {
+        return internal::king_table[s];
+    }
+
+    inline bitboard bishop_attacks(square s, bitboard occupied)
+    {
+        return internal::slider_attacks(internal::bishop_tables[s], occupied);
+    }
+
+    inline bitboard rook_attacks(square s, bitboard occupied)
+    {
+        return internal::slider_attacks(internal::rook_tables[s], occupied);
+    }
+
+    inline bitboard queen_attacks(square s, bitboard occupied)
+    {
+        return bishop_attacks(s, occupied) | rook_attacks(s, occupied);
+    }
+
+    // squares strictly between two aligned squares, empty otherwise
+    inline bitboard between(square from, square to)
+    {
+        return internal::between_table[from][to];
+    }
+
+    // whole line through two aligned squares, empty otherwise
+    inline bitboard line(square from, square to)
+    {
+        return internal::line_table[from][to];
+    }
+
+    // pawn attacks of every pawn of `c` in `pawns`
+    constexpr bitboard pawn_attacks_bb(color c, bitboard pawns)
+    {
+        auto up = c == white ? shift_north(pawns) : shift_south(pawns);
+        return shift_east(up) | shift_west(up);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "game/chess/types.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace chess
+{
+    constexpr bitboard file_a_bb = 0x0101010101010101ull;
+    constexpr bitboard file_h_bb = file_a_bb << 7;
+    constexpr bitboard rank_1_bb = 0xffull;
+    constexpr bitboard rank_8_bb = rank_1_bb << 56;
+
+    constexpr bitboard square_bb(square s)
+    {
+        return bitboard{1} << s;
+    }
+
+    constexpr bitboard file_bb(int file)
+    {
+        return file_a_bb << file;
+    }
+
+    constexpr bitboard rank_bb(int rank)
+    {
+        return rank_1_bb << (8 * rank);
+    }
+
+    // whole board shifted one square in a direction, without wrapping
+    // around the a and h files
+    constexpr bitboard shift_north(bitboard b) { return b << 8; }
+    constexpr bitboard shift_south(bitboard b) { return b >> 8; }
+    constexpr bitboard shift_east(bitboard b) { return (b & ~file_h_bb) << 1; }
+    constexpr bitboard shift_west(bitboard b) { return (b & ~file_a_bb) >> 1; }
+
+    // one square forward for the side `c`
+    constexpr bitboard shift_up(color c, bitboard b)
+    {
+        return c == white ? shift_north(b) : shift_south(b);
+    }
+
+    inline int popcount(bitboard b)
+    {
+#if defined(_MSC_VER)
+        return static_cast<int>(__popcnt64(b));
+#else
+        return __builtin_popcountll(b);
+#endif
+    }
+
+    // least significant square, `b` must not be empty
+    inline square lsb(bitboard b)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, b);
+        return static_cast<square>(index);
+#else
+        return __builtin_ctzll(b);
+#endif
+    }
+
+    inline square pop_lsb(bitboard &b)
+    {
+        auto s = lsb(b);
+        b &= b - 1;
+        return s;
+    }
+
+    constexpr bool more_than_one(bitboard b)
+    {
+        return (b & (b - 1)) != 0;
+    }
+}
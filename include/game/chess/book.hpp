@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "game/chess/mapped_file.hpp"
+#include "game/chess/pgn.hpp"
+
+// opening book in the Polyglot layout: 16-byte big-endian records (key,
+// move, weight, learn) sorted by key. The keys are the engine's own
+// Zobrist keys, not the Polyglot ones, so books are only exchanged between
+// builds of this engine. The weight of a move is 2 per game won and 1 per
+// game drawn by the side playing it, the learn field counts its games.
+//
+// The book is mapped: opening it costs nothing and probing is a binary
+// search into the file, without allocation.
+
+namespace chess
+{
+    // looked for in the working directory by the UCI engine and the board
+    // scene
+    constexpr std::string_view default_book_file = "cpp_chess.bin";
+
+    struct book_move
+    {
+        move m;
+        std::uint16_t weight;
+        std::uint32_t games;
+    };
+
+    // more moves of a position are ignored
+    constexpr std::size_t max_book_moves = 32;
+
+    struct book_moves
+    {
+        std::array<book_move, max_book_moves> moves;
+        std::size_t count{0};
+        std::uint32_t total_weight{0};
+
+        std::size_t size() const { return count; };
+        bool empty() const { return count == 0; };
+        const book_move &operator[](std::size_t i) const { return moves[i]; };
+        const book_move *begin() const { return moves.data(); };
+        const book_move *end() const { return moves.data() + count; };
+    };
+
+    class opening_book
+    {
+    public:
+        // false when the file is missing or not a book
+        bool open(const std::string &path);
+        void close();
+
+        bool is_open() const { return m_entries > 0; };
+        std::size_t size() const { return m_entries; };
+
+        // the legal book moves of the position, by decreasing weight.
+        // Records whose move is not legal, from a key collision, are skipped
+        void probe(const position &pos, book_moves &moves) const;
+        // a book move drawn in proportion to the weights, `random` is any
+        // 64-bit random number. `no_move` out of book
+        move pick(const position &pos, std::uint64_t random) const;
+
+    private:
+        mapped_file m_file;
+        std::size_t m_entries{0};
+    };
+
+    struct book_build_options
+    {
+        int threads{1};
+        // moves past this ply of the game are not counted
+        int max_ply{24};
+        // moves played in fewer games are left out
+        std::uint32_t min_games{2};
+    };
+
+    struct book_build_stats
+    {
+        std::uint64_t games{0};
+        std::uint64_t skipped{0};
+        std::uint64_t positions{0};
+        std::uint64_t entries{0};
+    };
+
+    // aggregates the moves of the games into a book at `path`. False when
+    // the file cannot be written
+    bool build_opening_book(std::string_view pgn, const std::string &path, const book_build_options &options,
+                            book_build_stats &stats);
+}
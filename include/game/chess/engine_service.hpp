@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "engine/spsc_queue.hpp"
+#include "game/chess/book.hpp"
+#include "game/chess/search.hpp"
+
+// search running on a worker thread, driven from the main loop without
+// blocking it. Commands and results travel through lock-free single
+// producer/single consumer queues: one thread (the owner, e.g. a `Scene`)
+// sends commands and polls the results, typically once per update.
+//
+// `stop` and `ponderhit` act on the running search directly, they cannot
+// wait behind it in the command queue.
+
+namespace chess
+{
+    struct engine_command
+    {
+        enum class kind : std::uint8_t
+        {
+            go,
+            set_threads,
+            set_hash,
+            new_game,
+            set_book,
+        };
+
+        kind type{kind::go};
+        std::uint32_t search_id{0};
+        position pos{};
+        search_limits limits{};
+        // threads or MB
+        std::size_t value{0};
+        std::shared_ptr<const opening_book> book{};
+    };
+
+    struct engine_event
+    {
+        enum class kind : std::uint8_t
+        {
+            // a depth of the search completed
+            info,
+            // the search ended, last event of a `go`
+            bestmove,
+        };
+
+        kind type{kind::info};
+        std::uint32_t search_id{0};
+        search_info info{};
+        search_result result{};
+    };
+
+    class engine_service
+    {
+    public:
+        static constexpr std::size_t command_capacity = 8;
+        static constexpr std::size_t event_capacity = 64;
+
+        explicit engine_service(int threads = 1, std::size_t hash_mb = transposition_table::default_mb);
+        ~engine_service();
+
+        engine_service(const engine_service &) = delete;
+        engine_service &operator=(const engine_service &) = delete;
+
+        // owner thread only, none of these block. Commands return false (or
+        // 0 for `go`) when the command queue is full
+        std::uint32_t go(const position &pos, const search_limits &limits);
+        void stop();
+        void ponderhit();
+        bool set_threads(int count);
+        bool set_hash(std::size_t mb);
+        // clears the hash table and move ordering
+        bool new_game();
+        // used by the searches with `limits.book`, null for none. Shared:
+        // the owner may keep probing it, e.g. to show the book moves
+        bool set_book(std::shared_ptr<const opening_book> book);
+
+        // the next result, false when none is waiting
+        bool poll(engine_event &event);
+
+        // a `go` was sent and its bestmove not polled yet
+        bool searching() const { return m_pending != 0; };
+        std::uint32_t current_search() const { return m_last_id; };
+        // infos dropped because the owner did not poll fast enough, the
+        // bestmove is never dropped
+        std::uint64_t dropped_infos() const { return m_dropped.load(std::memory_order_relaxed); };
+
+    private:
+        bool send(engine_command &&command);
+        void run();
+        void run_search(engine_command &command);
+
+        search_engine m_search;
+        // worker side
+        std::shared_ptr<const opening_book> m_book;
+        std::mt19937_64 m_random{std::random_device{}()};
+
+        spsc_queue<engine_command, command_capacity> m_commands;
+        spsc_queue<engine_event, event_capacity> m_events;
+
+        // owner side
+        std::uint32_t m_last_id{0};
+        std::uint32_t m_pending{0};
+
+        // latest search ids which were stopped or ponderhit by the owner,
+        // checked by the worker when the request raced the search start
+        std::atomic<std::uint32_t> m_stopped_id{0};
+        std::atomic<std::uint32_t> m_ponderhit_id{0};
+        std::atomic<std::uint64_t> m_dropped{0};
+        std::atomic<bool> m_quit{false};
+
+        // the idle worker sleeps on it, the owner only notifies
+        std::mutex m_wake_mutex;
+        std::condition_variable m_wake;
+        std::thread m_worker;
+    };
+}
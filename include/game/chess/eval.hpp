@@ -0,0 +1,22 @@
+#pragma once
+
+#include "game/chess/position.hpp"
+
+namespace chess
+{
+    // centipawns
+    constexpr int pawn_value = 100;
+    constexpr int knight_value = 320;
+    constexpr int bishop_value = 330;
+    constexpr int rook_value = 500;
+    constexpr int queen_value = 900;
+
+    // material and piece-square tables, blended between middle game and
+    // endgame by the material left. From the side to move's point of view
+    int evaluate(const position &pos);
+
+    int piece_value(piece_type type);
+    // material and table value of `p` on `s` for its own side, the king
+    // halfway between its middle game and endgame tables
+    int piece_square_value(piece p, square s);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "game/chess/mapped_file.hpp"
+#include "game/chess/pgn.hpp"
+
+// compact game database and the index of the positions its games reach.
+//
+// Games file (.cdb): the games in blocks of about 32 KB, each compressed
+// on its own with a small LZ77 coder, and a directory of the blocks at the
+// end. A move is stored as its index in the list of legal moves, as a
+// varint: one byte per move for nearly every game.
+//
+// Index file (.cdx): one record per position and game, (Zobrist key, game
+// number) sorted by key. The keys are uniformly distributed, the lookups
+// interpolate and touch a handful of pages of the mapped file.
+//
+// `build_game_database` writes both from PGN text. The threads replay
+// their share of the games and sort the index records in runs of bounded
+// size on disk, the runs are merged at the end.
+
+namespace chess
+{
+    // <name>.cdb and <name>.cdx, looked for in the working directory by the
+    // board scene
+    constexpr std::string_view default_database = "cpp_chess";
+
+    enum class game_result : std::uint8_t
+    {
+        white_wins,
+        black_wins,
+        draw,
+        unknown,
+    };
+
+    struct game_record
+    {
+        std::string white;
+        std::string black;
+        std::string event;
+        std::string date;
+        // empty for the start position
+        std::string fen;
+        game_result result{game_result::unknown};
+        std::vector<move> moves;
+        // the uncompressed block of the last read, reused
+        std::vector<std::uint8_t> block;
+        std::uint32_t block_index{~0u};
+    };
+
+    class game_database
+    {
+    public:
+        // false when the file is missing or malformed
+        bool open(const std::string &path);
+        void close();
+
+        std::uint32_t size() const { return m_games; };
+
+        // plays the game on `pos` while decoding it, `pos` is left at its
+        // end. False for a bad number or a corrupt block
+        bool read_game(std::uint32_t number, game_record &game, position &pos) const;
+
+    private:
+        mapped_file m_file;
+        std::uint32_t m_games{0};
+        std::uint32_t m_blocks{0};
+        const std::uint8_t *m_directory{nullptr};
+    };
+
+    // records of one position, as indices into the index
+    struct index_range
+    {
+        std::size_t begin{0};
+        std::size_t end{0};
+
+        std::size_t size() const { return end - begin; };
+        bool empty() const { return begin == end; };
+    };
+
+    class position_index
+    {
+    public:
+        bool open(const std::string &path);
+        void close();
+
+        std::size_t size() const { return m_entries; };
+
+        // the games reaching the position, each once, in game order. Does
+        // not allocate
+        index_range find(std::uint64_t key) const;
+        std::uint32_t game_at(std::size_t entry) const;
+
+    private:
+        std::uint64_t key_at(std::size_t entry) const;
+
+        mapped_file m_file;
+        const std::uint8_t *m_records{nullptr};
+        std::size_t m_entries{0};
+    };
+
+    struct game_db_build_options
+    {
+        int threads{1};
+        // for the index runs of every thread together
+        std::size_t memory_mb{256};
+        std::string temp_dir{"."};
+    };
+
+    struct game_db_build_stats
+    {
+        std::uint64_t games{0};
+        std::uint64_t skipped{0};
+        std::uint64_t positions{0};
+        std::uint64_t runs{0};
+        std::uint64_t games_bytes{0};
+        std::uint64_t index_bytes{0};
+    };
+
+    // writes `<name>.cdb` and `<name>.cdx`. Games which cannot be replayed
+    // are skipped. False when a file cannot be written
+    bool build_game_database(std::string_view pgn, const std::string &name, const game_db_build_options &options,
+                             game_db_build_stats &stats);
+}
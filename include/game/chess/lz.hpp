@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// small LZ77 coder for the data files of the engine (game database,
+// tablebases). Fast to decode, each buffer is compressed on its own.
+
+namespace chess
+{
+    // appends the compressed `in` to `out`
+    void lz_compress(const std::uint8_t *in, std::size_t size, std::vector<std::uint8_t> &out);
+    // false on corrupt data, or when it does not decode to `out_size` bytes
+    bool lz_decompress(const std::uint8_t *in, std::size_t size, std::uint8_t *out, std::size_t out_size);
+}
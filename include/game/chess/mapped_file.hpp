@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace chess
+{
+    // read-only memory mapping of a whole file. The pages are loaded by the
+    // OS on first access and shared between processes mapping the same
+    // file: large files are neither copied nor read upfront.
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+        ~mapped_file();
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+        mapped_file(mapped_file &&other) noexcept;
+        mapped_file &operator=(mapped_file &&other) noexcept;
+
+        // false when the file cannot be opened or mapped, the previous
+        // mapping is closed either way
+        bool open(const std::string &path);
+        void close();
+
+        bool is_open() const { return m_open; };
+        const std::byte *data() const { return m_data; };
+        std::size_t size() const { return m_size; };
+        std::string_view text() const { return {reinterpret_cast<const char *>(m_data), m_size}; };
+
+    private:
+        const std::byte *m_data{nullptr};
+        std::size_t m_size{0};
+        bool m_open{false};
+#ifdef _WIN32
+        void *m_file{nullptr};
+        void *m_mapping{nullptr};
+#endif
+    };
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "game/chess/search.hpp"
+
+// engine against engine matches, for testing changes to the engine. Both
+// engines are search engines of this process: a worker thread plays one
+// game after the other with its own pair of engines, nothing is spawned per
+// game.
+//
+// Each opening is played twice, the engines swapping colors, so that an
+// unbalanced opening favours neither. The result is an Elo difference and,
+// when bounds are given, a sequential probability ratio test stopping the
+// match as soon as one of the hypotheses is accepted.
+
+namespace chess
+{
+    struct match_engine
+    {
+        std::string name;
+        // a budget per move, usually nodes or movetime
+        search_limits limits{.depth = max_search_ply - 1, .nodes = 10000};
+        std::size_t hash_mb{transposition_table::default_mb};
+    };
+
+    // H0: the first engine is `elo0` stronger than the second, H1: `elo1`
+    struct sprt_bounds
+    {
+        double elo0{0.0};
+        double elo1{5.0};
+        double alpha{0.05};
+        double beta{0.05};
+    };
+
+    enum class sprt_state
+    {
+        running,
+        accept_h0,
+        accept_h1,
+    };
+
+    struct match_options
+    {
+        std::array<match_engine, 2> engines{};
+        // FENs, the start position when empty
+        std::vector<std::string> openings{};
+        int games{1000};
+        // games played at the same time, each on its own thread
+        int concurrency{1};
+        // adjudicated a draw after as many plies
+        int max_plies{400};
+        // positions in the loaded endgame tablebases end the game
+        bool tablebase_adjudication{true};
+        bool sprt{false};
+        sprt_bounds bounds{};
+    };
+
+    struct match_engine_stats
+    {
+        std::uint64_t moves{0};
+        std::uint64_t nodes{0};
+        std::uint64_t depth{0};
+        // spent searching
+        std::uint64_t microseconds{0};
+        std::uint64_t max_microseconds{0};
+    };
+
+    // from the point of view of the first engine
+    struct match_stats
+    {
+        int games{0};
+        int wins{0};
+        int draws{0};
+        int losses{0};
+        // ended by the ply limit or the tablebases
+        int adjudicated{0};
+        std::array<match_engine_stats, 2> engines;
+        double llr{0.0};
+        sprt_state sprt{sprt_state::running};
+    };
+
+    // logistic Elo of the score of the first engine, and the half width of
+    // its 95% confidence interval
+    double elo_difference(const match_stats &stats);
+    double elo_error(const match_stats &stats);
+
+    // log-likelihood ratio of H1 against H0, normal approximation of the
+    // trinomial distribution of the results
+    double sprt_llr(const match_stats &stats, const sprt_bounds &bounds);
+    // log(beta / (1 - alpha)) and log((1 - beta) / alpha)
+    double sprt_lower(const sprt_bounds &bounds);
+    double sprt_upper(const sprt_bounds &bounds);
+
+    // FENs of an EPD file, or of the positions after `plies` moves of each
+    // game of a PGN file. Duplicates are kept. False when the file cannot
+    // be read
+    bool load_openings(const std::string &path, int plies, std::vector<std::string> &fens);
+
+    // called after every game, by one thread at a time
+    using match_callback = std::function<void(const match_stats &)>;
+
+    // blocks until every game is played or the SPRT ends the match
+    match_stats play_match(const match_options &options, const match_callback &on_game = {});
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include "game/chess/position.hpp"
+
+namespace chess
+{
+    // no position has more legal moves
+    constexpr std::size_t max_moves = 256;
+
+    // fixed-capacity list on the stack, the moves are left uninitialized
+    struct move_list
+    {
+        std::array<move, max_moves> moves;
+        std::size_t count{0};
+
+        void push_back(move m) { moves[count++] = m; };
+        void clear() { count = 0; };
+        std::size_t size() const { return count; };
+        bool empty() const { return count == 0; };
+        move operator[](std::size_t i) const { return moves[i]; };
+        move *begin() { return moves.data(); };
+        move *end() { return moves.data() + count; };
+        const move *begin() const { return moves.data(); };
+        const move *end() const { return moves.data() + count; };
+    };
+
+    // legal moves of the side to move. Pinned pieces only move along their
+    // pin and, in check, only the moves resolving the check are generated
+    void generate_legal(const position &pos, move_list &list);
+
+    // the legal move written in long algebraic notation, `no_move` if the
+    // move is malformed or illegal
+    move parse_uci(const position &pos, std::string_view uci);
+
+    // leaf nodes of the legal move tree `depth` plies deep
+    std::uint64_t perft(position &pos, int depth);
+}
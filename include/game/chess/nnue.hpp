@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "game/chess/position.hpp"
+
+// NNUE-style evaluation, a small network whose first layer is updated
+// incrementally:
+//
+//   768 piece-square features, seen from each side
+//     -> 128 int16 neurons per side (the accumulators)
+//     -> clipped to [0, 127], side to move first, as 256 int8
+//     -> one output with int8 weights
+//
+// A move changes at most 4 features, the accumulators are updated with the
+// weight rows of those instead of being summed again. The kernels use AVX2,
+// SSE4.1 or plain C++, selected at runtime.
+//
+// The weights come from a network file, mapped in memory, or from the
+// bundled network which reproduces the material and piece-square tables of
+// `evaluate` (without the king taper): the engine plays sensibly without a
+// trained file.
+
+namespace chess::nnue
+{
+    constexpr int feature_count = 768;
+    constexpr int hidden_size = 128;
+    // the output sum is scaled to centipawns by `output_scale / 64`
+    constexpr int output_scale_shift = 6;
+
+    // looked for in the working directory at startup
+    constexpr std::string_view default_file = "cpp_chess.nnue";
+
+    enum class simd_level
+    {
+        scalar,
+        sse41,
+        avx2,
+    };
+
+    // best level supported by the CPU, detected once
+    simd_level detect_simd_level();
+    simd_level active_simd_level();
+    const char *simd_level_name(simd_level level);
+    // false when the CPU does not support the level
+    bool set_simd_level(simd_level level);
+
+    // views of the weights, in the mapped file or the bundled network
+    struct network
+    {
+        const std::int16_t *feature_biases;
+        // [feature][hidden_size]
+        const std::int16_t *feature_weights;
+        // side to move's neurons first
+        const std::int8_t *output_weights;
+        std::int32_t output_bias;
+        std::int32_t output_scale;
+    };
+
+    // not while searching, the evaluators read the weights in place. False
+    // when the file is missing or malformed, the active network is kept
+    bool load_network(const std::string &path);
+    void use_bundled_network();
+    const network &active_network();
+    // file name, or "bundled"
+    const std::string &network_name();
+    // the bundled network in the file format, a starting point for training
+    bool write_bundled_network(const std::string &path);
+
+    // the search uses the handcrafted evaluation when disabled
+    bool enabled();
+    void set_enabled(bool enabled);
+
+    // accumulators of the positions along the searched line. `push` after
+    // each make_move and `pop` after each unmake_move: the moves only record
+    // their changes, the accumulators are brought up to date from the
+    // nearest computed one when a position is evaluated. Positions which
+    // are cut off before their evaluation cost nothing.
+    class evaluator
+    {
+    public:
+        // plies past `reset`, more than a search reaches
+        static constexpr int max_depth = 256;
+
+        // from scratch, for a new root
+        void reset(const position &pos);
+        void push(const position &pos);
+        void pop() { --m_top; };
+
+        // from the side to move's point of view
+        int evaluate(const position &pos);
+
+    private:
+        struct entry
+        {
+            alignas(32) std::array<std::array<std::int16_t, hidden_size>, 2> values;
+            bool computed{false};
+            dirty_piece dirty;
+        };
+
+        void update(int index);
+
+        const network *m_network{nullptr};
+        std::array<entry, max_depth> m_stack;
+        int m_top{0};
+    };
+
+    // without incremental updates, slower: for tools and checks
+    int evaluate(const position &pos);
+}
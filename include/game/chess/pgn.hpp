@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "game/chess/movegen.hpp"
+
+// Portable Game Notation. The reader works on text already in memory,
+// usually a `mapped_file`: tags and moves are views into the text, nothing
+// is copied. Games are separated where a line starts with `[` after the
+// movetext, as in the export format, which also lets a large file be split
+// between threads without parsing it first.
+
+namespace chess
+{
+    struct pgn_tag
+    {
+        std::string_view name;
+        // between the quotes, escapes are left as is
+        std::string_view value;
+    };
+
+    // views into the text of the reader
+    struct pgn_game
+    {
+        std::vector<pgn_tag> tags;
+        std::string_view movetext;
+        // offset of the game in the text given to the reader
+        std::size_t offset{0};
+
+        // empty when missing
+        std::string_view tag(std::string_view name) const;
+    };
+
+    // games of a PGN text, one after the other
+    class pgn_reader
+    {
+    public:
+        explicit pgn_reader(std::string_view text) : m_text{text} {};
+
+        // false at the end of the text. `game` is overwritten, its vector
+        // of tags is reused
+        bool next(pgn_game &game);
+
+    private:
+        std::string_view m_text;
+        std::size_t m_offset{0};
+    };
+
+    // the moves of a movetext in SAN, skipping move numbers, comments,
+    // variations, annotation glyphs and the result
+    class san_tokenizer
+    {
+    public:
+        explicit san_tokenizer(std::string_view movetext) : m_text{movetext} {};
+
+        bool next(std::string_view &san);
+
+    private:
+        std::string_view m_text;
+        std::size_t m_offset{0};
+    };
+
+    // the legal move written in standard algebraic notation, `no_move` if
+    // the move is malformed, illegal or ambiguous. Check marks and
+    // annotations are ignored, castling may be written with zeros
+    move parse_san(const position &pos, std::string_view san);
+    // `m` must be legal. It is made and unmade to mark checks and mates
+    std::string to_san(position &pos, move m);
+
+    using pgn_move_callback = std::function<void(const position &pos, move m)>;
+
+    struct pgn_replay
+    {
+        bool ok{false};
+        int plies{0};
+        // the move which could not be played, empty for a bad FEN tag
+        std::string_view error;
+    };
+
+    // plays the game on `pos` from its FEN tag or the start position,
+    // `on_move` is called before each move is made
+    pgn_replay replay_game(const pgn_game &game, position &pos, const pgn_move_callback &on_move = {});
+
+    // `text` cut into at most `parts` consecutive pieces of about the same
+    // size, starting at game boundaries: each can be read by its own thread
+    std::vector<std::string_view> split_games(std::string_view text, std::size_t parts);
+}
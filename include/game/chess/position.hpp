@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include "game/chess/attacks.hpp"
+
+namespace chess
+{
+    // pieces moved by a move, for incremental evaluation: a square is
+    // `no_square` when the piece left or entered the board. At most a
+    // promotion with capture (pawn off, promoted piece on, captured off)
+    struct dirty_piece
+    {
+        int count{0};
+        std::array<piece, 3> pieces;
+        std::array<square, 3> from;
+        std::array<square, 3> to;
+    };
+
+    // state which cannot be recovered when a move is unmade, kept for every
+    // ply of the game
+    struct state_info
+    {
+        std::uint8_t castling{no_castling};
+        // only set when a pawn can capture en passant
+        square ep_square{no_square};
+        int halfmove_clock{0};
+        piece captured{no_piece};
+        // pieces giving check to the side to move
+        bitboard checkers{0};
+        // Zobrist hash, updated incrementally by make_move
+        std::uint64_t key{0};
+        // repetitions are not looked for across a null move
+        int plies_from_null{0};
+        // changes made by the move leading here
+        dirty_piece dirty;
+    };
+
+    // board with bitboards per piece type and color, and a mailbox. Moves
+    // are made and unmade in place, the irreversible state is pushed on a
+    // fixed-size stack: nothing is allocated.
+    class position
+    {
+    public:
+        static constexpr std::string_view start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+        // states kept, longer games drop the oldest ones: moves can only be
+        // unmade `max_ply - keep_ply` plies back
+        static constexpr int max_ply = 1024;
+        static constexpr int keep_ply = 128;
+
+        // start position
+        position();
+
+        // false on a malformed FEN, the position is left unchanged
+        bool set_fen(std::string_view fen);
+        std::string fen() const;
+
+        // `m` must be legal
+        void make_move(move m);
+        void unmake_move(move m);
+        // passes the turn, for null move pruning. Not allowed in check
+        void make_null_move();
+        void unmake_null_move();
+
+        color side_to_move() const { return m_side; };
+        bitboard pieces() const { return m_by_color[white] | m_by_color[black]; };
+        bitboard pieces(color c) const { return m_by_color[c]; };
+        bitboard pieces(piece_type type) const { return m_by_type[type]; };
+        bitboard pieces(color c, piece_type type) const { return m_by_color[c] & m_by_type[type]; };
+        piece piece_on(square s) const { return m_board[s]; };
+        square king_square(color c) const { return lsb(pieces(c, king)); };
+
+        const state_info &state() const { return m_states[m_ply]; };
+        std::uint8_t castling_rights() const { return state().castling; };
+        square ep_square() const { return state().ep_square; };
+        int halfmove_clock() const { return state().halfmove_clock; };
+        int fullmove_number() const { return m_fullmove; };
+        bitboard checkers() const { return state().checkers; };
+        bool in_check() const { return checkers() != 0; };
+        std::uint64_t key() const { return state().key; };
+
+        // fifty move rule or a repetition of a position since the last
+        // irreversible move
+        bool is_draw() const;
+        // any piece besides pawns and king, null moves are unsafe without
+        bool has_non_pawn_material(color c) const;
+
+        // pieces of both colors attacking `s` with the given occupancy
+        bitboard attackers_to(square s, bitboard occupied) const;
+
+    private:
+        void clear();
+        std::uint64_t compute_key() const;
+        void put_piece(piece p, square s);
+        void remove_piece(square s);
+        void move_piece(square from, square to);
+        state_info &push_state();
+
+        std::array<piece, 64> m_board;
+        std::array<bitboard, 6> m_by_type;
+        std::array<bitboard, 2> m_by_color;
+        color m_side{white};
+        int m_fullmove{1};
+
+        int m_ply{0};
+        std::array<state_info, max_ply> m_states;
+    };
+
+    // long algebraic notation, e.g. e2e4 or e7e8q
+    std::string to_uci(move m);
+    std::string square_name(square s);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "game/chess/movegen.hpp"
+#include "game/chess/tt.hpp"
+
+namespace chess
+{
+    constexpr int max_search_ply = 128;
+
+    constexpr int infinite_score = 32000;
+    constexpr int mate_score = 31000;
+    // scores beyond are mates found within the search
+    constexpr int mate_bound = mate_score - max_search_ply;
+    // a win known from the endgame tablebases, less the plies to it: below
+    // every mate found by the search
+    constexpr int tablebase_score = mate_bound - max_search_ply - 1;
+
+    inline bool is_mate_score(int score)
+    {
+        return score >= mate_bound || score <= -mate_bound;
+    }
+
+    // moves to mate, negative when being mated
+    inline int mate_in(int score)
+    {
+        return score > 0 ? (mate_score - score + 1) / 2 : -(mate_score + score) / 2;
+    }
+
+    // a search stops at the first limit reached, none means until `stop`
+    struct search_limits
+    {
+        int depth{max_search_ply - 1};
+        std::uint64_t nodes{0};
+        std::chrono::milliseconds movetime{0};
+        // search on the opponent's time: no limit applies until `ponderhit`,
+        // the movetime then counts from it
+        bool ponder{false};
+        // play a move of the opening book of the engine service without
+        // searching, when the position is in it
+        bool book{false};
+        // play the move of the endgame tablebases without searching, when
+        // the root is in them
+        bool tablebase{true};
+        // the handcrafted evaluation when false, even with the network
+        // enabled: engines of both kinds can play each other in process
+        bool nnue{true};
+    };
+
+    // sent by the main thread after every completed depth
+    struct search_info
+    {
+        int depth{0};
+        int seldepth{0};
+        int score{0};
+        std::uint64_t nodes{0};
+        std::chrono::milliseconds time{0};
+        std::uint64_t nps{0};
+        int hashfull{0};
+        // positions found in the endgame tablebases
+        std::uint64_t tbhits{0};
+        std::vector<move> pv;
+    };
+
+    struct search_result
+    {
+        move best{no_move};
+        // expected reply, for pondering
+        move ponder{no_move};
+        int score{0};
+        int depth{0};
+        std::uint64_t nodes{0};
+        std::chrono::milliseconds time{0};
+        // played from the opening book, not searched
+        bool from_book{false};
+        // played from the endgame tablebases, not searched
+        bool from_tablebase{false};
+    };
+
+    using search_callback = std::function<void(const search_info &)>;
+
+    namespace internal
+    {
+        struct search_thread;
+    }
+
+    // iterative deepening principal variation search with null move
+    // pruning, late move reductions and killer/history move ordering.
+    //
+    // Lazy SMP: every thread searches the same root on its own copy of the
+    // position, sharing only the transposition table. The helpers start at
+    // staggered depths so that they fill the table with different parts of
+    // the tree, the main thread decides when to stop and reports.
+    class search_engine
+    {
+    public:
+        search_engine();
+        ~search_engine();
+
+        search_engine(const search_engine &) = delete;
+        search_engine &operator=(const search_engine &) = delete;
+
+        // not while searching
+        void set_threads(int count);
+        int threads() const { return int(m_threads.size()); };
+        void set_hash_size(std::size_t mb);
+        std::size_t hash_size() const { return m_tt.size_mb(); };
+        // forgets the table and move ordering, for a new game
+        void clear();
+
+        // blocks until a limit is reached or `stop` is called, `on_depth`
+        // is called on the calling thread
+        search_result search(const position &pos, const search_limits &limits, const search_callback &on_depth = {});
+
+        // thread safe, the running search returns its best move so far
+        void stop();
+        bool stopping() const { return m_stop.load(std::memory_order_relaxed); };
+        // thread safe, the opponent played the expected move: a pondering
+        // search continues under its limits
+        void ponderhit();
+        bool pondering() const { return m_pondering.load(std::memory_order_relaxed); };
+
+        // nodes of the running or last search, over every thread
+        std::uint64_t nodes() const;
+        std::uint64_t tbhits() const;
+
+    private:
+        friend struct internal::search_thread;
+
+        void iterate(internal::search_thread &thread, const search_callback &on_depth);
+        bool out_of_time(const internal::search_thread &thread) const;
+        // the node budget is spent, cheap enough for every node
+        bool out_of_nodes() const;
+        // the move of the tablebases, the position restored after probing
+        bool tablebase_move(position &pos, const search_callback &on_depth, search_result &result);
+        std::chrono::steady_clock::duration limits_elapsed() const;
+
+        transposition_table m_tt;
+        std::vector<std::unique_ptr<internal::search_thread>> m_threads;
+        std::atomic<bool> m_stop{false};
+
+        search_limits m_limits;
+        std::chrono::steady_clock::time_point m_start;
+        // the time limits count from here, moved by `ponderhit`
+        std::atomic<std::chrono::steady_clock::rep> m_limits_start{0};
+        std::atomic<bool> m_pondering{false};
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "game/chess/position.hpp"
+
+// endgame tablebases of up to 5 pieces, generated by retrograde analysis.
+//
+// A table holds one material balance, e.g. KQvKR, the stronger side as
+// white: positions with the colors reversed are probed mirrored. The index
+// of a position is the side to move, the white king reduced by symmetry
+// (10 squares without pawns, 32 with) and the squares of the other pieces.
+//
+// Two files per table, both cut into blocks of 4 KB compressed on their
+// own:
+//
+//   <material>.ctw   win, draw or loss for the side to move, 2 bits each
+//   <material>.ctz   plies to mate, or to the capture or promotion which
+//                    keeps the result (the distance to zeroing, except that
+//                    pawn moves within the table do not count as zeroing)
+//
+// The files are mapped, a probe decompresses the block it needs into a
+// shared cache of the most recently used blocks. Positions with castling
+// rights are not probed. The tables hold no en passant rights: a probe
+// weighs the capture itself, but within a table a double push is valued as
+// if it could not be taken en passant. The fifty-move rule is ignored.
+
+namespace chess::tb
+{
+    constexpr int max_pieces = 5;
+    // looked for in the working directory at startup
+    constexpr std::string_view default_directory = "tablebases";
+    constexpr std::size_t default_cache_mb = 16;
+
+    // for the side to move
+    enum class wdl : std::int8_t
+    {
+        loss = -1,
+        draw = 0,
+        win = 1,
+    };
+
+    struct probe_result
+    {
+        wdl value{wdl::draw};
+        // plies, 0 for a draw
+        int distance{0};
+    };
+
+    // the tables found in `directory`, replacing those loaded before. Not
+    // while searching. Returns the number of tables
+    int load(const std::string &directory, std::size_t cache_mb = default_cache_mb);
+    void unload();
+    // pieces of the largest table loaded, 0 when none
+    int largest();
+
+    // false when no table holds the position. Thread safe
+    bool probe_wdl(const position &pos, wdl &value);
+    bool probe(const position &pos, probe_result &result);
+    // the move keeping the result of the position, the fastest win or the
+    // slowest loss. `no_move` when the position is not in the tables
+    move best_move(position &pos, probe_result &result);
+
+    struct cache_stats
+    {
+        std::uint64_t hits{0};
+        std::uint64_t misses{0};
+    };
+    cache_stats get_cache_stats();
+
+    // material balances of `pieces` pieces, those a table converts into
+    // first: fewer pawns first, as a promotion keeps the piece count
+    std::vector<std::string> materials(int pieces);
+
+    struct generate_options
+    {
+        int threads{1};
+    };
+
+    struct generate_stats
+    {
+        std::uint64_t entries{0};
+        std::uint64_t legal{0};
+        std::uint64_t wins{0};
+        std::uint64_t draws{0};
+        std::uint64_t losses{0};
+        int max_distance{0};
+        std::uint64_t wdl_bytes{0};
+        std::uint64_t distance_bytes{0};
+    };
+
+    // writes the table of `material`, e.g. "KQvKR", into `directory`. The
+    // tables it converts into, with a capture or a promotion, are read
+    // from there and must exist. False for a malformed material, a
+    // missing table or a file which cannot be written
+    bool generate(std::string_view material, const std::string &directory, const generate_options &options,
+                  generate_stats &stats);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "game/chess/types.hpp"
+
+namespace chess
+{
+    enum class tt_bound : std::uint8_t
+    {
+        none,
+        // the score is at most, at least or exactly the stored one
+        upper,
+        lower,
+        exact,
+    };
+
+    struct tt_entry
+    {
+        move best;
+        int score;
+        int eval;
+        int depth;
+        tt_bound bound;
+    };
+
+    // hash table shared by every search thread without locks. An entry is
+    // two 64 bit words written separately: the key is stored XORed with the
+    // data, a torn entry from concurrent writes fails the key check on probe
+    // and reads as a miss.
+    class transposition_table
+    {
+    public:
+        static constexpr std::size_t default_mb = 16;
+
+        transposition_table();
+
+        // rounded down to a power of two of entries, clears the table
+        void resize(std::size_t mb);
+        std::size_t size_mb() const;
+        void clear();
+
+        // starts a search, entries of older searches are replaced first
+        void new_search();
+
+        bool probe(std::uint64_t key, tt_entry &entry) const;
+        void store(std::uint64_t key, move best, int score, int eval, int depth, tt_bound bound);
+
+        // permille of the entries written by the current search, sampled
+        int hashfull() const;
+
+    private:
+        struct slot
+        {
+            std::atomic<std::uint64_t> key;
+            std::atomic<std::uint64_t> data;
+        };
+
+        slot &slot_for(std::uint64_t key) const { return m_slots[key & m_mask]; };
+
+        std::unique_ptr<slot[]> m_slots;
+        std::size_t m_count{0};
+        std::uint64_t m_mask{0};
+        std::uint8_t m_age{0};
+    };
+}
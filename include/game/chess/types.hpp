@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+
+// basic chess types. Squares are numbered from a1 = 0 to h8 = 63, file
+// first: b1 = 1, a2 = 8.
+
+namespace chess
+{
+    using bitboard = std::uint64_t;
+    using square = int;
+
+    constexpr square no_square = 64;
+
+    enum color : std::uint8_t
+    {
+        white,
+        black,
+    };
+
+    constexpr color operator~(color c)
+    {
+        return color(c ^ 1);
+    }
+
+    enum piece_type : std::uint8_t
+    {
+        pawn,
+        knight,
+        bishop,
+        rook,
+        queen,
+        king,
+        no_piece_type,
+    };
+
+    // white pieces first, `make_piece` and `type_of` convert
+    enum piece : std::uint8_t
+    {
+        white_pawn,
+        white_knight,
+        white_bishop,
+        white_rook,
+        white_queen,
+        white_king,
+        black_pawn,
+        black_knight,
+        black_bishop,
+        black_rook,
+        black_queen,
+        black_king,
+        no_piece,
+    };
+
+    constexpr piece make_piece(color c, piece_type type)
+    {
+        return piece(c * 6 + type);
+    }
+
+    constexpr piece_type type_of(piece p)
+    {
+        return piece_type(p % 6);
+    }
+
+    constexpr color color_of(piece p)
+    {
+        return color(p / 6);
+    }
+
+    // castling rights, as bit flags
+    enum castling : std::uint8_t
+    {
+        no_castling = 0,
+        white_king_side = 1,
+        white_queen_side = 2,
+        black_king_side = 4,
+        black_queen_side = 8,
+        all_castling = 15,
+    };
+
+    constexpr int file_of(square s)
+    {
+        return s & 7;
+    }
+
+    constexpr int rank_of(square s)
+    {
+        return s >> 3;
+    }
+
+    constexpr square make_square(int file, int rank)
+    {
+        return rank * 8 + file;
+    }
+
+    // the square seen from the side of `c`: a1 for white is a8 for black
+    constexpr square relative_square(color c, square s)
+    {
+        return s ^ (c * 56);
+    }
+
+    constexpr int relative_rank(color c, square s)
+    {
+        return rank_of(relative_square(c, s));
+    }
+
+    // move packed in 16 bits: origin (6 bits), destination (6 bits) and
+    // flags (4 bits). Castling is encoded as the king move
+    enum move_flag : std::uint8_t
+    {
+        quiet = 0,
+        double_push = 1,
+        king_castle = 2,
+        queen_castle = 3,
+        capture = 4,
+        en_passant = 5,
+        // + promoted piece - knight, 12 and above are captures as well
+        promotion = 8,
+        promotion_capture = 12,
+    };
+
+    class move
+    {
+    public:
+        // left uninitialized, move lists are not cleared
+        move() = default;
+        constexpr explicit move(std::uint16_t data) : m_data{data} {};
+        constexpr move(square from, square to, move_flag flags = quiet)
+            : m_data{static_cast<std::uint16_t>(from | (to << 6) | (flags << 12))} {};
+
+        constexpr square from() const { return m_data & 63; };
+        constexpr square to() const { return (m_data >> 6) & 63; };
+        constexpr move_flag flags() const { return move_flag(m_data >> 12); };
+        constexpr std::uint16_t data() const { return m_data; };
+
+        constexpr bool is_capture() const { return (flags() & capture) != 0; };
+        constexpr bool is_promotion() const { return (flags() & promotion) != 0; };
+        constexpr bool is_castling() const { return flags() == king_castle || flags() == queen_castle; };
+        constexpr piece_type promotion_type() const { return piece_type(knight + (flags() & 3)); };
+
+        constexpr bool operator==(move other) const { return m_data == other.m_data; };
+        constexpr bool operator!=(move other) const { return m_data != other.m_data; };
+
+    private:
+        std::uint16_t m_data;
+    };
+
+    // a1a1, never a legal move
+    constexpr move no_move{std::uint16_t{0}};
+}
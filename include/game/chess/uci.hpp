@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include "game/chess/engine_service.hpp"
+
+// Universal Chess Interface front-end of the engine service. The session
+// only parses commands and prints results, the search runs on the service
+// threads: `handle` returns at once, even for `go`, so that `stop` is read
+// while searching.
+
+namespace chess
+{
+    class uci_session
+    {
+    public:
+        static constexpr int max_hash_mb = 65536;
+        static constexpr int max_threads = 256;
+
+        explicit uci_session(std::FILE *out);
+
+        // one line of input, false once `quit` was read
+        bool handle(std::string_view line);
+
+        // prints the results of the service, false when there were none
+        bool poll();
+
+        bool searching() const { return m_service.searching(); };
+
+    private:
+        void set_option(std::string_view line);
+        void set_position(std::string_view line);
+        // the book of the service, false when the file is not a book
+        bool load_book(const std::string &path);
+        void go(std::string_view line);
+        void send(const std::string &line);
+        void send_network();
+        void send_info(const search_info &info);
+        void send_bestmove(const search_result &result);
+
+        std::FILE *m_out;
+        engine_service m_service;
+        position m_position;
+        engine_event m_event;
+
+        // only acknowledged, `go ponder` is searched either way
+        bool m_ponder_option{false};
+        bool m_own_book{true};
+        // `go infinite` answers only after `stop`, even when the search ends
+        // on its own
+        bool m_infinite{false};
+        bool m_stop_received{false};
+        bool m_has_deferred{false};
+        search_result m_deferred;
+    };
+}
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "engine/scene.hpp"
+#include "engine/profiler.hpp"
+#include "game/chess/book.hpp"
+#include "game/chess/engine_service.hpp"
+#include "game/chess/game_db.hpp"
+#include "game/chess/nnue.hpp"
+#include "game/chess/tablebase.hpp"
+
+// latest line of the engine, stored in the registry context
+struct engine_analysis
+{
+    std::uint32_t search_id{0};
+    chess::search_info info;
+    std::string pv;
+};
+
+// the engine plays against itself on a board of plain sprites, textured by
+// the BMP files of `assets/pieces` and `assets/board` when present. The
+// search runs on worker threads, `update` only polls its results: the frames
+// do not wait on the search, nor on the textures.
+//
+// Space pauses and resumes the game, N starts a new one.
+class ChessScene : public Scene
+{
+public:
+    static constexpr float square_size = 64.0f;
+    static constexpr float board_x = 32.0f;
+    static constexpr float board_y = 44.0f;
+    // `wp.bmp` to `bk.bmp`, and `light.bmp` and `dark.bmp`
+    static constexpr const char *piece_directory = "assets/pieces";
+    static constexpr const char *board_directory = "assets/board";
+
+    ChessScene()
+    {
+        init();
+    }
+
+    // `~Scene` cannot reach the override of `clean`
+    ~ChessScene() override
+    {
+        clean();
+    }
+
+    bool init() override
+    {
+        // leave a core to the main thread
+        auto threads = std::max<int>(int(std::thread::hardware_concurrency()) - 1, 1);
+        // a trained network in the working directory, the bundled one
+        // otherwise
+        chess::nnue::load_network(std::string(chess::nnue::default_file));
+        // optional, shows how many games reached the position
+        m_games_index.open(std::string(chess::default_database) + ".cdx");
+        // optional, endgames are then played perfectly and without searching
+        chess::tb::load(std::string(chess::tb::default_directory));
+        m_engine = std::make_unique<chess::engine_service>(threads, 64);
+        // optional too, the engine plays its moves and they are shown
+        m_book = std::make_shared<chess::opening_book>();
+        if (m_book->open(std::string(chess::default_book_file)))
+        {
+            m_engine->set_book(m_book);
+        }
+        m_registry.ctx().emplace<engine_analysis>();
+        m_pieces.fill(entt::null);
+        load_textures();
+
+        auto e_camera = m_registry.create();
+        m_registry.emplace<camera>(e_camera, camera{
+                                                 .z_index = 0,
+                                                 .view = SDL_FRect{0, 0, 800, 600},
+                                                 .viewport = SDL_FRect{0, 0, 800, 600},
+                                             });
+        m_registry.emplace<local_transform>(e_camera);
+
+        for (chess::square s = 0; s < 64; ++s)
+        {
+            auto light = (chess::file_of(s) + chess::rank_of(s)) % 2 != 0;
+            auto shade = light ? SDL_FColor{0.93f, 0.85f, 0.7f, 1.0f} : SDL_FColor{0.55f, 0.4f, 0.3f, 1.0f};
+
+            auto e_square = m_registry.create();
+            m_registry.emplace<local_transform>(e_square, local_transform{.position = square_position(s)});
+            m_registry.emplace<sprite>(e_square, sprite{
+                                                     .rect = SDL_FRect{0.0f, 0.0f, square_size, square_size},
+                                                     .tint = shade,
+                                                     .depth = 0,
+                                                 });
+            if (m_square_textures[light].valid())
+            {
+                m_registry.emplace<sprite_asset>(e_square, sprite_asset{.texture = m_square_textures[light]});
+            }
+        }
+
+        new_game();
+        return true;
+    }
+
+    void update() override
+    {
+        {
+            PROFILE_ZONE("engine_poll");
+            // never blocks: takes whatever the worker produced since the
+            // last step
+            while (m_engine->poll(m_event))
+            {
+                if (m_event.search_id != m_engine->current_search())
+                {
+                    continue;
+                }
+
+                if (m_event.type == chess::engine_event::kind::info)
+                {
+                    set_analysis(m_event.info);
+                }
+                else if (m_playing)
+                {
+                    play(m_event.result.best);
+                }
+            }
+        }
+
+        registry_updates();
+    }
+
+    void render(SDL_Renderer *renderer) override
+    {
+        auto &time = m_registry.ctx().get<frame_time>();
+        internal::render_system(m_registry, renderer, time.delta_time);
+        draw_analysis(renderer);
+    }
+
+    void handle_event(SDL_Event *event) override
+    {
+        if (event->type != SDL_EVENT_KEY_DOWN)
+        {
+            return;
+        }
+
+        if (event->key.key == SDLK_SPACE)
+        {
+            m_playing = !m_playing;
+            if (!m_playing)
+            {
+                m_engine->stop();
+            }
+            else if (!m_engine->searching())
+            {
+                start_search();
+            }
+        }
+        else if (event->key.key == SDLK_N)
+        {
+            m_engine->stop();
+            new_game();
+        }
+    }
+
+    void clean() override
+    {
+        // joins the worker threads
+        m_engine.reset();
+    }
+
+private:
+    // decoded in the background, the first frames show the plain board
+    void load_textures()
+    {
+        auto &assets = get_asset_manager();
+        if (SDL_GetPathInfo(piece_directory, nullptr))
+        {
+            constexpr char types[] = "pnbrqk";
+            for (int p = chess::white_pawn; p < chess::no_piece; ++p)
+            {
+                auto name = std::string{chess::color_of(chess::piece(p)) == chess::white ? 'w' : 'b',
+                                        types[chess::type_of(chess::piece(p))]};
+                m_piece_textures[std::size_t(p)] = assets.load(std::string(piece_directory) + "/" + name + ".bmp");
+            }
+        }
+        if (SDL_GetPathInfo(board_directory, nullptr))
+        {
+            m_square_textures[0] = assets.load(std::string(board_directory) + "/dark.bmp");
+            m_square_textures[1] = assets.load(std::string(board_directory) + "/light.bmp");
+        }
+    }
+
+    void set_piece_texture(entt::entity e_piece, chess::piece p)
+    {
+        if (m_piece_textures[p].valid())
+        {
+            m_registry.emplace_or_replace<sprite_asset>(e_piece, sprite_asset{.texture = m_piece_textures[p]});
+        }
+    }
+
+    static glm::vec3 square_position(chess::square s)
+    {
+        return {board_x + float(chess::file_of(s)) * square_size,
+                board_y + float(7 - chess::rank_of(s)) * square_size,
+                0.0f};
+    }
+
+    // pieces are squares, larger for the more valuable ones
+    static sprite piece_sprite(chess::piece p)
+    {
+        constexpr float sizes[6] = {22.0f, 32.0f, 32.0f, 36.0f, 42.0f, 48.0f};
+        auto size = sizes[chess::type_of(p)];
+        auto offset = (square_size - size) / 2.0f;
+
+        return sprite{
+            .rect = SDL_FRect{offset, offset, size, size},
+            .tint = chess::color_of(p) == chess::white ? SDL_FColor{0.98f, 0.96f, 0.9f, 1.0f}
+                                                       : SDL_FColor{0.12f, 0.1f, 0.1f, 1.0f},
+            .depth = 1,
+        };
+    }
+
+    void new_game()
+    {
+        for (auto &e_piece : m_pieces)
+        {
+            if (e_piece != entt::null)
+            {
+                m_registry.destroy(e_piece);
+                e_piece = entt::null;
+            }
+        }
+
+        m_position.set_fen(chess::position::start_fen);
+        for (chess::square s = 0; s < 64; ++s)
+        {
+            if (m_position.piece_on(s) != chess::no_piece)
+            {
+                auto e_piece = m_registry.create();
+                m_registry.emplace<local_transform>(e_piece, local_transform{.position = square_position(s)});
+                m_registry.emplace<sprite>(e_piece, piece_sprite(m_position.piece_on(s)));
+                set_piece_texture(e_piece, m_position.piece_on(s));
+                m_pieces[s] = e_piece;
+            }
+        }
+
+        m_engine->new_game();
+        m_registry.ctx().get<engine_analysis>() = engine_analysis{};
+        m_database_games = m_games_index.find(m_position.key()).size();
+        m_book->probe(m_position, m_book_moves);
+        if (m_playing)
+        {
+            start_search();
+        }
+    }
+
+    void start_search()
+    {
+        m_engine->go(m_position, chess::search_limits{.movetime = std::chrono::milliseconds{500}, .book = true});
+    }
+
+    void move_piece(chess::square from, chess::square to)
+    {
+        auto e_piece = std::exchange(m_pieces[from], entt::null);
+        m_pieces[to] = e_piece;
+        m_registry.patch<local_transform>(e_piece, [to](auto &t)
+                                          { t.position = square_position(to); });
+    }
+
+    void play(chess::move m)
+    {
+        if (m == chess::no_move)
+        {
+            new_game();
+            return;
+        }
+
+        auto from = m.from();
+        auto to = m.to();
+        auto captured = m.flags() == chess::en_passant ? to ^ 8 : to;
+        if (m.is_capture() && m_pieces[captured] != entt::null)
+        {
+            m_registry.destroy(std::exchange(m_pieces[captured], entt::null));
+        }
+
+        move_piece(from, to);
+        if (m.is_castling())
+        {
+            auto rank = chess::rank_of(from);
+            auto king_side = m.flags() == chess::king_castle;
+            move_piece(chess::make_square(king_side ? 7 : 0, rank), chess::make_square(king_side ? 5 : 3, rank));
+        }
+
+        m_position.make_move(m);
+        // microseconds, the index is mapped and interpolated
+        m_database_games = m_games_index.find(m_position.key()).size();
+        // a binary search in the mapped book, as cheap
+        m_book->probe(m_position, m_book_moves);
+        if (m.is_promotion())
+        {
+            auto promoted = piece_sprite(m_position.piece_on(to));
+            m_registry.patch<sprite>(m_pieces[to], [&promoted](auto &s)
+                                     { s = promoted; });
+            set_piece_texture(m_pieces[to], m_position.piece_on(to));
+        }
+
+        chess::move_list moves;
+        chess::generate_legal(m_position, moves);
+        if (moves.empty() || m_position.is_draw())
+        {
+            new_game();
+            return;
+        }
+        start_search();
+    }
+
+    void set_analysis(const chess::search_info &info)
+    {
+        auto &analysis = m_registry.ctx().get<engine_analysis>();
+        analysis.search_id = m_event.search_id;
+        analysis.info = info;
+
+        analysis.pv.clear();
+        for (std::size_t i = 0; i < info.pv.size() && i < 8; ++i)
+        {
+            analysis.pv += chess::to_uci(info.pv[i]) + " ";
+        }
+    }
+
+    void draw_analysis(SDL_Renderer *renderer) const
+    {
+        const auto &analysis = m_registry.ctx().get<engine_analysis>();
+        const auto &stats = m_registry.ctx().get<frame_stats>();
+        const auto &info = analysis.info;
+
+        char lines[8][96];
+        if (chess::is_mate_score(info.score))
+        {
+            std::snprintf(lines[0], sizeof(lines[0]), "depth %d/%d  mate %d", info.depth, info.seldepth, chess::mate_in(info.score));
+        }
+        else
+        {
+            std::snprintf(lines[0], sizeof(lines[0]), "depth %d/%d  score %+.2f", info.depth, info.seldepth, info.score / 100.0);
+        }
+        std::snprintf(lines[1], sizeof(lines[1]), "nodes %llu", static_cast<unsigned long long>(info.nodes));
+        std::snprintf(lines[2], sizeof(lines[2]), "nps %llu", static_cast<unsigned long long>(info.nps));
+        std::snprintf(lines[3], sizeof(lines[3]), "hash %d%%  tbhits %llu", info.hashfull / 10,
+                      static_cast<unsigned long long>(info.tbhits));
+        std::snprintf(lines[4], sizeof(lines[4]), "frame %.2f ms avg %.2f max", stats.average_ms, stats.max_ms);
+        if (m_games_index.size() > 0)
+        {
+            std::snprintf(lines[5], sizeof(lines[5]), "database games %zu", m_database_games);
+        }
+        else
+        {
+            std::snprintf(lines[5], sizeof(lines[5]), "no database");
+        }
+        if (!m_book->is_open())
+        {
+            std::snprintf(lines[6], sizeof(lines[6]), "no book");
+        }
+        else if (m_book_moves.empty())
+        {
+            std::snprintf(lines[6], sizeof(lines[6]), "out of book");
+        }
+        else
+        {
+            // the two main moves fit beside the board
+            auto length = std::snprintf(lines[6], sizeof(lines[6]), "book");
+            for (std::size_t i = 0; i < m_book_moves.size() && i < 2; ++i)
+            {
+                const auto &entry = m_book_moves[i];
+                length += std::snprintf(lines[6] + length, sizeof(lines[6]) - std::size_t(length), " %s %u%%",
+                                        chess::to_uci(entry.m).c_str(), 100 * entry.weight / m_book_moves.total_weight);
+            }
+        }
+        std::snprintf(lines[7], sizeof(lines[7]), "%s", m_playing ? "space: pause  n: new game" : "paused");
+
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        auto y = board_y;
+        for (const auto &line : lines)
+        {
+            SDL_RenderDebugText(renderer, 576.0f, y, line);
+            y += 14.0f;
+        }
+        // the principal variation, four moves per line
+        auto pv = std::string_view(analysis.pv);
+        for (std::size_t i = 0; i < pv.size(); i += 20)
+        {
+            char line[21];
+            auto length = pv.copy(line, 20, i);
+            line[length] = '\0';
+            SDL_RenderDebugText(renderer, 576.0f, y, line);
+            y += 14.0f;
+        }
+    }
+
+    std::unique_ptr<chess::engine_service> m_engine;
+    chess::position m_position;
+    std::array<entt::entity, 64> m_pieces;
+    bool m_playing{true};
+    chess::position_index m_games_index;
+    std::size_t m_database_games{0};
+    // shared with the engine worker
+    std::shared_ptr<chess::opening_book> m_book;
+    chess::book_moves m_book_moves;
+    // reused across polls
+    chess::engine_event m_event;
+    // by piece, and dark then light squares. Not valid without the files
+    std::array<texture_handle, chess::no_piece> m_piece_textures;
+    std::array<texture_handle, 2> m_square_textures;
+};
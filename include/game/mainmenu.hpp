@@ -1,6 +1,7 @@
 #pragma once
 
 #include "engine/scene.hpp"
+#include "game/chessscene.hpp"
 
 // MainMenuScene.hpp
 #include <iostream>
@@ -27,57 +28,15 @@ public:
 
         // auto &c_cam_draw_target = m_registry.emplace<internal::draw_target>(e_camera);
 
-        // Create drawable entity
+        // Create a button, drawn by the engine as a sprite
         auto e_button = m_registry.create();
 
-        auto &c_drawable = m_registry.emplace<drawable>(e_button);
-        c_drawable.depth = 0;
-        c_drawable.bounding_box = SDL_FRect{0.0f, 0.0f, 200.0f, 80.0f};
-
-        auto &c_transform = m_registry.emplace<local_transform>(e_button);
-
-        // Define draw lambda (using your system's signature)
-        c_drawable.draw = [](SDL_Renderer *renderer, glm::mat4 transform, float dt)
-        {
-            bool demo = false;
-            if (demo)
-            {
-                const char *message = "Hell World!";
-                int w = 0, h = 0;
-                float x, y;
-                const float scale = 4.0f;
-
-                /* Center the message and scale it up */
-                SDL_GetRenderOutputSize(renderer, &w, &h);
-                SDL_SetRenderScale(renderer, scale, scale);
-                x = ((w / scale) - SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE * SDL_strlen(message)) / 2;
-                y = ((h / scale) - SDL_DEBUG_TEXT_FONT_CHARACTER_SIZE) / 2;
-
-                /* Draw the message */
-                /*
-                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-                SDL_RenderClear(renderer);
-                */
-                SDL_SetRenderDrawColor(renderer, 0, 255, 255, 255);
-                SDL_RenderDebugText(renderer, x, y, message);
-                SDL_RenderPresent(renderer);
-            }
-
-            // Transform the rect's corners into world space
-            SDL_FRect rect{0.0f, 0.0f, 200.0f, 80.0f};
-            auto p0 = to_sdl_point(transform * to_vec4({rect.x, rect.y}));
-            auto p1 = to_sdl_point(transform * to_vec4({rect.x + rect.w, rect.y + rect.h}));
-
-            SDL_FRect screen_rect{
-                p0.x,
-                p0.y,
-                p1.x - p0.x,
-                p1.y - p0.y,
-            };
-
-            SDL_SetRenderDrawColor(renderer, 255, 128, 64, 255);
-            SDL_RenderFillRect(renderer, &screen_rect);
-        };
+        m_registry.emplace<local_transform>(e_button);
+        m_registry.emplace<sprite>(e_button, sprite{
+                                                 .rect = SDL_FRect{0.0f, 0.0f, 200.0f, 80.0f},
+                                                 .tint = SDL_FColor{1.0f, 0.5f, 0.25f, 1.0f},
+                                                 .depth = 0,
+                                             });
         return true;
     }
 
@@ -88,7 +47,8 @@ public:
 
     void render(SDL_Renderer *renderer) override
     {
-        internal::render_system(m_registry, renderer, 0.1f);
+        auto &time = m_registry.ctx().get<frame_time>();
+        internal::render_system(m_registry, renderer, time.delta_time);
         // draw buttons, logo, etc.
     }
 
@@ -98,6 +58,11 @@ public:
         {
             std::cout << "Main menu key press\n";
             SDL_Log("Key: %s", SDL_GetKeyName(event->key.key));
+
+            if (event->key.key == SDLK_RETURN)
+            {
+                change_scene(new ChessScene());
+            }
         }
     }
 
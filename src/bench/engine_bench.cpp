@@ -0,0 +1,749 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <SDL3/SDL.h>
+#include <entt/entt.hpp>
+
+#include "engine/game_objects.hpp"
+#include "engine/camera.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/job_system.hpp"
+#include "engine/rect_kernels.hpp"
+#include "engine/scene.hpp"
+#include "engine/spatial_grid.hpp"
+#include "engine/system_scheduler.hpp"
+#include "scene_stress.hpp"
+
+// Benchmark of the transform hierarchy systems.
+//
+// `legacy` is the recursive implementation the engine used before the
+// hierarchy was stored depth-sorted, kept here as the baseline: it walks
+// `std::unordered_set` children and recomputes every matrix every frame.
+//
+// The rect kernel run compares `transform_rect`, one glm::mat4x4 product per
+// corner or the affine2d center and extents, with the batched kernels of every instruction set the CPU supports.
+//
+// The culling run compares the linear scan of every drawable against the
+// spatial grid queries, for an increasing number of cameras.
+//
+// The reparenting stress run checks the hierarchy against a brute-force
+// recomputation after every frame and fails the process on a mismatch.
+//
+// The job run times the systems of a scene through the system scheduler
+// from 1 thread to one per core, and four independent systems which the
+// scheduler runs at the same time.
+//
+// `engine_bench --scenes` runs the headless scene stress suite instead, see
+// scene_stress.cpp.
+
+namespace legacy
+{
+    struct children
+    {
+        std::unordered_set<entt::entity> entities;
+    };
+
+    struct local_to_world
+    {
+        glm::mat4x4 mat;
+    };
+
+    struct bounding_box
+    {
+        SDL_FRect rect;
+    };
+
+    void parent_system(entt::registry &registry)
+    {
+        auto child_pov = registry.view<parent>();
+        auto parent_pov = registry.view<children>();
+
+        for (auto entity : child_pov)
+        {
+            auto &c_parent = registry.get<parent>(entity);
+
+            if (registry.valid(c_parent.entity))
+            {
+                registry.get_or_emplace<children>(c_parent.entity).entities.insert(entity);
+            }
+        }
+
+        for (auto entity : parent_pov)
+        {
+            auto &c_children = parent_pov.get<children>(entity);
+
+            auto to_remove = std::vector<entt::entity>{};
+            to_remove.reserve(c_children.entities.size());
+
+            for (auto child : c_children.entities)
+            {
+                if (!registry.valid(child) ||
+                    !child_pov.contains(child) ||
+                    registry.get<parent>(child).entity != entity)
+                {
+                    to_remove.push_back(child);
+                }
+            }
+
+            for (auto child : to_remove)
+            {
+                c_children.entities.erase(child);
+            }
+        }
+    }
+
+    void local_to_world_system(entt::registry &registry)
+    {
+        auto view = registry.view<local_transform>();
+        auto visited = entt::sparse_set();
+
+        auto compute_world_matrix = [&](auto &self, entt::entity e) -> glm::mat4x4
+        {
+            if (visited.contains(e))
+            {
+                return registry.get<local_to_world>(e).mat;
+            }
+
+            auto world_matrix = view.contains(e)
+                                    ? make_transform(view.get<local_transform>(e))
+                                    : glm::mat4x4(1.0f);
+
+            auto *c_parent = registry.try_get<parent>(e);
+            if (c_parent != nullptr && registry.valid(c_parent->entity))
+            {
+                world_matrix = self(self, c_parent->entity) * world_matrix;
+            }
+
+            registry.emplace_or_replace<local_to_world>(e, world_matrix);
+            visited.push(e);
+
+            return world_matrix;
+        };
+
+        for (auto entity : view)
+        {
+            compute_world_matrix(compute_world_matrix, entity);
+        }
+    }
+
+    void bounding_box_system(entt::registry &registry)
+    {
+        auto view = registry.view<drawable>();
+        auto visited = entt::sparse_set();
+
+        auto compute_bbox = [&](auto &self, entt::entity e) -> SDL_FRect
+        {
+            if (visited.contains(e))
+            {
+                return registry.get<bounding_box>(e).rect;
+            }
+
+            auto bbox = SDL_FRect{0.0f, 0.0f, 0.0f, 0.0f};
+            auto *c_drawable = registry.try_get<drawable>(e);
+            auto *c_transform = registry.try_get<local_to_world>(e);
+            auto *c_children = registry.try_get<children>(e);
+
+            if (c_drawable != nullptr && c_transform != nullptr)
+            {
+                bbox = transform_rect(c_transform->mat, c_drawable->bounding_box);
+            }
+
+            if (c_children != nullptr)
+            {
+                for (auto child : c_children->entities)
+                {
+                    auto child_bbox = self(self, child);
+                    SDL_GetRectUnionFloat(&bbox, &child_bbox, &bbox);
+                }
+            }
+
+            registry.emplace_or_replace<bounding_box>(e, bbox);
+            visited.push(e);
+
+            return bbox;
+        };
+
+        for (auto entity : view)
+        {
+            compute_bbox(compute_bbox, entity);
+        }
+    }
+}
+
+namespace
+{
+    struct scene_shape
+    {
+        const char *name;
+        // number of entities below each root, and how they hang from it
+        std::size_t tree_size;
+        bool deep;
+    };
+
+    // builds `count` entities split in trees of `shape.tree_size` entities,
+    // either one root with flat children or a single chain
+    std::vector<entt::entity> populate(entt::registry &registry, const scene_shape &shape, std::size_t count)
+    {
+        auto roots = std::vector<entt::entity>{};
+
+        for (std::size_t i = 0; i < count;)
+        {
+            auto root = registry.create();
+            registry.emplace<local_transform>(root, local_transform{.position = {float(i), 0.0f, 0.0f}});
+            registry.emplace<drawable>(root, drawable{.depth = 0, .bounding_box = {0.0f, 0.0f, 10.0f, 10.0f}});
+            roots.push_back(root);
+            ++i;
+
+            auto previous = root;
+            for (std::size_t j = 1; j < shape.tree_size && i < count; ++j, ++i)
+            {
+                auto child = registry.create();
+                registry.emplace<local_transform>(child, local_transform{
+                                                             .position = {1.0f, 1.0f, 0.0f},
+                                                             .rotation = {0.0f, 0.0f, 0.01f},
+                                                         });
+                registry.emplace<drawable>(child, drawable{.depth = 0, .bounding_box = {0.0f, 0.0f, 10.0f, 10.0f}});
+                registry.emplace<parent>(child, parent{shape.deep ? previous : root});
+                previous = child;
+            }
+        }
+
+        return roots;
+    }
+
+    // average ns per frame of `frame` over `frames` iterations
+    double measure(std::size_t frames, const std::function<void(std::size_t)> &frame)
+    {
+        auto begin = SDL_GetTicksNS();
+        for (std::size_t i = 0; i < frames; ++i)
+        {
+            frame(i);
+        }
+        return double(SDL_GetTicksNS() - begin) / double(frames);
+    }
+
+    void move_roots(entt::registry &registry, const std::vector<entt::entity> &roots, std::size_t frame)
+    {
+        for (auto root : roots)
+        {
+            registry.patch<local_transform>(root, [frame](auto &t)
+                                            { t.rotation.z = 0.001f * float(frame); });
+        }
+    }
+
+    void bench_hierarchy(const scene_shape &shape, std::size_t count, std::size_t frames)
+    {
+        {
+            auto registry = entt::registry{};
+            auto roots = populate(registry, shape, count);
+
+            auto ns = measure(frames, [&](std::size_t frame)
+                              {
+                                  move_roots(registry, roots, frame);
+                                  legacy::parent_system(registry);
+                                  legacy::local_to_world_system(registry);
+                                  legacy::bounding_box_system(registry); });
+
+            std::printf("%-6s %8zu  %-8s %-7s %14.0f\n", shape.name, count, "before", "moving", ns);
+        }
+
+        {
+            auto registry = entt::registry{};
+            internal::camera_setup_system(registry);
+            internal::transform_setup_system(registry);
+            auto roots = populate(registry, shape, count);
+
+            auto update = [&registry]()
+            {
+                parent_system(registry);
+                local_to_world_system(registry);
+                bounding_box_system(registry);
+            };
+            // first frame builds and sorts the hierarchy
+            update();
+
+            auto moving_ns = measure(frames, [&](std::size_t frame)
+                                     {
+                                         move_roots(registry, roots, frame);
+                                         update(); });
+            auto idle_ns = measure(frames, [&](std::size_t)
+                                   { update(); });
+
+            std::printf("%-6s %8zu  %-8s %-7s %14.0f\n", shape.name, count, "after", "moving", moving_ns);
+            std::printf("%-6s %8zu  %-8s %-7s %14.0f\n", shape.name, count, "after", "idle", idle_ns);
+        }
+    }
+}
+
+namespace
+{
+    bool nearly_equal(const world_transform &lhs_transform, const world_transform &rhs_transform)
+    {
+        auto lhs = to_mat4(lhs_transform);
+        auto rhs = to_mat4(rhs_transform);
+
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                auto tolerance = 1e-3f * std::max({1.0f, std::abs(lhs[c][r]), std::abs(rhs[c][r])});
+                if (std::abs(lhs[c][r] - rhs[c][r]) > tolerance)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // compares the hierarchy, its sibling lists, depths and world matrices
+    // with what the `parent` and `local_transform` components describe
+    bool validate_hierarchy(entt::registry &registry)
+    {
+        auto &nodes = registry.storage<internal::hierarchy>();
+        auto &worlds = registry.storage<internal::local_to_world>();
+        auto &locals = registry.storage<local_transform>();
+        auto &parents = registry.storage<parent>();
+
+        std::size_t linked = 0;
+        std::size_t listed = 0;
+
+        for (auto [entity, node] : registry.view<internal::hierarchy>().each())
+        {
+            auto expected_parent = parents.contains(entity) && registry.valid(parents.get(entity).entity)
+                                       ? parents.get(entity).entity
+                                       : entt::null;
+            if (node.parent != expected_parent)
+            {
+                return false;
+            }
+
+            auto expected_depth = node.parent == entt::null ? 0u : nodes.get(node.parent).depth + 1u;
+            if (node.depth != expected_depth)
+            {
+                return false;
+            }
+
+            linked += node.parent != entt::null;
+            for (auto child = node.first_child; child != entt::null; child = nodes.get(child).next_sibling)
+            {
+                if (nodes.get(child).parent != entity)
+                {
+                    return false;
+                }
+                ++listed;
+            }
+
+            auto expected_world = world_transform(1.0f);
+            for (auto e = entity; e != entt::null; e = nodes.get(e).parent)
+            {
+                if (locals.contains(e))
+                {
+                    expected_world = make_world_transform(locals.get(e)) * expected_world;
+                }
+            }
+            if (!nearly_equal(worlds.get(entity).mat, expected_world))
+            {
+                return false;
+            }
+        }
+
+        return linked == listed;
+    }
+
+    // reparents `per_frame` random entities every frame. An entity only ever
+    // hangs from an entity created before it, so no cycle can appear
+    bool bench_reparenting(std::size_t count, std::size_t per_frame, std::size_t frames)
+    {
+        auto registry = entt::registry{};
+        internal::camera_setup_system(registry);
+        internal::transform_setup_system(registry);
+
+        auto rng = std::mt19937{42};
+        auto entities = std::vector<entt::entity>{};
+        entities.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto entity = registry.create();
+            registry.emplace<local_transform>(entity, local_transform{
+                                                          .position = {1.0f, 0.5f, 0.0f},
+                                                          .rotation = {0.0f, 0.0f, 0.001f * float(i % 7)},
+                                                      });
+            registry.emplace<drawable>(entity, drawable{.depth = 0, .bounding_box = {0.0f, 0.0f, 10.0f, 10.0f}});
+
+            if (i > 0)
+            {
+                auto target = std::uniform_int_distribution<std::size_t>{0, i - 1}(rng);
+                registry.emplace<parent>(entity, parent{entities[target]});
+            }
+            entities.push_back(entity);
+        }
+
+        Uint64 elapsed = 0;
+        std::size_t recomputed = 0;
+        auto valid = true;
+
+        for (std::size_t frame = 0; frame <= frames && valid; ++frame)
+        {
+            auto begin = SDL_GetTicksNS();
+
+            // the first frame only builds the hierarchy
+            for (std::size_t k = 0; frame > 0 && k < per_frame; ++k)
+            {
+                auto i = std::uniform_int_distribution<std::size_t>{1, count - 1}(rng);
+                auto target = std::uniform_int_distribution<std::size_t>{0, i}(rng);
+
+                if (target == i)
+                {
+                    // detach it instead
+                    registry.remove<parent>(entities[i]);
+                }
+                else
+                {
+                    registry.emplace_or_replace<parent>(entities[i], parent{entities[target]});
+                }
+            }
+
+            parent_system(registry);
+            local_to_world_system(registry);
+            bounding_box_system(registry);
+
+            if (frame > 0)
+            {
+                elapsed += SDL_GetTicksNS() - begin;
+                recomputed += registry.ctx().get<transform_stats>().recomputed;
+            }
+
+            valid = validate_hierarchy(registry);
+        }
+
+        std::printf("%-6s %8zu  %-8zu %-7s %14.0f  %zu recomputed/frame\n",
+                    "churn", count, per_frame, valid ? "ok" : "FAILED",
+                    double(elapsed) / double(frames), recomputed / frames);
+
+        return valid;
+    }
+
+    // culls `count` drawables scattered over a large world for `cameras`
+    // views, `moving` drawables move every frame
+    bool bench_culling(std::size_t count, std::size_t cameras, std::size_t moving, std::size_t frames)
+    {
+        auto registry = entt::registry{};
+        internal::camera_setup_system(registry);
+        internal::transform_setup_system(registry);
+
+        const auto world_size = 40'000.0f;
+        auto rng = std::mt19937{7};
+        auto coordinate = std::uniform_real_distribution<float>{0.0f, world_size};
+        auto entities = std::vector<entt::entity>{};
+        entities.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto entity = registry.create();
+            registry.emplace<local_transform>(entity, local_transform{.position = {coordinate(rng), coordinate(rng), 0.0f}});
+            registry.emplace<drawable>(entity, drawable{.depth = 0, .bounding_box = {0.0f, 0.0f, 64.0f, 64.0f}});
+            entities.push_back(entity);
+        }
+
+        auto views = std::vector<SDL_FRect>{};
+        for (std::size_t i = 0; i < cameras; ++i)
+        {
+            views.push_back(SDL_FRect{coordinate(rng), coordinate(rng), 800.0f, 600.0f});
+        }
+
+        auto update = [&registry]()
+        {
+            parent_system(registry);
+            local_to_world_system(registry);
+            bounding_box_system(registry);
+        };
+        update();
+
+        auto move = [&]()
+        {
+            for (std::size_t k = 0; k < moving; ++k)
+            {
+                auto entity = entities[rng() % entities.size()];
+                registry.patch<local_transform>(entity, [&](auto &t)
+                                                { t.position = {coordinate(rng), coordinate(rng), 0.0f}; });
+            }
+        };
+
+        auto bboxes = registry.view<drawable, internal::bounding_box>();
+        auto &grid = registry.ctx().get<internal::spatial_grid>();
+
+        std::size_t linear_visible = 0;
+        std::size_t grid_visible = 0;
+        Uint64 update_ns = 0;
+        Uint64 linear_ns = 0;
+        Uint64 grid_ns = 0;
+
+        for (std::size_t frame = 0; frame < frames; ++frame)
+        {
+            // bounding boxes and grid maintenance
+            auto begin = SDL_GetTicksNS();
+            move();
+            update();
+            update_ns += SDL_GetTicksNS() - begin;
+
+            begin = SDL_GetTicksNS();
+            for (const auto &view : views)
+            {
+                for (auto [entity, c_drawable, c_bbox] : bboxes.each())
+                {
+                    linear_visible += SDL_HasRectIntersectionFloat(&view, &c_bbox.rect);
+                }
+            }
+            linear_ns += SDL_GetTicksNS() - begin;
+
+            // on the frame arena, as in the render system
+            begin = SDL_GetTicksNS();
+            auto candidates = std::pmr::vector<entt::entity>{&get_frame_arena()};
+            candidates.reserve(count);
+            for (const auto &view : views)
+            {
+                candidates.clear();
+                grid.query(view, candidates);
+                for (auto entity : candidates)
+                {
+                    grid_visible += SDL_HasRectIntersectionFloat(&view, &bboxes.get<internal::bounding_box>(entity).rect);
+                }
+            }
+            grid_ns += SDL_GetTicksNS() - begin;
+            get_frame_arena().reset();
+        }
+
+        auto valid = linear_visible == grid_visible;
+
+        std::printf("%-6s %8zu  %-8zu %-7zu %14.0f %14.0f %14.0f  %s\n",
+                    "cull", count, cameras, moving,
+                    double(update_ns) / double(frames),
+                    double(linear_ns) / double(frames),
+                    double(grid_ns) / double(frames),
+                    valid ? "ok" : "FAILED");
+
+        return valid;
+    }
+
+    // world bounding boxes of `count` rotated and scaled rectangles
+    void bench_rect_kernels(std::size_t count, std::size_t frames)
+    {
+        auto rng = std::mt19937{3};
+        auto value = std::uniform_real_distribution<float>{-100.0f, 100.0f};
+
+        auto matrices = std::vector<glm::mat4x4>{};
+        auto affines = std::vector<affine2d>{};
+        auto rects = std::vector<SDL_FRect>{};
+        auto transforms = internal::affine_array{};
+        auto rect_soa = internal::rect_array{};
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto t = local_transform{
+                .position = {value(rng), value(rng), 0.0f},
+                .scale = {1.0f + value(rng) / 200.0f, 1.0f, 1.0f},
+                .rotation = {0.0f, 0.0f, value(rng)},
+            };
+            matrices.push_back(make_transform(t));
+            affines.push_back(make_affine_transform(t));
+            rects.push_back(SDL_FRect{value(rng), value(rng), 64.0f, 32.0f});
+
+            transforms.push_back(matrices.back());
+            rect_soa.push_back(rects.back());
+        }
+
+        auto result = std::vector<SDL_FRect>(count);
+        auto scalar_ns = measure(frames, [&](std::size_t)
+                                 {
+                                     for (std::size_t i = 0; i < count; ++i)
+                                     {
+                                         result[i] = transform_rect(matrices[i], rects[i]);
+                                     } });
+
+        std::printf("%-10s %8zu %14.2f\n", "mat4", count, scalar_ns / double(count));
+
+        auto affine_ns = measure(frames, [&](std::size_t)
+                                 {
+                                     for (std::size_t i = 0; i < count; ++i)
+                                     {
+                                         result[i] = transform_rect(affines[i], rects[i]);
+                                     } });
+
+        std::printf("%-10s %8zu %14.2f\n", "affine2d", count, affine_ns / double(count));
+
+        auto levels = std::vector<internal::simd_level>{internal::simd_level::scalar};
+        if (internal::detect_simd_level() != internal::simd_level::scalar)
+        {
+            levels.push_back(internal::simd_level::sse2);
+        }
+        if (internal::detect_simd_level() == internal::simd_level::avx)
+        {
+            levels.push_back(internal::simd_level::avx);
+        }
+
+        auto batch_result = internal::rect_array{};
+        for (auto level : levels)
+        {
+            auto ns = measure(frames, [&](std::size_t)
+                              { internal::transform_rects(transforms, rect_soa, batch_result, level); });
+
+            std::printf("%-10s %8zu %14.2f\n", internal::simd_level_name(level), count, ns / double(count));
+        }
+    }
+}
+
+namespace
+{
+    // thread counts from 1 to one per core
+    std::vector<int> thread_counts()
+    {
+        auto cores = int(std::max(std::thread::hardware_concurrency(), 1u));
+        auto counts = std::vector<int>{};
+        for (int threads = 1; threads < cores; threads *= 2)
+        {
+            counts.push_back(threads);
+        }
+        counts.push_back(cores);
+        return counts;
+    }
+
+    // the systems of a scene through the system scheduler, on a growing job
+    // system: the transform systems split each depth of the hierarchy
+    void bench_jobs(const scene_shape &shape, std::size_t count, std::size_t frames)
+    {
+        auto &jobs = get_job_system();
+        auto single_ns = 0.0;
+
+        for (auto threads : thread_counts())
+        {
+            jobs.set_threads(threads);
+
+            auto registry = entt::registry{};
+            internal::camera_setup_system(registry);
+            internal::transform_setup_system(registry);
+            auto roots = populate(registry, shape, count);
+            auto systems = system_scheduler{};
+            internal::add_scene_systems(systems);
+            systems.run(registry, jobs);
+
+            auto ns = measure(frames, [&](std::size_t frame)
+                              {
+                                  move_roots(registry, roots, frame);
+                                  systems.run(registry, jobs); });
+            single_ns = threads == 1 ? ns : single_ns;
+            std::printf("%-6s %8zu  %-8s %7d %14.0f %8.2fx\n", shape.name, count, "systems", threads, ns, single_ns / ns);
+        }
+        jobs.set_threads(0);
+    }
+
+    template <int N>
+    struct counter
+    {
+        float value{0.0f};
+    };
+
+    // a system over its own component, the scheduler runs the four at once
+    template <int N>
+    void count_system(entt::registry &registry)
+    {
+        for (auto [entity, c] : registry.view<counter<N>>().each())
+        {
+            c.value = std::sqrt(c.value * c.value + 1.0f);
+        }
+    }
+
+    void bench_independent_systems(std::size_t count, std::size_t frames)
+    {
+        auto &jobs = get_job_system();
+        auto single_ns = 0.0;
+
+        for (auto threads : thread_counts())
+        {
+            jobs.set_threads(threads);
+
+            auto registry = entt::registry{};
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto entity = registry.create();
+                registry.emplace<counter<0>>(entity);
+                registry.emplace<counter<1>>(entity);
+                registry.emplace<counter<2>>(entity);
+                registry.emplace<counter<3>>(entity);
+            }
+            auto systems = system_scheduler{};
+            systems.add("count_0", system_access{}.write<counter<0>>(), count_system<0>);
+            systems.add("count_1", system_access{}.write<counter<1>>(), count_system<1>);
+            systems.add("count_2", system_access{}.write<counter<2>>(), count_system<2>);
+            systems.add("count_3", system_access{}.write<counter<3>>(), count_system<3>);
+
+            auto ns = measure(frames, [&](std::size_t)
+                              { systems.run(registry, jobs); });
+            single_ns = threads == 1 ? ns : single_ns;
+            std::printf("%-6s %8zu  %-8s %7d %14.0f %8.2fx  %d at once\n", "flat", count, "4 indep", threads, ns,
+                        single_ns / ns, systems.last_width());
+        }
+        jobs.set_threads(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "--scenes")
+    {
+        return run_scene_stress(argc - 1, argv + 1);
+    }
+
+    std::size_t frames = argc > 1 ? std::stoul(argv[1]) : 20;
+
+    const scene_shape shapes[] = {
+        {"wide", 100, false},
+        {"deep", 32, true},
+    };
+    const std::size_t counts[] = {10'000, 50'000, 100'000};
+
+    std::printf("%-6s %8s  %-8s %-7s %14s\n", "scene", "entities", "impl", "frame", "ns/frame");
+    for (const auto &shape : shapes)
+    {
+        for (auto count : counts)
+        {
+            bench_hierarchy(shape, count, frames);
+        }
+    }
+
+    std::printf("\n%-10s %8s %14s\n", "kernel", "rects", "ns/rect");
+    bench_rect_kernels(100'000, frames);
+
+    auto valid = true;
+
+    std::printf("\n%-6s %8s  %-8s %-7s %14s\n", "scene", "entities", "reparent", "check", "ns/frame");
+    for (auto count : counts)
+    {
+        valid = bench_reparenting(count, 1'000, frames) && valid;
+        valid = bench_reparenting(count, 5'000, frames) && valid;
+    }
+
+    std::printf("\n%-6s %8s  %-8s %-7s %14s %14s %14s  %s\n", "scene", "entities", "cameras", "moving", "update ns", "linear ns", "grid ns", "check");
+    for (auto cameras : {1, 4, 16, 64})
+    {
+        valid = bench_culling(100'000, cameras, 0, frames) && valid;
+        valid = bench_culling(100'000, cameras, 1'000, frames) && valid;
+    }
+
+    std::printf("\n%-6s %8s  %-8s %7s %14s %9s\n", "scene", "entities", "systems", "threads", "ns/frame", "speedup");
+    for (const auto &shape : shapes)
+    {
+        bench_jobs(shape, 100'000, frames);
+    }
+    bench_independent_systems(100'000, frames);
+
+    return valid ? 0 : 1;
+}
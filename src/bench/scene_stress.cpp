@@ -0,0 +1,582 @@
+#include "scene_stress.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL3/SDL.h>
+#include <entt/entt.hpp>
+
+#include "engine/scene.hpp"
+#include "engine/allocation_stats.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/profiler.hpp"
+#include "game/chess/engine_service.hpp"
+
+// Scene stress suite: every scene is generated from a fixed seed and runs
+// `Scene::update` and `Scene::render` on a software renderer drawing into a
+// surface, without any window.
+//
+// Each frame reports its duration, the heap allocations of the main thread
+// and of the job system workers with `ENGINE_ALLOC_STATS` (the search
+// threads' are not counted) and, with `ENGINE_PROFILER`, the time spent in
+// the engine systems. The results are printed as a table and written as
+// JSON, one scene per line, which `--baseline` reads back to fail the run
+// on a regression of the mean frame time. `--zero-alloc` fails the run
+// when a frame after the warmup allocates, and names the zones which did.
+//
+// `--search` runs every scene a second time while the chess engine analyses
+// on every core, polled by the scene on each update, and reports the frame
+// time impact on the main thread.
+
+namespace
+{
+    constexpr int surface_w = 800;
+    constexpr int surface_h = 600;
+    constexpr std::size_t warmup_frames = 5;
+
+    // engine systems reported per scene, from the profiler zones
+    const char *const system_zones[] = {
+        "parent_system",
+        "local_to_world_system",
+        "bounding_box_system",
+        "render_system",
+        "culling",
+        "sorting",
+        "draw",
+    };
+
+    struct stress_config
+    {
+        const char *name;
+        std::uint32_t seed;
+        std::size_t entities;
+        // children per tree, every child of a deep tree is the parent of
+        // the next one
+        std::size_t tree_size;
+        bool deep;
+        std::size_t cameras;
+        // roots moved every step
+        std::size_t moving;
+        // entities given a random parent every step
+        std::size_t reparenting;
+    };
+
+    const stress_config stress_configs[] = {
+        {"deep", 1, 50'000, 32, true, 1, 100, 0},
+        {"wide", 2, 50'000, 100, false, 1, 100, 0},
+        {"cameras", 3, 20'000, 1, false, 64, 200, 0},
+        {"drawables", 4, 100'000, 1, false, 1, 1'000, 0},
+        {"static", 5, 100'000, 1, false, 4, 0, 0},
+        {"churn", 6, 20'000, 10, false, 1, 0, 1'000},
+    };
+
+    class stress_scene : public Scene
+    {
+    public:
+        stress_scene(const stress_config &config, chess::engine_service *engine)
+            : m_config{config}, m_rng{config.seed}, m_engine{engine}
+        {
+            init();
+        }
+
+        bool init() override
+        {
+            // spread the trees over a square world, about one per 64x64
+            // cell
+            auto trees = (m_config.entities + m_config.tree_size - 1) / m_config.tree_size;
+            m_extent = 64.0f * std::sqrt(static_cast<float>(trees));
+            auto position = std::uniform_real_distribution<float>{0.0f, m_extent};
+            auto color = std::uniform_real_distribution<float>{0.25f, 1.0f};
+
+            for (std::size_t i = 0; i < m_config.entities;)
+            {
+                auto root = create_sprite(position(m_rng), position(m_rng), color(m_rng));
+                m_roots.push_back(root);
+                ++i;
+
+                auto previous = root;
+                for (std::size_t j = 1; j < m_config.tree_size && i < m_config.entities; ++j, ++i)
+                {
+                    auto child = create_sprite(8.0f, 8.0f, color(m_rng));
+                    m_registry.emplace<parent>(child, parent{m_config.deep ? previous : root});
+                    previous = child;
+                }
+            }
+
+            // the cameras tile the surface, their views are spread over the
+            // world
+            auto columns = static_cast<std::size_t>(std::ceil(std::sqrt(double(m_config.cameras))));
+            auto rows = (m_config.cameras + columns - 1) / columns;
+            auto viewport_w = float(surface_w) / float(columns);
+            auto viewport_h = float(surface_h) / float(rows);
+
+            for (std::size_t i = 0; i < m_config.cameras; ++i)
+            {
+                auto e_camera = m_registry.create();
+                m_registry.emplace<camera>(e_camera, camera{
+                                                         .z_index = Sint64(i),
+                                                         .view = SDL_FRect{0.0f, 0.0f, 800.0f, 600.0f},
+                                                         .viewport = SDL_FRect{
+                                                             float(i % columns) * viewport_w,
+                                                             float(i / columns) * viewport_h,
+                                                             viewport_w,
+                                                             viewport_h,
+                                                         },
+                                                     });
+                m_registry.emplace<local_transform>(e_camera, local_transform{
+                                                                  .position = {position(m_rng), position(m_rng), 0.0f},
+                                                              });
+            }
+
+            return true;
+        }
+
+        void handle_event(SDL_Event *) override {}
+
+        void update() override
+        {
+            if (m_engine != nullptr)
+            {
+                PROFILE_ZONE("engine_poll");
+                while (m_engine->poll(m_event))
+                {
+                    ++m_engine_events;
+                }
+            }
+
+            auto pick = std::uniform_int_distribution<std::size_t>{0, m_entities.size() - 1};
+            auto pick_root = std::uniform_int_distribution<std::size_t>{0, m_roots.size() - 1};
+
+            for (std::size_t i = 0; i < m_config.moving; ++i)
+            {
+                m_registry.patch<local_transform>(m_roots[pick_root(m_rng)], [](auto &t)
+                                                  {
+                                                      t.position.x += 1.0f;
+                                                      t.rotation.z += 0.01f; });
+            }
+
+            // cycles are resolved by the engine, the entity becomes a root
+            for (std::size_t i = 0; i < m_config.reparenting; ++i)
+            {
+                m_registry.emplace_or_replace<parent>(m_entities[pick(m_rng)], parent{m_entities[pick(m_rng)]});
+            }
+
+            registry_updates();
+        }
+
+        void render(SDL_Renderer *renderer) override
+        {
+            internal::render_system(m_registry, renderer, m_registry.ctx().get<frame_time>().fixed_delta_time);
+        }
+
+        const render_stats &stats() { return m_registry.ctx().get<render_stats>(); };
+        std::size_t engine_events() const { return m_engine_events; };
+
+    private:
+        entt::entity create_sprite(float x, float y, float shade)
+        {
+            auto entity = m_registry.create();
+            m_registry.emplace<local_transform>(entity, local_transform{.position = {x, y, 0.0f}});
+            m_registry.emplace<sprite>(entity, sprite{
+                                                   .rect = SDL_FRect{0.0f, 0.0f, 16.0f, 16.0f},
+                                                   .tint = SDL_FColor{shade, shade, shade, 1.0f},
+                                                   .depth = 0,
+                                               });
+            m_entities.push_back(entity);
+            return entity;
+        }
+
+        stress_config m_config;
+        std::mt19937 m_rng;
+        float m_extent{0.0f};
+        std::vector<entt::entity> m_entities;
+        std::vector<entt::entity> m_roots;
+
+        chess::engine_service *m_engine;
+        chess::engine_event m_event;
+        std::size_t m_engine_events{0};
+    };
+
+    struct stress_result
+    {
+        std::string scene;
+        std::size_t entities;
+        std::size_t cameras;
+        std::size_t frames;
+        double mean_ns;
+        double p50_ns;
+        double p90_ns;
+        double p99_ns;
+        double max_ns;
+        double allocations_per_frame;
+        double bytes_per_frame;
+        double draw_calls_per_frame;
+        // engine results polled, with `--search`
+        std::size_t engine_events;
+        // mean ns per frame of every `system_zones` entry
+        std::vector<double> system_ns;
+        // allocation zones which allocated after the warmup
+        std::vector<const char *> allocating_zones;
+    };
+
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        auto index = static_cast<std::size_t>(p * double(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    // searched on every core during the `--search` runs
+    constexpr const char *search_fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+
+    stress_result run_scene(
+        const stress_config &config,
+        SDL_Renderer *renderer,
+        std::size_t frames,
+        chess::engine_service *engine)
+    {
+        auto scene = stress_scene{config, engine};
+
+        // analysis without limits, for the whole run
+        if (engine != nullptr)
+        {
+            auto pos = chess::position{};
+            pos.set_fen(search_fen);
+            engine->new_game();
+            engine->go(pos, chess::search_limits{});
+        }
+
+        auto &profiler = get_profiler();
+        auto &tracker = get_allocation_tracker();
+
+        auto frame_ns = std::vector<double>{};
+        frame_ns.reserve(frames);
+        auto system_ns = std::vector<double>(std::size(system_zones), 0.0);
+        auto total_allocations = std::uint64_t{0};
+        auto total_bytes = std::uint64_t{0};
+        auto allocating_zones = std::vector<const char *>{};
+        auto total_draw_calls = std::size_t{0};
+
+        for (std::size_t frame = 0; frame < warmup_frames + frames; ++frame)
+        {
+            profiler.begin_frame();
+            tracker.begin_frame();
+            auto begin = SDL_GetTicksNS();
+
+            scene.update();
+            scene.render(renderer);
+            SDL_RenderPresent(renderer);
+
+            auto end = SDL_GetTicksNS();
+            tracker.end_frame();
+            profiler.end_frame();
+            get_frame_arena().reset();
+
+            // the first frames build the hierarchy, the grid and the
+            // textures of the cameras
+            if (frame < warmup_frames)
+            {
+                continue;
+            }
+
+            frame_ns.push_back(double(end - begin));
+            total_allocations += tracker.frame().count;
+            total_bytes += tracker.frame().bytes;
+            for (const auto &zone : tracker.zones())
+            {
+                if (zone.last.count > 0 &&
+                    std::find(allocating_zones.begin(), allocating_zones.end(), zone.name) == allocating_zones.end())
+                {
+                    allocating_zones.push_back(zone.name);
+                }
+            }
+            total_draw_calls += scene.stats().draw_calls;
+
+            for (const auto &zone : profiler.zones())
+            {
+                for (std::size_t i = 0; i < std::size(system_zones); ++i)
+                {
+                    if (std::strcmp(zone.name, system_zones[i]) == 0)
+                    {
+                        system_ns[i] += zone.last_ms * 1'000'000.0;
+                    }
+                }
+            }
+        }
+
+        if (engine != nullptr)
+        {
+            engine->stop();
+            auto event = chess::engine_event{};
+            while (engine->searching())
+            {
+                engine->poll(event);
+            }
+        }
+
+        auto sorted = frame_ns;
+        std::sort(sorted.begin(), sorted.end());
+
+        auto sum = 0.0;
+        for (auto ns : frame_ns)
+        {
+            sum += ns;
+        }
+        for (auto &ns : system_ns)
+        {
+            ns /= double(frames);
+        }
+
+        return stress_result{
+            .scene = engine != nullptr ? std::string(config.name) + "+search" : std::string(config.name),
+            .entities = config.entities,
+            .cameras = config.cameras,
+            .frames = frames,
+            .mean_ns = sum / double(frames),
+            .p50_ns = percentile(sorted, 0.50),
+            .p90_ns = percentile(sorted, 0.90),
+            .p99_ns = percentile(sorted, 0.99),
+            .max_ns = sorted.back(),
+            .allocations_per_frame = double(total_allocations) / double(frames),
+            .bytes_per_frame = double(total_bytes) / double(frames),
+            .draw_calls_per_frame = double(total_draw_calls) / double(frames),
+            .engine_events = scene.engine_events(),
+            .system_ns = system_ns,
+            .allocating_zones = allocating_zones,
+        };
+    }
+
+    void write_json(std::FILE *file, const std::vector<stress_result> &results)
+    {
+        std::fprintf(file, "{\"scenes\": [\n");
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const auto &r = results[i];
+
+            std::fprintf(file,
+                         "{\"scene\": \"%s\", \"entities\": %zu, \"cameras\": %zu, \"frames\": %zu, "
+                         "\"mean_ns\": %.0f, \"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f, "
+                         "\"allocations_per_frame\": %.2f, \"bytes_per_frame\": %.0f, \"draw_calls_per_frame\": %.2f",
+                         r.scene.c_str(), r.entities, r.cameras, r.frames,
+                         r.mean_ns, r.p50_ns, r.p90_ns, r.p99_ns, r.max_ns,
+                         r.allocations_per_frame, r.bytes_per_frame, r.draw_calls_per_frame);
+#ifdef ENGINE_PROFILER
+            std::fprintf(file, ", \"systems_ns\": {");
+            for (std::size_t s = 0; s < std::size(system_zones); ++s)
+            {
+                std::fprintf(file, "%s\"%s\": %.0f", s == 0 ? "" : ", ", system_zones[s], r.system_ns[s]);
+            }
+            std::fprintf(file, "}");
+#endif
+            std::fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(file, "]}\n");
+    }
+
+    // mean frame time of every scene in a JSON written by `write_json`
+    bool read_baseline(const char *path, std::vector<std::pair<std::string, double>> &baseline)
+    {
+        auto file = std::fopen(path, "r");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        char line[4096];
+        while (std::fgets(line, sizeof(line), file) != nullptr)
+        {
+            auto scene = std::strstr(line, "\"scene\": \"");
+            auto mean = std::strstr(line, "\"mean_ns\": ");
+            if (scene == nullptr || mean == nullptr)
+            {
+                continue;
+            }
+
+            scene += std::strlen("\"scene\": \"");
+            auto name = std::string(scene, std::strcspn(scene, "\""));
+            baseline.emplace_back(name, std::strtod(mean + std::strlen("\"mean_ns\": "), nullptr));
+        }
+
+        std::fclose(file);
+        return true;
+    }
+}
+
+int run_scene_stress(int argc, char *argv[])
+{
+    std::size_t frames = 100;
+    const char *json_path = nullptr;
+    const char *baseline_path = nullptr;
+    double tolerance = 0.15;
+    bool search = false;
+    bool zero_alloc = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        auto has_value = i + 1 < argc;
+
+        if (arg == "--frames" && has_value)
+        {
+            frames = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+        }
+        else if (arg == "--json" && has_value)
+        {
+            json_path = argv[++i];
+        }
+        else if (arg == "--baseline" && has_value)
+        {
+            baseline_path = argv[++i];
+        }
+        else if (arg == "--tolerance" && has_value)
+        {
+            tolerance = std::stod(argv[++i]);
+        }
+        else if (arg == "--search")
+        {
+            search = true;
+        }
+        else if (arg == "--zero-alloc")
+        {
+            zero_alloc = true;
+        }
+    }
+
+    // no window: the software renderer draws into a surface
+    if (!SDL_Init(0))
+    {
+        std::fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    auto surface = SDL_CreateSurface(surface_w, surface_h, SDL_PIXELFORMAT_RGBA8888);
+    auto renderer = surface != nullptr ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+    if (renderer == nullptr)
+    {
+        std::fprintf(stderr, "Couldn't create the software renderer: %s\n", SDL_GetError());
+        SDL_DestroySurface(surface);
+        SDL_Quit();
+        return 1;
+    }
+
+    // the frames run on this thread and on the job system workers
+    track_frame_allocations();
+
+    auto results = std::vector<stress_result>{};
+
+    std::printf("%-10s %8s %7s %12s %12s %12s %12s %10s %12s\n",
+                "scene", "entities", "cameras", "mean ns", "p50 ns", "p99 ns", "max ns", "allocs", "draw calls");
+    auto print_row = [](const stress_result &r)
+    {
+        std::printf("%-10s %8zu %7zu %12.0f %12.0f %12.0f %12.0f %10.2f %12.2f\n",
+                    r.scene.c_str(), r.entities, r.cameras, r.mean_ns, r.p50_ns, r.p99_ns, r.max_ns,
+                    r.allocations_per_frame, r.draw_calls_per_frame);
+    };
+
+    // every core searches, the main thread competes with the workers
+    auto engine = std::unique_ptr<chess::engine_service>{};
+    if (search)
+    {
+        engine = std::make_unique<chess::engine_service>(int(std::max(std::thread::hardware_concurrency(), 1u)), 64);
+    }
+
+    for (const auto &config : stress_configs)
+    {
+        print_row(results.emplace_back(run_scene(config, renderer, frames, nullptr)));
+        if (engine)
+        {
+            print_row(results.emplace_back(run_scene(config, renderer, frames, engine.get())));
+        }
+    }
+
+    if (engine)
+    {
+        std::printf("\n%-10s %12s %12s %10s\n", "scene", "mean impact", "p99 impact", "polled");
+        for (std::size_t i = 0; i + 1 < results.size(); i += 2)
+        {
+            const auto &idle = results[i];
+            const auto &loaded = results[i + 1];
+            std::printf("%-10s %+11.1f%% %+11.1f%% %10zu\n",
+                        idle.scene.c_str(),
+                        100.0 * (loaded.mean_ns / idle.mean_ns - 1.0),
+                        100.0 * (loaded.p99_ns / idle.p99_ns - 1.0),
+                        loaded.engine_events);
+        }
+        engine.reset();
+    }
+
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroySurface(surface);
+    SDL_Quit();
+
+    if (json_path != nullptr)
+    {
+        auto file = std::fopen(json_path, "w");
+        if (file == nullptr)
+        {
+            std::fprintf(stderr, "Couldn't write %s\n", json_path);
+            return 1;
+        }
+        write_json(file, results);
+        std::fclose(file);
+    }
+    else
+    {
+        write_json(stdout, results);
+    }
+
+    auto allocating = false;
+    if (zero_alloc)
+    {
+        for (const auto &r : results)
+        {
+            if (r.allocations_per_frame == 0.0)
+            {
+                continue;
+            }
+            std::fprintf(stderr, "%s allocates %.2f times per frame, in:", r.scene.c_str(), r.allocations_per_frame);
+            for (auto name : r.allocating_zones)
+            {
+                std::fprintf(stderr, " %s", name);
+            }
+            std::fprintf(stderr, "\n");
+            allocating = true;
+        }
+    }
+
+    if (baseline_path == nullptr)
+    {
+        return allocating ? 1 : 0;
+    }
+
+    auto baseline = std::vector<std::pair<std::string, double>>{};
+    if (!read_baseline(baseline_path, baseline))
+    {
+        std::fprintf(stderr, "Couldn't read the baseline %s\n", baseline_path);
+        return 1;
+    }
+
+    auto regressed = false;
+    for (const auto &[name, base_ns] : baseline)
+    {
+        for (const auto &r : results)
+        {
+            if (r.scene == name && r.mean_ns > base_ns * (1.0 + tolerance))
+            {
+                std::fprintf(stderr, "%s regressed: %.0f ns/frame, baseline %.0f ns/frame\n",
+                             name.c_str(), r.mean_ns, base_ns);
+                regressed = true;
+            }
+        }
+    }
+
+    return regressed || allocating ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Headless run of the `Scene` update/render pipeline over generated scenes,
+// see scene_stress.cpp. Returns the exit code of the process.
+//
+//   engine_bench --scenes [--frames N] [--json path] [--baseline path] [--tolerance 0.15] [--search] [--zero-alloc]
+int run_scene_stress(int argc, char *argv[]);
@@ -0,0 +1,144 @@
+#include "engine/allocation_stats.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <SDL3/SDL.h>
+
+namespace
+{
+    // constant initialized: `operator new` may run before and after the
+    // thread's dynamic initialization
+    thread_local allocation_counts t_counts;
+    thread_local bool t_frame_thread = false;
+
+    std::atomic<std::uint64_t> frame_count{0};
+    std::atomic<std::uint64_t> frame_bytes{0};
+
+    [[maybe_unused]] void count(std::size_t size)
+    {
+        ++t_counts.count;
+        t_counts.bytes += size;
+        if (t_frame_thread)
+        {
+            frame_count.fetch_add(1, std::memory_order_relaxed);
+            frame_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+}
+
+#ifdef ENGINE_ALLOC_STATS
+
+void *operator new(std::size_t size)
+{
+    count(size);
+
+    if (auto *p = std::malloc(size != 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    count(size);
+
+    if (auto *p = SDL_aligned_alloc(std::size_t(alignment), size != 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    SDL_aligned_free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    SDL_aligned_free(p);
+}
+
+#endif
+
+allocation_counts thread_allocations()
+{
+    return t_counts;
+}
+
+allocation_counts frame_thread_allocations()
+{
+    return allocation_counts{
+        .count = frame_count.load(std::memory_order_relaxed),
+        .bytes = frame_bytes.load(std::memory_order_relaxed),
+    };
+}
+
+void track_frame_allocations()
+{
+    t_frame_thread = true;
+}
+
+allocation_tracker &get_allocation_tracker()
+{
+    static allocation_tracker tracker;
+    return tracker;
+}
+
+void allocation_tracker::begin_frame()
+{
+    m_frame_begin = frame_thread_allocations();
+}
+
+void allocation_tracker::end_frame()
+{
+    auto lock = std::lock_guard{m_mutex};
+
+    m_frame = frame_thread_allocations() - m_frame_begin;
+    for (std::size_t i = 0; i < m_zones.size(); ++i)
+    {
+        m_zones[i].last = m_current[i];
+        if (m_current[i].count > 0)
+        {
+            ++m_zones[i].allocating_frames;
+        }
+        m_current[i] = allocation_counts{};
+    }
+}
+
+void allocation_tracker::record(const char *name, const allocation_counts &counts)
+{
+    auto lock = std::lock_guard{m_mutex};
+
+    auto &current = m_current[std::size_t(&zone(name) - m_zones.data())];
+    current.count += counts.count;
+    current.bytes += counts.bytes;
+}
+
+allocation_zone_stats &allocation_tracker::zone(const char *name)
+{
+    // few zones, as for the profiler
+    for (auto &stats : m_zones)
+    {
+        if (stats.name == name || std::strcmp(stats.name, name) == 0)
+        {
+            return stats;
+        }
+    }
+
+    m_current.emplace_back();
+    return m_zones.emplace_back(allocation_zone_stats{.name = name});
+}
@@ -0,0 +1,485 @@
+#include "engine/assets.hpp"
+#include "engine/profiler.hpp"
+#include "engine/sprite.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace
+{
+    constexpr double ms_per_ns = 1.0 / 1'000'000.0;
+    // texels of the pages
+    constexpr int bytes_per_texel = 4;
+}
+
+texture_handle::texture_handle(asset_manager *manager, Uint32 index) : m_manager{manager}, m_index{index}
+{
+    m_manager->acquire(m_index);
+}
+
+texture_handle::texture_handle(const texture_handle &other) : m_manager{other.m_manager}, m_index{other.m_index}
+{
+    if (m_manager != nullptr)
+    {
+        m_manager->acquire(m_index);
+    }
+}
+
+texture_handle::texture_handle(texture_handle &&other) noexcept
+    : m_manager{std::exchange(other.m_manager, nullptr)}, m_index{other.m_index}
+{
+}
+
+texture_handle &texture_handle::operator=(texture_handle other) noexcept
+{
+    std::swap(m_manager, other.m_manager);
+    std::swap(m_index, other.m_index);
+    return *this;
+}
+
+texture_handle::~texture_handle()
+{
+    if (m_manager != nullptr)
+    {
+        m_manager->release(m_index);
+    }
+}
+
+bool texture_handle::ready() const
+{
+    return m_manager != nullptr && m_manager->m_assets[m_index].state == asset_manager::asset_state::ready;
+}
+
+bool texture_handle::failed() const
+{
+    return m_manager != nullptr && m_manager->m_assets[m_index].state == asset_manager::asset_state::failed;
+}
+
+SDL_Texture *texture_handle::texture() const
+{
+    return ready() ? m_manager->m_pages[std::size_t(m_manager->m_assets[m_index].page)].texture : nullptr;
+}
+
+SDL_FRect texture_handle::region() const
+{
+    if (!ready())
+    {
+        return SDL_FRect{0.0f, 0.0f, 0.0f, 0.0f};
+    }
+
+    const auto &rect = m_manager->m_assets[m_index].rect;
+    auto padding = m_manager->m_config.padding;
+    return SDL_FRect{
+        float(rect.x + padding),
+        float(rect.y + padding),
+        float(rect.w - 2 * padding),
+        float(rect.h - 2 * padding),
+    };
+}
+
+asset_manager::asset_manager(const asset_config &config) : m_config{config}
+{
+    m_config.padding = std::max(m_config.padding, 0);
+    m_config.decode_threads = std::max(m_config.decode_threads, 1);
+}
+
+asset_manager::~asset_manager()
+{
+    shutdown();
+}
+
+asset_manager &get_asset_manager()
+{
+    static asset_manager assets;
+    return assets;
+}
+
+texture_handle asset_manager::load(const std::string &path)
+{
+    if (m_shutdown)
+    {
+        return texture_handle{};
+    }
+    if (auto it = m_indices.find(path); it != m_indices.end())
+    {
+        return texture_handle{this, it->second};
+    }
+
+    auto index = Uint32(m_assets.size());
+    if (!m_free.empty())
+    {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        m_assets.emplace_back();
+    }
+
+    auto &a = m_assets[index];
+    a.path = path;
+    a.state = asset_state::decoding;
+    m_indices.emplace(path, index);
+
+    ++m_stats.requested;
+    if (m_stats.loading++ == 0)
+    {
+        m_load_begin_ns = SDL_GetTicksNS();
+    }
+
+    if (m_decoders.empty())
+    {
+        for (int i = 0; i < m_config.decode_threads; ++i)
+        {
+            auto &d = m_decoders.emplace_back(std::make_unique<decoder>());
+            d->thread = std::thread([this, d = d.get()]()
+                                    { decode(*d); });
+        }
+    }
+
+    {
+        auto lock = std::lock_guard{m_mutex};
+        m_requests.push_back(request{.index = index, .path = path});
+    }
+    m_wake.notify_one();
+
+    return texture_handle{this, index};
+}
+
+void asset_manager::decode(decoder &d)
+{
+    while (true)
+    {
+        auto r = request{};
+        {
+            auto lock = std::unique_lock{m_mutex};
+            m_wake.wait(lock, [this]()
+                        { return m_stop.load() || !m_requests.empty(); });
+            if (m_stop.load())
+            {
+                return;
+            }
+            r = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        auto begin = SDL_GetTicksNS();
+        auto result = decoded{.index = r.index, .surface = decode_image(r.path)};
+        result.decode_ns = SDL_GetTicksNS() - begin;
+
+        // the render thread takes the results once per frame
+        while (!d.results.try_push(std::move(result)))
+        {
+            if (m_stop.load())
+            {
+                SDL_DestroySurface(result.surface);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+}
+
+SDL_Surface *asset_manager::decode_image(const std::string &path) const
+{
+    auto *loaded = SDL_LoadBMP(path.c_str());
+    if (loaded == nullptr)
+    {
+        SDL_Log("Couldn't load the texture %s: %s", path.c_str(), SDL_GetError());
+        return nullptr;
+    }
+
+    // new surfaces are cleared, the padding stays transparent
+    auto padding = m_config.padding;
+    auto *padded = SDL_CreateSurface(loaded->w + 2 * padding, loaded->h + 2 * padding, SDL_PIXELFORMAT_RGBA32);
+    auto destination = SDL_Rect{padding, padding, loaded->w, loaded->h};
+    if (padded == nullptr ||
+        !SDL_SetSurfaceBlendMode(loaded, SDL_BLENDMODE_NONE) ||
+        !SDL_BlitSurface(loaded, nullptr, padded, &destination))
+    {
+        SDL_Log("Couldn't convert the texture %s: %s", path.c_str(), SDL_GetError());
+        SDL_DestroySurface(padded);
+        padded = nullptr;
+    }
+
+    SDL_DestroySurface(loaded);
+    return padded;
+}
+
+void asset_manager::acquire(Uint32 index)
+{
+    ++m_assets[index].references;
+}
+
+void asset_manager::release(Uint32 index)
+{
+    auto &a = m_assets[index];
+    // a texture still decoding or uploading is dropped by `update`
+    if (--a.references == 0 && (a.state == asset_state::ready || a.state == asset_state::failed))
+    {
+        drop(index);
+    }
+}
+
+void asset_manager::drop(Uint32 index)
+{
+    auto &a = m_assets[index];
+    if (a.state == asset_state::decoding || a.state == asset_state::uploading)
+    {
+        --m_stats.loading;
+    }
+    SDL_DestroySurface(a.surface);
+
+    if (a.page >= 0)
+    {
+        auto &p = m_pages[std::size_t(a.page)];
+        if (--p.live == 0)
+        {
+            // the texture is kept for the next textures
+            p.packer.reset(p.packer.width(), p.packer.height());
+        }
+    }
+
+    m_indices.erase(a.path);
+    a = asset{};
+    m_free.push_back(index);
+}
+
+void asset_manager::update(SDL_Renderer *renderer)
+{
+    if (m_shutdown)
+    {
+        return;
+    }
+    PROFILE_ZONE("asset_manager");
+
+    for (auto &d : m_decoders)
+    {
+        auto result = decoded{};
+        while (d->results.try_pop(result))
+        {
+            m_stats.decode_ms += double(result.decode_ns) * ms_per_ns;
+
+            auto &a = m_assets[result.index];
+            if (a.references == 0)
+            {
+                SDL_DestroySurface(result.surface);
+                drop(result.index);
+            }
+            else if (result.surface == nullptr)
+            {
+                finish(a, asset_state::failed);
+            }
+            else
+            {
+                place(result.index, result.surface);
+            }
+        }
+    }
+
+    upload(renderer);
+
+    if (m_stats.loading == 0 && m_load_begin_ns != 0)
+    {
+        m_stats.load_ms = double(SDL_GetTicksNS() - m_load_begin_ns) * ms_per_ns;
+        m_load_begin_ns = 0;
+        SDL_Log("%zu textures ready and %zu failed in %.1f ms: decoding %.1f ms, uploading %.1f ms, %zu atlas pages",
+                m_stats.ready, m_stats.failed, m_stats.load_ms, m_stats.decode_ms, m_stats.upload_ms, m_stats.pages);
+    }
+}
+
+void asset_manager::place(Uint32 index, SDL_Surface *surface)
+{
+    auto position = SDL_Point{0, 0};
+    auto found = m_pages.size();
+    for (std::size_t i = 0; i < m_pages.size(); ++i)
+    {
+        if (m_pages[i].packer.pack(surface->w, surface->h, position))
+        {
+            found = i;
+            break;
+        }
+    }
+
+    if (found == m_pages.size())
+    {
+        auto size = m_config.page_size;
+        while (size < surface->w || size < surface->h)
+        {
+            size *= 2;
+        }
+        m_pages.push_back(page{.packer = internal::skyline_packer{size, size}});
+        m_pages.back().packer.pack(surface->w, surface->h, position);
+        ++m_stats.pages;
+    }
+
+    auto &a = m_assets[index];
+    a.surface = surface;
+    a.page = int(found);
+    a.rect = SDL_Rect{position.x, position.y, surface->w, surface->h};
+    a.uploaded_rows = 0;
+    a.state = asset_state::uploading;
+    ++m_pages[found].live;
+    m_uploads.push_back(index);
+}
+
+void asset_manager::upload(SDL_Renderer *renderer)
+{
+    if (m_uploads.empty())
+    {
+        return;
+    }
+
+    auto begin = SDL_GetTicksNS();
+    auto budget = m_config.upload_budget;
+
+    while (!m_uploads.empty() && budget > 0)
+    {
+        auto index = m_uploads.front();
+        auto &a = m_assets[index];
+        if (a.references == 0)
+        {
+            m_uploads.pop_front();
+            drop(index);
+            continue;
+        }
+
+        auto &p = m_pages[std::size_t(a.page)];
+        if (p.texture == nullptr)
+        {
+            p.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                          p.packer.width(), p.packer.height());
+            if (p.texture == nullptr)
+            {
+                SDL_Log("Couldn't create an atlas page: %s", SDL_GetError());
+                m_uploads.pop_front();
+                finish(a, asset_state::failed);
+                continue;
+            }
+            SDL_SetTextureBlendMode(p.texture, SDL_BLENDMODE_BLEND);
+        }
+
+        // as many rows as the budget allows, at least one
+        auto row_bytes = std::size_t(a.rect.w) * bytes_per_texel;
+        auto rows = int(std::clamp<std::size_t>(budget / row_bytes, 1, std::size_t(a.rect.h - a.uploaded_rows)));
+        auto slice = SDL_Rect{a.rect.x, a.rect.y + a.uploaded_rows, a.rect.w, rows};
+        const auto *pixels = static_cast<const Uint8 *>(a.surface->pixels) + std::size_t(a.uploaded_rows) * std::size_t(a.surface->pitch);
+
+        if (!SDL_UpdateTexture(p.texture, &slice, pixels, a.surface->pitch))
+        {
+            SDL_Log("Couldn't upload the texture %s: %s", a.path.c_str(), SDL_GetError());
+            m_uploads.pop_front();
+            finish(a, asset_state::failed);
+            continue;
+        }
+
+        auto bytes = std::size_t(rows) * row_bytes;
+        budget -= std::min(budget, bytes);
+        a.uploaded_rows += rows;
+        m_stats.bytes_uploaded += bytes;
+        ++m_stats.upload_slices;
+
+        if (a.uploaded_rows == a.rect.h)
+        {
+            m_uploads.pop_front();
+            finish(a, asset_state::ready);
+        }
+    }
+
+    m_stats.upload_ms += double(SDL_GetTicksNS() - begin) * ms_per_ns;
+}
+
+void asset_manager::finish(asset &a, asset_state state)
+{
+    SDL_DestroySurface(a.surface);
+    a.surface = nullptr;
+    a.state = state;
+
+    --m_stats.loading;
+    if (state == asset_state::ready)
+    {
+        ++m_stats.ready;
+    }
+    else
+    {
+        ++m_stats.failed;
+    }
+}
+
+void asset_manager::shutdown()
+{
+    if (m_shutdown)
+    {
+        return;
+    }
+    m_shutdown = true;
+
+    {
+        auto lock = std::lock_guard{m_mutex};
+        m_stop.store(true);
+    }
+    m_wake.notify_all();
+    for (auto &d : m_decoders)
+    {
+        d->thread.join();
+
+        auto result = decoded{};
+        while (d->results.try_pop(result))
+        {
+            SDL_DestroySurface(result.surface);
+        }
+    }
+    m_decoders.clear();
+    m_requests.clear();
+    m_uploads.clear();
+
+    for (auto &p : m_pages)
+    {
+        SDL_DestroyTexture(p.texture);
+        p.texture = nullptr;
+    }
+
+    // the handles left see failed textures
+    for (auto &a : m_assets)
+    {
+        SDL_DestroySurface(a.surface);
+        a.surface = nullptr;
+        if (a.state != asset_state::free)
+        {
+            a.state = asset_state::failed;
+        }
+    }
+    m_stats.loading = 0;
+}
+
+void sprite_asset_system(entt::registry &registry)
+{
+    PROFILE_ZONE("sprite_asset_system");
+
+    for (auto [entity, c_asset] : registry.view<sprite_asset, sprite>().each())
+    {
+        if (c_asset.applied || !(c_asset.texture.ready() || c_asset.texture.failed()))
+        {
+            continue;
+        }
+
+        // a failed texture leaves the sprite plain
+        c_asset.applied = true;
+        if (c_asset.texture.ready())
+        {
+            registry.patch<sprite>(entity, [&c_asset](auto &s)
+                                   {
+                                       s.texture = c_asset.texture.texture();
+                                       s.region = c_asset.texture.region();
+                                       s.tint = c_asset.tint; });
+        }
+    }
+}
+
+void internal::asset_setup_system(entt::registry &registry)
+{
+    // created here, the systems running at the same time do not create
+    // storages
+    registry.storage<sprite_asset>();
+}
@@ -1,22 +1,45 @@
 #include "engine/camera.hpp"
+#include "engine/allocation_stats.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/frame_scheduler.hpp"
+#include "engine/job_system.hpp"
+#include "engine/profiler.hpp"
+#include "engine/spatial_grid.hpp"
+#include "engine/sprite.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 /* treat your 2D coordinates as if they’re in the XY-plane at z=0:
 [x,y,0,1]
 */
 
-bool drawable::compare::operator()(const drawable &lhs, const drawable &rhs) const
+bool camera::compare::operator()(const camera &lhs, const camera &rhs) const
 {
-    return lhs.depth < rhs.depth;
+    return lhs.z_index > rhs.z_index;
 }
 
-bool camera::compare::operator()(const camera &lhs, const camera &rhs) const
+internal::draw_command internal::make_draw_command(Sint64 depth, Uint16 material, entt::entity entity)
 {
-    return lhs.z_index > rhs.z_index;
+    // flip the depth: the deepest drawables have the smallest keys. A depth
+    // out of 16 bits would be drawn out of order, it is clamped in release
+    SDL_assert(depth >= INT16_MIN && depth <= INT16_MAX);
+    auto clamped = std::clamp<Sint64>(depth, INT16_MIN, INT16_MAX);
+    auto depth_bits = static_cast<Uint64>(INT16_MAX - clamped);
+
+    return (depth_bits << 48) |
+           (static_cast<Uint64>(material) << 32) |
+           static_cast<Uint64>(entt::to_integral(entity));
+}
+
+entt::entity internal::draw_command_entity(draw_command command)
+{
+    return static_cast<entt::entity>(command & 0xffffffffu);
 }
 
-bool internal::draw_call::compare::operator()(const draw_call &lhs, const draw_call &rhs) const
+SDL_FRect transform_rect(const affine2d &transform, SDL_FRect rect)
 {
-    return drawable::compare{}(lhs.m_drawable, rhs.m_drawable);
+    return transform * rect;
 }
 
 SDL_FRect transform_rect(glm::mat4x4 transform, SDL_FRect rect)
@@ -48,58 +71,196 @@ SDL_FRect transform_rect(glm::mat4x4 transform, SDL_FRect rect)
 
 void bounding_box_system(entt::registry &registry)
 {
-    auto view = registry.view<drawable>();
-    auto visited = entt::sparse_set();
-    // auto visited = std::unordered_set<entt::entity>{};
-    visited.reserve(view.size());
+    PROFILE_ZONE("bounding_box_system");
+
+    auto &dirty = registry.storage<internal::dirty_transform>();
+    if (dirty.empty())
+    {
+        // nothing moved since the last frame
+        return;
+    }
+
+    auto &nodes = registry.storage<internal::hierarchy>();
+    auto &worlds = registry.storage<internal::local_to_world>();
+    auto &drawables = registry.storage<drawable>();
+    auto &bboxes = registry.storage<internal::bounding_box>();
+    auto &damage = registry.ctx().get<internal::render_damage>();
+    auto &batch = registry.ctx().get<internal::bounding_box_batch>();
 
-    auto compute_bbox = [&](auto &self, entt::entity e) -> SDL_FRect
+    const entt::sparse_set &dirty_entities = dirty;
+
+    // the drawables changed this frame damage the region they covered
+    batch.changed.clear();
+
+    for (auto entity : dirty_entities)
     {
-        if (visited.contains(e))
+        if (nodes.contains(entity) && drawables.contains(entity))
         {
-            auto &c_bbox = registry.get<internal::bounding_box>(e);
-            return c_bbox.rect;
+            batch.changed.push_back(entity);
+
+            if (bboxes.contains(entity))
+            {
+                damage.rects.push_back(bboxes.get(entity).own);
+            }
         }
+    }
 
-        auto bbox = SDL_FRect{0.0f, 0.0f, 0.0f, 0.0f};
+    // the hierarchy is sorted parents first, walking it backwards visits
+    // every child before its parent
+    const entt::sparse_set &order = nodes;
+
+    // first sweep: the ancestors of the dirty entities have to merge their
+    // bounding box again, they become dirty as well
+    for (auto it = order.rbegin(), last = order.rend(); it != last; ++it)
+    {
+        auto entity = *it;
+
+        if (!dirty.contains(entity))
+        {
+            continue;
+        }
+
+        auto e_parent = nodes.get(entity).parent;
+        if (e_parent != entt::null && !dirty.contains(e_parent))
+        {
+            dirty.emplace(e_parent);
+        }
+    }
+
+    // reset the dirty entities to their own bounding box. The drawables are
+    // gathered and transformed in a single batch
+    batch.entities.clear();
+    batch.transforms.clear();
+    batch.rects.clear();
+
+    for (auto entity : dirty_entities)
+    {
+        if (!nodes.contains(entity))
+        {
+            continue;
+        }
+
+        if (drawables.contains(entity))
+        {
+            batch.entities.push_back(entity);
+            batch.transforms.push_back(worlds.get(entity).mat);
+            batch.rects.push_back(drawables.get(entity).bounding_box);
+            continue;
+        }
 
         // child entities may have no drawables, but their children might have.
-        // let's check if the component exists and assume a default empty rect
-        // for the bounding box
+        // let's assume a default empty rect for the bounding box
+        auto bbox = SDL_FRect{0.0f, 0.0f, 0.0f, 0.0f};
 
-        auto *c_drawable = registry.try_get<drawable>(e);
-        auto *c_transform = registry.try_get<internal::local_to_world>(e);
-        auto *c_children = registry.try_get<internal::children>(e);
+        if (bboxes.contains(entity))
+        {
+            bboxes.get(entity) = internal::bounding_box{bbox};
+        }
+        else
+        {
+            bboxes.emplace(entity, bbox);
+        }
+    }
 
-        if (c_drawable != nullptr && c_transform != nullptr)
+    internal::transform_rects(batch.transforms, batch.rects, batch.result);
+
+    for (std::size_t i = 0; i < batch.entities.size(); ++i)
+    {
+        auto entity = batch.entities[i];
+        auto bbox = internal::bounding_box{batch.result[i], batch.result[i]};
+
+        if (bboxes.contains(entity))
+        {
+            bboxes.get(entity) = bbox;
+        }
+        else
         {
-            // we have a drawable, let's compute the actual local bounding box
-            bbox = transform_rect(c_transform->mat, c_drawable->bounding_box);
+            bboxes.emplace(entity, bbox);
         }
+    }
+
+    // ... and the region they cover now
+    for (auto entity : batch.changed)
+    {
+        damage.rects.push_back(bboxes.get(entity).own);
+    }
 
-        if (c_children != nullptr)
+    // second sweep, from the deepest nodes up: union of the children into
+    // their dirty parent, a child already holds the union of its own
+    // subtree. A parent is written by a single job, the depths are split as
+    // by the `local_to_world_system`
+    auto &jobs = registry.ctx().get<internal::transform_jobs>();
+    auto merge = [&](std::size_t begin, std::size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
         {
-            // we have children, let's get the union of their bounding box
-            for (auto child : c_children->entities)
+            auto entity = jobs.entities[i];
+            if (!dirty.contains(entity))
             {
-                // get child bounding box (recursively)
-                auto child_bbox = self(self, child);
+                continue;
+            }
 
-                // bbox U child_bbox --> bbox
+            // bbox U child_bbox --> bbox
+            auto &bbox = bboxes.get(entity).rect;
+            for (auto child = nodes.get(entity).first_child; child != entt::null; child = nodes.get(child).next_sibling)
+            {
+                const auto &child_bbox = bboxes.get(child).rect;
                 SDL_GetRectUnionFloat(&bbox, &child_bbox, &bbox);
             }
         }
+    };
 
-        // add the component to the entity
-        registry.emplace_or_replace<internal::bounding_box>(e, bbox);
-        visited.push(e);
+    auto &pool = get_job_system();
+    auto parallel = order.size() >= internal::transform_jobs::min_parallel_nodes;
+    for (auto depth = jobs.levels.size(); depth-- > 1;)
+    {
+        auto first = jobs.levels[depth - 1];
+        auto last = jobs.levels[depth];
+        if (!parallel)
+        {
+            merge(first, last);
+            continue;
+        }
+        pool.parallel_for(last - first, internal::transform_jobs::grain, [&](std::size_t begin, std::size_t end)
+                          { merge(first + begin, first + end); });
+    }
 
-        return bbox;
-    };
+    // move the drawables whose bounding box changed in the spatial grid
+    auto &grid = registry.ctx().get<internal::spatial_grid>();
+
+    for (auto entity : dirty_entities)
+    {
+        if (drawables.contains(entity) && bboxes.contains(entity))
+        {
+            grid.update(entity, bboxes.get(entity).rect);
+        }
+    }
+
+    // without cameras there is no texture to repair, nothing consumes the
+    // damage
+    if (registry.storage<internal::draw_target>().empty())
+    {
+        damage.rects.clear();
+    }
+
+    // last consumer of the dirty tags for this frame
+    registry.clear<internal::dirty_transform>();
+}
 
-    for (auto entity : view)
+void internal::damage_drawable(entt::registry &registry, entt::entity entity)
+{
+    // connected to both components, whichever is destroyed first
+    auto &bboxes = registry.storage<internal::bounding_box>();
+    if (registry.all_of<drawable>(entity) && bboxes.contains(entity))
     {
-        compute_bbox(compute_bbox, entity);
+        auto &damage = registry.ctx().get<internal::render_damage>();
+        damage.rects.push_back(bboxes.get(entity).own);
+
+        // drawn in between two steps
+        if (auto *c_motion = registry.try_get<internal::motion>(entity))
+        {
+            damage.rects.push_back(c_motion->drawn);
+        }
     }
 }
 
@@ -112,10 +273,38 @@ void internal::destroy_draw_target(entt::registry &registry, entt::entity entity
 {
     registry.remove<internal::draw_target>(entity);
 }
+
+void internal::destroy_bounding_box(entt::registry &registry, entt::entity entity)
+{
+    registry.remove<internal::bounding_box>(entity);
+}
 void internal::camera_setup_system(entt::registry &registry)
 {
     registry.on_construct<camera>().connect<&construct_draw_target>();
     registry.on_destroy<camera>().connect<&destroy_draw_target>();
+
+    registry.ctx().emplace<internal::bounding_box_batch>();
+    registry.ctx().emplace<internal::render_damage>();
+
+    // the pixels of a removed drawable must be drawn again
+    registry.on_destroy<drawable>().connect<&internal::damage_drawable>();
+    registry.on_destroy<internal::bounding_box>().connect<&internal::damage_drawable>();
+    registry.on_destroy<internal::hierarchy>().connect<&internal::destroy_bounding_box>();
+
+    // a new or modified bounding box must be transformed again
+    registry.on_construct<drawable>().connect<&internal::mark_transform_dirty>();
+    registry.on_update<drawable>().connect<&internal::mark_transform_dirty>();
+
+    internal::spatial_grid_setup_system(registry);
+    internal::sprite_setup_system(registry);
+}
+
+void internal::invalidate_draw_targets(entt::registry &registry)
+{
+    for (auto &c_draw_target : registry.storage<internal::draw_target>())
+    {
+        c_draw_target.valid = false;
+    }
 }
 
 SDL_Texture *internal::prepare_draw_target_texture(
@@ -128,7 +317,8 @@ SDL_Texture *internal::prepare_draw_target_texture(
         float w, h;
         SDL_GetTextureSize(target, &w, &h);
 
-        if (w != view.w || h != view.h)
+        // a larger texture is kept, the view is drawn in its top-left corner
+        if (w < view.w || h < view.h)
         {
             SDL_DestroyTexture(target);
             target = nullptr;
@@ -147,13 +337,57 @@ SDL_Texture *internal::prepare_draw_target_texture(
     return target;
 }
 
+namespace
+{
+    float area(const SDL_FRect &rect)
+    {
+        return rect.w * rect.h;
+    }
+
+    // merge the overlapping regions until none overlap
+    void merge_regions(std::vector<SDL_FRect> &regions)
+    {
+        for (std::size_t i = 0; i < regions.size(); ++i)
+        {
+            for (std::size_t j = i + 1; j < regions.size();)
+            {
+                if (!SDL_HasRectIntersectionFloat(&regions[i], &regions[j]))
+                {
+                    ++j;
+                    continue;
+                }
+
+                SDL_GetRectUnionFloat(&regions[i], &regions[j], &regions[i]);
+                regions[j] = regions.back();
+                regions.pop_back();
+                // the grown region may overlap the regions already checked
+                j = i + 1;
+            }
+        }
+    }
+
+    // pixels covering the screen space region, with a margin for the
+    // filtered edges of the drawables
+    SDL_Rect to_pixels(const SDL_FRect &rect)
+    {
+        auto min_x = static_cast<int>(std::floor(rect.x)) - 1;
+        auto min_y = static_cast<int>(std::floor(rect.y)) - 1;
+        auto max_x = static_cast<int>(std::ceil(rect.x + rect.w)) + 1;
+        auto max_y = static_cast<int>(std::ceil(rect.y + rect.h)) + 1;
+
+        return SDL_Rect{min_x, min_y, max_x - min_x, max_y - min_y};
+    }
+}
+
 void internal::render_system(
     entt::registry &registry,
     SDL_Renderer *renderer,
     float delta_time)
 {
+    PROFILE_ZONE("render_system");
+    ALLOCATION_ZONE("render_system");
+
     registry.sort<camera>(camera::compare{});
-    registry.sort<drawable>(drawable::compare{});
 
     auto camera_entities = registry.view<
         camera,
@@ -162,20 +396,66 @@ void internal::render_system(
     // iterate over entities using the `camera` component ordering
     camera_entities.use<camera>();
 
-    auto drawable_entities = registry.view<
-        drawable,
-        internal::local_to_world,
-        internal::bounding_box>();
-    // iterate over entities using the `drawable` component ordering
-    drawable_entities.use<drawable>();
+    auto &drawables = registry.storage<drawable>();
+    auto &worlds = registry.storage<internal::local_to_world>();
+    auto &bboxes = registry.storage<internal::bounding_box>();
+    auto &grid = registry.ctx().get<internal::spatial_grid>();
+    auto &sprites = registry.storage<sprite>();
+    auto &batch = registry.ctx().get<internal::sprite_batch>();
+    auto &damage = registry.ctx().get<internal::render_damage>();
+    auto &motions = registry.storage<internal::motion>();
+
+    auto &stats = registry.ctx().get<render_stats>();
+    stats = render_stats{};
+
+    // the frame is drawn in between the last two simulation steps
+    auto *time = registry.ctx().find<frame_time>();
+    auto alpha = time != nullptr ? time->alpha : 1.0f;
+
+    auto world_matrix = [&](entt::entity entity)
+    {
+        const auto &current = worlds.get(entity).mat;
+        return motions.contains(entity)
+                   ? interpolate_transform(motions.get(entity).previous, current, alpha)
+                   : current;
+    };
+
+    // the moving drawables damage where they were drawn and where they are
+    // drawn now. They are culled with the latter, their bounding box is the
+    // one of the last step: the grid holds the union of both until they
+    // stand still
+    for (auto [entity, c_motion] : motions.each())
+    {
+        if (!drawables.contains(entity))
+        {
+            continue;
+        }
+
+        auto drawn = transform_rect(world_matrix(entity), drawables.get(entity).bounding_box);
+        damage.rects.push_back(c_motion.drawn);
+        damage.rects.push_back(drawn);
+        c_motion.drawn = drawn;
+
+        auto cell_rect = drawn;
+        if (bboxes.contains(entity))
+        {
+            SDL_GetRectUnionFloat(&cell_rect, &bboxes.get(entity).rect, &cell_rect);
+        }
+        grid.update(entity, cell_rect);
+    }
+
+    // candidates and draw commands of the regions, from the frame arena.
+    // Reserved for every drawable on the first redraw, they never grow
+    auto visible = std::pmr::vector<entt::entity>{&get_frame_arena()};
+    auto commands = std::pmr::vector<internal::draw_command>{&get_frame_arena()};
 
     for (auto e_tuple_camera : camera_entities.each())
     {
         entt::entity e_camera = std::get<0>(e_tuple_camera);
         auto &c_camera = camera_entities.get<camera>(e_camera);
-        auto &c_camera_transform = camera_entities.get<internal::local_to_world>(e_camera);
         auto &c_draw_target = camera_entities.get<internal::draw_target>(e_camera);
 
+        auto *previous_target = c_draw_target.target;
         c_draw_target.target = prepare_draw_target_texture(
             renderer,
             c_draw_target.target,
@@ -184,19 +464,13 @@ void internal::render_system(
         {
             continue;
         }
-
-        SDL_SetRenderTarget(renderer, c_draw_target.target);
-
-        // clear target
-        auto bak = SDL_Color{};
-        SDL_GetRenderDrawColor(renderer, &bak.r, &bak.g, &bak.b, &bak.a);
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-        SDL_SetRenderDrawColor(renderer, bak.r, bak.g, bak.b, bak.a);
+        if (c_draw_target.target != previous_target)
+        {
+            c_draw_target.valid = false;
+        }
 
         auto view_local_pos = SDL_FPoint{c_camera.view.x, c_camera.view.y};
-        auto view_world_pos4 = c_camera_transform.mat * to_vec4(view_local_pos);
-        auto view_world_pos = to_sdl_point(view_world_pos4);
+        auto view_world_pos = transform_point(world_matrix(e_camera), view_local_pos);
 
         auto world_view = SDL_FRect{
             .x = view_world_pos.x - c_camera.view.w / 2.0f,
@@ -205,45 +479,229 @@ void internal::render_system(
             .h = c_camera.view.h,
         };
 
-        for (auto e_tuple_drawable : drawable_entities.each())
+        // world space to screen space transformation matrix
+        auto M_offset = make_world_translation(-view_world_pos.x, -view_world_pos.y);
+        auto M_center = make_world_translation(c_camera.view.w / 2.0f, c_camera.view.h / 2.0f);
+        auto M_view = M_center * M_offset;
+
+        // damaged regions of the view, the whole view when the texture
+        // content cannot be reused
+        auto view_area = area(world_view);
+        auto &regions = c_draw_target.regions;
+        regions.clear();
+
+        bool full_redraw = !c_draw_target.valid ||
+                           !SDL_RectsEqualFloat(&world_view, &c_draw_target.world_view);
+
+        if (!full_redraw)
         {
-            entt::entity e_drawable = std::get<0>(e_tuple_drawable);
-            auto &c_drawable = drawable_entities.get<drawable>(e_drawable);
-            auto &c_drawable_transform = drawable_entities.get<internal::local_to_world>(e_drawable);
-            auto &c_bounding_box = drawable_entities.get<internal::bounding_box>(e_drawable);
+            for (const auto &rect : damage.rects)
+            {
+                auto clipped = SDL_FRect{};
+                if (SDL_GetRectIntersectionFloat(&world_view, &rect, &clipped))
+                {
+                    regions.push_back(clipped);
+                }
+            }
+            // many small regions end up in a full redraw anyway
+            if (regions.size() <= internal::max_damage_regions * 4)
+            {
+                merge_regions(regions);
+            }
 
-            if (SDL_HasRectIntersectionFloat(&world_view, &c_bounding_box.rect))
+            auto damaged_area = 0.0f;
+            for (const auto &region : regions)
             {
-                // entity's bounding box intersects with the camera view
+                damaged_area += area(region);
+            }
 
-                // compute world space to screen space transformation matrix
+            // drawing most of the view region by region costs more than
+            // drawing it once
+            full_redraw = regions.size() > internal::max_damage_regions ||
+                          damaged_area > view_area / 2.0f;
+        }
+
+        // part of the texture holding the view
+        auto source = SDL_FRect{0.0f, 0.0f, c_camera.view.w, c_camera.view.h};
+
+        if (!full_redraw && regions.empty())
+        {
+            // nothing changed in the view, reuse the texture as is
+            ++stats.cameras_skipped;
+            stats.pixels_saved += view_area;
+            stats.draw_calls_saved += c_draw_target.full_draw_calls;
+
+            SDL_RenderTexture(renderer, c_draw_target.target, &source, &c_camera.viewport);
+            continue;
+        }
+
+        if (full_redraw)
+        {
+            regions.clear();
+            regions.push_back(world_view);
+        }
 
-                auto M_offset = glm::translate(glm::mat4x4(1.0f), glm::vec3(-view_world_pos.x, -view_world_pos.y, 0.0f));
-                glm::mat4 M_center = glm::translate(glm::mat4x4(1.0f), glm::vec3(c_camera.view.w / 2.0f, c_camera.view.h / 2.0f, 0.0f));
+        visible.reserve(drawables.size());
+        commands.reserve(drawables.size());
 
-                auto M = (M_center * M_offset) * c_drawable_transform.mat;
+        SDL_SetRenderTarget(renderer, c_draw_target.target);
 
-                // push draw call
-                c_draw_target.queue.emplace(internal::draw_call{
-                    .m_drawable = c_drawable,
-                    .world_transform = M,
+        auto bak = SDL_Color{};
+        SDL_GetRenderDrawColor(renderer, &bak.r, &bak.g, &bak.b, &bak.a);
+
+        auto draw_calls_begin = stats.draw_calls;
+        auto pixels_redrawn = 0.0f;
+
+        for (const auto &region : regions)
+        {
+            auto world_region = world_view;
+
+            // clear target
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            if (full_redraw)
+            {
+                SDL_RenderClear(renderer);
+                pixels_redrawn += view_area;
+            }
+            else
+            {
+                auto clip = to_pixels(SDL_FRect{
+                    region.x - world_view.x,
+                    region.y - world_view.y,
+                    region.w,
+                    region.h,
                 });
+                auto clip_rect = SDL_FRect{
+                    static_cast<float>(clip.x),
+                    static_cast<float>(clip.y),
+                    static_cast<float>(clip.w),
+                    static_cast<float>(clip.h),
+                };
+
+                SDL_SetRenderClipRect(renderer, &clip);
+                SDL_RenderFillRect(renderer, &clip_rect);
+                pixels_redrawn += area(clip_rect);
+
+                // everything drawn in the pixels of the region
+                world_region = SDL_FRect{
+                    clip_rect.x + world_view.x,
+                    clip_rect.y + world_view.y,
+                    clip_rect.w,
+                    clip_rect.h,
+                };
+            }
+            SDL_SetRenderDrawColor(renderer, bak.r, bak.g, bak.b, bak.a);
+
+            // record the draw commands
+            commands.clear();
+
+            {
+                PROFILE_ZONE("culling");
+
+                // candidates from the cells overlapping the region
+                visible.clear();
+                grid.query(world_region, visible);
+
+                for (auto e_drawable : visible)
+                {
+                    // the moving drawables where they are drawn this frame
+                    const auto &rect = motions.contains(e_drawable)
+                                           ? motions.get(e_drawable).drawn
+                                           : bboxes.get(e_drawable).rect;
+
+                    if (SDL_HasRectIntersectionFloat(&world_region, &rect))
+                    {
+                        // entity's bounding box intersects with the region
+                        auto &c_drawable = drawables.get(e_drawable);
+                        commands.push_back(internal::make_draw_command(
+                            c_drawable.depth,
+                            c_drawable.material,
+                            e_drawable));
+                    }
+                }
+            }
+
+            {
+                PROFILE_ZONE("sorting");
+                std::sort(commands.begin(), commands.end());
+            }
+
+            // execute draw calls, consecutive sprites are batched
+            PROFILE_ZONE("draw");
+            for (auto command : commands)
+            {
+                auto e_drawable = internal::draw_command_entity(command);
+                auto M = M_view * world_matrix(e_drawable);
+
+                if (sprites.contains(e_drawable))
+                {
+                    internal::push_sprite(batch, stats, renderer, sprites.get(e_drawable), M);
+                    continue;
+                }
+
+                // keep the draw order
+                internal::flush_sprites(batch, stats, renderer);
+
+                auto &c_drawable = drawables.get(e_drawable);
+                if (c_drawable.draw)
+                {
+                    c_drawable.draw(renderer, to_mat4(M), delta_time);
+                    ++stats.draw_calls;
+                }
             }
+            internal::flush_sprites(batch, stats, renderer);
         }
+        SDL_SetRenderClipRect(renderer, nullptr);
 
-        // execute draw calls
-        while (!c_draw_target.queue.empty())
-        {
-            auto draw_call = c_draw_target.queue.top();
-            c_draw_target.queue.pop();
+        auto draw_calls = stats.draw_calls - draw_calls_begin;
+        ++stats.cameras_redrawn;
+        stats.regions += regions.size();
+        stats.pixels_redrawn += pixels_redrawn;
 
-            draw_call.m_drawable.draw(renderer, draw_call.world_transform, delta_time);
+        if (full_redraw)
+        {
+            c_draw_target.full_draw_calls = draw_calls;
         }
+        else
+        {
+            stats.pixels_saved += std::max(view_area - pixels_redrawn, 0.0f);
+            if (c_draw_target.full_draw_calls > draw_calls)
+            {
+                stats.draw_calls_saved += c_draw_target.full_draw_calls - draw_calls;
+            }
+        }
+
+        c_draw_target.world_view = world_view;
+        c_draw_target.valid = true;
 
         // render camera texture to screen
         // NB: SDL will automatically stretch the texture to the viewport
         SDL_SetRenderTarget(renderer, nullptr);
-        SDL_RenderTexture(renderer, c_draw_target.target, nullptr, &c_camera.viewport);
+        SDL_RenderTexture(renderer, c_draw_target.target, &source, &c_camera.viewport);
     }
-    SDL_RenderPresent(renderer);
-}
\ No newline at end of file
+
+    // every camera has seen the damage of this frame
+    damage.rects.clear();
+
+    // the entities which stood still during the last step were drawn where
+    // they are, they are not interpolated anymore and go back to their
+    // bounding box in the grid
+    for (auto [entity, c_motion] : registry.view<internal::motion>().each())
+    {
+        if (!c_motion.moved && !c_motion.snap)
+        {
+            if (drawables.contains(entity))
+            {
+                if (bboxes.contains(entity))
+                {
+                    grid.update(entity, bboxes.get(entity).rect);
+                }
+                else
+                {
+                    grid.remove(entity);
+                }
+            }
+            registry.remove<internal::motion>(entity);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#include "engine/frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+    constexpr std::size_t block_alignment = alignof(std::max_align_t);
+
+    // offset from `base` of the first address past `offset` aligned to
+    // `alignment`
+    std::size_t align_offset(const std::byte *base, std::size_t offset, std::size_t alignment)
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(base) + offset;
+        auto aligned = (address + alignment - 1) & ~(std::uintptr_t(alignment) - 1);
+        return offset + std::size_t(aligned - address);
+    }
+}
+
+frame_arena::frame_arena(std::size_t capacity, std::pmr::memory_resource *upstream)
+    : m_upstream{upstream}, m_capacity{std::max<std::size_t>(capacity, block_alignment)}
+{
+    m_block = static_cast<std::byte *>(m_upstream->allocate(m_capacity, block_alignment));
+}
+
+frame_arena::~frame_arena()
+{
+    for (const auto &extra : m_extra)
+    {
+        m_upstream->deallocate(extra.data, extra.size, extra.alignment);
+    }
+    m_upstream->deallocate(m_block, m_capacity, block_alignment);
+}
+
+frame_arena &get_frame_arena()
+{
+    static frame_arena arena;
+    return arena;
+}
+
+void *frame_arena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    auto offset = m_offset.load(std::memory_order_relaxed);
+    auto begin = std::size_t{0};
+    do
+    {
+        begin = align_offset(m_block, offset, alignment);
+        if (begin + bytes > m_capacity)
+        {
+            return allocate_extra(bytes, alignment);
+        }
+    } while (!m_offset.compare_exchange_weak(offset, begin + bytes, std::memory_order_relaxed));
+
+    return m_block + begin;
+}
+
+void *frame_arena::allocate_extra(std::size_t bytes, std::size_t alignment)
+{
+    auto lock = std::lock_guard{m_mutex};
+
+    if (!m_extra.empty())
+    {
+        auto &last = m_extra.back();
+        auto begin = align_offset(last.data, m_extra_offset, alignment);
+        if (begin + bytes <= last.size)
+        {
+            m_extra_offset = begin + bytes;
+            m_extra_used += bytes;
+            return last.data + begin;
+        }
+    }
+
+    // at the start of a new block, aligned by the upstream resource
+    auto size = std::max(m_capacity, bytes);
+    alignment = std::max(alignment, block_alignment);
+    auto *data = static_cast<std::byte *>(m_upstream->allocate(size, alignment));
+    m_extra.push_back(block{.data = data, .size = size, .alignment = alignment});
+    m_extra_offset = bytes;
+    m_extra_used += bytes;
+    return data;
+}
+
+std::size_t frame_arena::used() const
+{
+    return m_offset.load(std::memory_order_relaxed) + m_extra_used;
+}
+
+void frame_arena::reset()
+{
+    auto frame_used = used();
+    m_peak = std::max(m_peak, frame_used);
+
+    if (!m_extra.empty())
+    {
+        for (const auto &extra : m_extra)
+        {
+            m_upstream->deallocate(extra.data, extra.size, extra.alignment);
+        }
+        m_extra.clear();
+
+        // the next frames fit in the block, with room for the alignment
+        auto capacity = m_capacity;
+        while (capacity < frame_used + frame_used / 8)
+        {
+            capacity *= 2;
+        }
+        m_upstream->deallocate(m_block, m_capacity, block_alignment);
+        m_block = static_cast<std::byte *>(m_upstream->allocate(capacity, block_alignment));
+        m_capacity = capacity;
+    }
+
+    m_offset.store(0, std::memory_order_relaxed);
+    m_extra_offset = 0;
+    m_extra_used = 0;
+}
@@ -0,0 +1,147 @@
+#include "engine/frame_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    Uint64 to_ns(double seconds)
+    {
+        return static_cast<Uint64>(std::llround(seconds * SDL_NS_PER_SECOND));
+    }
+}
+
+frame_scheduler::frame_scheduler(const frame_scheduler_config &config)
+{
+    set_config(config);
+}
+
+void frame_scheduler::set_config(const frame_scheduler_config &config)
+{
+    m_config = config;
+    m_config.max_steps = std::max(m_config.max_steps, 1);
+
+    m_step_ns = std::max<Uint64>(to_ns(m_config.fixed_step), 1);
+    m_period_ns = m_config.frame_cap > 0.0 ? to_ns(1.0 / m_config.frame_cap) : 0;
+}
+
+int frame_scheduler::begin_frame()
+{
+    auto now = SDL_GetTicksNS();
+
+    if (m_frame_begin_ns == 0)
+    {
+        // first frame: a single step, the deadlines start from here
+        m_frame_begin_ns = now;
+        m_deadline_ns = now;
+        m_accumulator_ns = m_step_ns;
+    }
+
+    auto interval_ns = now - m_frame_begin_ns;
+    m_frame_begin_ns = now;
+    m_delta_time = static_cast<float>(interval_ns) / SDL_NS_PER_SECOND;
+    m_accumulator_ns += interval_ns;
+
+    auto steps = m_accumulator_ns / m_step_ns;
+    m_accumulator_ns -= steps * m_step_ns;
+
+    // a slow frame would be followed by even more steps, drop them instead
+    if (steps > static_cast<Uint64>(m_config.max_steps))
+    {
+        m_stats.dropped_steps += steps - m_config.max_steps;
+        steps = m_config.max_steps;
+    }
+    m_steps += steps;
+
+    m_stats.steps = static_cast<int>(steps);
+    if (m_stats.frames > 0)
+    {
+        update_stats(interval_ns);
+    }
+    ++m_stats.frames;
+
+    return m_stats.steps;
+}
+
+void frame_scheduler::end_frame()
+{
+    if (m_config.vsync || m_period_ns == 0)
+    {
+        return;
+    }
+
+    m_deadline_ns += m_period_ns;
+
+    auto now = SDL_GetTicksNS();
+    if (now > m_deadline_ns + m_period_ns)
+    {
+        // more than a frame late, start over instead of rushing the next
+        // frames to catch up
+        ++m_stats.late_frames;
+        m_deadline_ns = now;
+        return;
+    }
+
+    wait_until(m_deadline_ns);
+}
+
+frame_time frame_scheduler::time() const
+{
+    return frame_time{
+        .fixed_delta_time = static_cast<float>(m_step_ns) / SDL_NS_PER_SECOND,
+        .delta_time = m_delta_time,
+        .alpha = static_cast<float>(m_accumulator_ns) / static_cast<float>(m_step_ns),
+        .steps = m_steps,
+    };
+}
+
+void frame_scheduler::update_stats(Uint64 interval_ns)
+{
+    auto frame_ms = interval_ns / 1'000'000.0;
+    // `frames` counts the first frame, which has no interval
+    m_frame_ms[(m_stats.frames - 1) % window] = frame_ms;
+    m_stats.frame_ms = frame_ms;
+
+    auto count = std::min<std::size_t>(m_stats.frames, window);
+    auto first = m_frame_ms.begin();
+    auto last = first + count;
+
+    auto sum = 0.0;
+    auto min_ms = frame_ms;
+    auto max_ms = frame_ms;
+    for (auto it = first; it != last; ++it)
+    {
+        sum += *it;
+        min_ms = std::min(min_ms, *it);
+        max_ms = std::max(max_ms, *it);
+    }
+    auto average = sum / count;
+
+    auto variance = 0.0;
+    for (auto it = first; it != last; ++it)
+    {
+        variance += (*it - average) * (*it - average);
+    }
+
+    m_stats.average_ms = average;
+    m_stats.min_ms = min_ms;
+    m_stats.max_ms = max_ms;
+    m_stats.jitter_ms = std::sqrt(variance / count);
+}
+
+void frame_scheduler::wait_until(Uint64 deadline_ns) const
+{
+    auto now = SDL_GetTicksNS();
+
+    // sleep most of the wait, the wake up is late by up to a few ms...
+    if (now + m_config.spin_ns < deadline_ns)
+    {
+        SDL_DelayNS(deadline_ns - now - m_config.spin_ns);
+    }
+
+    // ... spin until the deadline
+    while (SDL_GetTicksNS() < deadline_ns)
+    {
+        SDL_CPUPauseInstruction();
+    }
+}
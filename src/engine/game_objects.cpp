@@ -1,119 +1,439 @@
 #include "engine/game_objects.hpp"
+#include "engine/job_system.hpp"
+#include "engine/profiler.hpp"
 
-void parent_system(entt::registry &registry)
+#include <algorithm>
+
+namespace
 {
-    auto child_pov = registry.view<parent>();
+    // the helpers below take the `internal::hierarchy` storage directly to
+    // avoid looking it up in the registry for every node
 
-    auto parent_pov = registry.view<internal::children>();
-    // add to `children` every entity with a `parent`
-    for (auto entity : child_pov)
+    template <typename Storage>
+    void unlink_node(Storage &nodes, entt::entity entity)
     {
-        auto &c_parent = registry.get<parent>(entity);
+        auto &node = nodes.get(entity);
+
+        if (node.parent == entt::null)
+        {
+            // roots are not part of any list
+            return;
+        }
+
+        if (node.prev_sibling != entt::null)
+        {
+            nodes.get(node.prev_sibling).next_sibling = node.next_sibling;
+        }
+        else
+        {
+            nodes.get(node.parent).first_child = node.next_sibling;
+        }
 
-        if (registry.valid(c_parent.entity))
+        if (node.next_sibling != entt::null)
         {
-            auto &c_children = registry.get_or_emplace<internal::children>(c_parent.entity);
-            c_children.entities.insert(entity); // insert(entity);
+            nodes.get(node.next_sibling).prev_sibling = node.prev_sibling;
         }
+
+        node.parent = entt::null;
+        node.prev_sibling = entt::null;
+        node.next_sibling = entt::null;
     }
 
-    // remove from `children`:
-    //  - every invalid entities
-    //  - entities with the a different `parent`
-    //  - entities without a `parent`
-    for (auto entity : parent_pov)
+    template <typename Storage>
+    void link_node(Storage &nodes, entt::entity entity, entt::entity e_parent)
     {
-        auto &c_children = parent_pov.get<internal::children>(entity);
+        auto &node = nodes.get(entity);
+        auto &parent_node = nodes.get(e_parent);
 
-        auto to_remove = std::vector<entt::entity>{};
-        to_remove.reserve(c_children.entities.size());
+        node.parent = e_parent;
+        node.next_sibling = parent_node.first_child;
 
-        for (auto child : c_children.entities)
+        if (parent_node.first_child != entt::null)
         {
-            if (!registry.valid(child))
+            nodes.get(parent_node.first_child).prev_sibling = entity;
+        }
+        parent_node.first_child = entity;
+    }
+
+    // recompute the depth of `root` and of its whole subtree
+    template <typename Storage>
+    void update_depths(Storage &nodes, entt::entity root)
+    {
+        auto &root_node = nodes.get(root);
+        root_node.depth = root_node.parent == entt::null
+                              ? 0u
+                              : nodes.get(root_node.parent).depth + 1u;
+
+        // iterative pre-order walk, the subtree may be arbitrarily deep
+        auto e = root_node.first_child;
+        while (e != entt::null)
+        {
+            auto &node = nodes.get(e);
+            node.depth = nodes.get(node.parent).depth + 1u;
+
+            if (node.first_child != entt::null)
             {
-                // the entity was destroyed
-                to_remove.push_back(child);
+                e = node.first_child;
+                continue;
             }
-            else if (child_pov.contains(child))
+
+            // climb up to the first ancestor with a next sibling, without
+            // leaving the subtree
+            while (e != root && nodes.get(e).next_sibling == entt::null)
             {
-                auto &c_parent = registry.get<parent>(child);
+                e = nodes.get(e).parent;
+            }
+            e = e == root ? entt::null : nodes.get(e).next_sibling;
+        }
+    }
 
-                if (c_parent.entity != entity)
-                {
-                    // the entity was assigned to another parent
-                    to_remove.push_back(child);
-                }
+    internal::hierarchy &get_or_emplace_node(entt::registry &registry, entt::entity entity)
+    {
+        if (auto *node = registry.try_get<internal::hierarchy>(entity))
+        {
+            return *node;
+        }
+
+        // a new node is a root. It is appended to the pools and iterated
+        // first, so the order of the hierarchy still holds
+        registry.emplace<internal::local_to_world>(entity);
+        registry.emplace_or_replace<internal::motion>(entity, internal::motion{.snap = true});
+        internal::mark_transform_dirty(registry, entity);
+
+        return registry.emplace<internal::hierarchy>(entity);
+    }
+
+    void reparent(entt::registry &registry, entt::entity entity, entt::entity e_parent)
+    {
+        auto &nodes = registry.storage<internal::hierarchy>();
+
+        unlink_node(nodes, entity);
+
+        if (e_parent != entt::null)
+        {
+            link_node(nodes, entity, e_parent);
+        }
+
+        update_depths(nodes, entity);
+        registry.ctx().get<internal::hierarchy_order>().unsorted = true;
+        internal::mark_transform_dirty(registry, entity);
+    }
+
+    // an entity left with neither `local_transform` nor `parent` stays in
+    // the hierarchy only as the root of its children: without any, it
+    // leaves it as if it never joined
+    void remove_orphan_node(entt::registry &registry, entt::entity entity)
+    {
+        auto &nodes = registry.storage<internal::hierarchy>();
+        if (!nodes.contains(entity) || nodes.get(entity).first_child != entt::null ||
+            registry.any_of<local_transform, parent>(entity))
+        {
+            return;
+        }
+
+        // unlinked by `destroy_hierarchy_node`. The removals swap the last
+        // nodes into the hole, the pools are sorted again
+        registry.remove<internal::hierarchy>(entity);
+        registry.remove<internal::local_to_world>(entity);
+        registry.remove<internal::motion>(entity);
+        registry.remove<internal::dirty_transform>(entity);
+        registry.ctx().get<internal::hierarchy_order>().unsorted = true;
+    }
+
+    // the parent an entity should be linked to: null when it is invalid or
+    // when it would create a cycle
+    entt::entity resolve_parent(entt::registry &registry, entt::entity entity, entt::entity e_parent)
+    {
+        if (!registry.valid(e_parent))
+        {
+            return entt::null;
+        }
+
+        auto &nodes = registry.storage<internal::hierarchy>();
+
+        for (auto e = e_parent; e != entt::null && nodes.contains(e); e = nodes.get(e).parent)
+        {
+            if (e == entity)
+            {
+                return entt::null;
             }
-            else
+        }
+
+        return e_parent;
+    }
+}
+
+void parent_system(entt::registry &registry)
+{
+    PROFILE_ZONE("parent_system");
+
+    auto &changes = registry.ctx().get<internal::hierarchy_changes>();
+    auto &parents = registry.storage<parent>();
+    auto &locals = registry.storage<local_transform>();
+    auto &nodes = registry.storage<internal::hierarchy>();
+
+    // only the entities recorded by the signals are reconciled, an entity may
+    // appear several times: the extra passes are no-ops. Removing a node
+    // may record its parent, by index as the list grows
+    for (std::size_t i = 0; i < changes.entities.size(); ++i)
+    {
+        auto entity = changes.entities[i];
+        if (!registry.valid(entity))
+        {
+            // destroyed in the meantime
+            continue;
+        }
+
+        auto has_parent = parents.contains(entity);
+
+        if (!has_parent && !locals.contains(entity) && !nodes.contains(entity))
+        {
+            // lost its `parent` without ever being part of the hierarchy
+            continue;
+        }
+
+        auto &node = get_or_emplace_node(registry, entity);
+        auto e_parent = has_parent
+                            ? resolve_parent(registry, entity, parents.get(entity).entity)
+                            : entt::null;
+
+        auto old_parent = node.parent;
+        if (old_parent != e_parent)
+        {
+            if (e_parent != entt::null)
+            {
+                get_or_emplace_node(registry, e_parent);
+            }
+            reparent(registry, entity, e_parent);
+            // its last child may have kept the old parent in the hierarchy
+            if (old_parent != entt::null)
             {
-                // the entity does not have a parent anymore
-                to_remove.push_back(child);
+                remove_orphan_node(registry, old_parent);
             }
         }
+        else
+        {
+            // e.g. the entity lost its `local_transform`
+            internal::mark_transform_dirty(registry, entity);
+        }
 
-        for (auto child : to_remove)
+        if (!has_parent)
         {
-            c_children.entities.erase(child);
+            remove_orphan_node(registry, entity);
         }
     }
-    /*
-     */
+
+    changes.entities.clear();
 }
 
-void local_to_world_system(entt::registry &registry)
+void internal::mark_transform_dirty(entt::registry &registry, entt::entity entity)
+{
+    registry.emplace_or_replace<internal::dirty_transform>(entity);
+}
+
+void internal::record_hierarchy_change(entt::registry &registry, entt::entity entity)
+{
+    registry.ctx().get<internal::hierarchy_changes>().entities.push_back(entity);
+}
+
+void internal::destroy_hierarchy_node(entt::registry &registry, entt::entity entity)
 {
-    auto view = registry.view<local_transform>();
-    auto visited = entt::sparse_set();
-    //    std::unordered_set<entt::entity>{};
+    auto &nodes = registry.storage<internal::hierarchy>();
+    auto &node = nodes.get(entity);
 
-    // recursive function to traverse the hierarchy
-    // `self` is the function itself, for recursion,
-    // see: https://en.wikipedia.org/wiki/Fixed-point_combinator
-    auto compute_world_matrix = [&](auto &self, entt::entity e) -> glm::mat4x4
+    if (node.first_child != entt::null)
     {
-        if (visited.contains(e))
+        // the parent is going away, its children become roots
+        for (auto child = node.first_child; child != entt::null;)
         {
-            // we already visited this entity, let's return its world matrix
-            auto &c_local_to_world = registry.get<internal::local_to_world>(e);
-            return c_local_to_world.mat;
+            auto &child_node = nodes.get(child);
+            auto next = child_node.next_sibling;
+
+            child_node.parent = entt::null;
+            child_node.prev_sibling = entt::null;
+            child_node.next_sibling = entt::null;
+            update_depths(nodes, child);
+            mark_transform_dirty(registry, child);
+
+            child = next;
         }
+        node.first_child = entt::null;
+        registry.ctx().get<internal::hierarchy_order>().unsorted = true;
+    }
 
-        auto local_matrix = glm::mat4x4(1.0f);
+    // a parent kept only for its children may have lost the last one, the
+    // `parent_system` removes it
+    if (node.parent != entt::null && !registry.any_of<local_transform, parent>(node.parent))
+    {
+        record_hierarchy_change(registry, node.parent);
+    }
 
-        // it is possible that the developer referenced a parent entity that
-        // has no local transform.
+    unlink_node(nodes, entity);
+}
 
-        if (view.contains(e))
-        {
-            // but if it does, let's compute the local matrix
-            const auto &c_local_transform = view.get<local_transform>(e);
+void internal::transform_setup_system(entt::registry &registry)
+{
+    registry.ctx().emplace<transform_stats>();
+    registry.ctx().emplace<internal::hierarchy_order>();
+    registry.ctx().emplace<internal::hierarchy_changes>();
+    registry.ctx().emplace<internal::transform_jobs>();
+
+    registry.on_construct<local_transform>().connect<&record_hierarchy_change>();
+    registry.on_update<local_transform>().connect<&mark_transform_dirty>();
+    registry.on_destroy<local_transform>().connect<&record_hierarchy_change>();
 
-            local_matrix = make_transform(c_local_transform);
+    registry.on_construct<parent>().connect<&record_hierarchy_change>();
+    registry.on_update<parent>().connect<&record_hierarchy_change>();
+    registry.on_destroy<parent>().connect<&record_hierarchy_change>();
+
+    registry.on_destroy<internal::hierarchy>().connect<&destroy_hierarchy_node>();
+}
+
+void local_to_world_system(entt::registry &registry)
+{
+    PROFILE_ZONE("local_to_world_system");
+
+    auto &stats = registry.ctx().get<transform_stats>();
+    stats.recomputed = 0;
+
+    auto &order = registry.ctx().get<internal::hierarchy_order>();
+    if (order.unsorted)
+    {
+        // parents before children, the world matrices follow the same order
+        // so each depth below reads both pools sequentially
+        registry.sort<internal::hierarchy>(
+            [](const internal::hierarchy &lhs, const internal::hierarchy &rhs)
+            { return lhs.depth < rhs.depth; });
+        registry.sort<internal::local_to_world, internal::hierarchy>();
+        order.unsorted = false;
+    }
+
+    auto &worlds = registry.storage<internal::local_to_world>();
+    auto &motions = registry.storage<internal::motion>();
+
+    // the entities that moved during the previous step stand still unless
+    // they move again below
+    for (auto [entity, c_motion] : motions.each())
+    {
+        if (c_motion.moved)
+        {
+            c_motion.previous = worlds.get(entity).mat;
+            c_motion.moved = false;
         }
+    }
 
-        auto world_matrix = local_matrix;
+    auto &dirty = registry.storage<internal::dirty_transform>();
+    if (dirty.empty())
+    {
+        // nothing moved since the last frame
+        return;
+    }
 
-        // if the entity has a parent and this parent is a valid entity,
-        // let's recurse
-        auto *c_parent = registry.try_get<parent>(e);
+    auto &locals = registry.storage<local_transform>();
+    auto &nodes = registry.storage<internal::hierarchy>();
+    const entt::sparse_set &pool = nodes;
+    auto &jobs = registry.ctx().get<internal::transform_jobs>();
 
-        if (c_parent != nullptr && registry.valid(c_parent->entity))
+    jobs.entities.clear();
+    jobs.levels.clear();
+    for (auto [entity, node] : registry.view<internal::hierarchy>().each())
+    {
+        if (jobs.levels.size() <= node.depth)
         {
-            auto parent_world_matrix = self(self, c_parent->entity);
-            world_matrix = parent_world_matrix * world_matrix;
+            jobs.levels.resize(node.depth + 1, jobs.entities.size());
         }
+        jobs.entities.push_back(entity);
+    }
+    jobs.levels.push_back(jobs.entities.size());
+    jobs.flags.assign(pool.size(), 0);
+    jobs.previous.resize(pool.size());
 
-        // finally update or insert the final component
-        registry.emplace_or_replace<internal::local_to_world>(e, world_matrix);
-        visited.push(e);
+    // the parent of a node was processed with the depth above, so its
+    // matrix is up to date and its dirty state is passed down
+    auto update = [&](std::size_t begin, std::size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            auto entity = jobs.entities[i];
+            auto &node = nodes.get(entity);
+            auto &flags = jobs.flags[pool.index(entity)];
+
+            if (!dirty.contains(entity))
+            {
+                if (node.parent == entt::null ||
+                    (jobs.flags[pool.index(node.parent)] & internal::transform_jobs::recomputed) == 0)
+                {
+                    continue;
+                }
+                flags |= internal::transform_jobs::dirtied;
+            }
+
+            auto world_matrix = locals.contains(entity)
+                                    ? make_world_transform(locals.get(entity))
+                                    : world_transform(1.0f);
 
-        return world_matrix;
+            if (node.parent != entt::null)
+            {
+                world_matrix = worlds.get(node.parent).mat * world_matrix;
+            }
+
+            auto &c_world = worlds.get(entity);
+
+            // remember where the entity comes from, for the interpolation
+            if (!motions.contains(entity))
+            {
+                flags |= internal::transform_jobs::new_motion;
+                jobs.previous[pool.index(entity)] = c_world.mat;
+            }
+            else if (auto &c_motion = motions.get(entity); c_motion.snap)
+            {
+                c_motion.previous = world_matrix;
+                c_motion.snap = false;
+            }
+            else
+            {
+                c_motion.previous = c_world.mat;
+                c_motion.moved = true;
+            }
+
+            c_world.mat = world_matrix;
+            flags |= internal::transform_jobs::recomputed;
+        }
     };
 
-    for (auto entity : view)
+    auto &pool_jobs = get_job_system();
+    auto parallel = pool.size() >= internal::transform_jobs::min_parallel_nodes;
+    for (std::size_t depth = 0; depth + 1 < jobs.levels.size(); ++depth)
     {
-        compute_world_matrix(compute_world_matrix, entity);
+        auto first = jobs.levels[depth];
+        auto last = jobs.levels[depth + 1];
+        if (!parallel)
+        {
+            update(first, last);
+            continue;
+        }
+        pool_jobs.parallel_for(last - first, internal::transform_jobs::grain, [&](std::size_t begin, std::size_t end)
+                               { update(first + begin, first + end); });
+    }
+
+    // the components the jobs could not add
+    const auto *packed = pool.data();
+    for (std::size_t i = 0; i < jobs.flags.size(); ++i)
+    {
+        auto flags = jobs.flags[i];
+        if (flags == 0)
+        {
+            continue;
+        }
+        ++stats.recomputed;
+        if ((flags & internal::transform_jobs::dirtied) != 0)
+        {
+            dirty.emplace(packed[i]);
+        }
+        if ((flags & internal::transform_jobs::new_motion) != 0)
+        {
+            motions.emplace(packed[i], internal::motion{.previous = jobs.previous[i], .moved = true});
+        }
     }
 }
 
@@ -134,3 +454,19 @@ glm::mat4 make_transform(const local_transform &t)
 
     return mat;
 }
+
+affine2d make_affine_transform(const local_transform &t)
+{
+    // translate * rotate(roll) * scale
+    auto cos = std::cos(t.rotation.z);
+    auto sin = std::sin(t.rotation.z);
+
+    return affine2d{
+        cos * t.scale.x,
+        sin * t.scale.x,
+        -sin * t.scale.y,
+        cos * t.scale.y,
+        t.position.x,
+        t.position.y,
+    };
+}
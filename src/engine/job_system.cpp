@@ -0,0 +1,286 @@
+#include "engine/job_system.hpp"
+
+#include "engine/allocation_stats.hpp"
+
+namespace internal
+{
+    // Chase-Lev deque of a fixed capacity. The owner pushes and pops at
+    // the bottom without contention, thieves take the top with a
+    // compare-and-swap; only the last job is contended by both.
+    struct work_deque
+    {
+        static constexpr std::int64_t capacity = 4096;
+
+        // false when full, the owner then runs the job itself
+        bool push(job *j)
+        {
+            auto bottom = m_bottom.load(std::memory_order_relaxed);
+            auto top = m_top.load(std::memory_order_acquire);
+            if (bottom - top >= capacity)
+            {
+                return false;
+            }
+            m_jobs[std::size_t(bottom & (capacity - 1))].store(j, std::memory_order_relaxed);
+            // publishes the job, and what the submitter wrote before it
+            m_bottom.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        job *pop()
+        {
+            // the store of the bottom and the load of the top are ordered
+            // against the steals
+            auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(bottom, std::memory_order_seq_cst);
+            auto top = m_top.load(std::memory_order_seq_cst);
+
+            if (top > bottom)
+            {
+                // empty
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            auto *j = m_jobs[std::size_t(bottom & (capacity - 1))].load(std::memory_order_relaxed);
+            if (top == bottom)
+            {
+                // the last job, a thief may be taking it
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    j = nullptr;
+                }
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return j;
+        }
+
+        job *steal()
+        {
+            auto top = m_top.load(std::memory_order_seq_cst);
+            auto bottom = m_bottom.load(std::memory_order_seq_cst);
+            if (top >= bottom)
+            {
+                return nullptr;
+            }
+            auto *j = m_jobs[std::size_t(top & (capacity - 1))].load(std::memory_order_relaxed);
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                // lost the race against the owner or another thief
+                return nullptr;
+            }
+            return j;
+        }
+
+        alignas(64) std::atomic<std::int64_t> m_top{0};
+        alignas(64) std::atomic<std::int64_t> m_bottom{0};
+        // written by the thread owning the deque only
+        alignas(64) std::atomic<std::uint64_t> executed{0};
+        std::atomic<std::uint64_t> stolen{0};
+        std::array<std::atomic<job *>, capacity> m_jobs{};
+    };
+}
+
+namespace
+{
+    // spins before a worker goes to sleep, a frame submits its jobs in
+    // bursts
+    constexpr int idle_spins = 2048;
+
+    struct thread_slot
+    {
+        const job_system *pool{nullptr};
+        int index{-1};
+        std::uint32_t random{0x9e3779b9u};
+    };
+
+    thread_local thread_slot t_slot;
+
+    std::uint32_t next_random()
+    {
+        // xorshift, to pick the deques to steal from
+        auto x = t_slot.random;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        t_slot.random = x;
+        return x;
+    }
+
+    void add(std::atomic<std::uint64_t> &counter, std::uint64_t value)
+    {
+        // a single writer
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+}
+
+job_system::job_system(int threads)
+{
+    t_slot = thread_slot{.pool = this, .index = 0};
+    start(threads);
+}
+
+job_system::~job_system()
+{
+    stop();
+}
+
+void job_system::set_threads(int threads)
+{
+    stop();
+    start(threads);
+}
+
+void job_system::start(int threads)
+{
+    if (threads <= 0)
+    {
+        threads = int(std::max(std::thread::hardware_concurrency(), 1u));
+    }
+
+    m_stop.store(false, std::memory_order_relaxed);
+    m_deques.clear();
+    for (int i = 0; i < threads; ++i)
+    {
+        m_deques.push_back(std::make_unique<internal::work_deque>());
+    }
+    for (int i = 1; i < threads; ++i)
+    {
+        m_workers.emplace_back([this, i]()
+                               { work(i); });
+    }
+}
+
+void job_system::stop()
+{
+    {
+        auto lock = std::lock_guard{m_mutex};
+        m_stop.store(true, std::memory_order_seq_cst);
+    }
+    m_wake.notify_all();
+    for (auto &worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+int job_system::current_index() const
+{
+    return t_slot.pool == this ? t_slot.index : -1;
+}
+
+void job_system::submit(job &j)
+{
+    auto index = current_index();
+    if (index < 0 || !m_deques[std::size_t(index)]->push(&j))
+    {
+        j.run(j.context, j.begin, j.end);
+        j.pending->fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    m_queued.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        // under the lock: a worker cannot check for jobs and then miss the
+        // notification
+        auto lock = std::lock_guard{m_mutex};
+        m_wake.notify_one();
+    }
+}
+
+void job_system::wait(std::atomic<int> &pending)
+{
+    auto index = current_index();
+    while (pending.load(std::memory_order_acquire) > 0)
+    {
+        if (auto *j = index >= 0 ? find_job(index) : nullptr; j != nullptr)
+        {
+            execute(j, index);
+        }
+        else
+        {
+            // the last jobs run on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+job *job_system::find_job(int index)
+{
+    if (auto *j = m_deques[std::size_t(index)]->pop())
+    {
+        return j;
+    }
+
+    auto count = int(m_deques.size());
+    auto offset = int(next_random() % std::uint32_t(count));
+    for (int i = 0; i < count; ++i)
+    {
+        auto victim = (offset + i) % count;
+        if (victim == index)
+        {
+            continue;
+        }
+        if (auto *j = m_deques[std::size_t(victim)]->steal())
+        {
+            add(m_deques[std::size_t(index)]->stolen, 1);
+            return j;
+        }
+    }
+    return nullptr;
+}
+
+void job_system::execute(job *j, int index)
+{
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    add(m_deques[std::size_t(index)]->executed, 1);
+    j->run(j->context, j->begin, j->end);
+    j->pending->fetch_sub(1, std::memory_order_release);
+}
+
+void job_system::work(int index)
+{
+    t_slot = thread_slot{.pool = this, .index = index, .random = 0x9e3779b9u * std::uint32_t(index + 1)};
+    // the workers run the systems of the frame
+    track_frame_allocations();
+
+    auto idle = 0;
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        if (auto *j = find_job(index))
+        {
+            execute(j, index);
+            idle = 0;
+            continue;
+        }
+        if (++idle < idle_spins)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto lock = std::unique_lock{m_mutex};
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        m_wake.wait(lock, [this]()
+                    { return m_queued.load(std::memory_order_seq_cst) > 0 || m_stop.load(std::memory_order_relaxed); });
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+job_stats job_system::stats() const
+{
+    auto stats = job_stats{};
+    for (const auto &deque : m_deques)
+    {
+        stats.executed += deque->executed.load(std::memory_order_relaxed);
+        stats.stolen += deque->stolen.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+job_system &get_job_system()
+{
+    static job_system jobs;
+    return jobs;
+}
@@ -1,27 +1,48 @@
 #include "engine/engine.hpp"
+#include "engine/allocation_stats.hpp"
+#include "engine/assets.hpp"
+#include "engine/frame_arena.hpp"
 #include "engine/game_objects.hpp"
 #include "engine/camera.hpp"
+#include "engine/profiler.hpp"
 #include "game/game.hpp"
+#include <string>
 
 /* This function runs once at startup. */
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[])
 {
-    AppState *state = (AppState *)SDL_calloc(1, sizeof(AppState));
-    if (!state)
-    {
-        return SDL_APP_FAILURE;
-    }
+    AppState *state = new AppState{};
 
     /* Create the window */
     if (!SDL_CreateWindowAndRenderer("Hello World", 800, 600, SDL_WINDOW_RESIZABLE, &(state->window), &(state->renderer)))
     {
         SDL_Log("Couldn't create window and renderer: %s", SDL_GetError());
         SDL_DestroyWindow(state->window);
+        delete state;
         return SDL_APP_FAILURE;
     }
 
+    auto config = frame_scheduler_config{.frame_cap = FPS};
+
+    if (auto frame_cap = SDL_getenv("ENGINE_FRAME_CAP"))
+    {
+        config.frame_cap = SDL_atof(frame_cap);
+    }
+    if (auto vsync = SDL_getenv("ENGINE_VSYNC"); vsync != nullptr && SDL_atoi(vsync) != 0)
+    {
+        // the cap still applies when the display refresh cannot be waited on
+        config.vsync = SDL_SetRenderVSync(state->renderer, 1);
+        if (!config.vsync)
+        {
+            SDL_Log("Couldn't enable VSync: %s", SDL_GetError());
+        }
+    }
+    state->scheduler.set_config(config);
+
+    // the main thread runs the frames, see `allocation_tracker`
+    track_frame_allocations();
+
     state->is_running = true;
-    state->last_frame_end = SDL_GetTicksNS();
     state->scene = initial_scene();
     *appstate = state;
 
@@ -43,6 +64,17 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
     }
     else
     {
+        if (event->type == SDL_EVENT_RENDER_TARGETS_RESET ||
+            event->type == SDL_EVENT_RENDER_DEVICE_RESET)
+        {
+            state->scene->invalidate_render_targets();
+        }
+#ifdef ENGINE_PROFILER
+        if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F3)
+        {
+            get_profiler().toggle_overlay();
+        }
+#endif
         state->scene->handle_event(event);
     }
 
@@ -58,22 +90,59 @@ SDL_AppResult SDL_AppIterate(void *appstate)
     }
     AppState *state = (AppState *)appstate;
 
-    Uint64 frame_begin = SDL_GetTicksNS();
-    float delta_time = (frame_begin - state->last_frame_end) / SDL_NS_PER_SECOND;
+    auto &scheduler = state->scheduler;
+    auto steps = scheduler.begin_frame();
 
-    state->scene->update();
-    state->scene->render(state->renderer);
-
-    /*
-     */
-    state->last_frame_end = SDL_GetTicksNS();
-    Uint64 elapsed = state->last_frame_end - frame_begin;
-    Uint64 target = SDL_NS_PER_SECOND / FPS;
+#ifdef ENGINE_PROFILER
+    auto &profiler = get_profiler();
+    profiler.begin_frame();
+#endif
+    auto &allocations = get_allocation_tracker();
+    allocations.begin_frame();
+    state->scene->set_frame_time(scheduler.time(), scheduler.stats());
+    {
+        PROFILE_ZONE("update");
+        // fixed timestep, the render interpolates between the last two steps
+        for (int step = 0; step < steps; ++step)
+        {
+            state->scene->update();
+        }
+    }
+    if (auto next = state->scene->take_next_scene())
+    {
+        delete state->scene;
+        state->scene = next;
+        state->scene->set_frame_time(scheduler.time(), scheduler.stats());
+    }
+    // the decoded textures, within the upload budget of a frame
+    get_asset_manager().update(state->renderer);
+    {
+        PROFILE_ZONE("render");
+        state->scene->render(state->renderer);
+    }
+#ifdef ENGINE_PROFILER
+    profiler.draw_overlay(state->renderer);
+#endif
+    {
+        PROFILE_ZONE("present");
+        SDL_RenderPresent(state->renderer);
+    }
+#ifdef ENGINE_PROFILER
+    profiler.end_frame();
+#endif
 
-    if (elapsed < target)
+    allocations.end_frame();
+    // the first frame does not wait for the textures
+    if (static bool first_frame = true; first_frame)
     {
-        SDL_DelayNS(target - elapsed);
+        first_frame = false;
+        SDL_Log("First frame after %.1f ms, %zu textures still loading",
+                double(SDL_GetTicksNS()) / 1'000'000.0, get_asset_manager().stats().loading);
     }
+    // nothing allocated from the arena outlives the frame
+    get_frame_arena().reset();
+
+    scheduler.end_frame();
 
     return SDL_APP_CONTINUE;
 }
@@ -84,10 +153,36 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result)
     if (appstate == nullptr)
     {
         SDL_Quit();
+        return;
     }
     AppState *state = (AppState *)appstate;
 
+#ifdef ENGINE_PROFILER
+    // the last samples of the run, written only when ENGINE_PROFILE names
+    // the files: ENGINE_PROFILE=profile writes profile.csv and
+    // profile.trace.json
+    if (auto base = SDL_getenv("ENGINE_PROFILE"); base != nullptr && *base != '\0')
+    {
+        auto csv_path = std::string(base) + ".csv";
+        auto trace_path = std::string(base) + ".trace.json";
+
+        if (!get_profiler().write_csv(csv_path.c_str()) ||
+            !get_profiler().write_chrome_trace(trace_path.c_str()))
+        {
+            SDL_Log("Couldn't write the profile to %s", csv_path.c_str());
+        }
+    }
+#endif
+
+    // stops the threads of the scene (e.g. the chess search) before the
+    // statics they use are destroyed, and releases its textures
+    delete state->scene;
+    state->scene = nullptr;
+
+    // the atlas pages belong to the renderer
+    get_asset_manager().shutdown();
     SDL_DestroyRenderer(state->renderer);
     SDL_DestroyWindow(state->window);
+    delete state;
     SDL_Quit();
 }
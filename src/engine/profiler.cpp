@@ -0,0 +1,297 @@
+#include "engine/profiler.hpp"
+#include "engine/allocation_stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    thread_local Uint32 zone_depth = 0;
+
+    constexpr double ms_per_ns = 1.0 / 1'000'000.0;
+    // smoothing of the averages shown by the overlay
+    constexpr double average_weight = 0.05;
+
+    double smooth(double average, double value)
+    {
+        return average + (value - average) * average_weight;
+    }
+
+    // a quoted CSV field doubles its quotes
+    void write_csv_escaped(std::FILE *file, const char *name)
+    {
+        for (auto c = name; *c != '\0'; ++c)
+        {
+            if (*c == '"')
+            {
+                std::fputc('"', file);
+            }
+            std::fputc(*c, file);
+        }
+    }
+
+    // a JSON string escapes its quotes and backslashes
+    void write_json_escaped(std::FILE *file, const char *name)
+    {
+        for (auto c = name; *c != '\0'; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                std::fputc('\\', file);
+            }
+            std::fputc(*c, file);
+        }
+    }
+}
+
+frame_profiler::frame_profiler() : m_slots{std::make_unique<slot[]>(capacity)}
+{
+}
+
+frame_profiler &get_profiler()
+{
+    static frame_profiler profiler;
+    return profiler;
+}
+
+void frame_profiler::begin_frame()
+{
+    m_frame_begin_ns = SDL_GetTicksNS();
+    m_frame_first_sample = m_head.load(std::memory_order_acquire);
+}
+
+void frame_profiler::end_frame()
+{
+    auto frame = m_frame.load(std::memory_order_relaxed);
+    auto frame_end_ns = SDL_GetTicksNS();
+
+    m_frame_ms = (frame_end_ns - m_frame_begin_ns) * ms_per_ns;
+    m_average_frame_ms = smooth(m_average_frame_ms, m_frame_ms);
+
+    for (auto &stats : m_zones)
+    {
+        stats.last_ms = 0.0;
+    }
+
+    // sum the samples of the frame, the ring may have wrapped around
+    auto head = m_head.load(std::memory_order_acquire);
+    auto first = std::max(m_frame_first_sample, head > capacity ? head - capacity : Uint64{0});
+
+    auto sample = profile_sample{};
+    for (auto index = first; index < head; ++index)
+    {
+        if (read(index, sample) && sample.frame == frame)
+        {
+            zone(sample.name).last_ms += (sample.end_ns - sample.begin_ns) * ms_per_ns;
+        }
+    }
+
+    for (auto &stats : m_zones)
+    {
+        stats.average_ms = smooth(stats.average_ms, stats.last_ms);
+        stats.window_peak_ms = std::max(stats.window_peak_ms, stats.last_ms);
+
+        if ((frame + 1) % peak_window == 0)
+        {
+            stats.peak_ms = stats.window_peak_ms;
+            stats.window_peak_ms = 0.0;
+        }
+    }
+
+    m_frame.store(frame + 1, std::memory_order_relaxed);
+}
+
+void frame_profiler::record(const char *name, Uint64 begin_ns, Uint64 end_ns, Uint32 depth)
+{
+    auto index = m_head.fetch_add(1, std::memory_order_relaxed);
+    auto &s = m_slots[index & (capacity - 1)];
+
+    // readers skip the slot until the new sample is complete
+    s.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s.sample = profile_sample{
+        .name = name,
+        .begin_ns = begin_ns,
+        .end_ns = end_ns,
+        .frame = m_frame.load(std::memory_order_relaxed),
+        .thread = SDL_GetCurrentThreadID(),
+        .depth = depth,
+    };
+
+    s.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool frame_profiler::read(Uint64 index, profile_sample &sample) const
+{
+    const auto &s = m_slots[index & (capacity - 1)];
+
+    if (s.sequence.load(std::memory_order_acquire) != index + 1)
+    {
+        return false;
+    }
+    sample = s.sample;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // overwritten while copied
+    return s.sequence.load(std::memory_order_relaxed) == index + 1;
+}
+
+void frame_profiler::snapshot(std::vector<profile_sample> &result) const
+{
+    result.clear();
+
+    auto head = m_head.load(std::memory_order_acquire);
+    auto first = head > capacity ? head - capacity : Uint64{0};
+
+    auto sample = profile_sample{};
+    for (auto index = first; index < head; ++index)
+    {
+        if (read(index, sample))
+        {
+            result.push_back(sample);
+        }
+    }
+}
+
+profile_zone_stats &frame_profiler::zone(const char *name)
+{
+    // few zones, a linear search beats hashing the names
+    for (auto &stats : m_zones)
+    {
+        if (stats.name == name || std::strcmp(stats.name, name) == 0)
+        {
+            return stats;
+        }
+    }
+
+    return m_zones.emplace_back(profile_zone_stats{.name = name});
+}
+
+void frame_profiler::draw_overlay(SDL_Renderer *renderer) const
+{
+    if (!m_overlay)
+    {
+        return;
+    }
+
+    // the debug font is 8x8 pixels
+    constexpr float line_height = 10.0f;
+    constexpr float margin = 4.0f;
+    constexpr float width = 46.0f * 8.0f;
+
+    auto bak = SDL_Color{};
+    auto bak_blend = SDL_BlendMode{};
+    SDL_GetRenderDrawColor(renderer, &bak.r, &bak.g, &bak.b, &bak.a);
+    SDL_GetRenderDrawBlendMode(renderer, &bak_blend);
+
+    auto background = SDL_FRect{
+        0.0f,
+        0.0f,
+        width + 2.0f * margin,
+        (m_zones.size() + 3) * line_height + 2.0f * margin,
+    };
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 192);
+    SDL_RenderFillRect(renderer, &background);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+    char line[64];
+    auto y = margin;
+
+    SDL_snprintf(line, sizeof(line), "frame %7.2f ms  avg %7.2f ms", m_frame_ms, m_average_frame_ms);
+    SDL_RenderDebugText(renderer, margin, y, line);
+    y += line_height;
+
+    // of the previous frame, 0 without ENGINE_ALLOC_STATS
+    const auto &allocations = get_allocation_tracker().frame();
+    SDL_snprintf(line, sizeof(line), "allocs %7llu  %10llu bytes",
+                 static_cast<unsigned long long>(allocations.count),
+                 static_cast<unsigned long long>(allocations.bytes));
+    SDL_RenderDebugText(renderer, margin, y, line);
+    y += line_height;
+
+    SDL_snprintf(line, sizeof(line), "%-22s %7s %7s", "zone", "avg", "peak");
+    SDL_RenderDebugText(renderer, margin, y, line);
+    y += line_height;
+
+    for (const auto &stats : m_zones)
+    {
+        SDL_snprintf(line, sizeof(line), "%-22.22s %7.3f %7.3f", stats.name, stats.average_ms, stats.peak_ms);
+        SDL_RenderDebugText(renderer, margin, y, line);
+        y += line_height;
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, bak_blend);
+    SDL_SetRenderDrawColor(renderer, bak.r, bak.g, bak.b, bak.a);
+}
+
+bool frame_profiler::write_csv(const char *path) const
+{
+    auto samples = std::vector<profile_sample>{};
+    snapshot(samples);
+
+    auto file = std::fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    std::fprintf(file, "frame,thread,depth,zone,begin_ns,duration_ns\n");
+    for (const auto &sample : samples)
+    {
+        std::fprintf(file, "%llu,%llu,%u,\"",
+                     static_cast<unsigned long long>(sample.frame),
+                     static_cast<unsigned long long>(sample.thread),
+                     sample.depth);
+        write_csv_escaped(file, sample.name);
+        std::fprintf(file, "\",%llu,%llu\n",
+                     static_cast<unsigned long long>(sample.begin_ns),
+                     static_cast<unsigned long long>(sample.end_ns - sample.begin_ns));
+    }
+
+    return std::fclose(file) == 0;
+}
+
+bool frame_profiler::write_chrome_trace(const char *path) const
+{
+    auto samples = std::vector<profile_sample>{};
+    snapshot(samples);
+
+    auto file = std::fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    // complete events, timestamps in microseconds
+    std::fprintf(file, "{\"traceEvents\":[");
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        const auto &sample = samples[i];
+
+        std::fprintf(file, "%s\n{\"name\":\"", i == 0 ? "" : ",");
+        write_json_escaped(file, sample.name);
+        std::fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                     static_cast<unsigned long long>(sample.thread),
+                     sample.begin_ns / 1000.0,
+                     (sample.end_ns - sample.begin_ns) / 1000.0,
+                     static_cast<unsigned long long>(sample.frame));
+    }
+    std::fprintf(file, "\n]}\n");
+
+    return std::fclose(file) == 0;
+}
+
+profile_scope::profile_scope(const char *name)
+    : m_name{name}, m_begin_ns{SDL_GetTicksNS()}, m_depth{zone_depth++}
+{
+}
+
+profile_scope::~profile_scope()
+{
+    --zone_depth;
+    get_profiler().record(m_name, m_begin_ns, SDL_GetTicksNS(), m_depth);
+}
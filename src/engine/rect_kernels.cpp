@@ -0,0 +1,390 @@
+#include "engine/rect_kernels.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENGINE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and clang only allow AVX intrinsics in functions compiled for AVX,
+// the rest of the engine keeps the default target
+#if defined(__GNUC__) || defined(__clang__)
+#define ENGINE_TARGET_AVX __attribute__((target("avx")))
+#else
+#define ENGINE_TARGET_AVX
+#endif
+
+void internal::affine_array::push_back(const glm::mat4x4 &m)
+{
+    // glm matrices are column-major: m[column][row]
+    a.push_back(m[0][0]);
+    b.push_back(m[0][1]);
+    c.push_back(m[1][0]);
+    d.push_back(m[1][1]);
+    tx.push_back(m[3][0]);
+    ty.push_back(m[3][1]);
+}
+
+void internal::affine_array::push_back(const affine2d &m)
+{
+    a.push_back(m.a);
+    b.push_back(m.b);
+    c.push_back(m.c);
+    d.push_back(m.d);
+    tx.push_back(m.tx);
+    ty.push_back(m.ty);
+}
+
+void internal::affine_array::clear()
+{
+    a.clear();
+    b.clear();
+    c.clear();
+    d.clear();
+    tx.clear();
+    ty.clear();
+}
+
+void internal::rect_array::push_back(const SDL_FRect &rect)
+{
+    x.push_back(rect.x);
+    y.push_back(rect.y);
+    w.push_back(rect.w);
+    h.push_back(rect.h);
+}
+
+void internal::rect_array::resize(std::size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    w.resize(count);
+    h.resize(count);
+}
+
+void internal::rect_array::clear()
+{
+    x.clear();
+    y.clear();
+    w.clear();
+    h.clear();
+}
+
+void internal::quad_array::resize(std::size_t count)
+{
+    for (int k = 0; k < 4; ++k)
+    {
+        x[k].resize(count);
+        y[k].resize(count);
+    }
+}
+
+namespace
+{
+    // raw pointers to the arrays, so that the kernels can start at any index
+    struct affine_ptrs
+    {
+        const float *a, *b, *c, *d, *tx, *ty;
+    };
+
+    struct rect_ptrs
+    {
+        const float *x, *y, *w, *h;
+    };
+
+    struct rect_out_ptrs
+    {
+        float *x, *y, *w, *h;
+    };
+
+    struct quad_out_ptrs
+    {
+        float *x[4], *y[4];
+    };
+
+    // The bounding box is computed from the transformed center and the
+    // extents projected on each axis, which is the same as the min/max of the
+    // four corners for an affine transform:
+    //   ex = |a| * w/2 + |c| * h/2
+    //   ey = |b| * w/2 + |d| * h/2
+
+    void transform_rects_scalar(affine_ptrs m, rect_ptrs r, rect_out_ptrs out, std::size_t begin, std::size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            auto hw = r.w[i] * 0.5f;
+            auto hh = r.h[i] * 0.5f;
+            auto cx = r.x[i] + hw;
+            auto cy = r.y[i] + hh;
+
+            auto wcx = m.a[i] * cx + m.c[i] * cy + m.tx[i];
+            auto wcy = m.b[i] * cx + m.d[i] * cy + m.ty[i];
+            auto ex = std::abs(m.a[i]) * hw + std::abs(m.c[i]) * hh;
+            auto ey = std::abs(m.b[i]) * hw + std::abs(m.d[i]) * hh;
+
+            out.x[i] = wcx - ex;
+            out.y[i] = wcy - ey;
+            out.w[i] = ex + ex;
+            out.h[i] = ey + ey;
+        }
+    }
+
+    void transform_quads_scalar(affine_ptrs m, rect_ptrs r, quad_out_ptrs out, std::size_t begin, std::size_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            auto x0 = m.a[i] * r.x[i] + m.c[i] * r.y[i] + m.tx[i];
+            auto y0 = m.b[i] * r.x[i] + m.d[i] * r.y[i] + m.ty[i];
+            // edges of the quad
+            auto ux = m.a[i] * r.w[i], uy = m.b[i] * r.w[i];
+            auto vx = m.c[i] * r.h[i], vy = m.d[i] * r.h[i];
+
+            out.x[0][i] = x0;
+            out.y[0][i] = y0;
+            out.x[1][i] = x0 + ux;
+            out.y[1][i] = y0 + uy;
+            out.x[2][i] = x0 + ux + vx;
+            out.y[2][i] = y0 + uy + vy;
+            out.x[3][i] = x0 + vx;
+            out.y[3][i] = y0 + vy;
+        }
+    }
+
+#ifdef ENGINE_SIMD_X86
+
+    std::size_t transform_rects_sse2(affine_ptrs m, rect_ptrs r, rect_out_ptrs out, std::size_t count)
+    {
+        const auto half = _mm_set1_ps(0.5f);
+        const auto sign = _mm_set1_ps(-0.0f);
+
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto hw = _mm_mul_ps(_mm_loadu_ps(r.w + i), half);
+            auto hh = _mm_mul_ps(_mm_loadu_ps(r.h + i), half);
+            auto cx = _mm_add_ps(_mm_loadu_ps(r.x + i), hw);
+            auto cy = _mm_add_ps(_mm_loadu_ps(r.y + i), hh);
+
+            auto a = _mm_loadu_ps(m.a + i);
+            auto b = _mm_loadu_ps(m.b + i);
+            auto c = _mm_loadu_ps(m.c + i);
+            auto d = _mm_loadu_ps(m.d + i);
+
+            auto wcx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(c, cy)), _mm_loadu_ps(m.tx + i));
+            auto wcy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, cx), _mm_mul_ps(d, cy)), _mm_loadu_ps(m.ty + i));
+            auto ex = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, a), hw), _mm_mul_ps(_mm_andnot_ps(sign, c), hh));
+            auto ey = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, b), hw), _mm_mul_ps(_mm_andnot_ps(sign, d), hh));
+
+            _mm_storeu_ps(out.x + i, _mm_sub_ps(wcx, ex));
+            _mm_storeu_ps(out.y + i, _mm_sub_ps(wcy, ey));
+            _mm_storeu_ps(out.w + i, _mm_add_ps(ex, ex));
+            _mm_storeu_ps(out.h + i, _mm_add_ps(ey, ey));
+        }
+        return i;
+    }
+
+    ENGINE_TARGET_AVX
+    std::size_t transform_rects_avx(affine_ptrs m, rect_ptrs r, rect_out_ptrs out, std::size_t count)
+    {
+        const auto half = _mm256_set1_ps(0.5f);
+        const auto sign = _mm256_set1_ps(-0.0f);
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto hw = _mm256_mul_ps(_mm256_loadu_ps(r.w + i), half);
+            auto hh = _mm256_mul_ps(_mm256_loadu_ps(r.h + i), half);
+            auto cx = _mm256_add_ps(_mm256_loadu_ps(r.x + i), hw);
+            auto cy = _mm256_add_ps(_mm256_loadu_ps(r.y + i), hh);
+
+            auto a = _mm256_loadu_ps(m.a + i);
+            auto b = _mm256_loadu_ps(m.b + i);
+            auto c = _mm256_loadu_ps(m.c + i);
+            auto d = _mm256_loadu_ps(m.d + i);
+
+            auto wcx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, cx), _mm256_mul_ps(c, cy)), _mm256_loadu_ps(m.tx + i));
+            auto wcy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b, cx), _mm256_mul_ps(d, cy)), _mm256_loadu_ps(m.ty + i));
+            auto ex = _mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, a), hw), _mm256_mul_ps(_mm256_andnot_ps(sign, c), hh));
+            auto ey = _mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, b), hw), _mm256_mul_ps(_mm256_andnot_ps(sign, d), hh));
+
+            _mm256_storeu_ps(out.x + i, _mm256_sub_ps(wcx, ex));
+            _mm256_storeu_ps(out.y + i, _mm256_sub_ps(wcy, ey));
+            _mm256_storeu_ps(out.w + i, _mm256_add_ps(ex, ex));
+            _mm256_storeu_ps(out.h + i, _mm256_add_ps(ey, ey));
+        }
+        return i;
+    }
+
+    std::size_t transform_quads_sse2(affine_ptrs m, rect_ptrs r, quad_out_ptrs out, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto x = _mm_loadu_ps(r.x + i);
+            auto y = _mm_loadu_ps(r.y + i);
+            auto w = _mm_loadu_ps(r.w + i);
+            auto h = _mm_loadu_ps(r.h + i);
+
+            auto a = _mm_loadu_ps(m.a + i);
+            auto b = _mm_loadu_ps(m.b + i);
+            auto c = _mm_loadu_ps(m.c + i);
+            auto d = _mm_loadu_ps(m.d + i);
+
+            auto x0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(c, y)), _mm_loadu_ps(m.tx + i));
+            auto y0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, x), _mm_mul_ps(d, y)), _mm_loadu_ps(m.ty + i));
+            auto ux = _mm_mul_ps(a, w), uy = _mm_mul_ps(b, w);
+            auto vx = _mm_mul_ps(c, h), vy = _mm_mul_ps(d, h);
+            auto x1 = _mm_add_ps(x0, ux), y1 = _mm_add_ps(y0, uy);
+
+            _mm_storeu_ps(out.x[0] + i, x0);
+            _mm_storeu_ps(out.y[0] + i, y0);
+            _mm_storeu_ps(out.x[1] + i, x1);
+            _mm_storeu_ps(out.y[1] + i, y1);
+            _mm_storeu_ps(out.x[2] + i, _mm_add_ps(x1, vx));
+            _mm_storeu_ps(out.y[2] + i, _mm_add_ps(y1, vy));
+            _mm_storeu_ps(out.x[3] + i, _mm_add_ps(x0, vx));
+            _mm_storeu_ps(out.y[3] + i, _mm_add_ps(y0, vy));
+        }
+        return i;
+    }
+
+    ENGINE_TARGET_AVX
+    std::size_t transform_quads_avx(affine_ptrs m, rect_ptrs r, quad_out_ptrs out, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto x = _mm256_loadu_ps(r.x + i);
+            auto y = _mm256_loadu_ps(r.y + i);
+            auto w = _mm256_loadu_ps(r.w + i);
+            auto h = _mm256_loadu_ps(r.h + i);
+
+            auto a = _mm256_loadu_ps(m.a + i);
+            auto b = _mm256_loadu_ps(m.b + i);
+            auto c = _mm256_loadu_ps(m.c + i);
+            auto d = _mm256_loadu_ps(m.d + i);
+
+            auto x0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, x), _mm256_mul_ps(c, y)), _mm256_loadu_ps(m.tx + i));
+            auto y0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b, x), _mm256_mul_ps(d, y)), _mm256_loadu_ps(m.ty + i));
+            auto ux = _mm256_mul_ps(a, w), uy = _mm256_mul_ps(b, w);
+            auto vx = _mm256_mul_ps(c, h), vy = _mm256_mul_ps(d, h);
+            auto x1 = _mm256_add_ps(x0, ux), y1 = _mm256_add_ps(y0, uy);
+
+            _mm256_storeu_ps(out.x[0] + i, x0);
+            _mm256_storeu_ps(out.y[0] + i, y0);
+            _mm256_storeu_ps(out.x[1] + i, x1);
+            _mm256_storeu_ps(out.y[1] + i, y1);
+            _mm256_storeu_ps(out.x[2] + i, _mm256_add_ps(x1, vx));
+            _mm256_storeu_ps(out.y[2] + i, _mm256_add_ps(y1, vy));
+            _mm256_storeu_ps(out.x[3] + i, _mm256_add_ps(x0, vx));
+            _mm256_storeu_ps(out.y[3] + i, _mm256_add_ps(y0, vy));
+        }
+        return i;
+    }
+
+#endif
+
+    affine_ptrs ptrs_of(const internal::affine_array &m)
+    {
+        return affine_ptrs{m.a.data(), m.b.data(), m.c.data(), m.d.data(), m.tx.data(), m.ty.data()};
+    }
+
+    rect_ptrs ptrs_of(const internal::rect_array &r)
+    {
+        return rect_ptrs{r.x.data(), r.y.data(), r.w.data(), r.h.data()};
+    }
+}
+
+internal::simd_level internal::detect_simd_level()
+{
+    static const auto level = []()
+    {
+#ifdef ENGINE_SIMD_X86
+        if (SDL_HasAVX())
+        {
+            return simd_level::avx;
+        }
+        // always available on x86-64
+        return simd_level::sse2;
+#else
+        return simd_level::scalar;
+#endif
+    }();
+
+    return level;
+}
+
+const char *internal::simd_level_name(simd_level level)
+{
+    switch (level)
+    {
+    case simd_level::sse2:
+        return "sse2";
+    case simd_level::avx:
+        return "avx";
+    default:
+        return "scalar";
+    }
+}
+
+void internal::transform_rects(
+    const affine_array &transforms,
+    const rect_array &rects,
+    rect_array &result,
+    simd_level level)
+{
+    auto count = rects.size();
+    result.resize(count);
+
+    auto m = ptrs_of(transforms);
+    auto r = ptrs_of(rects);
+    auto out = rect_out_ptrs{result.x.data(), result.y.data(), result.w.data(), result.h.data()};
+
+    std::size_t done = 0;
+#ifdef ENGINE_SIMD_X86
+    if (level == simd_level::avx)
+    {
+        done = transform_rects_avx(m, r, out, count);
+    }
+    else if (level == simd_level::sse2)
+    {
+        done = transform_rects_sse2(m, r, out, count);
+    }
+#endif
+
+    // remainder, or everything without SIMD
+    transform_rects_scalar(m, r, out, done, count);
+}
+
+void internal::transform_quads(
+    const affine_array &transforms,
+    const rect_array &rects,
+    quad_array &result,
+    simd_level level)
+{
+    auto count = rects.size();
+    result.resize(count);
+
+    auto m = ptrs_of(transforms);
+    auto r = ptrs_of(rects);
+    auto out = quad_out_ptrs{};
+    for (int k = 0; k < 4; ++k)
+    {
+        out.x[k] = result.x[k].data();
+        out.y[k] = result.y[k].data();
+    }
+
+    std::size_t done = 0;
+#ifdef ENGINE_SIMD_X86
+    if (level == simd_level::avx)
+    {
+        done = transform_quads_avx(m, r, out, count);
+    }
+    else if (level == simd_level::sse2)
+    {
+        done = transform_quads_sse2(m, r, out, count);
+    }
+#endif
+
+    transform_quads_scalar(m, r, out, done, count);
+}
@@ -0,0 +1,105 @@
+#include "engine/skyline_packer.hpp"
+
+#include <algorithm>
+
+void internal::skyline_packer::reset(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    m_used = 0;
+    m_skyline.clear();
+    m_skyline.push_back(segment{.x = 0, .y = 0, .w = width});
+}
+
+int internal::skyline_packer::fit(std::size_t index, int w, int h) const
+{
+    if (m_skyline[index].x + w > m_width)
+    {
+        return -1;
+    }
+
+    // highest segment under the rectangle
+    auto y = 0;
+    auto remaining = w;
+    for (auto i = index; remaining > 0; ++i)
+    {
+        y = std::max(y, m_skyline[i].y);
+        if (y + h > m_height)
+        {
+            return -1;
+        }
+        remaining -= m_skyline[i].w;
+    }
+    return y;
+}
+
+bool internal::skyline_packer::pack(int w, int h, SDL_Point &position)
+{
+    if (w <= 0 || h <= 0)
+    {
+        return false;
+    }
+
+    // the lowest bottom edge, then the narrowest segment to waste less
+    auto best = m_skyline.size();
+    auto best_bottom = m_height + 1;
+    auto best_w = m_width + 1;
+    for (std::size_t i = 0; i < m_skyline.size(); ++i)
+    {
+        auto y = fit(i, w, h);
+        if (y >= 0 && (y + h < best_bottom || (y + h == best_bottom && m_skyline[i].w < best_w)))
+        {
+            best = i;
+            best_bottom = y + h;
+            best_w = m_skyline[i].w;
+        }
+    }
+    if (best == m_skyline.size())
+    {
+        return false;
+    }
+
+    position = SDL_Point{m_skyline[best].x, best_bottom - h};
+    m_skyline.insert(m_skyline.begin() + std::ptrdiff_t(best), segment{.x = position.x, .y = best_bottom, .w = w});
+
+    // the segments under the rectangle shrink or disappear
+    auto right = position.x + w;
+    for (auto i = best + 1; i < m_skyline.size();)
+    {
+        auto &s = m_skyline[i];
+        if (s.x >= right)
+        {
+            break;
+        }
+        auto end = s.x + s.w;
+        if (end <= right)
+        {
+            m_skyline.erase(m_skyline.begin() + std::ptrdiff_t(i));
+            continue;
+        }
+        s.w = end - right;
+        s.x = right;
+        break;
+    }
+
+    // neighbours at the same height become one segment
+    for (std::size_t i = 0; i + 1 < m_skyline.size();)
+    {
+        if (m_skyline[i].y == m_skyline[i + 1].y)
+        {
+            m_skyline[i].w += m_skyline[i + 1].w;
+            m_skyline.erase(m_skyline.begin() + std::ptrdiff_t(i + 1));
+            continue;
+        }
+        ++i;
+    }
+
+    m_used += Uint64(w) * Uint64(h);
+    return true;
+}
+
+float internal::skyline_packer::occupancy() const
+{
+    auto area = Uint64(m_width) * Uint64(m_height);
+    return area > 0 ? float(double(m_used) / double(area)) : 0.0f;
+}
@@ -0,0 +1,205 @@
+#include "engine/spatial_grid.hpp"
+#include "engine/camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+internal::spatial_grid::cell_range internal::spatial_grid::cells_of(const SDL_FRect &rect) const
+{
+    return cell_range{
+        .min_x = static_cast<Sint32>(std::floor(rect.x / m_cell_size)),
+        .min_y = static_cast<Sint32>(std::floor(rect.y / m_cell_size)),
+        .max_x = static_cast<Sint32>(std::floor((rect.x + rect.w) / m_cell_size)),
+        .max_y = static_cast<Sint32>(std::floor((rect.y + rect.h) / m_cell_size)),
+    };
+}
+
+Uint64 internal::spatial_grid::cell_key(Sint32 x, Sint32 y)
+{
+    return (static_cast<Uint64>(static_cast<Uint32>(x)) << 32) | static_cast<Uint32>(y);
+}
+
+void internal::spatial_grid::insert_cells(entt::entity entity, const record &r)
+{
+    if (r.oversized)
+    {
+        m_oversized.push_back(entity);
+        return;
+    }
+
+    for (auto y = r.range.min_y; y <= r.range.max_y; ++y)
+    {
+        for (auto x = r.range.min_x; x <= r.range.max_x; ++x)
+        {
+            auto key = cell_key(x, y);
+            auto it = m_cells.find(key);
+            if (it == m_cells.end() && !m_spare_cells.empty())
+            {
+                auto cell = std::move(m_spare_cells.back());
+                m_spare_cells.pop_back();
+                cell.key() = key;
+                it = m_cells.insert(std::move(cell)).position;
+            }
+            else if (it == m_cells.end())
+            {
+                it = m_cells.emplace(key, std::vector<entt::entity>{}).first;
+            }
+            it->second.push_back(entity);
+        }
+    }
+}
+
+void internal::spatial_grid::erase_cells(entt::entity entity, const record &r)
+{
+    // swap and pop, the order inside a cell does not matter
+    auto erase = [entity](std::vector<entt::entity> &entities)
+    {
+        auto it = std::find(entities.begin(), entities.end(), entity);
+        if (it != entities.end())
+        {
+            *it = entities.back();
+            entities.pop_back();
+        }
+    };
+
+    if (r.oversized)
+    {
+        erase(m_oversized);
+        return;
+    }
+
+    for (auto y = r.range.min_y; y <= r.range.max_y; ++y)
+    {
+        for (auto x = r.range.min_x; x <= r.range.max_x; ++x)
+        {
+            auto it = m_cells.find(cell_key(x, y));
+            if (it != m_cells.end())
+            {
+                erase(it->second);
+                if (it->second.empty())
+                {
+                    m_spare_cells.push_back(m_cells.extract(it));
+                }
+            }
+        }
+    }
+}
+
+void internal::spatial_grid::update(entt::entity entity, const SDL_FRect &rect)
+{
+    if (rect.w <= 0.0f || rect.h <= 0.0f)
+    {
+        remove(entity);
+        return;
+    }
+
+    auto range = cells_of(rect);
+    auto count = (Sint64(range.max_x) - range.min_x + 1) * (Sint64(range.max_y) - range.min_y + 1);
+    auto oversized = count > max_cells;
+
+    if (m_records.contains(entity))
+    {
+        auto &r = m_records.get(entity);
+
+        if (r.oversized == oversized &&
+            r.range.min_x == range.min_x && r.range.min_y == range.min_y &&
+            r.range.max_x == range.max_x && r.range.max_y == range.max_y)
+        {
+            // moved within the same cells
+            return;
+        }
+
+        erase_cells(entity, r);
+        r.range = range;
+        r.oversized = oversized;
+        insert_cells(entity, r);
+    }
+    else
+    {
+        auto &r = m_records.emplace(entity, record{range, oversized, m_stamp});
+        insert_cells(entity, r);
+    }
+}
+
+void internal::spatial_grid::remove(entt::entity entity)
+{
+    if (m_records.contains(entity))
+    {
+        erase_cells(entity, m_records.get(entity));
+        m_records.erase(entity);
+    }
+}
+
+void internal::spatial_grid::query(const SDL_FRect &rect, std::pmr::vector<entt::entity> &result)
+{
+    if (++m_stamp == 0)
+    {
+        // the stamps wrapped around, forget the old ones
+        for (auto &r : m_records)
+        {
+            r.stamp = 0;
+        }
+        m_stamp = 1;
+    }
+
+    result.insert(result.end(), m_oversized.begin(), m_oversized.end());
+
+    auto append = [this, &result](const std::vector<entt::entity> &entities)
+    {
+        for (auto entity : entities)
+        {
+            auto &r = m_records.get(entity);
+
+            // entities spanning several cells are only returned once
+            if (r.stamp != m_stamp)
+            {
+                r.stamp = m_stamp;
+                result.push_back(entity);
+            }
+        }
+    };
+
+    auto range = cells_of(rect);
+    auto count = (Sint64(range.max_x) - range.min_x + 1) * (Sint64(range.max_y) - range.min_y + 1);
+
+    if (count > Sint64(m_cells.size()))
+    {
+        // a zoomed out view spans more cells than there are populated ones
+        for (const auto &[key, entities] : m_cells)
+        {
+            auto x = static_cast<Sint32>(static_cast<Uint32>(key >> 32));
+            auto y = static_cast<Sint32>(static_cast<Uint32>(key));
+
+            if (x >= range.min_x && x <= range.max_x && y >= range.min_y && y <= range.max_y)
+            {
+                append(entities);
+            }
+        }
+        return;
+    }
+
+    for (auto y = range.min_y; y <= range.max_y; ++y)
+    {
+        for (auto x = range.min_x; x <= range.max_x; ++x)
+        {
+            auto it = m_cells.find(cell_key(x, y));
+            if (it != m_cells.end())
+            {
+                append(it->second);
+            }
+        }
+    }
+}
+
+void internal::remove_from_spatial_grid(entt::registry &registry, entt::entity entity)
+{
+    registry.ctx().get<internal::spatial_grid>().remove(entity);
+}
+
+void internal::spatial_grid_setup_system(entt::registry &registry, float cell_size)
+{
+    registry.ctx().emplace<internal::spatial_grid>(cell_size);
+
+    registry.on_destroy<internal::bounding_box>().connect<&remove_from_spatial_grid>();
+    registry.on_destroy<drawable>().connect<&remove_from_spatial_grid>();
+}
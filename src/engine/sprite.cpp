@@ -0,0 +1,152 @@
+#include "engine/sprite.hpp"
+#include "engine/camera.hpp"
+
+void internal::sync_sprite_drawable(entt::registry &registry, entt::entity entity)
+{
+    auto &c_sprite = registry.get<sprite>(entity);
+    auto &materials = registry.ctx().get<internal::sprite_materials>();
+
+    // ids start at 1, 0 is the default material of the other drawables.
+    // Ids are never recycled: past the last one the new textures share the
+    // default material, their sprites are only batched less
+    auto material = Uint16{0};
+    if (auto found = materials.ids.find(c_sprite.texture); found != materials.ids.end())
+    {
+        material = found->second;
+    }
+    else if (materials.ids.size() < SDL_MAX_UINT16)
+    {
+        material = static_cast<Uint16>(materials.ids.size() + 1);
+        materials.ids.emplace(c_sprite.texture, material);
+    }
+    else
+    {
+        SDL_assert(materials.ids.size() < SDL_MAX_UINT16);
+    }
+
+    // the drawable has no callback, the render system draws the sprite
+    registry.emplace_or_replace<drawable>(entity, drawable{
+                                                      .depth = c_sprite.depth,
+                                                      .bounding_box = c_sprite.rect,
+                                                      .material = material,
+                                                  });
+}
+
+void internal::remove_sprite_drawable(entt::registry &registry, entt::entity entity)
+{
+    registry.remove<drawable>(entity);
+}
+
+void internal::sprite_setup_system(entt::registry &registry)
+{
+    registry.ctx().emplace<render_stats>();
+    registry.ctx().emplace<internal::sprite_batch>();
+    registry.ctx().emplace<internal::sprite_materials>();
+
+    registry.on_construct<sprite>().connect<&sync_sprite_drawable>();
+    registry.on_update<sprite>().connect<&sync_sprite_drawable>();
+    registry.on_destroy<sprite>().connect<&remove_sprite_drawable>();
+}
+
+void internal::flush_sprites(sprite_batch &batch, render_stats &stats, SDL_Renderer *renderer)
+{
+    auto count = batch.rects.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    internal::transform_quads(batch.transforms, batch.rects, batch.corners);
+
+    batch.vertices.clear();
+    batch.indices.clear();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto &uv = batch.tex_coords[i];
+        const SDL_FPoint tex_coords[4] = {
+            {uv.x, uv.y}, // top-left
+            {uv.w, uv.y}, // top-right
+            {uv.w, uv.h}, // bottom-right
+            {uv.x, uv.h}, // bottom-left
+        };
+
+        auto first = static_cast<int>(batch.vertices.size());
+        for (int k = 0; k < 4; ++k)
+        {
+            batch.vertices.push_back(SDL_Vertex{
+                .position = SDL_FPoint{batch.corners.x[k][i], batch.corners.y[k][i]},
+                .color = batch.tints[i],
+                .tex_coord = tex_coords[k],
+            });
+        }
+
+        // two triangles per quad
+        for (int index : {0, 1, 2, 0, 2, 3})
+        {
+            batch.indices.push_back(first + index);
+        }
+    }
+
+    SDL_RenderGeometry(
+        renderer,
+        batch.texture,
+        batch.vertices.data(),
+        static_cast<int>(batch.vertices.size()),
+        batch.indices.data(),
+        static_cast<int>(batch.indices.size()));
+    ++stats.draw_calls;
+
+    batch.transforms.clear();
+    batch.rects.clear();
+    batch.tex_coords.clear();
+    batch.tints.clear();
+
+    // the texture may be destroyed and another one created at its address
+    // before the next sprite, its size is read again
+    batch.texture = nullptr;
+    batch.texture_w = 1.0f;
+    batch.texture_h = 1.0f;
+}
+
+void internal::push_sprite(
+    sprite_batch &batch,
+    render_stats &stats,
+    SDL_Renderer *renderer,
+    const sprite &c_sprite,
+    const world_transform &transform)
+{
+    if (c_sprite.texture != batch.texture)
+    {
+        flush_sprites(batch, stats, renderer);
+
+        batch.texture = c_sprite.texture;
+        batch.texture_w = 1.0f;
+        batch.texture_h = 1.0f;
+        if (batch.texture != nullptr)
+        {
+            SDL_GetTextureSize(batch.texture, &batch.texture_w, &batch.texture_h);
+        }
+    }
+
+    // texture coordinates of the region
+    auto uv = SDL_FRect{0.0f, 0.0f, 1.0f, 1.0f};
+    const auto &region = c_sprite.region;
+
+    if (region.w > 0.0f && region.h > 0.0f)
+    {
+        uv = SDL_FRect{
+            region.x / batch.texture_w,
+            region.y / batch.texture_h,
+            (region.x + region.w) / batch.texture_w,
+            (region.y + region.h) / batch.texture_h,
+        };
+    }
+
+    batch.transforms.push_back(transform);
+    batch.rects.push_back(c_sprite.rect);
+    batch.tex_coords.push_back(uv);
+    batch.tints.push_back(c_sprite.tint);
+
+    ++stats.sprites;
+}
@@ -0,0 +1,99 @@
+#include "engine/system_scheduler.hpp"
+
+#include <algorithm>
+#include "engine/allocation_stats.hpp"
+
+namespace
+{
+    bool intersects(const std::vector<entt::id_type> &lhs, const std::vector<entt::id_type> &rhs)
+    {
+        // a handful of types per system
+        return std::any_of(lhs.begin(), lhs.end(), [&rhs](auto id)
+                           { return std::find(rhs.begin(), rhs.end(), id) != rhs.end(); });
+    }
+}
+
+bool system_access::conflicts(const system_access &other) const
+{
+    return structural || other.structural ||
+           intersects(writes, other.writes) || intersects(writes, other.reads) || intersects(reads, other.writes);
+}
+
+void system_scheduler::add(const char *name, const system_access &access, system update)
+{
+    auto added = std::make_unique<node>();
+    added->name = name;
+    added->access = access;
+    added->update = std::move(update);
+    added->owner = this;
+
+    // after every earlier system it conflicts with
+    for (std::size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        if (m_nodes[i]->access.conflicts(access))
+        {
+            m_nodes[i]->dependents.push_back(m_nodes.size());
+            ++added->dependencies;
+        }
+    }
+    m_nodes.push_back(std::move(added));
+}
+
+void system_scheduler::run_node(void *context, std::size_t, std::size_t)
+{
+    auto *current = static_cast<node *>(context);
+    auto *owner = current->owner;
+
+    auto running = owner->m_running.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto peak = owner->m_peak.load(std::memory_order_relaxed);
+    while (running > peak && !owner->m_peak.compare_exchange_weak(peak, running, std::memory_order_relaxed))
+    {
+    }
+
+    {
+        ALLOCATION_ZONE(current->name);
+        current->update(*owner->m_registry);
+    }
+    owner->m_running.fetch_sub(1, std::memory_order_relaxed);
+
+    // the last dependency to finish starts a dependent, from this thread
+    for (auto index : current->dependents)
+    {
+        auto &dependent = *owner->m_nodes[index];
+        if (dependent.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            owner->m_jobs->submit(dependent.task);
+        }
+    }
+}
+
+void system_scheduler::run(entt::registry &registry, job_system &jobs)
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    m_registry = &registry;
+    m_jobs = &jobs;
+    m_peak.store(0, std::memory_order_relaxed);
+    m_pending.store(int(m_nodes.size()), std::memory_order_relaxed);
+    for (auto &current : m_nodes)
+    {
+        current->remaining.store(current->dependencies, std::memory_order_relaxed);
+        current->task = job{&run_node, current.get(), 0, 0, &m_pending};
+    }
+
+    for (auto &current : m_nodes)
+    {
+        if (current->dependencies == 0)
+        {
+            jobs.submit(current->task);
+        }
+    }
+    jobs.wait(m_pending);
+
+    m_width = m_peak.load(std::memory_order_relaxed);
+    m_registry = nullptr;
+    m_jobs = nullptr;
+}
@@ -0,0 +1,331 @@
+#include "game/chess/attacks.hpp"
+
+#include <mutex>
+#include <vector>
+
+#if CHESS_HAS_PEXT && defined(_MSC_VER)
+#include <intrin.h>
+#elif CHESS_HAS_PEXT
+#include <cpuid.h>
+#endif
+
+namespace chess::internal
+{
+    std::array<slider_table, 64> rook_tables;
+    std::array<slider_table, 64> bishop_tables;
+    std::array<std::array<bitboard, 64>, 2> pawn_table;
+    std::array<bitboard, 64> knight_table;
+    std::array<bitboard, 64> king_table;
+    std::array<std::array<bitboard, 64>, 64> between_table;
+    std::array<std::array<bitboard, 64>, 64> line_table;
+    bool use_pext = false;
+}
+
+namespace
+{
+    using namespace chess;
+
+    // entries of the attack tables over every square
+    constexpr std::size_t rook_entries = 102'400;
+    constexpr std::size_t bishop_entries = 5'248;
+
+    std::vector<bitboard> rook_magic_attacks(rook_entries);
+    std::vector<bitboard> rook_pext_attacks(rook_entries);
+    std::vector<bitboard> bishop_magic_attacks(bishop_entries);
+    std::vector<bitboard> bishop_pext_attacks(bishop_entries);
+
+    bool pext_supported = false;
+
+    constexpr int rook_directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    constexpr int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+    bool on_board(int file, int rank)
+    {
+        return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+    }
+
+    // attacks of a slider walking the rays until a blocker, slow, used to
+    // fill the tables
+    bitboard ray_attacks(square s, bitboard occupied, const int (&directions)[4][2])
+    {
+        auto attacks = bitboard{0};
+
+        for (const auto &d : directions)
+        {
+            auto file = file_of(s) + d[0];
+            auto rank = rank_of(s) + d[1];
+
+            while (on_board(file, rank))
+            {
+                auto to = make_square(file, rank);
+                attacks |= square_bb(to);
+
+                if (occupied & square_bb(to))
+                {
+                    break;
+                }
+                file += d[0];
+                rank += d[1];
+            }
+        }
+
+        return attacks;
+    }
+
+    // step attacks (knight, king) from a list of offsets
+    bitboard step_attacks(square s, const int (*offsets)[2], int count)
+    {
+        auto attacks = bitboard{0};
+
+        for (int i = 0; i < count; ++i)
+        {
+            auto file = file_of(s) + offsets[i][0];
+            auto rank = rank_of(s) + offsets[i][1];
+
+            if (on_board(file, rank))
+            {
+                attacks |= square_bb(make_square(file, rank));
+            }
+        }
+
+        return attacks;
+    }
+
+    // sparse random numbers make good magic candidates
+    struct xorshift
+    {
+        std::uint64_t state;
+
+        std::uint64_t next()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 2685821657736338717ull;
+        }
+
+        std::uint64_t sparse()
+        {
+            return next() & next() & next();
+        }
+    };
+
+    // software PEXT, the tables are built the same way on every CPU
+    bitboard pext_fallback(bitboard source, bitboard mask)
+    {
+        auto result = bitboard{0};
+
+        for (auto bit = bitboard{1}; mask != 0; bit <<= 1)
+        {
+            if (source & mask & (0 - mask))
+            {
+                result |= bit;
+            }
+            mask &= mask - 1;
+        }
+
+        return result;
+    }
+
+    void init_sliders(
+        std::array<internal::slider_table, 64> &tables,
+        std::vector<bitboard> &magic_attacks,
+        std::vector<bitboard> &pext_attacks,
+        const int (&directions)[4][2])
+    {
+        // the blockers and their attacks of a square, reused
+        auto occupancies = std::vector<bitboard>(4096);
+        auto references = std::vector<bitboard>(4096);
+        // attempt at which an entry was last written, to avoid clearing
+        // the table between attempts
+        auto epochs = std::vector<int>(4096, 0);
+
+        auto rng = xorshift{0x9e3779b97f4a7c15ull};
+        std::size_t offset = 0;
+
+        for (square s = 0; s < 64; ++s)
+        {
+            auto &table = tables[s];
+
+            // edges do not matter, a slider always attacks them
+            auto edges = ((rank_1_bb | rank_8_bb) & ~rank_bb(rank_of(s))) |
+                         ((file_a_bb | file_h_bb) & ~file_bb(file_of(s)));
+            table.mask = ray_attacks(s, 0, directions) & ~edges;
+
+            auto bits = popcount(table.mask);
+            auto size = std::size_t{1} << bits;
+            table.shift = 64 - bits;
+            table.magic_attacks = magic_attacks.data() + offset;
+            table.pext_attacks = pext_attacks.data() + offset;
+
+            // every subset of the mask, carry-rippler enumeration
+            auto subset = bitboard{0};
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                occupancies[i] = subset;
+                references[i] = ray_attacks(s, subset, directions);
+                pext_attacks[offset + pext_fallback(subset, table.mask)] = references[i];
+                subset = (subset - table.mask) & table.mask;
+            }
+
+            for (int attempt = 1;; ++attempt)
+            {
+                do
+                {
+                    table.magic = rng.sparse();
+                } while (popcount((table.magic * table.mask) >> 56) < 6);
+
+                auto valid = true;
+                for (std::size_t i = 0; i < size && valid; ++i)
+                {
+                    auto index = ((occupancies[i] & table.mask) * table.magic) >> table.shift;
+                    auto &entry = magic_attacks[offset + index];
+
+                    if (epochs[index] < attempt)
+                    {
+                        epochs[index] = attempt;
+                        entry = references[i];
+                    }
+                    else if (entry != references[i])
+                    {
+                        valid = false;
+                    }
+                }
+
+                if (valid)
+                {
+                    break;
+                }
+            }
+
+            std::fill(epochs.begin(), epochs.end(), 0);
+            offset += size;
+        }
+    }
+
+    bool cpu_has_fast_pext()
+    {
+#if CHESS_HAS_PEXT
+        unsigned int regs[4] = {};
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, 7, 0);
+        auto bmi2 = (info[1] & (1 << 8)) != 0;
+        __cpuid(info, 0);
+        auto amd = info[1] == 0x68747541; // "Auth"enticAMD
+        __cpuid(info, 1);
+        regs[0] = static_cast<unsigned int>(info[0]);
+#else
+        if (!__get_cpuid_count(7, 0, &regs[0], &regs[1], &regs[2], &regs[3]))
+        {
+            return false;
+        }
+        auto bmi2 = (regs[1] & (1u << 8)) != 0;
+        __get_cpuid(0, &regs[0], &regs[1], &regs[2], &regs[3]);
+        auto amd = regs[1] == 0x68747541; // "Auth"enticAMD
+        __get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+        if (!bmi2)
+        {
+            return false;
+        }
+
+        // Zen 1 and 2 execute PEXT in microcode, slower than the magics
+        auto family = (regs[0] >> 8) & 0xf;
+        if (family == 0xf)
+        {
+            family += (regs[0] >> 20) & 0xff;
+        }
+        return !amd || family >= 0x19;
+#else
+        return false;
+#endif
+    }
+
+    bool cpu_has_pext()
+    {
+#if CHESS_HAS_PEXT && defined(_MSC_VER)
+        int info[4];
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 8)) != 0;
+#elif CHESS_HAS_PEXT
+        unsigned int regs[4] = {};
+        return __get_cpuid_count(7, 0, &regs[0], &regs[1], &regs[2], &regs[3]) &&
+               (regs[1] & (1u << 8)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    void build_tables()
+    {
+        constexpr int knight_offsets[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+        constexpr int king_offsets[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+        constexpr int white_pawn_offsets[2][2] = {{-1, 1}, {1, 1}};
+        constexpr int black_pawn_offsets[2][2] = {{-1, -1}, {1, -1}};
+
+        for (square s = 0; s < 64; ++s)
+        {
+            internal::knight_table[s] = step_attacks(s, knight_offsets, 8);
+            internal::king_table[s] = step_attacks(s, king_offsets, 8);
+            internal::pawn_table[white][s] = step_attacks(s, white_pawn_offsets, 2);
+            internal::pawn_table[black][s] = step_attacks(s, black_pawn_offsets, 2);
+        }
+
+        init_sliders(internal::rook_tables, rook_magic_attacks, rook_pext_attacks, rook_directions);
+        init_sliders(internal::bishop_tables, bishop_magic_attacks, bishop_pext_attacks, bishop_directions);
+
+        for (square from = 0; from < 64; ++from)
+        {
+            for (square to = 0; to < 64; ++to)
+            {
+                internal::between_table[from][to] = 0;
+                internal::line_table[from][to] = 0;
+
+                for (const auto *directions : {&rook_directions, &bishop_directions})
+                {
+                    if (ray_attacks(from, 0, *directions) & square_bb(to))
+                    {
+                        internal::between_table[from][to] =
+                            ray_attacks(from, square_bb(to), *directions) &
+                            ray_attacks(to, square_bb(from), *directions);
+                        internal::line_table[from][to] =
+                            (ray_attacks(from, 0, *directions) & ray_attacks(to, 0, *directions)) |
+                            square_bb(from) | square_bb(to);
+                    }
+                }
+            }
+        }
+
+        pext_supported = cpu_has_pext();
+        internal::use_pext = cpu_has_fast_pext();
+    }
+}
+
+void chess::init_attacks()
+{
+    static std::once_flag once;
+    std::call_once(once, build_tables);
+}
+
+chess::slider_backend chess::active_slider_backend()
+{
+    return internal::use_pext ? slider_backend::pext : slider_backend::magic;
+}
+
+const char *chess::slider_backend_name(slider_backend backend)
+{
+    return backend == slider_backend::pext ? "pext" : "magic";
+}
+
+bool chess::set_slider_backend(slider_backend backend)
+{
+    init_attacks();
+
+    if (backend == slider_backend::pext && !pext_supported)
+    {
+        return false;
+    }
+    internal::use_pext = backend == slider_backend::pext;
+    return true;
+}
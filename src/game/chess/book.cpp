@@ -0,0 +1,340 @@
+#include "game/chess/book.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace chess;
+
+    constexpr std::size_t record_size = 16;
+    // merged in place when a thread collected that many records
+    constexpr std::size_t compact_threshold = 1 << 22;
+
+    std::uint64_t read_big_endian(const std::byte *data, int bytes)
+    {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value = (value << 8) | std::to_integer<std::uint64_t>(data[i]);
+        }
+        return value;
+    }
+
+    void write_big_endian(std::uint8_t *out, std::uint64_t value, int bytes)
+    {
+        for (int i = bytes - 1; i >= 0; --i)
+        {
+            out[i] = static_cast<std::uint8_t>(value);
+            value >>= 8;
+        }
+    }
+
+    // Polyglot move: destination, origin and promoted piece (knight 1 to
+    // queen 4). Castling is written as the king taking its rook
+    std::uint16_t encode_move(move m)
+    {
+        auto to = m.to();
+        if (m.is_castling())
+        {
+            to = make_square(m.flags() == king_castle ? 7 : 0, rank_of(to));
+        }
+        auto promoted = m.is_promotion() ? m.promotion_type() - knight + 1 : 0;
+        return static_cast<std::uint16_t>(to | (m.from() << 6) | (promoted << 12));
+    }
+
+    // counts of a move in a position while building
+    struct book_record
+    {
+        std::uint64_t key;
+        std::uint16_t move;
+        std::uint32_t games;
+        std::uint32_t points;
+
+        bool same_move(const book_record &other) const
+        {
+            return key == other.key && move == other.move;
+        }
+    };
+
+    // sorted by key and move, duplicates summed
+    void compact(std::vector<book_record> &records)
+    {
+        std::sort(records.begin(), records.end(), [](const book_record &a, const book_record &b)
+                  { return a.key != b.key ? a.key < b.key : a.move < b.move; });
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < records.size(); ++i)
+        {
+            if (kept > 0 && records[kept - 1].same_move(records[i]))
+            {
+                records[kept - 1].games += records[i].games;
+                records[kept - 1].points += records[i].points;
+            }
+            else
+            {
+                records[kept++] = records[i];
+            }
+        }
+        records.resize(kept);
+    }
+
+    void collect(std::string_view text, const book_build_options &options, std::vector<book_record> &records,
+                 std::uint64_t &games, std::uint64_t &skipped)
+    {
+        auto reader = pgn_reader{text};
+        auto game = pgn_game{};
+        auto pos = std::make_unique<position>();
+
+        while (reader.next(game))
+        {
+            // points of the side to move for a win and for a draw
+            auto result = game.tag("Result");
+            std::uint32_t points[2] = {0, 0};
+            if (result == "1-0")
+            {
+                points[white] = 2;
+            }
+            else if (result == "0-1")
+            {
+                points[black] = 2;
+            }
+            else if (result == "1/2-1/2")
+            {
+                points[white] = points[black] = 1;
+            }
+
+            // only the first plies are read, most of the game is skipped
+            ++games;
+            auto fen = game.tag("FEN");
+            if (!pos->set_fen(fen.empty() ? position::start_fen : fen))
+            {
+                ++skipped;
+                continue;
+            }
+
+            auto tokens = san_tokenizer{game.movetext};
+            auto san = std::string_view{};
+            for (int ply = 0; ply < options.max_ply && tokens.next(san); ++ply)
+            {
+                auto m = parse_san(*pos, san);
+                if (m == no_move)
+                {
+                    // the moves before the illegal one still count
+                    ++skipped;
+                    break;
+                }
+                records.push_back(book_record{
+                    .key = pos->key(),
+                    .move = encode_move(m),
+                    .games = 1,
+                    .points = points[pos->side_to_move()],
+                });
+                pos->make_move(m);
+            }
+
+            if (records.size() >= compact_threshold)
+            {
+                auto before = records.size();
+                compact(records);
+                // mostly different positions, compacting again soon is a waste
+                if (records.size() > before / 2)
+                {
+                    records.reserve(records.size() * 2);
+                }
+            }
+        }
+        compact(records);
+    }
+}
+
+bool opening_book::open(const std::string &path)
+{
+    close();
+    if (!m_file.open(path) || m_file.size() == 0 || m_file.size() % record_size != 0)
+    {
+        close();
+        return false;
+    }
+    m_entries = m_file.size() / record_size;
+    return true;
+}
+
+void opening_book::close()
+{
+    m_file.close();
+    m_entries = 0;
+}
+
+void opening_book::probe(const position &pos, book_moves &moves) const
+{
+    moves.count = 0;
+    moves.total_weight = 0;
+    if (m_entries == 0)
+    {
+        return;
+    }
+
+    auto key = pos.key();
+    const auto *data = m_file.data();
+
+    // first record of the key
+    std::size_t low = 0;
+    std::size_t high = m_entries;
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        if (read_big_endian(data + middle * record_size, 8) < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if (low == m_entries || read_big_endian(data + low * record_size, 8) != key)
+    {
+        return;
+    }
+
+    move_list legal;
+    generate_legal(pos, legal);
+
+    for (auto i = low; i < m_entries && moves.count < max_book_moves; ++i)
+    {
+        const auto *record = data + i * record_size;
+        if (read_big_endian(record, 8) != key)
+        {
+            break;
+        }
+        auto encoded = static_cast<std::uint16_t>(read_big_endian(record + 8, 2));
+        auto found = std::find_if(legal.begin(), legal.end(), [encoded](move m)
+                                  { return encode_move(m) == encoded; });
+        if (found == legal.end())
+        {
+            continue;
+        }
+
+        auto entry = book_move{
+            .m = *found,
+            .weight = static_cast<std::uint16_t>(read_big_endian(record + 10, 2)),
+            .games = static_cast<std::uint32_t>(read_big_endian(record + 12, 4)),
+        };
+        // insertion by weight, a position has few moves
+        auto at = moves.count++;
+        for (; at > 0 && moves.moves[at - 1].weight < entry.weight; --at)
+        {
+            moves.moves[at] = moves.moves[at - 1];
+        }
+        moves.moves[at] = entry;
+        moves.total_weight += entry.weight;
+    }
+}
+
+move opening_book::pick(const position &pos, std::uint64_t random) const
+{
+    book_moves moves;
+    probe(pos, moves);
+    if (moves.total_weight == 0)
+    {
+        return no_move;
+    }
+
+    auto target = random % moves.total_weight;
+    for (const auto &entry : moves)
+    {
+        if (target < entry.weight)
+        {
+            return entry.m;
+        }
+        target -= entry.weight;
+    }
+    return moves[0].m;
+}
+
+bool chess::build_opening_book(std::string_view pgn, const std::string &path, const book_build_options &options,
+                               book_build_stats &stats)
+{
+    auto pieces = split_games(pgn, std::size_t(std::max(options.threads, 1)));
+    auto parts = std::vector<std::vector<book_record>>(pieces.size());
+    auto games = std::vector<std::uint64_t>(pieces.size(), 0);
+    auto skipped = std::vector<std::uint64_t>(pieces.size(), 0);
+
+    auto workers = std::vector<std::thread>{};
+    for (std::size_t i = 0; i < pieces.size(); ++i)
+    {
+        workers.emplace_back([&, i]()
+                             { collect(pieces[i], options, parts[i], games[i], skipped[i]); });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    stats = book_build_stats{};
+    auto records = std::vector<book_record>{};
+    for (std::size_t i = 0; i < parts.size(); ++i)
+    {
+        stats.games += games[i];
+        stats.skipped += skipped[i];
+        records.insert(records.end(), parts[i].begin(), parts[i].end());
+        parts[i] = {};
+    }
+    compact(records);
+
+    auto *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    auto ok = true;
+    auto buffer = std::vector<std::uint8_t>{};
+    for (std::size_t begin = 0; begin < records.size();)
+    {
+        auto end = begin;
+        std::uint32_t max_points = 0;
+        for (; end < records.size() && records[end].key == records[begin].key; ++end)
+        {
+            if (records[end].games >= options.min_games)
+            {
+                max_points = std::max(max_points, records[end].points);
+            }
+        }
+
+        // the weights are 16 bits, scaled down per position when needed
+        auto scale = max_points > 0xffff ? double(0xffff) / double(max_points) : 1.0;
+        auto written = false;
+        for (auto i = begin; i < end; ++i)
+        {
+            auto weight = std::uint32_t(double(records[i].points) * scale);
+            if (records[i].games < options.min_games || weight == 0)
+            {
+                continue;
+            }
+
+            std::uint8_t record[record_size];
+            write_big_endian(record, records[i].key, 8);
+            write_big_endian(record + 8, records[i].move, 2);
+            write_big_endian(record + 10, weight, 2);
+            write_big_endian(record + 12, records[i].games, 4);
+            buffer.insert(buffer.end(), record, record + record_size);
+            ++stats.entries;
+            written = true;
+        }
+        stats.positions += written ? 1 : 0;
+
+        if (buffer.size() >= (1 << 20))
+        {
+            ok &= std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+            buffer.clear();
+        }
+        begin = end;
+    }
+    ok &= std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,188 @@
+#include "game/chess/engine_service.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace chess;
+
+engine_service::engine_service(int threads, std::size_t hash_mb)
+{
+    m_search.set_threads(threads);
+    m_search.set_hash_size(hash_mb);
+    m_worker = std::thread{[this]()
+                           { run(); }};
+}
+
+engine_service::~engine_service()
+{
+    m_quit.store(true);
+    m_search.stop();
+    m_wake.notify_one();
+    m_worker.join();
+}
+
+bool engine_service::send(engine_command &&command)
+{
+    if (!m_commands.try_push(std::move(command)))
+    {
+        return false;
+    }
+    // without the mutex: a wakeup lost between the worker's check and its
+    // wait only delays the command to the next wait timeout
+    m_wake.notify_one();
+    return true;
+}
+
+std::uint32_t engine_service::go(const position &pos, const search_limits &limits)
+{
+    auto command = engine_command{
+        .type = engine_command::kind::go,
+        .search_id = m_last_id + 1,
+        .pos = pos,
+        .limits = limits,
+    };
+    if (!send(std::move(command)))
+    {
+        return 0;
+    }
+
+    ++m_pending;
+    return ++m_last_id;
+}
+
+void engine_service::stop()
+{
+    m_stopped_id.store(m_last_id);
+    m_search.stop();
+}
+
+void engine_service::ponderhit()
+{
+    m_ponderhit_id.store(m_last_id);
+    m_search.ponderhit();
+}
+
+bool engine_service::set_threads(int count)
+{
+    return send(engine_command{.type = engine_command::kind::set_threads, .value = std::size_t(std::max(count, 1))});
+}
+
+bool engine_service::set_hash(std::size_t mb)
+{
+    return send(engine_command{.type = engine_command::kind::set_hash, .value = mb});
+}
+
+bool engine_service::new_game()
+{
+    return send(engine_command{.type = engine_command::kind::new_game});
+}
+
+bool engine_service::set_book(std::shared_ptr<const opening_book> book)
+{
+    return send(engine_command{.type = engine_command::kind::set_book, .book = std::move(book)});
+}
+
+bool engine_service::poll(engine_event &event)
+{
+    if (!m_events.try_pop(event))
+    {
+        return false;
+    }
+    if (event.type == engine_event::kind::bestmove && m_pending > 0)
+    {
+        --m_pending;
+    }
+    return true;
+}
+
+void engine_service::run()
+{
+    // reused, a position is too large to construct on every command
+    auto command = std::make_unique<engine_command>();
+
+    while (!m_quit.load())
+    {
+        if (!m_commands.try_pop(*command))
+        {
+            auto lock = std::unique_lock{m_wake_mutex};
+            m_wake.wait_for(lock, std::chrono::milliseconds{2});
+            continue;
+        }
+
+        switch (command->type)
+        {
+        case engine_command::kind::go:
+            run_search(*command);
+            break;
+        case engine_command::kind::set_threads:
+            m_search.set_threads(int(command->value));
+            break;
+        case engine_command::kind::set_hash:
+            m_search.set_hash_size(command->value);
+            break;
+        case engine_command::kind::new_game:
+            m_search.clear();
+            break;
+        case engine_command::kind::set_book:
+            m_book = std::move(command->book);
+            break;
+        }
+    }
+}
+
+void engine_service::run_search(engine_command &command)
+{
+    auto id = command.search_id;
+    auto limits = command.limits;
+
+    // requests sent before the search could see them
+    auto stopped = [this, id]()
+    {
+        return m_stopped_id.load() >= id || m_quit.load();
+    };
+    if (m_ponderhit_id.load() >= id)
+    {
+        limits.ponder = false;
+    }
+
+    auto result = search_result{};
+    auto book_move = limits.book && m_book != nullptr ? m_book->pick(command.pos, m_random()) : no_move;
+    if (book_move != no_move)
+    {
+        result.best = book_move;
+        result.from_book = true;
+    }
+    else if (!stopped())
+    {
+        result = m_search.search(command.pos, limits, [&](const search_info &info)
+                                 {
+                                     if (stopped())
+                                     {
+                                         m_search.stop();
+                                     }
+                                     if (m_search.pondering() && m_ponderhit_id.load() >= id)
+                                     {
+                                         m_search.ponderhit();
+                                     }
+
+                                     // the owner is behind, it only needs the latest lines
+                                     auto event = engine_event{.type = engine_event::kind::info, .search_id = id, .info = info};
+                                     if (!m_events.try_push(std::move(event)))
+                                     {
+                                         m_dropped.fetch_add(1, std::memory_order_relaxed);
+                                     } });
+    }
+    else
+    {
+        // stopped before it started, still answer with a legal move
+        move_list list;
+        generate_legal(command.pos, list);
+        result.best = list.empty() ? no_move : list[0];
+    }
+
+    auto event = engine_event{.type = engine_event::kind::bestmove, .search_id = id, .result = result};
+    while (!m_events.try_push(std::move(event)) && !m_quit.load())
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+}
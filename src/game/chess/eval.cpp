@@ -0,0 +1,144 @@
+#include "game/chess/eval.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    using namespace chess;
+
+    // piece-square tables as seen by white, written from a8 to h1
+    using square_table = std::array<int, 64>;
+
+    constexpr square_table pawn_table = {
+        0, 0, 0, 0, 0, 0, 0, 0,
+        50, 50, 50, 50, 50, 50, 50, 50,
+        10, 10, 20, 30, 30, 20, 10, 10,
+        5, 5, 10, 25, 25, 10, 5, 5,
+        0, 0, 0, 20, 20, 0, 0, 0,
+        5, -5, -10, 0, 0, -10, -5, 5,
+        5, 10, 10, -20, -20, 10, 10, 5,
+        0, 0, 0, 0, 0, 0, 0, 0};
+
+    constexpr square_table knight_table = {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20, 0, 0, 0, 0, -20, -40,
+        -30, 0, 10, 15, 15, 10, 0, -30,
+        -30, 5, 15, 20, 20, 15, 5, -30,
+        -30, 0, 15, 20, 20, 15, 0, -30,
+        -30, 5, 10, 15, 15, 10, 5, -30,
+        -40, -20, 0, 5, 5, 0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50};
+
+    constexpr square_table bishop_table = {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10, 0, 0, 0, 0, 0, 0, -10,
+        -10, 0, 5, 10, 10, 5, 0, -10,
+        -10, 5, 5, 10, 10, 5, 5, -10,
+        -10, 0, 10, 10, 10, 10, 0, -10,
+        -10, 10, 10, 10, 10, 10, 10, -10,
+        -10, 5, 0, 0, 0, 0, 5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20};
+
+    constexpr square_table rook_table = {
+        0, 0, 0, 0, 0, 0, 0, 0,
+        5, 10, 10, 10, 10, 10, 10, 5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        -5, 0, 0, 0, 0, 0, 0, -5,
+        0, 0, 0, 5, 5, 0, 0, 0};
+
+    constexpr square_table queen_table = {
+        -20, -10, -10, -5, -5, -10, -10, -20,
+        -10, 0, 0, 0, 0, 0, 0, -10,
+        -10, 0, 5, 5, 5, 5, 0, -10,
+        -5, 0, 5, 5, 5, 5, 0, -5,
+        0, 0, 5, 5, 5, 5, 0, -5,
+        -10, 5, 5, 5, 5, 5, 0, -10,
+        -10, 0, 5, 0, 0, 0, 0, -10,
+        -20, -10, -10, -5, -5, -10, -10, -20};
+
+    // the king shelters in the middle game and centralizes in the endgame
+    constexpr square_table king_middle_table = {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+        20, 20, 0, 0, 0, 0, 20, 20,
+        20, 30, 10, 0, 0, 10, 30, 20};
+
+    constexpr square_table king_end_table = {
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10, 0, 0, -10, -20, -30,
+        -30, -10, 20, 30, 30, 20, -10, -30,
+        -30, -10, 30, 40, 40, 30, -10, -30,
+        -30, -10, 30, 40, 40, 30, -10, -30,
+        -30, -10, 20, 30, 30, 20, -10, -30,
+        -30, -30, 0, 0, 0, 0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50};
+
+    constexpr const square_table *piece_tables[5] = {
+        &pawn_table, &knight_table, &bishop_table, &rook_table, &queen_table};
+
+    constexpr int piece_values[6] = {pawn_value, knight_value, bishop_value, rook_value, queen_value, 0};
+
+    // game phase, 24 with every piece on the board and 0 without pieces
+    constexpr int phase_weights[6] = {0, 1, 1, 2, 4, 0};
+    constexpr int max_phase = 24;
+
+    constexpr int tempo = 10;
+
+    // the tables index a8 first, flip for white
+    constexpr int table_index(color c, square s)
+    {
+        return c == white ? s ^ 56 : s;
+    }
+}
+
+int chess::piece_value(piece_type type)
+{
+    return piece_values[type];
+}
+
+int chess::piece_square_value(piece p, square s)
+{
+    auto type = type_of(p);
+    auto index = table_index(color_of(p), s);
+    if (type == king)
+    {
+        return (king_middle_table[index] + king_end_table[index]) / 2;
+    }
+    return piece_values[type] + (*piece_tables[type])[index];
+}
+
+int chess::evaluate(const position &pos)
+{
+    int score[2] = {0, 0};
+    int phase = 0;
+
+    for (auto c : {white, black})
+    {
+        for (int type = pawn; type <= queen; ++type)
+        {
+            for (auto b = pos.pieces(c, piece_type(type)); b != 0;)
+            {
+                auto s = pop_lsb(b);
+                score[c] += piece_values[type] + (*piece_tables[type])[table_index(c, s)];
+                phase += phase_weights[type];
+            }
+        }
+    }
+
+    phase = std::min(phase, max_phase);
+    for (auto c : {white, black})
+    {
+        auto index = table_index(c, pos.king_square(c));
+        score[c] += (king_middle_table[index] * phase + king_end_table[index] * (max_phase - phase)) / max_phase;
+    }
+
+    auto us = pos.side_to_move();
+    return score[us] - score[~us] + tempo;
+}
@@ -0,0 +1,718 @@
+#include "game/chess/game_db.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <thread>
+#include "game/chess/lz.hpp"
+
+// the files are little-endian, like every platform the engine runs on
+
+namespace
+{
+    using namespace chess;
+
+    constexpr char games_magic[8] = {'c', 'p', 'p', 'g', 'd', 'b', '\0', '\0'};
+    constexpr char index_magic[8] = {'c', 'p', 'p', 'i', 'd', 'x', '\0', '\0'};
+    constexpr std::uint32_t file_version = 1;
+    constexpr std::size_t header_size = 64;
+    // offset, compressed size, raw size, first game, game count
+    constexpr std::size_t directory_entry_size = 24;
+    // key and game
+    constexpr std::size_t index_record_size = 12;
+    // games are added to a block until it reaches this size
+    constexpr std::size_t block_target = 32 * 1024;
+
+    // integers and strings
+
+    void put_varint(std::vector<std::uint8_t> &out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    bool get_varint(const std::uint8_t *&in, const std::uint8_t *end, std::uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && in < end; shift += 7)
+        {
+            auto byte = *in++;
+            value |= std::uint64_t{byte & 0x7fu} << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void put_string(std::vector<std::uint8_t> &out, std::string_view text)
+    {
+        put_varint(out, text.size());
+        out.insert(out.end(), text.begin(), text.end());
+    }
+
+    bool get_string(const std::uint8_t *&in, const std::uint8_t *end, std::string &text)
+    {
+        std::uint64_t size;
+        if (!get_varint(in, end, size) || size > std::uint64_t(end - in))
+        {
+            return false;
+        }
+        text.assign(reinterpret_cast<const char *>(in), std::size_t(size));
+        in += size;
+        return true;
+    }
+
+    template <typename T>
+    void put(std::uint8_t *out, T value)
+    {
+        std::memcpy(out, &value, sizeof(T));
+    }
+
+    template <typename T>
+    T get(const std::uint8_t *in)
+    {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        return value;
+    }
+
+    game_result parse_result(std::string_view result)
+    {
+        return result == "1-0" ? game_result::white_wins : result == "0-1"   ? game_result::black_wins
+                                                       : result == "1/2-1/2" ? game_result::draw
+                                                                             : game_result::unknown;
+    }
+
+    // records of the index while building
+    struct index_entry
+    {
+        std::uint64_t key;
+        std::uint32_t game;
+
+        bool operator<(const index_entry &other) const
+        {
+            return key != other.key ? key < other.key : game < other.game;
+        }
+        bool operator==(const index_entry &other) const
+        {
+            return key == other.key && game == other.game;
+        }
+    };
+
+    struct block_info
+    {
+        std::uint64_t offset;
+        std::uint32_t compressed_size;
+        std::uint32_t raw_size;
+        std::uint32_t first_game;
+        std::uint32_t game_count;
+    };
+
+    // what one thread built from its part of the PGN text, game numbers
+    // and offsets counted from the part
+    struct part_result
+    {
+        std::string games_path;
+        std::vector<block_info> blocks;
+        std::uint32_t games{0};
+        std::uint64_t skipped{0};
+        std::uint64_t games_bytes{0};
+        std::vector<std::string> runs;
+        bool ok{true};
+    };
+
+    bool write_run(std::vector<index_entry> &entries, const std::string &path)
+    {
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+        auto *file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+        auto written = std::fwrite(entries.data(), sizeof(index_entry), entries.size(), file) == entries.size();
+        entries.clear();
+        return std::fclose(file) == 0 && written;
+    }
+
+    void build_part(std::string_view text, const std::string &prefix, std::size_t run_capacity, part_result &result)
+    {
+        result.games_path = prefix + ".games";
+        auto *games_file = std::fopen(result.games_path.c_str(), "wb");
+        if (games_file == nullptr)
+        {
+            result.ok = false;
+            return;
+        }
+
+        auto reader = pgn_reader{text};
+        auto game = pgn_game{};
+        auto pos = std::make_unique<position>();
+        auto replayed = std::make_unique<position>();
+
+        auto entries = std::vector<index_entry>{};
+        entries.reserve(run_capacity);
+        auto game_entries = std::vector<index_entry>{};
+        auto indices = std::vector<std::uint32_t>{};
+        auto block = std::vector<std::uint8_t>{};
+        auto compressed = std::vector<std::uint8_t>{};
+        auto first_in_block = std::uint32_t{0};
+
+        auto flush_block = [&]()
+        {
+            if (block.empty())
+            {
+                return;
+            }
+            compressed.clear();
+            lz_compress(block.data(), block.size(), compressed);
+            result.blocks.push_back(block_info{
+                .offset = result.games_bytes,
+                .compressed_size = std::uint32_t(compressed.size()),
+                .raw_size = std::uint32_t(block.size()),
+                .first_game = first_in_block,
+                .game_count = result.games - first_in_block,
+            });
+            result.ok &= std::fwrite(compressed.data(), 1, compressed.size(), games_file) == compressed.size();
+            result.games_bytes += compressed.size();
+            first_in_block = result.games;
+            block.clear();
+        };
+
+        move_list list;
+        while (reader.next(game))
+        {
+            auto number = result.games;
+            game_entries.clear();
+            indices.clear();
+
+            auto replay = replay_game(game, *pos, [&](const position &current, move m)
+                                      {
+                                          game_entries.push_back(index_entry{current.key(), number});
+                                          generate_legal(current, list);
+                                          indices.push_back(std::uint32_t(std::find(list.begin(), list.end(), m) - list.begin())); });
+            if (!replay.ok)
+            {
+                ++result.skipped;
+                continue;
+            }
+            game_entries.push_back(index_entry{pos->key(), number});
+
+            auto fen = game.tag("FEN");
+            put_varint(block, fen.empty() ? 0 : 1);
+            put_string(block, game.tag("White"));
+            put_string(block, game.tag("Black"));
+            put_string(block, game.tag("Event"));
+            put_string(block, game.tag("Date"));
+            if (!fen.empty())
+            {
+                put_string(block, fen);
+            }
+            block.push_back(static_cast<std::uint8_t>(parse_result(game.tag("Result"))));
+            put_varint(block, indices.size());
+            for (auto index : indices)
+            {
+                put_varint(block, index);
+            }
+            ++result.games;
+            if (block.size() >= block_target)
+            {
+                flush_block();
+            }
+
+            // runs end between games: a game is never split between two
+            if (entries.size() + game_entries.size() > run_capacity && !entries.empty())
+            {
+                auto path = prefix + ".run" + std::to_string(result.runs.size());
+                result.ok &= write_run(entries, path);
+                result.runs.push_back(path);
+            }
+            entries.insert(entries.end(), game_entries.begin(), game_entries.end());
+        }
+
+        flush_block();
+        if (!entries.empty())
+        {
+            auto path = prefix + ".run" + std::to_string(result.runs.size());
+            result.ok &= write_run(entries, path);
+            result.runs.push_back(path);
+        }
+        result.ok &= std::fclose(games_file) == 0;
+    }
+
+    // sorted run on disk, read a chunk at a time
+    struct run_reader
+    {
+        std::FILE *file{nullptr};
+        std::uint32_t game_base{0};
+        std::vector<index_entry> chunk;
+        std::size_t next{0};
+
+        bool open(const std::string &path, std::uint32_t base, std::size_t chunk_size)
+        {
+            file = std::fopen(path.c_str(), "rb");
+            game_base = base;
+            chunk.reserve(chunk_size);
+            return file != nullptr;
+        }
+
+        // false at the end of the run
+        bool peek(index_entry &entry)
+        {
+            if (next >= chunk.size())
+            {
+                chunk.resize(chunk.capacity());
+                auto count = std::fread(chunk.data(), sizeof(index_entry), chunk.size(), file);
+                chunk.resize(count);
+                next = 0;
+                if (count == 0)
+                {
+                    return false;
+                }
+            }
+            entry = chunk[next];
+            entry.game += game_base;
+            return true;
+        }
+
+        void pop() { ++next; };
+
+        ~run_reader()
+        {
+            if (file != nullptr)
+            {
+                std::fclose(file);
+            }
+        }
+    };
+
+    // k-way merge of the runs of every part into the index file
+    bool merge_runs(const std::vector<part_result> &parts, const std::vector<std::uint32_t> &bases,
+                    std::size_t memory_bytes, const std::string &path, std::uint64_t &positions)
+    {
+        auto readers = std::vector<std::unique_ptr<run_reader>>{};
+        std::size_t run_count = 0;
+        for (const auto &part : parts)
+        {
+            run_count += part.runs.size();
+        }
+        auto chunk_size = std::max<std::size_t>(memory_bytes / std::max<std::size_t>(run_count, 1) / sizeof(index_entry), 1024);
+
+        for (std::size_t p = 0; p < parts.size(); ++p)
+        {
+            for (const auto &run : parts[p].runs)
+            {
+                auto reader = std::make_unique<run_reader>();
+                if (!reader->open(run, bases[p], chunk_size))
+                {
+                    return false;
+                }
+                readers.push_back(std::move(reader));
+            }
+        }
+
+        auto *file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+        std::uint8_t header[header_size] = {};
+        auto ok = std::fwrite(header, 1, header_size, file) == header_size;
+
+        // smallest entry first
+        using head = std::pair<index_entry, std::size_t>;
+        auto later = [](const head &a, const head &b)
+        {
+            return b.first < a.first;
+        };
+        auto heads = std::priority_queue<head, std::vector<head>, decltype(later)>{later};
+        for (std::size_t r = 0; r < readers.size(); ++r)
+        {
+            index_entry entry;
+            if (readers[r]->peek(entry))
+            {
+                heads.push({entry, r});
+            }
+        }
+
+        auto buffer = std::vector<std::uint8_t>{};
+        buffer.reserve(index_record_size * 65536);
+        positions = 0;
+        while (!heads.empty())
+        {
+            auto [entry, r] = heads.top();
+            heads.pop();
+
+            std::uint8_t record[index_record_size];
+            put(record, entry.key);
+            put(record + 8, entry.game);
+            buffer.insert(buffer.end(), record, record + index_record_size);
+            ++positions;
+            if (buffer.size() + index_record_size > buffer.capacity())
+            {
+                ok &= std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+                buffer.clear();
+            }
+
+            readers[r]->pop();
+            if (readers[r]->peek(entry))
+            {
+                heads.push({entry, r});
+            }
+        }
+        ok &= std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+
+        std::memcpy(header, index_magic, sizeof(index_magic));
+        put(header + 8, file_version);
+        put(header + 16, positions);
+        ok &= std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(header, 1, header_size, file) == header_size;
+        return std::fclose(file) == 0 && ok;
+    }
+
+    // the games of every part after each other, then the block directory
+    bool write_games(const std::vector<part_result> &parts, const std::vector<std::uint32_t> &bases,
+                     const std::string &path, std::uint64_t &bytes)
+    {
+        auto *file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+        std::uint8_t header[header_size] = {};
+        auto ok = std::fwrite(header, 1, header_size, file) == header_size;
+
+        auto directory = std::vector<std::uint8_t>{};
+        std::uint64_t offset = header_size;
+        std::uint64_t blocks = 0;
+        auto buffer = std::vector<char>(1 << 20);
+        for (std::size_t p = 0; p < parts.size(); ++p)
+        {
+            auto *part = std::fopen(parts[p].games_path.c_str(), "rb");
+            if (part == nullptr)
+            {
+                std::fclose(file);
+                return false;
+            }
+            for (std::size_t read; (read = std::fread(buffer.data(), 1, buffer.size(), part)) > 0;)
+            {
+                ok &= std::fwrite(buffer.data(), 1, read, file) == read;
+            }
+            std::fclose(part);
+
+            for (const auto &block : parts[p].blocks)
+            {
+                std::uint8_t entry[directory_entry_size];
+                put(entry, offset + block.offset);
+                put(entry + 8, block.compressed_size);
+                put(entry + 12, block.raw_size);
+                put(entry + 16, bases[p] + block.first_game);
+                put(entry + 20, block.game_count);
+                directory.insert(directory.end(), entry, entry + directory_entry_size);
+                ++blocks;
+            }
+            offset += parts[p].games_bytes;
+        }
+        ok &= std::fwrite(directory.data(), 1, directory.size(), file) == directory.size();
+        bytes = offset + directory.size();
+
+        std::memcpy(header, games_magic, sizeof(games_magic));
+        put(header + 8, file_version);
+        put(header + 16, std::uint64_t{bases.back() + parts.back().games});
+        put(header + 24, blocks);
+        put(header + 32, offset);
+        ok &= std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(header, 1, header_size, file) == header_size;
+        return std::fclose(file) == 0 && ok;
+    }
+}
+
+bool game_database::open(const std::string &path)
+{
+    close();
+    if (!m_file.open(path) || m_file.size() < header_size)
+    {
+        close();
+        return false;
+    }
+
+    const auto *data = reinterpret_cast<const std::uint8_t *>(m_file.data());
+    auto games = get<std::uint64_t>(data + 16);
+    auto blocks = get<std::uint64_t>(data + 24);
+    auto directory = get<std::uint64_t>(data + 32);
+    if (std::memcmp(data, games_magic, sizeof(games_magic)) != 0 || get<std::uint32_t>(data + 8) != file_version ||
+        games > ~0u || directory > m_file.size() || blocks > (m_file.size() - directory) / directory_entry_size)
+    {
+        close();
+        return false;
+    }
+
+    m_games = std::uint32_t(games);
+    m_blocks = std::uint32_t(blocks);
+    m_directory = data + directory;
+    return true;
+}
+
+void game_database::close()
+{
+    m_file.close();
+    m_games = 0;
+    m_blocks = 0;
+    m_directory = nullptr;
+}
+
+bool game_database::read_game(std::uint32_t number, game_record &game, position &pos) const
+{
+    if (number >= m_games || m_blocks == 0)
+    {
+        return false;
+    }
+
+    // the last block starting at or before the game
+    std::uint32_t low = 0;
+    std::uint32_t high = m_blocks;
+    while (high - low > 1)
+    {
+        auto middle = (low + high) / 2;
+        if (get<std::uint32_t>(m_directory + middle * directory_entry_size + 16) <= number)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    const auto *entry = m_directory + low * directory_entry_size;
+    auto offset = get<std::uint64_t>(entry);
+    auto compressed_size = get<std::uint32_t>(entry + 8);
+    auto raw_size = get<std::uint32_t>(entry + 12);
+    auto first_game = get<std::uint32_t>(entry + 16);
+    if (offset + compressed_size > m_file.size())
+    {
+        return false;
+    }
+
+    if (game.block_index != low)
+    {
+        game.block.resize(raw_size);
+        const auto *compressed = reinterpret_cast<const std::uint8_t *>(m_file.data()) + offset;
+        if (!lz_decompress(compressed, compressed_size, game.block.data(), raw_size))
+        {
+            game.block_index = ~0u;
+            return false;
+        }
+        game.block_index = low;
+    }
+
+    const auto *in = game.block.data();
+    const auto *end = in + game.block.size();
+    for (auto current = first_game;; ++current)
+    {
+        std::uint64_t flags;
+        std::uint64_t plies;
+        auto ok = get_varint(in, end, flags) &&
+                  get_string(in, end, game.white) && get_string(in, end, game.black) &&
+                  get_string(in, end, game.event) && get_string(in, end, game.date);
+        game.fen.clear();
+        if (ok && (flags & 1) != 0)
+        {
+            ok = get_string(in, end, game.fen);
+        }
+        ok = ok && in < end;
+        if (ok)
+        {
+            game.result = game_result(*in++);
+        }
+        if (!ok || !get_varint(in, end, plies))
+        {
+            return false;
+        }
+
+        if (current < number)
+        {
+            // skipped, the indices are not decoded
+            for (std::uint64_t i = 0; i < plies; ++i)
+            {
+                std::uint64_t index;
+                if (!get_varint(in, end, index))
+                {
+                    return false;
+                }
+            }
+            continue;
+        }
+
+        if (!pos.set_fen(game.fen.empty() ? position::start_fen : std::string_view{game.fen}))
+        {
+            return false;
+        }
+        game.moves.clear();
+        move_list list;
+        for (std::uint64_t i = 0; i < plies; ++i)
+        {
+            std::uint64_t index;
+            generate_legal(pos, list);
+            if (!get_varint(in, end, index) || index >= list.size())
+            {
+                return false;
+            }
+            game.moves.push_back(list[std::size_t(index)]);
+            pos.make_move(list[std::size_t(index)]);
+        }
+        return true;
+    }
+}
+
+bool position_index::open(const std::string &path)
+{
+    close();
+    if (!m_file.open(path) || m_file.size() < header_size)
+    {
+        close();
+        return false;
+    }
+
+    const auto *data = reinterpret_cast<const std::uint8_t *>(m_file.data());
+    auto entries = get<std::uint64_t>(data + 16);
+    if (std::memcmp(data, index_magic, sizeof(index_magic)) != 0 || get<std::uint32_t>(data + 8) != file_version ||
+        entries != (m_file.size() - header_size) / index_record_size)
+    {
+        close();
+        return false;
+    }
+
+    m_records = data + header_size;
+    m_entries = std::size_t(entries);
+    return true;
+}
+
+void position_index::close()
+{
+    m_file.close();
+    m_records = nullptr;
+    m_entries = 0;
+}
+
+std::uint64_t position_index::key_at(std::size_t entry) const
+{
+    return get<std::uint64_t>(m_records + entry * index_record_size);
+}
+
+std::uint32_t position_index::game_at(std::size_t entry) const
+{
+    return get<std::uint32_t>(m_records + entry * index_record_size + 8);
+}
+
+index_range position_index::find(std::uint64_t key) const
+{
+    // first entry with a key not below `key`. The keys are random: the
+    // interpolation lands next to it in a few probes, binary search is
+    // the fallback for unlucky ranges
+    auto lower_bound = [this](std::uint64_t target)
+    {
+        std::size_t low = 0;
+        std::size_t high = m_entries;
+        for (int probes = 0; high - low > 32 && probes < 8; ++probes)
+        {
+            auto low_key = key_at(low);
+            auto high_key = key_at(high - 1);
+            if (target <= low_key)
+            {
+                return low;
+            }
+            if (target > high_key)
+            {
+                return high;
+            }
+
+            auto fraction = static_cast<long double>(target - low_key) / static_cast<long double>(high_key - low_key);
+            auto middle = low + std::min(std::size_t(fraction * static_cast<long double>(high - 1 - low)), high - 1 - low);
+            if (key_at(middle) < target)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        while (low < high)
+        {
+            auto middle = low + (high - low) / 2;
+            if (key_at(middle) < target)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return low;
+    };
+
+    auto range = index_range{};
+    range.begin = lower_bound(key);
+    range.end = key == ~std::uint64_t{0} ? m_entries : lower_bound(key + 1);
+    return range;
+}
+
+bool chess::build_game_database(std::string_view pgn, const std::string &name, const game_db_build_options &options,
+                                game_db_build_stats &stats)
+{
+    auto pieces = split_games(pgn, std::size_t(std::max(options.threads, 1)));
+    auto parts = std::vector<part_result>(pieces.size());
+    auto memory_bytes = std::max<std::size_t>(options.memory_mb, 1) * 1024 * 1024;
+    auto run_capacity = std::max<std::size_t>(memory_bytes / pieces.size() / sizeof(index_entry), 1024);
+
+    // the temporary files are named after the output
+    auto base_name = name.substr(name.find_last_of("/\\") + 1);
+    auto prefix = options.temp_dir + "/" + base_name;
+
+    auto workers = std::vector<std::thread>{};
+    for (std::size_t i = 0; i < pieces.size(); ++i)
+    {
+        workers.emplace_back([&, i]()
+                             { build_part(pieces[i], prefix + ".part" + std::to_string(i), run_capacity, parts[i]); });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    auto ok = true;
+    auto bases = std::vector<std::uint32_t>(parts.size(), 0);
+    stats = game_db_build_stats{};
+    for (std::size_t i = 0; i < parts.size(); ++i)
+    {
+        ok &= parts[i].ok;
+        bases[i] = std::uint32_t(stats.games);
+        stats.games += parts[i].games;
+        stats.skipped += parts[i].skipped;
+        stats.runs += parts[i].runs.size();
+    }
+
+    ok = ok && stats.games <= ~0u &&
+         write_games(parts, bases, name + ".cdb", stats.games_bytes) &&
+         merge_runs(parts, bases, memory_bytes, name + ".cdx", stats.positions);
+    stats.index_bytes = header_size + stats.positions * index_record_size;
+
+    for (const auto &part : parts)
+    {
+        std::remove(part.games_path.c_str());
+        for (const auto &run : part.runs)
+        {
+            std::remove(run.c_str());
+        }
+    }
+    return ok;
+}
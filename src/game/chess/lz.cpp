@@ -0,0 +1,171 @@
+#include "game/chess/lz.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    std::uint32_t read_u32(const std::uint8_t *in)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, in, sizeof(value));
+        return value;
+    }
+
+    // LZ77 with sequences of literals and matches, as in LZ4: a token with
+    // the literal count and the match length in 4 bits each (15 continues
+    // in 255-valued bytes), the literals, and a 16-bit match offset. The
+    // last sequence has literals only
+    constexpr std::size_t min_match = 4;
+    constexpr std::size_t max_offset = 65535;
+
+    void put_length(std::vector<std::uint8_t> &out, std::size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            out.push_back(255);
+        }
+        out.push_back(static_cast<std::uint8_t>(length));
+    }
+
+    void put_sequence(std::vector<std::uint8_t> &out, const std::uint8_t *literals, std::size_t literal_count,
+                      std::size_t offset, std::size_t match_length)
+    {
+        auto match_code = match_length >= min_match ? match_length - min_match : 0;
+        out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literal_count, 15) << 4) |
+                                                std::min<std::size_t>(match_code, 15)));
+        if (literal_count >= 15)
+        {
+            put_length(out, literal_count - 15);
+        }
+        out.insert(out.end(), literals, literals + literal_count);
+
+        if (match_length == 0)
+        {
+            return;
+        }
+        out.push_back(static_cast<std::uint8_t>(offset));
+        out.push_back(static_cast<std::uint8_t>(offset >> 8));
+        if (match_code >= 15)
+        {
+            put_length(out, match_code - 15);
+        }
+    }
+
+    bool get_length(const std::uint8_t *&in, const std::uint8_t *end, std::size_t &length)
+    {
+        while (true)
+        {
+            if (in >= end)
+            {
+                return false;
+            }
+            auto byte = *in++;
+            length += byte;
+            if (byte != 255)
+            {
+                return true;
+            }
+        }
+    }
+}
+
+void chess::lz_compress(const std::uint8_t *in, std::size_t size, std::vector<std::uint8_t> &out)
+{
+    constexpr int hash_bits = 14;
+    // positions of the last 4-byte sequences, by hash
+    auto table = std::vector<std::int32_t>(std::size_t{1} << hash_bits, -1);
+
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+    while (i + min_match <= size)
+    {
+        auto sequence = read_u32(in + i);
+        auto hash = (sequence * 2654435761u) >> (32 - hash_bits);
+        auto candidate = table[hash];
+        table[hash] = std::int32_t(i);
+
+        if (candidate < 0 || i - std::size_t(candidate) > max_offset ||
+            read_u32(in + candidate) != sequence)
+        {
+            ++i;
+            continue;
+        }
+
+        auto length = min_match;
+        while (i + length < size && in[candidate + length] == in[i + length])
+        {
+            ++length;
+        }
+        put_sequence(out, in + anchor, i - anchor, i - std::size_t(candidate), length);
+        i += length;
+        anchor = i;
+    }
+    put_sequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+bool chess::lz_decompress(const std::uint8_t *in, std::size_t size, std::uint8_t *out, std::size_t out_size)
+{
+    const auto *end = in + size;
+    auto *op = out;
+    auto *out_end = out + out_size;
+
+    while (in < end)
+    {
+        auto token = *in++;
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !get_length(in, end, literals))
+        {
+            return false;
+        }
+        if (literals > std::size_t(end - in) || literals > std::size_t(out_end - op))
+        {
+            return false;
+        }
+        std::memcpy(op, in, literals);
+        in += literals;
+        op += literals;
+        if (in == end)
+        {
+            break;
+        }
+
+        if (end - in < 2)
+        {
+            return false;
+        }
+        std::size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        std::size_t length = token & 15;
+        if (length == 15 && !get_length(in, end, length))
+        {
+            return false;
+        }
+        length += min_match;
+        if (offset == 0 || offset > std::size_t(op - out) || length > std::size_t(out_end - op))
+        {
+            return false;
+        }
+        // the match may overlap what it writes: runs of a byte are set at
+        // once, other overlaps copied byte by byte
+        const auto *match = op - offset;
+        if (offset >= length)
+        {
+            std::memcpy(op, match, length);
+            op += length;
+        }
+        else if (offset == 1)
+        {
+            std::memset(op, *match, length);
+            op += length;
+        }
+        else
+        {
+            for (; length > 0; --length)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+    return op == out_end;
+}
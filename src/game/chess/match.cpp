@@ -0,0 +1,340 @@
+#include "game/chess/match.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "game/chess/mapped_file.hpp"
+#include "game/chess/pgn.hpp"
+#include "game/chess/tablebase.hpp"
+
+namespace
+{
+    using namespace chess;
+
+    enum class game_result
+    {
+        white_wins,
+        draw,
+        black_wins,
+    };
+
+    struct game_record
+    {
+        game_result result{game_result::draw};
+        bool adjudicated{false};
+        // by the engine playing white, then black
+        std::array<match_engine_stats, 2> stats;
+    };
+
+    // no sequence of legal moves mates
+    bool insufficient_material(const position &pos)
+    {
+        auto others = pos.pieces() & ~pos.pieces(king);
+        return others == 0 ||
+               (popcount(others) == 1 && (others & (pos.pieces(knight) | pos.pieces(bishop))) != 0);
+    }
+
+    // the third occurrence, the search treats the second as a draw already
+    bool threefold(const position &pos, const std::vector<std::uint64_t> &keys)
+    {
+        auto window = std::min<std::size_t>(std::size_t(pos.halfmove_clock()) + 1, keys.size());
+        return std::count(keys.end() - std::ptrdiff_t(window), keys.end(), pos.key()) >= 3;
+    }
+
+    double expected_score(double elo)
+    {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+
+    double score_elo(double score)
+    {
+        score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+        return -400.0 * std::log10(1.0 / score - 1.0);
+    }
+
+    double mean_score(const match_stats &stats)
+    {
+        return (stats.wins + 0.5 * stats.draws) / std::max(stats.games, 1);
+    }
+
+    // of a single game
+    double score_variance(const match_stats &stats)
+    {
+        auto s = mean_score(stats);
+        return (stats.wins * (1.0 - s) * (1.0 - s) + stats.draws * (0.5 - s) * (0.5 - s) + stats.losses * s * s) /
+               std::max(stats.games, 1);
+    }
+
+    // the engines keep their tables between moves, not between games
+    game_record play_game(const std::string &opening, std::array<search_engine *, 2> players,
+                          const std::array<const match_engine *, 2> &configs, const match_options &options,
+                          position &pos)
+    {
+        auto record = game_record{};
+        if (!pos.set_fen(opening))
+        {
+            pos.set_fen(position::start_fen);
+        }
+        for (auto *player : players)
+        {
+            player->clear();
+        }
+
+        auto keys = std::vector<std::uint64_t>{pos.key()};
+        auto list = move_list{};
+        for (int ply = 0;; ++ply)
+        {
+            auto us = pos.side_to_move();
+            generate_legal(pos, list);
+            if (list.empty())
+            {
+                record.result = !pos.in_check() ? game_result::draw : us == white ? game_result::black_wins
+                                                                                  : game_result::white_wins;
+                return record;
+            }
+            if (pos.halfmove_clock() >= 100 || threefold(pos, keys) || insufficient_material(pos))
+            {
+                return record;
+            }
+            if (ply >= options.max_plies)
+            {
+                record.adjudicated = true;
+                return record;
+            }
+
+            auto value = tb::wdl::draw;
+            if (options.tablebase_adjudication && popcount(pos.pieces()) <= tb::largest() && tb::probe_wdl(pos, value))
+            {
+                record.adjudicated = true;
+                record.result = value == tb::wdl::draw ? game_result::draw : (value == tb::wdl::win) == (us == white) ? game_result::white_wins
+                                                                                                                       : game_result::black_wins;
+                return record;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            auto result = players[us]->search(pos, configs[us]->limits);
+            auto micros = std::uint64_t(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+            auto &stats = record.stats[us];
+            ++stats.moves;
+            stats.nodes += result.nodes;
+            stats.depth += std::uint64_t(result.depth);
+            stats.microseconds += micros;
+            stats.max_microseconds = std::max(stats.max_microseconds, micros);
+
+            // a search always returns a legal move while there is one
+            pos.make_move(result.best);
+            keys.push_back(pos.key());
+        }
+    }
+
+    void add(match_engine_stats &total, const match_engine_stats &game)
+    {
+        total.moves += game.moves;
+        total.nodes += game.nodes;
+        total.depth += game.depth;
+        total.microseconds += game.microseconds;
+        total.max_microseconds = std::max(total.max_microseconds, game.max_microseconds);
+    }
+}
+
+double chess::elo_difference(const match_stats &stats)
+{
+    return score_elo(mean_score(stats));
+}
+
+double chess::elo_error(const match_stats &stats)
+{
+    if (stats.games < 2)
+    {
+        return 0.0;
+    }
+    auto s = mean_score(stats);
+    auto margin = 1.959964 * std::sqrt(score_variance(stats) / stats.games);
+    return (score_elo(s + margin) - score_elo(s - margin)) / 2.0;
+}
+
+double chess::sprt_llr(const match_stats &stats, const sprt_bounds &bounds)
+{
+    auto variance = score_variance(stats);
+    // undefined until both a decisive and another result were seen
+    if (stats.games < 2 || variance <= 0.0)
+    {
+        return 0.0;
+    }
+    auto s0 = expected_score(bounds.elo0);
+    auto s1 = expected_score(bounds.elo1);
+    return stats.games * (s1 - s0) * (2.0 * mean_score(stats) - s0 - s1) / (2.0 * variance);
+}
+
+double chess::sprt_lower(const sprt_bounds &bounds)
+{
+    return std::log(bounds.beta / (1.0 - bounds.alpha));
+}
+
+double chess::sprt_upper(const sprt_bounds &bounds)
+{
+    return std::log((1.0 - bounds.beta) / bounds.alpha);
+}
+
+bool chess::load_openings(const std::string &path, int plies, std::vector<std::string> &fens)
+{
+    auto file = mapped_file{};
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    auto pos = std::make_unique<position>();
+    auto text = file.text();
+    auto is_pgn = path.size() >= 4 && path.compare(path.size() - 4, 4, ".pgn") == 0;
+    if (is_pgn)
+    {
+        auto reader = pgn_reader{text};
+        auto game = pgn_game{};
+        while (reader.next(game))
+        {
+            auto fen = game.tag("FEN");
+            if (!pos->set_fen(fen.empty() ? position::start_fen : fen))
+            {
+                continue;
+            }
+            // only the first moves are parsed
+            auto tokens = san_tokenizer{game.movetext};
+            auto san = std::string_view{};
+            auto played = 0;
+            for (; played < plies && tokens.next(san); ++played)
+            {
+                auto m = parse_san(*pos, san);
+                if (m == no_move)
+                {
+                    break;
+                }
+                pos->make_move(m);
+            }
+            if (played == plies)
+            {
+                fens.push_back(pos->fen());
+            }
+        }
+        return true;
+    }
+
+    // EPD: the first four fields of a FEN, then operations
+    for (std::size_t begin = 0; begin < text.size();)
+    {
+        auto end = std::min(text.find('\n', begin), text.size());
+        auto line = text.substr(begin, end - begin);
+        begin = end + 1;
+
+        auto fields = std::string{};
+        std::size_t offset = 0;
+        for (int field = 0; field < 4; ++field)
+        {
+            offset = line.find_first_not_of(" \t\r", offset);
+            if (offset == std::string_view::npos)
+            {
+                break;
+            }
+            auto field_end = std::min(line.find_first_of(" \t\r", offset), line.size());
+            fields += std::string(line.substr(offset, field_end - offset)) + " ";
+            offset = field_end;
+        }
+        fields += "0 1";
+        if (pos->set_fen(fields))
+        {
+            fens.push_back(pos->fen());
+        }
+    }
+    return true;
+}
+
+match_stats chess::play_match(const match_options &options, const match_callback &on_game)
+{
+    auto openings = options.openings;
+    if (openings.empty())
+    {
+        openings.emplace_back(position::start_fen);
+    }
+
+    auto stats = match_stats{};
+    auto mutex = std::mutex{};
+    auto next = std::atomic<int>{0};
+    auto finished = std::atomic<bool>{false};
+
+    auto work = [&]()
+    {
+        // a pair of engines per worker, one thread each
+        auto engines = std::array<std::unique_ptr<search_engine>, 2>{};
+        for (std::size_t i = 0; i < engines.size(); ++i)
+        {
+            engines[i] = std::make_unique<search_engine>();
+            engines[i]->set_hash_size(options.engines[i].hash_mb);
+        }
+        auto pos = std::make_unique<position>();
+
+        for (auto game = next.fetch_add(1); game < options.games && !finished.load(std::memory_order_relaxed);
+             game = next.fetch_add(1))
+        {
+            // the first engine is white in the even games
+            auto first_white = game % 2 == 0;
+            auto &opening = openings[std::size_t(game / 2) % openings.size()];
+            auto players = first_white ? std::array<search_engine *, 2>{engines[0].get(), engines[1].get()}
+                                       : std::array<search_engine *, 2>{engines[1].get(), engines[0].get()};
+            auto configs = first_white ? std::array<const match_engine *, 2>{&options.engines[0], &options.engines[1]}
+                                       : std::array<const match_engine *, 2>{&options.engines[1], &options.engines[0]};
+            auto record = play_game(opening, players, configs, options, *pos);
+
+            auto lock = std::lock_guard{mutex};
+            if (finished.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            auto first_wins = record.result == (first_white ? game_result::white_wins : game_result::black_wins);
+            auto first_loses = record.result == (first_white ? game_result::black_wins : game_result::white_wins);
+            ++stats.games;
+            stats.wins += first_wins ? 1 : 0;
+            stats.losses += first_loses ? 1 : 0;
+            stats.draws += !first_wins && !first_loses ? 1 : 0;
+            stats.adjudicated += record.adjudicated ? 1 : 0;
+            add(stats.engines[0], record.stats[first_white ? white : black]);
+            add(stats.engines[1], record.stats[first_white ? black : white]);
+
+            if (options.sprt)
+            {
+                stats.llr = sprt_llr(stats, options.bounds);
+                if (stats.llr <= sprt_lower(options.bounds))
+                {
+                    stats.sprt = sprt_state::accept_h0;
+                }
+                else if (stats.llr >= sprt_upper(options.bounds))
+                {
+                    stats.sprt = sprt_state::accept_h1;
+                }
+                // the games still being played are not counted
+                finished.store(stats.sprt != sprt_state::running, std::memory_order_relaxed);
+            }
+            if (on_game)
+            {
+                on_game(stats);
+            }
+        }
+    };
+
+    auto workers = std::vector<std::thread>{};
+    for (int i = 1; i < options.concurrency; ++i)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return stats;
+}
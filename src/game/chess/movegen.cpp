@@ -0,0 +1,285 @@
+#include "game/chess/movegen.hpp"
+
+namespace
+{
+    using namespace chess;
+
+    // pawn moves to `to`, as the four promotions on the last rank
+    void push_pawn_move(move_list &list, square from, square to, bool is_capture)
+    {
+        if (rank_of(to) == 0 || rank_of(to) == 7)
+        {
+            auto base = is_capture ? promotion_capture : promotion;
+            for (int type = 3; type >= 0; --type)
+            {
+                list.push_back(move{from, to, move_flag(base + type)});
+            }
+            return;
+        }
+        list.push_back(move{from, to, is_capture ? capture : quiet});
+    }
+
+    // squares attacked by `them`, the king of `us` removed from the board so
+    // that it cannot step back along a slider's ray
+    bitboard danger_squares(const position &pos, color them, bitboard occupied)
+    {
+        auto danger = pawn_attacks_bb(them, pos.pieces(them, pawn));
+        danger |= king_attacks(pos.king_square(them));
+
+        for (auto b = pos.pieces(them, knight); b != 0;)
+        {
+            danger |= knight_attacks(pop_lsb(b));
+        }
+        for (auto b = pos.pieces(them, bishop) | pos.pieces(them, queen); b != 0;)
+        {
+            danger |= bishop_attacks(pop_lsb(b), occupied);
+        }
+        for (auto b = pos.pieces(them, rook) | pos.pieces(them, queen); b != 0;)
+        {
+            danger |= rook_attacks(pop_lsb(b), occupied);
+        }
+
+        return danger;
+    }
+
+    // our pieces standing alone between our king and an enemy slider
+    bitboard pinned_pieces(const position &pos, color us, square king_sq)
+    {
+        auto them = ~us;
+        auto snipers = (rook_attacks(king_sq, 0) & (pos.pieces(them, rook) | pos.pieces(them, queen))) |
+                       (bishop_attacks(king_sq, 0) & (pos.pieces(them, bishop) | pos.pieces(them, queen)));
+
+        auto pinned = bitboard{0};
+        while (snipers != 0)
+        {
+            auto blockers = between(king_sq, pop_lsb(snipers)) & pos.pieces();
+            if (blockers != 0 && !more_than_one(blockers))
+            {
+                pinned |= blockers & pos.pieces(us);
+            }
+        }
+
+        return pinned;
+    }
+
+    void generate_pawn_moves(
+        const position &pos,
+        move_list &list,
+        color us,
+        square king_sq,
+        bitboard pinned,
+        bitboard check_mask)
+    {
+        auto them = ~us;
+        auto occupied = pos.pieces();
+        auto enemies = pos.pieces(them);
+        auto up = us == white ? 8 : -8;
+        auto ep = pos.ep_square();
+
+        for (auto pawns = pos.pieces(us, pawn); pawns != 0;)
+        {
+            auto from = pop_lsb(pawns);
+            auto allowed = check_mask;
+            if (pinned & square_bb(from))
+            {
+                allowed &= line(king_sq, from);
+            }
+
+            // pushes
+            auto to = from + up;
+            if (!(occupied & square_bb(to)))
+            {
+                if (allowed & square_bb(to))
+                {
+                    push_pawn_move(list, from, to, false);
+                }
+
+                if (relative_rank(us, from) == 1)
+                {
+                    auto double_to = to + up;
+                    if (!(occupied & square_bb(double_to)) && (allowed & square_bb(double_to)))
+                    {
+                        list.push_back(move{from, double_to, double_push});
+                    }
+                }
+            }
+
+            // captures
+            for (auto targets = pawn_attacks(us, from) & enemies & allowed; targets != 0;)
+            {
+                push_pawn_move(list, from, pop_lsb(targets), true);
+            }
+
+            if (ep != no_square && (pawn_attacks(us, from) & square_bb(ep)))
+            {
+                // both pawns leave their rank at once: the capture is legal
+                // if the king is not attacked afterwards, by a slider through
+                // the vacated squares or by a checker left in place
+                auto captured_sq = ep ^ 8;
+                auto after = (occupied ^ square_bb(from) ^ square_bb(captured_sq)) | square_bb(ep);
+                auto remaining = enemies ^ square_bb(captured_sq);
+
+                auto sliders = (bishop_attacks(king_sq, after) & (pos.pieces(them, bishop) | pos.pieces(them, queen))) |
+                               (rook_attacks(king_sq, after) & (pos.pieces(them, rook) | pos.pieces(them, queen)));
+                auto steppers = (knight_attacks(king_sq) & pos.pieces(them, knight)) |
+                                (pawn_attacks(us, king_sq) & pos.pieces(them, pawn));
+
+                if (((sliders | steppers) & remaining) == 0)
+                {
+                    list.push_back(move{from, ep, en_passant});
+                }
+            }
+        }
+    }
+
+    void generate_castling(const position &pos, move_list &list, color us, bitboard danger)
+    {
+        auto rights = pos.castling_rights() >> (2 * us);
+        auto occupied = pos.pieces();
+        auto king_sq = relative_square(us, make_square(4, 0));
+
+        // the squares between king and rook are empty, the king does not
+        // cross an attacked square
+        if (rights & white_king_side)
+        {
+            auto path = between(king_sq, relative_square(us, make_square(7, 0)));
+            auto walk = square_bb(relative_square(us, make_square(5, 0))) |
+                        square_bb(relative_square(us, make_square(6, 0)));
+
+            if (!(occupied & path) && !(danger & walk))
+            {
+                list.push_back(move{king_sq, relative_square(us, make_square(6, 0)), king_castle});
+            }
+        }
+        if (rights & white_queen_side)
+        {
+            auto path = between(king_sq, relative_square(us, make_square(0, 0)));
+            auto walk = square_bb(relative_square(us, make_square(3, 0))) |
+                        square_bb(relative_square(us, make_square(2, 0)));
+
+            if (!(occupied & path) && !(danger & walk))
+            {
+                list.push_back(move{king_sq, relative_square(us, make_square(2, 0)), queen_castle});
+            }
+        }
+    }
+
+    template <typename Attacks>
+    void generate_piece_moves(
+        move_list &list,
+        bitboard pieces,
+        bitboard enemies,
+        bitboard targets,
+        square king_sq,
+        bitboard pinned,
+        Attacks attacks)
+    {
+        while (pieces != 0)
+        {
+            auto from = pop_lsb(pieces);
+            auto b = attacks(from) & targets;
+            if (pinned & square_bb(from))
+            {
+                b &= line(king_sq, from);
+            }
+
+            while (b != 0)
+            {
+                auto to = pop_lsb(b);
+                list.push_back(move{from, to, (enemies & square_bb(to)) ? capture : quiet});
+            }
+        }
+    }
+}
+
+void chess::generate_legal(const position &pos, move_list &list)
+{
+    list.clear();
+
+    auto us = pos.side_to_move();
+    auto them = ~us;
+    auto king_sq = pos.king_square(us);
+    auto occupied = pos.pieces();
+    auto enemies = pos.pieces(them);
+    auto checkers = pos.checkers();
+
+    auto danger = danger_squares(pos, them, occupied ^ square_bb(king_sq));
+
+    for (auto b = king_attacks(king_sq) & ~pos.pieces(us) & ~danger; b != 0;)
+    {
+        auto to = pop_lsb(b);
+        list.push_back(move{king_sq, to, (enemies & square_bb(to)) ? capture : quiet});
+    }
+
+    // double check, only the king can move
+    if (more_than_one(checkers))
+    {
+        return;
+    }
+
+    // in check, the other pieces capture the checker or block its ray
+    auto check_mask = checkers != 0
+                          ? between(king_sq, lsb(checkers)) | checkers
+                          : ~bitboard{0};
+    auto pinned = pinned_pieces(pos, us, king_sq);
+    auto targets = ~pos.pieces(us) & check_mask;
+
+    generate_pawn_moves(pos, list, us, king_sq, pinned, check_mask);
+
+    // a pinned knight can never move along its pin
+    generate_piece_moves(list, pos.pieces(us, knight) & ~pinned, enemies, targets, king_sq, pinned,
+                         [](square s)
+                         { return knight_attacks(s); });
+    generate_piece_moves(list, pos.pieces(us, bishop) | pos.pieces(us, queen), enemies, targets, king_sq, pinned,
+                         [occupied](square s)
+                         { return bishop_attacks(s, occupied); });
+    generate_piece_moves(list, pos.pieces(us, rook) | pos.pieces(us, queen), enemies, targets, king_sq, pinned,
+                         [occupied](square s)
+                         { return rook_attacks(s, occupied); });
+
+    if (checkers == 0)
+    {
+        generate_castling(pos, list, us, danger);
+    }
+}
+
+move chess::parse_uci(const position &pos, std::string_view uci)
+{
+    move_list list;
+    generate_legal(pos, list);
+
+    for (auto m : list)
+    {
+        if (to_uci(m) == uci)
+        {
+            return m;
+        }
+    }
+    return no_move;
+}
+
+std::uint64_t chess::perft(position &pos, int depth)
+{
+    if (depth <= 0)
+    {
+        return 1;
+    }
+
+    move_list list;
+    generate_legal(pos, list);
+
+    // bulk counting, the last ply is not played
+    if (depth == 1)
+    {
+        return list.size();
+    }
+
+    std::uint64_t nodes = 0;
+    for (auto m : list)
+    {
+        pos.make_move(m);
+        nodes += perft(pos, depth - 1);
+        pos.unmake_move(m);
+    }
+    return nodes;
+}
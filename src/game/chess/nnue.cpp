@@ -0,0 +1,578 @@
+#include "game/chess/nnue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "game/chess/eval.hpp"
+#include "game/chess/mapped_file.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHESS_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and clang only allow the intrinsics in functions compiled for their
+// instruction set, the rest of the engine keeps the default target
+#if defined(__GNUC__) || defined(__clang__)
+#define CHESS_TARGET_AVX2 __attribute__((target("avx2")))
+#define CHESS_TARGET_SSE41 __attribute__((target("sse4.1")))
+#else
+#define CHESS_TARGET_AVX2
+#define CHESS_TARGET_SSE41
+#endif
+
+namespace
+{
+    using namespace chess;
+    using namespace chess::nnue;
+
+    constexpr int activation_max = 127;
+    // a network cannot claim a mate
+    constexpr int max_evaluation = 20000;
+
+    // network file, little-endian:
+    //   header (64 bytes)
+    //   int16 feature biases[hidden_size]
+    //   int16 feature weights[feature_count][hidden_size]
+    //   int8 output weights[2 * hidden_size]
+    struct file_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t features;
+        std::uint32_t hidden;
+        std::int32_t output_bias;
+        std::int32_t output_scale;
+        std::uint8_t reserved[36];
+    };
+    static_assert(sizeof(file_header) == 64);
+
+    constexpr char file_magic[8] = {'c', 'p', 'p', 'n', 'n', 'u', 'e', '\0'};
+    constexpr std::uint32_t file_version = 1;
+    constexpr std::size_t file_size = sizeof(file_header) +
+                                      sizeof(std::int16_t) * hidden_size * (feature_count + 1) +
+                                      sizeof(std::int8_t) * hidden_size * 2;
+
+    // piece-square feature of `p` on `s`, as seen by `perspective`: the
+    // board is flipped for black so that both sides see their own pieces
+    // first and moving up
+    int feature_index(color perspective, piece p, square s)
+    {
+        if (perspective == black)
+        {
+            p = piece((p + 6) % 12);
+            s ^= 56;
+        }
+        return p * 64 + s;
+    }
+
+    // kernels, over a whole accumulator of `hidden_size` neurons
+
+    using update_kernel = void (*)(std::int16_t *out, const std::int16_t *in,
+                                   const std::int16_t *const *added, int added_count,
+                                   const std::int16_t *const *removed, int removed_count);
+    using output_kernel = std::int32_t (*)(const std::int16_t *us, const std::int16_t *them, const std::int8_t *weights);
+
+    void update_scalar(std::int16_t *out, const std::int16_t *in,
+                       const std::int16_t *const *added, int added_count,
+                       const std::int16_t *const *removed, int removed_count)
+    {
+        for (int i = 0; i < hidden_size; ++i)
+        {
+            int value = in[i];
+            for (int a = 0; a < added_count; ++a)
+            {
+                value += added[a][i];
+            }
+            for (int r = 0; r < removed_count; ++r)
+            {
+                value -= removed[r][i];
+            }
+            // wraps like the 16-bit SIMD additions
+            out[i] = static_cast<std::int16_t>(value);
+        }
+    }
+
+    std::int32_t output_scalar(const std::int16_t *us, const std::int16_t *them, const std::int8_t *weights)
+    {
+        std::int32_t sum = 0;
+        for (int i = 0; i < hidden_size; ++i)
+        {
+            sum += std::clamp<int>(us[i], 0, activation_max) * weights[i];
+            sum += std::clamp<int>(them[i], 0, activation_max) * weights[hidden_size + i];
+        }
+        return sum;
+    }
+
+#ifdef CHESS_SIMD_X86
+    CHESS_TARGET_AVX2 void update_avx2(std::int16_t *out, const std::int16_t *in,
+                                       const std::int16_t *const *added, int added_count,
+                                       const std::int16_t *const *removed, int removed_count)
+    {
+        for (int i = 0; i < hidden_size; i += 16)
+        {
+            auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            for (int a = 0; a < added_count; ++a)
+            {
+                value = _mm256_add_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(added[a] + i)));
+            }
+            for (int r = 0; r < removed_count; ++r)
+            {
+                value = _mm256_sub_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(removed[r] + i)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), value);
+        }
+    }
+
+    CHESS_TARGET_AVX2 std::int32_t output_avx2(const std::int16_t *us, const std::int16_t *them, const std::int8_t *weights)
+    {
+        const auto zero = _mm256_setzero_si256();
+        const auto ones = _mm256_set1_epi16(1);
+        auto sum = _mm256_setzero_si256();
+
+        const std::int16_t *sides[2] = {us, them};
+        for (int side = 0; side < 2; ++side)
+        {
+            for (int i = 0; i < hidden_size; i += 32)
+            {
+                auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sides[side] + i));
+                auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sides[side] + i + 16));
+                // saturates to [-128, 127] per 128-bit lane, the permute
+                // restores the order of the neurons
+                auto packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xd8);
+                packed = _mm256_max_epi8(packed, zero);
+
+                auto w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + side * hidden_size + i));
+                // u8 * i8 pairs fit 16 bits: activations are at most 127
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(packed, w), ones));
+            }
+        }
+
+        auto lanes = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, 0x4e));
+        lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, 0xb1));
+        return _mm_cvtsi128_si32(lanes);
+    }
+
+    CHESS_TARGET_SSE41 void update_sse41(std::int16_t *out, const std::int16_t *in,
+                                         const std::int16_t *const *added, int added_count,
+                                         const std::int16_t *const *removed, int removed_count)
+    {
+        for (int i = 0; i < hidden_size; i += 8)
+        {
+            auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            for (int a = 0; a < added_count; ++a)
+            {
+                value = _mm_add_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(added[a] + i)));
+            }
+            for (int r = 0; r < removed_count; ++r)
+            {
+                value = _mm_sub_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(removed[r] + i)));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), value);
+        }
+    }
+
+    CHESS_TARGET_SSE41 std::int32_t output_sse41(const std::int16_t *us, const std::int16_t *them, const std::int8_t *weights)
+    {
+        const auto zero = _mm_setzero_si128();
+        const auto ones = _mm_set1_epi16(1);
+        auto sum = _mm_setzero_si128();
+
+        const std::int16_t *sides[2] = {us, them};
+        for (int side = 0; side < 2; ++side)
+        {
+            for (int i = 0; i < hidden_size; i += 16)
+            {
+                auto low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sides[side] + i));
+                auto high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sides[side] + i + 8));
+                auto packed = _mm_max_epi8(_mm_packs_epi16(low, high), zero);
+
+                auto w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + side * hidden_size + i));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(packed, w), ones));
+            }
+        }
+
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+        return _mm_cvtsi128_si32(sum);
+    }
+#endif
+
+    struct kernel_set
+    {
+        update_kernel update;
+        output_kernel output;
+    };
+
+    kernel_set kernels_for([[maybe_unused]] simd_level level)
+    {
+#ifdef CHESS_SIMD_X86
+        if (level == simd_level::avx2)
+        {
+            return {update_avx2, output_avx2};
+        }
+        if (level == simd_level::sse41)
+        {
+            return {update_sse41, output_sse41};
+        }
+#endif
+        return {update_scalar, output_scalar};
+    }
+
+    std::atomic<simd_level> active_level{detect_simd_level()};
+    std::atomic<bool> nnue_enabled{true};
+
+    // the bundled network, always kept, and the loaded file if any
+    struct network_storage
+    {
+        std::vector<std::byte> bundled_data;
+        network bundled;
+        mapped_file file;
+        network loaded;
+        const network *active{nullptr};
+        std::string name;
+    };
+
+    network_storage storage;
+    std::once_flag storage_once;
+
+    bool parse_network(const std::byte *data, std::size_t size, network &net)
+    {
+        if (data == nullptr || size != file_size)
+        {
+            return false;
+        }
+
+        file_header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.version != file_version ||
+            header.features != feature_count || header.hidden != hidden_size)
+        {
+            return false;
+        }
+
+        auto *biases = data + sizeof(file_header);
+        auto *weights = biases + sizeof(std::int16_t) * hidden_size;
+        auto *output = weights + sizeof(std::int16_t) * hidden_size * feature_count;
+        net = network{
+            .feature_biases = reinterpret_cast<const std::int16_t *>(biases),
+            .feature_weights = reinterpret_cast<const std::int16_t *>(weights),
+            .output_weights = reinterpret_cast<const std::int8_t *>(output),
+            .output_bias = header.output_bias,
+            .output_scale = header.output_scale,
+        };
+        return true;
+    }
+
+    // piece-square evaluation as a network. Each side's score `s` is split
+    // over 32 neurons clipped at 127 centipawns each, neuron `k` holds
+    // clamp(s - 127 k, 0, 127), 32 more hold the negative part: their sum
+    // gives back `s` between -4064 and 4064. Both perspectives are averaged,
+    // the other 64 neurons are left to trained networks.
+    std::vector<std::byte> build_bundled_network()
+    {
+        constexpr int bands = 32;
+        constexpr int tempo = 10;
+
+        auto biases = std::vector<std::int16_t>(hidden_size, 0);
+        auto weights = std::vector<std::int16_t>(std::size_t(hidden_size) * feature_count, 0);
+        auto output = std::vector<std::int8_t>(hidden_size * 2, 0);
+
+        for (int k = 0; k < bands; ++k)
+        {
+            biases[k] = static_cast<std::int16_t>(-activation_max * k);
+            biases[bands + k] = static_cast<std::int16_t>(-activation_max * k);
+            output[k] = 1;
+            output[bands + k] = -1;
+            output[hidden_size + k] = -1;
+            output[hidden_size + bands + k] = 1;
+        }
+
+        // seen by white: the features of every perspective look the same
+        for (int p = white_pawn; p <= black_king; ++p)
+        {
+            for (square s = 0; s < 64; ++s)
+            {
+                auto value = piece_square_value(piece(p), s);
+                if (color_of(piece(p)) == black)
+                {
+                    value = -value;
+                }
+
+                auto *row = &weights[std::size_t(feature_index(white, piece(p), s)) * hidden_size];
+                for (int k = 0; k < bands; ++k)
+                {
+                    row[k] = static_cast<std::int16_t>(value);
+                    row[bands + k] = static_cast<std::int16_t>(-value);
+                }
+            }
+        }
+
+        // both perspectives sum to 2 s, halved by the scale
+        file_header header{};
+        std::memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.version = file_version;
+        header.features = feature_count;
+        header.hidden = hidden_size;
+        header.output_bias = 2 * tempo;
+        header.output_scale = (1 << output_scale_shift) / 2;
+
+        auto data = std::vector<std::byte>(file_size);
+        auto *out = data.data();
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        std::memcpy(out, biases.data(), biases.size() * sizeof(std::int16_t));
+        out += biases.size() * sizeof(std::int16_t);
+        std::memcpy(out, weights.data(), weights.size() * sizeof(std::int16_t));
+        out += weights.size() * sizeof(std::int16_t);
+        std::memcpy(out, output.data(), output.size());
+        return data;
+    }
+
+    network_storage &get_storage()
+    {
+        std::call_once(storage_once, []()
+                       {
+                           storage.bundled_data = build_bundled_network();
+                           parse_network(storage.bundled_data.data(), storage.bundled_data.size(), storage.bundled);
+                           storage.active = &storage.bundled;
+                           storage.name = "bundled"; });
+        return storage;
+    }
+
+    // accumulators of `pos` from scratch
+    void refresh(const network &net, const position &pos, std::array<std::array<std::int16_t, hidden_size>, 2> &values)
+    {
+        auto kernels = kernels_for(active_level.load(std::memory_order_relaxed));
+
+        for (auto perspective : {white, black})
+        {
+            // added in batches, the kernel keeps the neurons in registers
+            std::array<const std::int16_t *, 32> rows;
+            int count = 0;
+            auto *out = values[perspective].data();
+            const auto *in = net.feature_biases;
+
+            for (auto b = pos.pieces(); b != 0;)
+            {
+                auto s = pop_lsb(b);
+                rows[count++] = net.feature_weights + std::size_t(feature_index(perspective, pos.piece_on(s), s)) * hidden_size;
+                if (count == int(rows.size()) || b == 0)
+                {
+                    kernels.update(out, in, rows.data(), count, nullptr, 0);
+                    in = out;
+                    count = 0;
+                }
+            }
+            if (in != out)
+            {
+                // no piece at all
+                std::copy(net.feature_biases, net.feature_biases + hidden_size, out);
+            }
+        }
+    }
+
+    int propagate(const network &net, const position &pos, const std::array<std::array<std::int16_t, hidden_size>, 2> &values)
+    {
+        auto kernels = kernels_for(active_level.load(std::memory_order_relaxed));
+        auto us = pos.side_to_move();
+
+        auto sum = kernels.output(values[us].data(), values[~us].data(), net.output_weights) + net.output_bias;
+        auto score = std::int64_t{sum} * net.output_scale / (1 << output_scale_shift);
+        return int(std::clamp<std::int64_t>(score, -max_evaluation, max_evaluation));
+    }
+}
+
+simd_level chess::nnue::detect_simd_level()
+{
+    static const auto level = []()
+    {
+#if defined(CHESS_SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        auto sse41 = (info[2] & (1 << 19)) != 0;
+        // AVX registers must also be saved by the OS
+        auto os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        auto avx2 = os_avx && (info[1] & (1 << 5)) != 0;
+#elif defined(CHESS_SIMD_X86)
+        __builtin_cpu_init();
+        auto sse41 = __builtin_cpu_supports("sse4.1") != 0;
+        auto avx2 = __builtin_cpu_supports("avx2") != 0;
+#else
+        auto sse41 = false;
+        auto avx2 = false;
+#endif
+        return avx2 ? simd_level::avx2 : sse41 ? simd_level::sse41
+                                               : simd_level::scalar;
+    }();
+
+    return level;
+}
+
+simd_level chess::nnue::active_simd_level()
+{
+    return active_level.load(std::memory_order_relaxed);
+}
+
+const char *chess::nnue::simd_level_name(simd_level level)
+{
+    switch (level)
+    {
+    case simd_level::sse41:
+        return "sse4.1";
+    case simd_level::avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+bool chess::nnue::set_simd_level(simd_level level)
+{
+    if (level > detect_simd_level())
+    {
+        return false;
+    }
+    active_level.store(level, std::memory_order_relaxed);
+    return true;
+}
+
+bool chess::nnue::load_network(const std::string &path)
+{
+    auto &s = get_storage();
+
+    auto file = mapped_file{};
+    auto net = network{};
+    if (!file.open(path) || !parse_network(file.data(), file.size(), net))
+    {
+        return false;
+    }
+
+    s.file = std::move(file);
+    s.loaded = net;
+    s.active = &s.loaded;
+    s.name = path;
+    return true;
+}
+
+void chess::nnue::use_bundled_network()
+{
+    auto &s = get_storage();
+    s.active = &s.bundled;
+    s.name = "bundled";
+    s.file.close();
+}
+
+const network &chess::nnue::active_network()
+{
+    return *get_storage().active;
+}
+
+const std::string &chess::nnue::network_name()
+{
+    return get_storage().name;
+}
+
+bool chess::nnue::write_bundled_network(const std::string &path)
+{
+    const auto &data = get_storage().bundled_data;
+
+    auto *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    auto written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && written;
+}
+
+bool chess::nnue::enabled()
+{
+    return nnue_enabled.load(std::memory_order_relaxed);
+}
+
+void chess::nnue::set_enabled(bool enabled)
+{
+    nnue_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void evaluator::reset(const position &pos)
+{
+    m_network = &active_network();
+    m_top = 0;
+    refresh(*m_network, pos, m_stack[0].values);
+    m_stack[0].computed = true;
+}
+
+void evaluator::push(const position &pos)
+{
+    auto &next = m_stack[++m_top];
+    next.computed = false;
+    next.dirty = pos.state().dirty;
+}
+
+int evaluator::evaluate(const position &pos)
+{
+    // the nearest computed accumulator, the root one always is
+    auto first = m_top;
+    while (!m_stack[first].computed)
+    {
+        --first;
+    }
+    for (auto index = first + 1; index <= m_top; ++index)
+    {
+        update(index);
+    }
+
+    return propagate(*m_network, pos, m_stack[m_top].values);
+}
+
+void evaluator::update(int index)
+{
+    auto kernels = kernels_for(active_level.load(std::memory_order_relaxed));
+    auto &current = m_stack[index];
+    const auto &previous = m_stack[index - 1];
+    const auto &dirty = current.dirty;
+
+    for (auto perspective : {white, black})
+    {
+        std::array<const std::int16_t *, 3> added;
+        std::array<const std::int16_t *, 3> removed;
+        int added_count = 0;
+        int removed_count = 0;
+
+        for (int i = 0; i < dirty.count; ++i)
+        {
+            if (dirty.from[i] != no_square)
+            {
+                removed[removed_count++] = m_network->feature_weights +
+                                           std::size_t(feature_index(perspective, dirty.pieces[i], dirty.from[i])) * hidden_size;
+            }
+            if (dirty.to[i] != no_square)
+            {
+                added[added_count++] = m_network->feature_weights +
+                                       std::size_t(feature_index(perspective, dirty.pieces[i], dirty.to[i])) * hidden_size;
+            }
+        }
+
+        kernels.update(current.values[perspective].data(), previous.values[perspective].data(),
+                       added.data(), added_count, removed.data(), removed_count);
+    }
+    current.computed = true;
+}
+
+int chess::nnue::evaluate(const position &pos)
+{
+    const auto &net = active_network();
+    std::array<std::array<std::int16_t, hidden_size>, 2> values;
+    refresh(net, pos, values);
+    return propagate(net, pos, values);
+}
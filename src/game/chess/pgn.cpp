@@ -0,0 +1,463 @@
+#include "game/chess/pgn.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    using namespace chess;
+
+    bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    // ends a SAN token besides spaces
+    bool is_delimiter(char c)
+    {
+        return is_space(c) || c == '{' || c == '}' || c == '(' || c == ')' || c == ';' || c == '$';
+    }
+
+    bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    piece_type piece_from_letter(char c)
+    {
+        switch (c)
+        {
+        case 'N':
+        case 'n':
+            return knight;
+        case 'B':
+        case 'b':
+            return bishop;
+        case 'R':
+        case 'r':
+            return rook;
+        case 'Q':
+        case 'q':
+            return queen;
+        case 'K':
+            return king;
+        default:
+            return no_piece_type;
+        }
+    }
+
+    std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && is_space(text.front()))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && is_space(text.back()))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    // first line of `text` starting at or after `from` which begins a game:
+    // it starts with `[` and the last line before it is movetext
+    std::size_t find_game_start(std::string_view text, std::size_t from)
+    {
+        auto at = from;
+        while (true)
+        {
+            auto newline = text.find("\n[", at);
+            if (newline == std::string_view::npos)
+            {
+                return text.size();
+            }
+
+            // the previous line with text
+            auto end = newline;
+            while (end > 0 && is_space(text[end - 1]))
+            {
+                --end;
+            }
+            auto begin = text.rfind('\n', end == 0 ? 0 : end - 1);
+            begin = begin == std::string_view::npos ? 0 : begin + 1;
+            if (end == 0 || text[begin] != '[')
+            {
+                return newline + 1;
+            }
+            at = newline + 1;
+        }
+    }
+
+    void parse_tag(std::string_view line, std::vector<pgn_tag> &tags)
+    {
+        // [Name "value"]
+        line.remove_prefix(1);
+        auto name_end = line.find_first_of(" \t\"");
+        auto open = line.find('"');
+        auto close = line.rfind('"');
+        if (name_end == std::string_view::npos || open == std::string_view::npos || close <= open)
+        {
+            return;
+        }
+        tags.push_back(pgn_tag{.name = line.substr(0, name_end), .value = line.substr(open + 1, close - open - 1)});
+    }
+}
+
+std::string_view pgn_game::tag(std::string_view name) const
+{
+    for (const auto &t : tags)
+    {
+        if (t.name == name)
+        {
+            return t.value;
+        }
+    }
+    return {};
+}
+
+bool pgn_reader::next(pgn_game &game)
+{
+    while (m_offset < m_text.size() && is_space(m_text[m_offset]))
+    {
+        ++m_offset;
+    }
+    if (m_offset >= m_text.size())
+    {
+        return false;
+    }
+
+    game.tags.clear();
+    game.offset = m_offset;
+
+    while (m_offset < m_text.size() && m_text[m_offset] == '[')
+    {
+        auto end = std::min(m_text.find('\n', m_offset), m_text.size());
+        parse_tag(trim(m_text.substr(m_offset, end - m_offset)), game.tags);
+        m_offset = end;
+        while (m_offset < m_text.size() && is_space(m_text[m_offset]))
+        {
+            ++m_offset;
+        }
+    }
+
+    // up to the tags of the next game
+    auto end = m_text.find("\n[", m_offset);
+    end = end == std::string_view::npos ? m_text.size() : end + 1;
+    game.movetext = trim(m_text.substr(m_offset, end - m_offset));
+    m_offset = end;
+    return true;
+}
+
+bool san_tokenizer::next(std::string_view &san)
+{
+    auto size = m_text.size();
+    while (m_offset < size)
+    {
+        auto c = m_text[m_offset];
+        if (is_space(c) || c == ')' || c == '}' || c == '*')
+        {
+            ++m_offset;
+        }
+        else if (c == '{')
+        {
+            auto close = m_text.find('}', m_offset);
+            m_offset = close == std::string_view::npos ? size : close + 1;
+        }
+        else if (c == ';')
+        {
+            auto newline = m_text.find('\n', m_offset);
+            m_offset = newline == std::string_view::npos ? size : newline + 1;
+        }
+        else if (c == '(')
+        {
+            // variations nest, and may hold comments with parentheses
+            int depth = 0;
+            do
+            {
+                c = m_text[m_offset];
+                if (c == '(')
+                {
+                    ++depth;
+                }
+                else if (c == ')')
+                {
+                    --depth;
+                }
+                else if (c == '{')
+                {
+                    auto close = m_text.find('}', m_offset);
+                    m_offset = close == std::string_view::npos ? size - 1 : close;
+                }
+                ++m_offset;
+            } while (depth > 0 && m_offset < size);
+        }
+        else if (c == '$')
+        {
+            ++m_offset;
+            while (m_offset < size && is_digit(m_text[m_offset]))
+            {
+                ++m_offset;
+            }
+        }
+        else if (is_digit(c) && m_text.compare(m_offset, 3, "0-0") != 0)
+        {
+            // move number, or a result such as 1-0 or 1/2-1/2
+            while (m_offset < size && is_digit(m_text[m_offset]))
+            {
+                ++m_offset;
+            }
+            if (m_offset < size && m_text[m_offset] == '.')
+            {
+                while (m_offset < size && m_text[m_offset] == '.')
+                {
+                    ++m_offset;
+                }
+            }
+            else
+            {
+                while (m_offset < size && !is_delimiter(m_text[m_offset]))
+                {
+                    ++m_offset;
+                }
+            }
+        }
+        else
+        {
+            auto begin = m_offset;
+            while (m_offset < size && !is_delimiter(m_text[m_offset]))
+            {
+                ++m_offset;
+            }
+            san = m_text.substr(begin, m_offset - begin);
+            return true;
+        }
+    }
+    return false;
+}
+
+move chess::parse_san(const position &pos, std::string_view san)
+{
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+    {
+        san.remove_suffix(1);
+    }
+    if (san.size() < 2)
+    {
+        return no_move;
+    }
+
+    move_list list;
+    generate_legal(pos, list);
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0")
+    {
+        auto flag = san.size() == 3 ? king_castle : queen_castle;
+        for (auto m : list)
+        {
+            if (m.flags() == flag)
+            {
+                return m;
+            }
+        }
+        return no_move;
+    }
+
+    auto type = pawn;
+    if (auto letter = piece_from_letter(san[0]); letter != no_piece_type && san[0] >= 'A' && san[0] <= 'Z')
+    {
+        type = letter;
+        san.remove_prefix(1);
+    }
+
+    auto promoted = no_piece_type;
+    if (auto equals = san.find('='); equals != std::string_view::npos && equals + 1 < san.size())
+    {
+        promoted = piece_from_letter(san[equals + 1]);
+        if (promoted == no_piece_type || promoted == king)
+        {
+            return no_move;
+        }
+        san = san.substr(0, equals);
+    }
+    else if (type == pawn && !san.empty() && san.back() >= 'A' && san.back() <= 'Z')
+    {
+        promoted = piece_from_letter(san.back());
+        san.remove_suffix(1);
+    }
+    if (san.size() < 2)
+    {
+        return no_move;
+    }
+
+    auto to_file = san[san.size() - 2] - 'a';
+    auto to_rank = san[san.size() - 1] - '1';
+    if (to_file < 0 || to_file > 7 || to_rank < 0 || to_rank > 7)
+    {
+        return no_move;
+    }
+    auto to = make_square(to_file, to_rank);
+
+    // disambiguation, captures and separators aside
+    int from_file = -1;
+    int from_rank = -1;
+    for (auto c : san.substr(0, san.size() - 2))
+    {
+        if (c >= 'a' && c <= 'h')
+        {
+            from_file = c - 'a';
+        }
+        else if (c >= '1' && c <= '8')
+        {
+            from_rank = c - '1';
+        }
+        else if (c != 'x' && c != ':' && c != '-')
+        {
+            return no_move;
+        }
+    }
+
+    auto found = no_move;
+    for (auto m : list)
+    {
+        if (m.to() != to || type_of(pos.piece_on(m.from())) != type ||
+            (from_file >= 0 && file_of(m.from()) != from_file) ||
+            (from_rank >= 0 && rank_of(m.from()) != from_rank) ||
+            m.is_promotion() != (promoted != no_piece_type) ||
+            (m.is_promotion() && m.promotion_type() != promoted))
+        {
+            continue;
+        }
+        if (found != no_move)
+        {
+            return no_move;
+        }
+        found = m;
+    }
+    return found;
+}
+
+std::string chess::to_san(position &pos, move m)
+{
+    auto san = std::string{};
+    auto from = m.from();
+    auto to = m.to();
+    auto type = type_of(pos.piece_on(from));
+
+    if (m.is_castling())
+    {
+        san = m.flags() == king_castle ? "O-O" : "O-O-O";
+    }
+    else if (type == pawn)
+    {
+        if (m.is_capture())
+        {
+            san += char('a' + file_of(from));
+            san += 'x';
+        }
+        san += square_name(to);
+        if (m.is_promotion())
+        {
+            san += '=';
+            san += "NBRQ"[m.promotion_type() - knight];
+        }
+    }
+    else
+    {
+        san += "PNBRQK"[type];
+
+        // other pieces of the type reaching the square
+        move_list list;
+        generate_legal(pos, list);
+        auto ambiguous = false;
+        auto same_file = false;
+        auto same_rank = false;
+        for (auto other : list)
+        {
+            if (other.to() == to && other.from() != from && type_of(pos.piece_on(other.from())) == type)
+            {
+                ambiguous = true;
+                same_file |= file_of(other.from()) == file_of(from);
+                same_rank |= rank_of(other.from()) == rank_of(from);
+            }
+        }
+        if (ambiguous && (!same_file || same_rank))
+        {
+            san += char('a' + file_of(from));
+        }
+        if (ambiguous && same_file)
+        {
+            san += char('1' + rank_of(from));
+        }
+
+        if (m.is_capture())
+        {
+            san += 'x';
+        }
+        san += square_name(to);
+    }
+
+    pos.make_move(m);
+    if (pos.in_check())
+    {
+        move_list replies;
+        generate_legal(pos, replies);
+        san += replies.empty() ? '#' : '+';
+    }
+    pos.unmake_move(m);
+    return san;
+}
+
+pgn_replay chess::replay_game(const pgn_game &game, position &pos, const pgn_move_callback &on_move)
+{
+    auto result = pgn_replay{};
+    auto fen = game.tag("FEN");
+    if (!pos.set_fen(fen.empty() ? position::start_fen : fen))
+    {
+        return result;
+    }
+
+    auto tokens = san_tokenizer{game.movetext};
+    auto san = std::string_view{};
+    while (tokens.next(san))
+    {
+        auto m = parse_san(pos, san);
+        if (m == no_move)
+        {
+            result.error = san;
+            return result;
+        }
+        if (on_move)
+        {
+            on_move(pos, m);
+        }
+        pos.make_move(m);
+        ++result.plies;
+    }
+
+    result.ok = true;
+    return result;
+}
+
+std::vector<std::string_view> chess::split_games(std::string_view text, std::size_t parts)
+{
+    parts = std::max<std::size_t>(parts, 1);
+
+    auto pieces = std::vector<std::string_view>{};
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i < parts; ++i)
+    {
+        auto target = text.size() / parts * i;
+        if (target <= begin)
+        {
+            continue;
+        }
+        auto boundary = find_game_start(text, target);
+        if (boundary >= text.size())
+        {
+            break;
+        }
+        pieces.push_back(text.substr(begin, boundary - begin));
+        begin = boundary;
+    }
+    pieces.push_back(text.substr(begin));
+    return pieces;
+}
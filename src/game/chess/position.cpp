@@ -0,0 +1,597 @@
+#include "game/chess/position.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <tuple>
+
+namespace
+{
+    using namespace chess;
+
+    constexpr std::string_view piece_chars = "PNBRQKpnbrqk";
+
+    // rights kept when a piece moves from or to a square
+    constexpr std::array<std::uint8_t, 64> make_castling_masks()
+    {
+        auto masks = std::array<std::uint8_t, 64>{};
+        for (auto &mask : masks)
+        {
+            mask = all_castling;
+        }
+        masks[make_square(4, 0)] &= ~(white_king_side | white_queen_side);
+        masks[make_square(7, 0)] &= ~white_king_side;
+        masks[make_square(0, 0)] &= ~white_queen_side;
+        masks[make_square(4, 7)] &= ~(black_king_side | black_queen_side);
+        masks[make_square(7, 7)] &= ~black_king_side;
+        masks[make_square(0, 7)] &= ~black_queen_side;
+        return masks;
+    }
+
+    constexpr auto castling_masks = make_castling_masks();
+
+    struct zobrist_keys
+    {
+        std::array<std::array<std::uint64_t, 64>, 12> pieces;
+        std::array<std::uint64_t, 16> castling;
+        std::array<std::uint64_t, 8> ep_file;
+        std::uint64_t side;
+    };
+
+    // fixed seed, keys are the same in every build so that hashes can be
+    // stored in books and game databases
+    constexpr zobrist_keys make_zobrist_keys()
+    {
+        auto keys = zobrist_keys{};
+        std::uint64_t state = 0x3243f6a8885a308dull;
+        auto next = [&state]()
+        {
+            // splitmix64
+            state += 0x9e3779b97f4a7c15ull;
+            auto z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        };
+
+        for (auto &squares : keys.pieces)
+        {
+            for (auto &key : squares)
+            {
+                key = next();
+            }
+        }
+        for (auto &key : keys.castling)
+        {
+            key = next();
+        }
+        for (auto &key : keys.ep_file)
+        {
+            key = next();
+        }
+        keys.side = next();
+        return keys;
+    }
+
+    constexpr auto zobrist = make_zobrist_keys();
+
+    std::uint64_t piece_key(piece p, square s)
+    {
+        return zobrist.pieces[p][s];
+    }
+
+    // the en passant square only matters when a pawn can capture
+    square capturable_ep_square(const position &pos, square ep, color us)
+    {
+        return pawn_attacks(~us, ep) & pos.pieces(us, pawn) ? ep : no_square;
+    }
+}
+
+position::position()
+{
+    init_attacks();
+    clear();
+    set_fen(start_fen);
+}
+
+void position::clear()
+{
+    m_board.fill(no_piece);
+    m_by_type.fill(0);
+    m_by_color.fill(0);
+    m_side = white;
+    m_fullmove = 1;
+    m_ply = 0;
+    m_states[0] = state_info{};
+}
+
+bool position::set_fen(std::string_view fen)
+{
+    auto parsed = *this;
+    parsed.clear();
+
+    auto fields = std::array<std::string_view, 6>{};
+    std::size_t count = 0;
+    while (!fen.empty() && count < fields.size())
+    {
+        auto begin = fen.find_first_not_of(' ');
+        if (begin == std::string_view::npos)
+        {
+            break;
+        }
+        fen.remove_prefix(begin);
+        auto end = std::min(fen.find(' '), fen.size());
+        fields[count++] = fen.substr(0, end);
+        fen.remove_prefix(end);
+    }
+    if (count < 4)
+    {
+        return false;
+    }
+
+    // placement, from a8 to h1
+    int file = 0;
+    int rank = 7;
+    for (auto c : fields[0])
+    {
+        if (c == '/')
+        {
+            if (file != 8 || rank == 0)
+            {
+                return false;
+            }
+            file = 0;
+            --rank;
+        }
+        else if (c >= '1' && c <= '8')
+        {
+            file += c - '0';
+        }
+        else if (auto index = piece_chars.find(c); index != std::string_view::npos && file < 8)
+        {
+            parsed.put_piece(piece(index), make_square(file++, rank));
+        }
+        else
+        {
+            return false;
+        }
+
+        if (file > 8)
+        {
+            return false;
+        }
+    }
+    if (rank != 0 || file != 8 ||
+        popcount(parsed.pieces(white, king)) != 1 || popcount(parsed.pieces(black, king)) != 1)
+    {
+        return false;
+    }
+
+    if (fields[1] != "w" && fields[1] != "b")
+    {
+        return false;
+    }
+    parsed.m_side = fields[1] == "w" ? white : black;
+
+    auto &st = parsed.m_states[0];
+    for (auto c : fields[2])
+    {
+        switch (c)
+        {
+        case 'K':
+            st.castling |= white_king_side;
+            break;
+        case 'Q':
+            st.castling |= white_queen_side;
+            break;
+        case 'k':
+            st.castling |= black_king_side;
+            break;
+        case 'q':
+            st.castling |= black_queen_side;
+            break;
+        case '-':
+            break;
+        default:
+            return false;
+        }
+    }
+
+    // rights without the king and rook in place are dropped
+    for (auto [right, king_sq, rook_sq, c] : {
+             std::tuple{white_king_side, make_square(4, 0), make_square(7, 0), white},
+             std::tuple{white_queen_side, make_square(4, 0), make_square(0, 0), white},
+             std::tuple{black_king_side, make_square(4, 7), make_square(7, 7), black},
+             std::tuple{black_queen_side, make_square(4, 7), make_square(0, 7), black},
+         })
+    {
+        if (parsed.m_board[king_sq] != make_piece(c, king) || parsed.m_board[rook_sq] != make_piece(c, rook))
+        {
+            st.castling &= ~right;
+        }
+    }
+
+    if (fields[3] != "-")
+    {
+        if (fields[3].size() != 2 ||
+            fields[3][0] < 'a' || fields[3][0] > 'h' ||
+            (fields[3][1] != '3' && fields[3][1] != '6'))
+        {
+            return false;
+        }
+        auto ep = make_square(fields[3][0] - 'a', fields[3][1] - '1');
+        st.ep_square = capturable_ep_square(parsed, ep, parsed.m_side);
+    }
+
+    if (count > 4)
+    {
+        st.halfmove_clock = std::max(std::atoi(std::string(fields[4]).c_str()), 0);
+    }
+    if (count > 5)
+    {
+        parsed.m_fullmove = std::max(std::atoi(std::string(fields[5]).c_str()), 1);
+    }
+
+    // the side which just moved cannot be in check
+    auto them = ~parsed.m_side;
+    if (parsed.attackers_to(parsed.king_square(them), parsed.pieces()) & parsed.pieces(parsed.m_side))
+    {
+        return false;
+    }
+    st.checkers = parsed.attackers_to(parsed.king_square(parsed.m_side), parsed.pieces()) & parsed.pieces(them);
+    st.key = parsed.compute_key();
+
+    *this = parsed;
+    return true;
+}
+
+std::string position::fen() const
+{
+    auto fen = std::string{};
+
+    for (int rank = 7; rank >= 0; --rank)
+    {
+        int empty = 0;
+        for (int file = 0; file < 8; ++file)
+        {
+            auto p = m_board[make_square(file, rank)];
+            if (p == no_piece)
+            {
+                ++empty;
+                continue;
+            }
+            if (empty > 0)
+            {
+                fen += char('0' + empty);
+                empty = 0;
+            }
+            fen += piece_chars[p];
+        }
+        if (empty > 0)
+        {
+            fen += char('0' + empty);
+        }
+        if (rank > 0)
+        {
+            fen += '/';
+        }
+    }
+
+    fen += m_side == white ? " w " : " b ";
+
+    auto castling = castling_rights();
+    if (castling == no_castling)
+    {
+        fen += '-';
+    }
+    if (castling & white_king_side)
+    {
+        fen += 'K';
+    }
+    if (castling & white_queen_side)
+    {
+        fen += 'Q';
+    }
+    if (castling & black_king_side)
+    {
+        fen += 'k';
+    }
+    if (castling & black_queen_side)
+    {
+        fen += 'q';
+    }
+
+    fen += ' ';
+    fen += ep_square() == no_square ? "-" : square_name(ep_square());
+    fen += ' ' + std::to_string(halfmove_clock()) + ' ' + std::to_string(m_fullmove);
+
+    return fen;
+}
+
+std::uint64_t position::compute_key() const
+{
+    auto key = std::uint64_t{0};
+
+    for (square s = 0; s < 64; ++s)
+    {
+        if (m_board[s] != no_piece)
+        {
+            key ^= piece_key(m_board[s], s);
+        }
+    }
+    key ^= zobrist.castling[castling_rights()];
+    if (ep_square() != no_square)
+    {
+        key ^= zobrist.ep_file[file_of(ep_square())];
+    }
+    if (m_side == black)
+    {
+        key ^= zobrist.side;
+    }
+
+    return key;
+}
+
+bool position::is_draw() const
+{
+    const auto &st = state();
+    if (st.halfmove_clock >= 100)
+    {
+        return true;
+    }
+
+    // same side to move, every second ply back to the last irreversible move
+    auto end = std::min({st.halfmove_clock, st.plies_from_null, m_ply});
+    for (int i = 4; i <= end; i += 2)
+    {
+        if (m_states[m_ply - i].key == st.key)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool position::has_non_pawn_material(color c) const
+{
+    return (pieces(c) & ~pieces(pawn) & ~pieces(king)) != 0;
+}
+
+bitboard position::attackers_to(square s, bitboard occupied) const
+{
+    return (pawn_attacks(black, s) & pieces(white, pawn)) |
+           (pawn_attacks(white, s) & pieces(black, pawn)) |
+           (knight_attacks(s) & m_by_type[knight]) |
+           (king_attacks(s) & m_by_type[king]) |
+           (bishop_attacks(s, occupied) & (m_by_type[bishop] | m_by_type[queen])) |
+           (rook_attacks(s, occupied) & (m_by_type[rook] | m_by_type[queen]));
+}
+
+void position::put_piece(piece p, square s)
+{
+    m_board[s] = p;
+    m_by_type[type_of(p)] |= square_bb(s);
+    m_by_color[color_of(p)] |= square_bb(s);
+}
+
+void position::remove_piece(square s)
+{
+    auto p = m_board[s];
+    m_by_type[type_of(p)] ^= square_bb(s);
+    m_by_color[color_of(p)] ^= square_bb(s);
+    m_board[s] = no_piece;
+}
+
+void position::move_piece(square from, square to)
+{
+    auto p = m_board[from];
+    auto from_to = square_bb(from) | square_bb(to);
+    m_by_type[type_of(p)] ^= from_to;
+    m_by_color[color_of(p)] ^= from_to;
+    m_board[from] = no_piece;
+    m_board[to] = p;
+}
+
+state_info &position::push_state()
+{
+    if (m_ply + 1 == max_ply)
+    {
+        // drop the oldest states, the recent ones are enough to unmake the
+        // search moves and to detect repetitions
+        std::copy(m_states.end() - keep_ply, m_states.end(), m_states.begin());
+        m_ply = keep_ply - 1;
+    }
+
+    m_states[m_ply + 1] = m_states[m_ply];
+    return m_states[++m_ply];
+}
+
+void position::make_move(move m)
+{
+    auto &st = push_state();
+    auto us = m_side;
+    auto them = ~us;
+    auto from = m.from();
+    auto to = m.to();
+    auto moved = m_board[from];
+
+    st.key ^= zobrist.side ^ zobrist.castling[st.castling];
+    if (st.ep_square != no_square)
+    {
+        st.key ^= zobrist.ep_file[file_of(st.ep_square)];
+    }
+
+    st.ep_square = no_square;
+    st.captured = no_piece;
+    ++st.halfmove_clock;
+    ++st.plies_from_null;
+
+    auto &dirty = st.dirty;
+    dirty.count = 1;
+    dirty.pieces[0] = moved;
+    dirty.from[0] = from;
+    dirty.to[0] = to;
+
+    if (m.is_castling())
+    {
+        auto king_side = m.flags() == king_castle;
+        auto rook_from = relative_square(us, king_side ? make_square(7, 0) : make_square(0, 0));
+        auto rook_to = relative_square(us, king_side ? make_square(5, 0) : make_square(3, 0));
+        auto rook_piece = make_piece(us, rook);
+
+        move_piece(from, to);
+        move_piece(rook_from, rook_to);
+        dirty.count = 2;
+        dirty.pieces[1] = rook_piece;
+        dirty.from[1] = rook_from;
+        dirty.to[1] = rook_to;
+        st.key ^= piece_key(moved, from) ^ piece_key(moved, to) ^
+                  piece_key(rook_piece, rook_from) ^ piece_key(rook_piece, rook_to);
+    }
+    else
+    {
+        if (m.flags() == en_passant)
+        {
+            auto captured_sq = to ^ 8;
+            st.captured = m_board[captured_sq];
+            st.key ^= piece_key(st.captured, captured_sq);
+            remove_piece(captured_sq);
+            dirty.count = 2;
+            dirty.pieces[1] = st.captured;
+            dirty.from[1] = captured_sq;
+            dirty.to[1] = no_square;
+        }
+        else if (m.is_capture())
+        {
+            st.captured = m_board[to];
+            st.key ^= piece_key(st.captured, to);
+            remove_piece(to);
+            dirty.count = 2;
+            dirty.pieces[1] = st.captured;
+            dirty.from[1] = to;
+            dirty.to[1] = no_square;
+        }
+
+        move_piece(from, to);
+        st.key ^= piece_key(moved, from) ^ piece_key(moved, to);
+
+        if (m.is_promotion())
+        {
+            auto promoted = make_piece(us, m.promotion_type());
+            remove_piece(to);
+            put_piece(promoted, to);
+            st.key ^= piece_key(moved, to) ^ piece_key(promoted, to);
+
+            // the pawn leaves the board, the promoted piece enters it
+            dirty.to[0] = no_square;
+            dirty.pieces[dirty.count] = promoted;
+            dirty.from[dirty.count] = no_square;
+            dirty.to[dirty.count] = to;
+            ++dirty.count;
+        }
+
+        if (type_of(moved) == pawn || st.captured != no_piece)
+        {
+            st.halfmove_clock = 0;
+        }
+
+        if (m.flags() == double_push)
+        {
+            st.ep_square = capturable_ep_square(*this, (from + to) / 2, them);
+            if (st.ep_square != no_square)
+            {
+                st.key ^= zobrist.ep_file[file_of(st.ep_square)];
+            }
+        }
+    }
+
+    st.castling &= castling_masks[from] & castling_masks[to];
+    st.key ^= zobrist.castling[st.castling];
+
+    if (us == black)
+    {
+        ++m_fullmove;
+    }
+    m_side = them;
+
+    st.checkers = attackers_to(king_square(them), pieces()) & pieces(us);
+}
+
+void position::unmake_move(move m)
+{
+    const auto &st = m_states[m_ply];
+    m_side = ~m_side;
+    auto us = m_side;
+    auto from = m.from();
+    auto to = m.to();
+
+    if (m.is_castling())
+    {
+        auto king_side = m.flags() == king_castle;
+        auto rook_from = relative_square(us, king_side ? make_square(7, 0) : make_square(0, 0));
+        auto rook_to = relative_square(us, king_side ? make_square(5, 0) : make_square(3, 0));
+
+        move_piece(to, from);
+        move_piece(rook_to, rook_from);
+    }
+    else
+    {
+        if (m.is_promotion())
+        {
+            remove_piece(to);
+            put_piece(make_piece(us, pawn), to);
+        }
+
+        move_piece(to, from);
+
+        if (st.captured != no_piece)
+        {
+            put_piece(st.captured, m.flags() == en_passant ? to ^ 8 : to);
+        }
+    }
+
+    if (us == black)
+    {
+        --m_fullmove;
+    }
+    --m_ply;
+}
+
+void position::make_null_move()
+{
+    auto &st = push_state();
+
+    st.key ^= zobrist.side;
+    if (st.ep_square != no_square)
+    {
+        st.key ^= zobrist.ep_file[file_of(st.ep_square)];
+        st.ep_square = no_square;
+    }
+    st.captured = no_piece;
+    st.checkers = 0;
+    ++st.halfmove_clock;
+    st.plies_from_null = 0;
+    st.dirty.count = 0;
+
+    m_side = ~m_side;
+}
+
+void position::unmake_null_move()
+{
+    m_side = ~m_side;
+    --m_ply;
+}
+
+std::string chess::square_name(square s)
+{
+    return std::string{char('a' + file_of(s)), char('1' + rank_of(s))};
+}
+
+std::string chess::to_uci(move m)
+{
+    auto uci = square_name(m.from()) + square_name(m.to());
+    if (m.is_promotion())
+    {
+        uci += "nbrq"[m.promotion_type() - knight];
+    }
+    return uci;
+}
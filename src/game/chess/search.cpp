@@ -0,0 +1,843 @@
+#include "game/chess/search.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "game/chess/eval.hpp"
+#include "game/chess/nnue.hpp"
+#include "game/chess/tablebase.hpp"
+
+namespace chess::internal
+{
+    struct search_thread
+    {
+        search_engine &engine;
+        int id;
+        position pos;
+        // written by this thread only, read by the main thread for limits
+        // and reports
+        std::atomic<std::uint64_t> nodes{0};
+        std::atomic<std::uint64_t> tbhits{0};
+        int seldepth{0};
+
+        std::array<std::array<move, 2>, max_search_ply + 1> killers;
+        // [side][from][to], kept between searches and decayed
+        std::array<std::array<std::array<int, 64>, 64>, 2> history;
+
+        // triangular principal variation table
+        std::array<std::array<move, max_search_ply + 1>, max_search_ply + 1> pv;
+        std::array<int, max_search_ply + 1> pv_length;
+
+        int completed_depth{0};
+        int best_score{0};
+        std::vector<move> root_pv;
+
+        nnue::evaluator nnue;
+
+        search_thread(search_engine &engine, int id) : engine{engine}, id{id} { clear(); };
+
+        void clear();
+        void count_node();
+        // the moves keep the evaluator in step with the position
+        void make_move(move m);
+        void unmake_move(move m);
+        void make_null_move();
+        void unmake_null_move();
+        int evaluate();
+        int search(int alpha, int beta, int depth, int ply, bool null_allowed);
+        int qsearch(int alpha, int beta, int ply);
+        void score_moves(const move_list &list, std::array<int, max_moves> &scores, move tt_move, int ply) const;
+        void update_quiet_stats(move best, const move *tried, int tried_count, int depth, int ply);
+    };
+}
+
+namespace
+{
+    using namespace chess;
+    using internal::search_thread;
+
+    constexpr int history_max = 16384;
+
+    // late move reductions by depth and move number
+    struct reduction_table
+    {
+        std::array<std::array<int, 64>, 64> values;
+
+        reduction_table()
+        {
+            for (int depth = 0; depth < 64; ++depth)
+            {
+                for (int moves = 0; moves < 64; ++moves)
+                {
+                    values[depth][moves] = depth == 0 || moves == 0
+                                               ? 0
+                                               : int(0.75 + std::log(double(depth)) * std::log(double(moves)) / 2.25);
+                }
+            }
+        }
+
+        int operator()(int depth, int moves) const
+        {
+            return values[std::min(depth, 63)][std::min(moves, 63)];
+        }
+    };
+
+    const reduction_table reductions;
+
+    // helper threads skip depths in a staggered pattern, not every thread
+    // searches the same depth at the same time
+    constexpr int skip_size[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+    constexpr int skip_phase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+    // mate scores are stored relative to the node, not the root
+    int score_to_tt(int score, int ply)
+    {
+        return score >= mate_bound ? score + ply : score <= -mate_bound ? score - ply
+                                                                       : score;
+    }
+
+    int score_from_tt(int score, int ply)
+    {
+        return score >= mate_bound ? score - ply : score <= -mate_bound ? score + ply
+                                                                       : score;
+    }
+
+    bool is_quiet(move m)
+    {
+        return !m.is_capture() && !m.is_promotion();
+    }
+
+    // moves the best remaining move to `index`
+    move pick_move(move_list &list, std::array<int, max_moves> &scores, std::size_t index)
+    {
+        auto best = index;
+        for (auto i = index + 1; i < list.size(); ++i)
+        {
+            if (scores[i] > scores[best])
+            {
+                best = i;
+            }
+        }
+        std::swap(list.moves[index], list.moves[best]);
+        std::swap(scores[index], scores[best]);
+        return list.moves[index];
+    }
+}
+
+void search_thread::clear()
+{
+    for (auto &k : killers)
+    {
+        k.fill(no_move);
+    }
+    for (auto &side : history)
+    {
+        for (auto &from : side)
+        {
+            from.fill(0);
+        }
+    }
+}
+
+void search_thread::count_node()
+{
+    auto count = nodes.load(std::memory_order_relaxed) + 1;
+    nodes.store(count, std::memory_order_relaxed);
+
+    // the clock is polled, a node budget is checked on every node of every
+    // thread: the search stops at the budget, even one below the interval
+    if (engine.out_of_nodes() || (id == 0 && (count & 2047) == 0 && engine.out_of_time(*this)))
+    {
+        engine.stop();
+    }
+}
+
+void search_thread::make_move(move m)
+{
+    pos.make_move(m);
+    nnue.push(pos);
+}
+
+void search_thread::unmake_move(move m)
+{
+    pos.unmake_move(m);
+    nnue.pop();
+}
+
+void search_thread::make_null_move()
+{
+    pos.make_null_move();
+    nnue.push(pos);
+}
+
+void search_thread::unmake_null_move()
+{
+    pos.unmake_null_move();
+    nnue.pop();
+}
+
+int search_thread::evaluate()
+{
+    return nnue::enabled() && engine.m_limits.nnue ? nnue.evaluate(pos) : chess::evaluate(pos);
+}
+
+void search_thread::score_moves(const move_list &list, std::array<int, max_moves> &scores, move tt_move, int ply) const
+{
+    auto side = pos.side_to_move();
+
+    for (std::size_t i = 0; i < list.size(); ++i)
+    {
+        auto m = list[i];
+        if (m == tt_move)
+        {
+            scores[i] = 1'000'000;
+        }
+        else if (m.is_capture())
+        {
+            // most valuable victim, least valuable attacker
+            auto victim = m.flags() == en_passant ? pawn : type_of(pos.piece_on(m.to()));
+            scores[i] = 100'000 + piece_value(victim) * 8 - type_of(pos.piece_on(m.from()));
+            if (m.is_promotion())
+            {
+                scores[i] += piece_value(m.promotion_type());
+            }
+        }
+        else if (m.is_promotion())
+        {
+            scores[i] = 90'000 + piece_value(m.promotion_type());
+        }
+        else if (m == killers[ply][0])
+        {
+            scores[i] = 80'000;
+        }
+        else if (m == killers[ply][1])
+        {
+            scores[i] = 79'000;
+        }
+        else
+        {
+            scores[i] = history[side][m.from()][m.to()];
+        }
+    }
+}
+
+void search_thread::update_quiet_stats(move best, const move *tried, int tried_count, int depth, int ply)
+{
+    if (killers[ply][0] != best)
+    {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = best;
+    }
+
+    // history gravity: the bonus shrinks as a counter nears the bound
+    auto side = pos.side_to_move();
+    auto bonus = std::min(depth * depth, 1200);
+    auto update = [&](move m, int delta)
+    {
+        auto &h = history[side][m.from()][m.to()];
+        h += delta - h * std::abs(delta) / history_max;
+    };
+
+    update(best, bonus);
+    for (int i = 0; i < tried_count; ++i)
+    {
+        update(tried[i], -bonus);
+    }
+}
+
+int search_thread::search(int alpha, int beta, int depth, int ply, bool null_allowed)
+{
+    auto pv_node = beta - alpha > 1;
+    pv_length[ply] = ply;
+
+    if (depth <= 0)
+    {
+        return qsearch(alpha, beta, ply);
+    }
+
+    count_node();
+    if (engine.stopping())
+    {
+        return 0;
+    }
+    seldepth = std::max(seldepth, ply);
+
+    auto in_check = pos.in_check();
+    if (ply > 0)
+    {
+        if (pos.is_draw())
+        {
+            return 0;
+        }
+        if (ply >= max_search_ply)
+        {
+            return in_check ? 0 : evaluate();
+        }
+
+        // no line can beat a mate found closer to the root
+        alpha = std::max(alpha, -mate_score + ply);
+        beta = std::min(beta, mate_score - ply - 1);
+        if (alpha >= beta)
+        {
+            return alpha;
+        }
+
+        // exact below the root, a fraction of a microsecond once the block
+        // is cached
+        auto value = tb::wdl::draw;
+        if (popcount(pos.pieces()) <= tb::largest() && tb::probe_wdl(pos, value))
+        {
+            tbhits.store(tbhits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return value == tb::wdl::win ? tablebase_score - ply : value == tb::wdl::loss ? -tablebase_score + ply
+                                                                                           : 0;
+        }
+    }
+
+    auto key = pos.key();
+    auto &tt = engine.m_tt;
+    auto entry = tt_entry{};
+    auto tt_hit = tt.probe(key, entry);
+    auto tt_move = tt_hit ? entry.best : no_move;
+
+    if (tt_hit && !pv_node && entry.depth >= depth)
+    {
+        auto score = score_from_tt(entry.score, ply);
+        if (entry.bound == tt_bound::exact ||
+            (entry.bound == tt_bound::lower && score >= beta) ||
+            (entry.bound == tt_bound::upper && score <= alpha))
+        {
+            return score;
+        }
+    }
+
+    auto static_eval = in_check ? -infinite_score : tt_hit ? entry.eval
+                                                           : evaluate();
+
+    // null move: if passing still fails high, a real move surely does.
+    // Unsafe in zugzwang, hence not in pawn endgames
+    if (!pv_node && !in_check && null_allowed && depth >= 3 && static_eval >= beta &&
+        pos.has_non_pawn_material(pos.side_to_move()))
+    {
+        auto r = 3 + depth / 6;
+
+        make_null_move();
+        auto score = -search(-beta, -beta + 1, depth - 1 - r, ply + 1, false);
+        unmake_null_move();
+
+        if (engine.stopping())
+        {
+            return 0;
+        }
+        if (score >= beta)
+        {
+            return is_mate_score(score) ? beta : score;
+        }
+    }
+
+    // check extension
+    if (in_check)
+    {
+        ++depth;
+    }
+
+    move_list list;
+    generate_legal(pos, list);
+    if (list.empty())
+    {
+        return in_check ? -mate_score + ply : 0;
+    }
+
+    std::array<int, max_moves> scores;
+    score_moves(list, scores, tt_move, ply);
+
+    // quiet moves searched before a cutoff, their history is lowered
+    std::array<move, 64> quiets_tried;
+    int quiets_count = 0;
+
+    auto original_alpha = alpha;
+    auto best_score = -infinite_score;
+    auto best_move = no_move;
+    int searched = 0;
+
+    for (std::size_t i = 0; i < list.size(); ++i)
+    {
+        auto m = pick_move(list, scores, i);
+        auto quiet = is_quiet(m);
+
+        make_move(m);
+        auto gives_check = pos.in_check();
+        auto new_depth = depth - 1;
+        int score;
+
+        if (searched == 0)
+        {
+            score = -search(-beta, -alpha, new_depth, ply + 1, true);
+        }
+        else
+        {
+            // late quiet moves are searched shallower first, and again at
+            // full depth if they beat alpha
+            auto r = 0;
+            if (depth >= 3 && searched >= 3 && quiet && !in_check && !gives_check)
+            {
+                r = reductions(depth, searched);
+                r -= pv_node ? 1 : 0;
+                r -= m == killers[ply][0] || m == killers[ply][1] ? 1 : 0;
+                r = std::clamp(r, 0, new_depth - 1);
+            }
+
+            score = -search(-alpha - 1, -alpha, new_depth - r, ply + 1, true);
+            if (score > alpha && r > 0)
+            {
+                score = -search(-alpha - 1, -alpha, new_depth, ply + 1, true);
+            }
+            if (score > alpha && score < beta)
+            {
+                score = -search(-beta, -alpha, new_depth, ply + 1, true);
+            }
+        }
+
+        unmake_move(m);
+        ++searched;
+
+        if (engine.stopping())
+        {
+            return 0;
+        }
+
+        if (score > best_score)
+        {
+            best_score = score;
+
+            if (score > alpha)
+            {
+                best_move = m;
+                alpha = score;
+
+                pv[ply][ply] = m;
+                for (auto next = ply + 1; next < pv_length[ply + 1]; ++next)
+                {
+                    pv[ply][next] = pv[ply + 1][next];
+                }
+                pv_length[ply] = std::max(pv_length[ply + 1], ply + 1);
+
+                if (alpha >= beta)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (quiet && m != best_move && quiets_count < int(quiets_tried.size()))
+        {
+            quiets_tried[quiets_count++] = m;
+        }
+    }
+
+    if (best_score >= beta && is_quiet(best_move))
+    {
+        update_quiet_stats(best_move, quiets_tried.data(), quiets_count, depth, ply);
+    }
+
+    auto bound = best_score >= beta ? tt_bound::lower : best_score > original_alpha ? tt_bound::exact
+                                                                                     : tt_bound::upper;
+    tt.store(key, best_move, score_to_tt(best_score, ply), in_check ? 0 : static_eval, depth, bound);
+
+    return best_score;
+}
+
+int search_thread::qsearch(int alpha, int beta, int ply)
+{
+    pv_length[ply] = ply;
+
+    count_node();
+    if (engine.stopping())
+    {
+        return 0;
+    }
+    seldepth = std::max(seldepth, ply);
+
+    auto in_check = pos.in_check();
+    if (ply >= max_search_ply)
+    {
+        return in_check ? 0 : evaluate();
+    }
+
+    // stand pat, a side not in check can decline every capture
+    auto best_score = -infinite_score;
+    if (!in_check)
+    {
+        best_score = evaluate();
+        if (best_score >= beta)
+        {
+            return best_score;
+        }
+        alpha = std::max(alpha, best_score);
+    }
+
+    move_list list;
+    generate_legal(pos, list);
+    if (list.empty() && in_check)
+    {
+        return -mate_score + ply;
+    }
+
+    // every evasion in check, captures and promotions otherwise
+    if (!in_check)
+    {
+        auto kept = std::size_t{0};
+        for (auto m : list)
+        {
+            if (!is_quiet(m))
+            {
+                list.moves[kept++] = m;
+            }
+        }
+        list.count = kept;
+    }
+
+    std::array<int, max_moves> scores;
+    score_moves(list, scores, no_move, ply);
+
+    for (std::size_t i = 0; i < list.size(); ++i)
+    {
+        auto m = pick_move(list, scores, i);
+
+        make_move(m);
+        auto score = -qsearch(-beta, -alpha, ply + 1);
+        unmake_move(m);
+
+        if (engine.stopping())
+        {
+            return 0;
+        }
+
+        if (score > best_score)
+        {
+            best_score = score;
+            if (score > alpha)
+            {
+                alpha = score;
+                if (alpha >= beta)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return best_score;
+}
+
+search_engine::search_engine()
+{
+    set_threads(1);
+}
+
+search_engine::~search_engine() = default;
+
+void search_engine::set_threads(int count)
+{
+    count = std::max(count, 1);
+    m_threads.resize(std::size_t(count));
+    for (int i = 0; i < count; ++i)
+    {
+        if (!m_threads[i])
+        {
+            m_threads[i] = std::make_unique<internal::search_thread>(*this, i);
+        }
+    }
+}
+
+void search_engine::set_hash_size(std::size_t mb)
+{
+    m_tt.resize(mb);
+}
+
+void search_engine::clear()
+{
+    m_tt.clear();
+    for (auto &thread : m_threads)
+    {
+        thread->clear();
+    }
+}
+
+void search_engine::stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+}
+
+std::uint64_t search_engine::nodes() const
+{
+    std::uint64_t total = 0;
+    for (const auto &thread : m_threads)
+    {
+        total += thread->nodes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::uint64_t search_engine::tbhits() const
+{
+    std::uint64_t total = 0;
+    for (const auto &thread : m_threads)
+    {
+        total += thread->tbhits.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void search_engine::ponderhit()
+{
+    m_limits_start.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    m_pondering.store(false, std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::duration search_engine::limits_elapsed() const
+{
+    auto start = std::chrono::steady_clock::duration{m_limits_start.load(std::memory_order_relaxed)};
+    return std::chrono::steady_clock::now().time_since_epoch() - start;
+}
+
+bool search_engine::out_of_time(const internal::search_thread &) const
+{
+    if (pondering())
+    {
+        return false;
+    }
+    if (m_limits.movetime.count() > 0 && limits_elapsed() >= m_limits.movetime)
+    {
+        return true;
+    }
+    return out_of_nodes();
+}
+
+bool search_engine::out_of_nodes() const
+{
+    return m_limits.nodes != 0 && !pondering() && nodes() >= m_limits.nodes;
+}
+
+void search_engine::iterate(internal::search_thread &thread, const search_callback &on_depth)
+{
+    auto main = thread.id == 0;
+    auto score = 0;
+
+    for (int depth = 1; depth <= std::min(m_limits.depth, max_search_ply - 1); ++depth)
+    {
+        if (!main)
+        {
+            auto i = (thread.id - 1) % 20;
+            if (((depth + skip_phase[i]) / skip_size[i]) % 2 != 0)
+            {
+                continue;
+            }
+        }
+
+        thread.seldepth = 0;
+
+        // aspiration window around the last score, widened on a fail
+        auto window = 25;
+        auto alpha = -infinite_score;
+        auto beta = infinite_score;
+        if (depth >= 5)
+        {
+            alpha = std::max(score - window, -infinite_score);
+            beta = std::min(score + window, infinite_score);
+        }
+
+        while (true)
+        {
+            score = thread.search(alpha, beta, depth, 0, false);
+            if (stopping())
+            {
+                break;
+            }
+
+            if (score <= alpha)
+            {
+                beta = (alpha + beta) / 2;
+                alpha = std::max(score - window, -infinite_score);
+            }
+            else if (score >= beta)
+            {
+                beta = std::min(score + window, infinite_score);
+            }
+            else
+            {
+                break;
+            }
+            window += window;
+        }
+
+        if (stopping())
+        {
+            break;
+        }
+
+        thread.completed_depth = depth;
+        thread.best_score = score;
+        thread.root_pv.assign(thread.pv[0].begin(), thread.pv[0].begin() + thread.pv_length[0]);
+
+        if (!main)
+        {
+            continue;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start);
+        if (on_depth)
+        {
+            auto info = search_info{
+                .depth = depth,
+                .seldepth = thread.seldepth,
+                .score = score,
+                .nodes = nodes(),
+                .time = elapsed,
+                .nps = nodes() * 1000 / std::uint64_t(std::max<std::int64_t>(elapsed.count(), 1)),
+                .hashfull = m_tt.hashfull(),
+                .tbhits = tbhits(),
+                .pv = thread.root_pv,
+            };
+            on_depth(info);
+        }
+
+        // the next depth takes longer than every previous one together
+        if (!pondering() && m_limits.movetime.count() > 0 && limits_elapsed() * 2 >= m_limits.movetime)
+        {
+            break;
+        }
+    }
+
+    if (main)
+    {
+        // a pondering search reports only once the opponent has moved
+        while (pondering() && !stopping())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        stop();
+    }
+}
+
+bool search_engine::tablebase_move(position &pos, const search_callback &on_depth, search_result &result)
+{
+    if (popcount(pos.pieces()) > tb::largest())
+    {
+        return false;
+    }
+    auto probed = tb::probe_result{};
+    auto best = tb::best_move(pos, probed);
+    if (best == no_move)
+    {
+        return false;
+    }
+
+    auto score = probed.value == tb::wdl::win ? tablebase_score - probed.distance : probed.value == tb::wdl::loss ? -tablebase_score + probed.distance
+                                                                                                                  : 0;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start);
+    if (on_depth)
+    {
+        on_depth(search_info{
+            .depth = 1,
+            .seldepth = 1,
+            .score = score,
+            .time = elapsed,
+            .hashfull = m_tt.hashfull(),
+            .tbhits = 1,
+            .pv = {best},
+        });
+    }
+    result = search_result{
+        .best = best,
+        .score = score,
+        .depth = 1,
+        .time = elapsed,
+        .from_tablebase = true,
+    };
+    return true;
+}
+
+search_result search_engine::search(const position &pos, const search_limits &limits, const search_callback &on_depth)
+{
+    m_stop.store(false, std::memory_order_relaxed);
+    m_limits = limits;
+    m_start = std::chrono::steady_clock::now();
+    m_limits_start.store(m_start.time_since_epoch().count(), std::memory_order_relaxed);
+    m_pondering.store(limits.ponder, std::memory_order_relaxed);
+    m_tt.new_search();
+
+    for (auto &thread : m_threads)
+    {
+        thread->pos = pos;
+        thread->nnue.reset(pos);
+        thread->nodes.store(0, std::memory_order_relaxed);
+        thread->tbhits.store(0, std::memory_order_relaxed);
+        thread->completed_depth = 0;
+        thread->best_score = 0;
+        thread->root_pv.clear();
+        for (auto &k : thread->killers)
+        {
+            k.fill(no_move);
+        }
+        // older searches saw other positions, trust their history less
+        for (auto &side : thread->history)
+        {
+            for (auto &from : side)
+            {
+                for (auto &h : from)
+                {
+                    h /= 2;
+                }
+            }
+        }
+    }
+
+    auto result = search_result{};
+    if (limits.tablebase && !limits.ponder && tablebase_move(m_threads[0]->pos, on_depth, result))
+    {
+        return result;
+    }
+
+    auto helpers = std::vector<std::thread>{};
+    for (std::size_t i = 1; i < m_threads.size(); ++i)
+    {
+        helpers.emplace_back([this, i]()
+                             { iterate(*m_threads[i], {}); });
+    }
+    iterate(*m_threads[0], on_depth);
+    for (auto &helper : helpers)
+    {
+        helper.join();
+    }
+
+    // a helper which completed a deeper iteration has the better move
+    const auto *best = m_threads[0].get();
+    for (const auto &thread : m_threads)
+    {
+        if (thread->completed_depth > best->completed_depth && !thread->root_pv.empty())
+        {
+            best = thread.get();
+        }
+    }
+
+    result = search_result{
+        .score = best->best_score,
+        .depth = best->completed_depth,
+        .nodes = nodes(),
+        .time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start),
+    };
+    if (!best->root_pv.empty())
+    {
+        result.best = best->root_pv[0];
+        result.ponder = best->root_pv.size() > 1 ? best->root_pv[1] : no_move;
+    }
+    else
+    {
+        // stopped before the first depth completed
+        move_list list;
+        generate_legal(pos, list);
+        result.best = list.empty() ? no_move : list[0];
+    }
+
+    return result;
+}
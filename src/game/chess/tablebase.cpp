@@ -0,0 +1,1472 @@
+#include "game/chess/tablebase.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "game/chess/lz.hpp"
+#include "game/chess/mapped_file.hpp"
+#include "game/chess/movegen.hpp"
+
+// the files are little-endian, like every platform the engine runs on
+
+namespace
+{
+    using namespace chess;
+    using namespace chess::tb;
+
+    struct file_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        // 2 for the results, 8 or 16 for the distances
+        std::uint32_t bits;
+        std::uint64_t entries;
+        std::uint32_t block_size;
+        std::uint32_t blocks;
+        std::uint32_t max_distance;
+        char material[16];
+        std::uint8_t reserved[12];
+    };
+    static_assert(sizeof(file_header) == 64);
+
+    constexpr char file_magic[8] = {'c', 'p', 'p', 't', 'b', '\0', '\0', '\0'};
+    constexpr std::uint32_t file_version = 1;
+    constexpr std::uint32_t block_size = 4 * 1024;
+
+    constexpr std::string_view results_extension = ".ctw";
+    constexpr std::string_view distances_extension = ".ctz";
+
+    // 2-bit codes of the results file
+    enum : std::uint8_t
+    {
+        code_draw,
+        code_win,
+        code_loss,
+        code_illegal,
+    };
+
+    // piece values ordering the sides of a material, the stronger is white
+    constexpr int material_values[5] = {1, 3, 3, 5, 9};
+    constexpr char piece_letters[] = "PNBRQK";
+
+    // material
+
+    // the count of each piece type but the king, 4 bits each
+    using side_key = std::uint32_t;
+
+    constexpr std::uint64_t table_key(side_key white_side, side_key black_side)
+    {
+        return white_side | (std::uint64_t(black_side) << 20);
+    }
+
+    // pieces of a table in the order of its index: the white king, the
+    // black king, then the white and black pieces from the queens down
+    struct layout
+    {
+        std::string name;
+        std::array<piece, max_pieces> slots;
+        int count{0};
+        bool pawns{false};
+        // squares of the white king, reduced by symmetry
+        int kings{0};
+        std::uint64_t entries{0};
+        std::uint64_t key{0};
+    };
+
+    // a1-d1-d4 triangle, and files a to d with pawns
+    constexpr std::array<square, 10> triangle = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+    int king_index(const layout &shape, square s)
+    {
+        if (shape.pawns)
+        {
+            return rank_of(s) * 4 + file_of(s);
+        }
+        return int(std::find(triangle.begin(), triangle.end(), s) - triangle.begin());
+    }
+
+    square king_square(const layout &shape, int index)
+    {
+        return shape.pawns ? make_square(index % 4, index / 4) : triangle[std::size_t(index)];
+    }
+
+    bool parse_material(std::string_view material, layout &shape)
+    {
+        auto split = material.find('v');
+        if (split == std::string_view::npos || material.size() < 4 || material[0] != 'K' ||
+            split + 1 >= material.size() || material[split + 1] != 'K')
+        {
+            return false;
+        }
+
+        shape = layout{};
+        side_key keys[2] = {0, 0};
+        std::array<std::array<int, 5>, 2> counts{};
+        for (auto c : {white, black})
+        {
+            auto side = c == white ? material.substr(1, split - 1) : material.substr(split + 2);
+            for (auto letter : side)
+            {
+                const auto *found = std::strchr(piece_letters, letter);
+                if (letter == '\0' || found == nullptr || found - piece_letters >= king)
+                {
+                    return false;
+                }
+                ++counts[c][found - piece_letters];
+            }
+        }
+
+        shape.slots[0] = white_king;
+        shape.slots[1] = black_king;
+        shape.count = 2;
+        for (auto c : {white, black})
+        {
+            shape.name += 'K';
+            for (int type = queen; type >= pawn; --type)
+            {
+                for (int i = 0; i < counts[c][type]; ++i)
+                {
+                    if (shape.count == max_pieces)
+                    {
+                        return false;
+                    }
+                    shape.slots[shape.count++] = make_piece(c, piece_type(type));
+                    shape.name += piece_letters[type];
+                }
+                keys[c] |= side_key(counts[c][type]) << (type * 4);
+            }
+            shape.name += c == white ? "v" : "";
+        }
+        if (shape.count < 3)
+        {
+            return false;
+        }
+
+        shape.pawns = counts[white][pawn] + counts[black][pawn] > 0;
+        shape.kings = shape.pawns ? 32 : 10;
+        shape.entries = 2 * std::uint64_t(shape.kings);
+        for (int i = 1; i < shape.count; ++i)
+        {
+            shape.entries *= 64;
+        }
+        shape.key = table_key(keys[white], keys[black]);
+        return true;
+    }
+
+    // indices
+
+    using squares = std::array<square, max_pieces>;
+
+    // bit 0 mirrors the files, bit 1 the ranks, bit 2 swaps files and ranks
+    square transform(square s, int symmetry)
+    {
+        if (symmetry & 1)
+        {
+            s ^= 7;
+        }
+        if (symmetry & 2)
+        {
+            s ^= 56;
+        }
+        if (symmetry & 4)
+        {
+            s = make_square(rank_of(s), file_of(s));
+        }
+        return s;
+    }
+
+    std::uint64_t encode(const layout &shape, const squares &board, color side)
+    {
+        std::uint64_t index = side * std::uint64_t(shape.kings) + std::uint64_t(king_index(shape, board[0]));
+        for (int i = 1; i < shape.count; ++i)
+        {
+            index = index * 64 + std::uint64_t(board[i]);
+        }
+        return index;
+    }
+
+    void decode(const layout &shape, std::uint64_t index, squares &board, color &side)
+    {
+        for (int i = shape.count - 1; i >= 1; --i)
+        {
+            board[i] = square(index % 64);
+            index /= 64;
+        }
+        board[0] = king_square(shape, int(index % std::uint64_t(shape.kings)));
+        side = color(index / std::uint64_t(shape.kings));
+    }
+
+    std::uint64_t encode_symmetric(const layout &shape, squares board, color side, int symmetry)
+    {
+        for (int i = 0; i < shape.count; ++i)
+        {
+            board[i] = transform(board[i], symmetry);
+        }
+        // identical pieces by increasing square
+        for (int i = 2; i < shape.count;)
+        {
+            auto j = i + 1;
+            while (j < shape.count && shape.slots[j] == shape.slots[i])
+            {
+                ++j;
+            }
+            std::sort(board.begin() + i, board.begin() + j);
+            i = j;
+        }
+        return encode(shape, board, side);
+    }
+
+    // the same index for every position equal by symmetry. With the white
+    // king on the diagonal both sides of it are tried, the smaller wins
+    std::uint64_t canonical_index(const layout &shape, const squares &board, color side)
+    {
+        auto king = board[0];
+        auto symmetry = file_of(king) > 3 ? 1 : 0;
+        if (shape.pawns)
+        {
+            return encode_symmetric(shape, board, side, symmetry);
+        }
+
+        symmetry |= rank_of(king) > 3 ? 2 : 0;
+        king = transform(king, symmetry);
+        if (rank_of(king) > file_of(king))
+        {
+            symmetry |= 4;
+        }
+        auto index = encode_symmetric(shape, board, side, symmetry);
+        if (rank_of(king) == file_of(king))
+        {
+            index = std::min(index, encode_symmetric(shape, board, side, symmetry | 4));
+        }
+        return index;
+    }
+
+    // attacks
+
+    bitboard piece_attacks(piece p, square s, bitboard occupied)
+    {
+        switch (type_of(p))
+        {
+        case pawn:
+            return pawn_attacks(color_of(p), s);
+        case knight:
+            return knight_attacks(s);
+        case bishop:
+            return bishop_attacks(s, occupied);
+        case rook:
+            return rook_attacks(s, occupied);
+        case queen:
+            return queen_attacks(s, occupied);
+        default:
+            return king_attacks(s);
+        }
+    }
+
+    // a piece of `by`, but the one in slot `skip`, attacks `target`
+    bool attacked(const layout &shape, const squares &board, int skip, square target, color by, bitboard occupied)
+    {
+        for (int i = 0; i < shape.count; ++i)
+        {
+            if (i != skip && color_of(shape.slots[i]) == by &&
+                (piece_attacks(shape.slots[i], board[i], occupied) & square_bb(target)) != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bitboard occupancy(const layout &shape, const squares &board)
+    {
+        bitboard occupied = 0;
+        for (int i = 0; i < shape.count; ++i)
+        {
+            occupied |= square_bb(board[i]);
+        }
+        return occupied;
+    }
+
+    // any placement of pieces, mapped to the table holding it
+    struct piece_list
+    {
+        std::array<piece, max_pieces> pieces;
+        std::array<square, max_pieces> squares;
+        int count{0};
+        color side{white};
+    };
+
+    side_key key_of(const piece_list &list, color c)
+    {
+        side_key key = 0;
+        for (int i = 0; i < list.count; ++i)
+        {
+            if (color_of(list.pieces[i]) == c && type_of(list.pieces[i]) != king)
+            {
+                key += side_key(1) << (type_of(list.pieces[i]) * 4);
+            }
+        }
+        return key;
+    }
+
+    // index of the pieces in `shape`, mirrored to the other colors first
+    // when `flipped`
+    std::uint64_t index_in(const layout &shape, const piece_list &list, bool flipped)
+    {
+        squares board{};
+        std::uint32_t used = 0;
+        for (int slot = 0; slot < shape.count; ++slot)
+        {
+            for (int i = 0; i < list.count; ++i)
+            {
+                auto p = flipped ? make_piece(~color_of(list.pieces[i]), type_of(list.pieces[i])) : list.pieces[i];
+                if ((used & (1u << i)) == 0 && p == shape.slots[slot])
+                {
+                    board[slot] = flipped ? list.squares[i] ^ 56 : list.squares[i];
+                    used |= 1u << i;
+                    break;
+                }
+            }
+        }
+        return canonical_index(shape, board, flipped ? ~list.side : list.side);
+    }
+
+    // file writing
+
+    bool write_table_file(const std::string &path, const layout &shape, std::uint32_t bits,
+                          const std::vector<std::uint8_t> &raw, int max_distance, std::uint64_t &bytes)
+    {
+        auto header = file_header{};
+        std::memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.version = file_version;
+        header.bits = bits;
+        header.entries = shape.entries;
+        header.block_size = block_size;
+        header.blocks = std::uint32_t((raw.size() + block_size - 1) / block_size);
+        header.max_distance = std::uint32_t(max_distance);
+        std::memcpy(header.material, shape.name.data(), std::min(shape.name.size(), sizeof(header.material) - 1));
+
+        // directory: offset of every block and of the end
+        auto directory = std::vector<std::uint64_t>{};
+        auto blocks = std::vector<std::uint8_t>{};
+        auto offset = sizeof(file_header) + (header.blocks + 1) * sizeof(std::uint64_t);
+        for (std::size_t begin = 0; begin < raw.size(); begin += block_size)
+        {
+            directory.push_back(offset + blocks.size());
+            lz_compress(raw.data() + begin, std::min<std::size_t>(block_size, raw.size() - begin), blocks);
+        }
+        directory.push_back(offset + blocks.size());
+
+        auto *file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+        auto ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(directory.data(), sizeof(std::uint64_t), directory.size(), file) == directory.size() &&
+                  std::fwrite(blocks.data(), 1, blocks.size(), file) == blocks.size();
+        bytes = offset + blocks.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    // mapped table file, the blocks decompressed on demand
+    struct table_file
+    {
+        mapped_file file;
+        file_header header{};
+        const std::uint8_t *directory{nullptr};
+        std::uint64_t raw_size{0};
+
+        bool open(const std::string &path, const layout &shape)
+        {
+            if (!file.open(path) || file.size() < sizeof(file_header))
+            {
+                return false;
+            }
+            std::memcpy(&header, file.data(), sizeof(header));
+            raw_size = (header.entries * header.bits + 7) / 8;
+            auto directory_size = (std::uint64_t(header.blocks) + 1) * sizeof(std::uint64_t);
+            if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.version != file_version ||
+                header.entries != shape.entries || header.block_size != block_size ||
+                header.blocks != (raw_size + header.block_size - 1) / header.block_size ||
+                (header.bits != 2 && header.bits != 8 && header.bits != 16) ||
+                file.size() < sizeof(file_header) + directory_size)
+            {
+                file.close();
+                return false;
+            }
+            directory = reinterpret_cast<const std::uint8_t *>(file.data()) + sizeof(file_header);
+            return true;
+        }
+
+        std::uint64_t entries_per_block() const
+        {
+            return std::uint64_t(header.block_size) * 8 / header.bits;
+        }
+
+        // false when the block is corrupt
+        bool decompress(std::uint32_t block, std::vector<std::uint8_t> &out) const
+        {
+            std::uint64_t begin;
+            std::uint64_t end;
+            std::memcpy(&begin, directory + block * sizeof(std::uint64_t), sizeof(begin));
+            std::memcpy(&end, directory + (block + 1) * sizeof(std::uint64_t), sizeof(end));
+            if (begin > end || end > file.size())
+            {
+                return false;
+            }
+            auto size = std::min<std::uint64_t>(header.block_size, raw_size - std::uint64_t(block) * header.block_size);
+            out.resize(header.block_size);
+            return lz_decompress(reinterpret_cast<const std::uint8_t *>(file.data()) + begin, end - begin, out.data(), size);
+        }
+
+        // entry `index` of the block holding it
+        int value(const std::uint8_t *data, std::uint64_t index) const
+        {
+            auto entry = index % entries_per_block();
+            switch (header.bits)
+            {
+            case 2:
+                return (data[entry / 4] >> ((entry % 4) * 2)) & 3;
+            case 8:
+                return data[entry];
+            default:
+                return data[entry * 2] | (data[entry * 2 + 1] << 8);
+            }
+        }
+    };
+
+    // generation
+
+    // a smaller table the generated one converts into, decoded whole
+    struct loaded_table
+    {
+        layout shape;
+        std::vector<std::uint8_t> results;
+
+        int code(std::uint64_t index) const
+        {
+            return (results[index / 4] >> ((index % 4) * 2)) & 3;
+        }
+    };
+
+    bool load_results(const std::string &directory, const std::string &name, loaded_table &table)
+    {
+        if (!parse_material(name, table.shape))
+        {
+            return false;
+        }
+        auto file = table_file{};
+        auto path = (std::filesystem::path(directory) / (table.shape.name + std::string(results_extension))).string();
+        if (!file.open(path, table.shape) || file.header.bits != 2)
+        {
+            return false;
+        }
+
+        table.results.resize(file.raw_size);
+        auto block = std::vector<std::uint8_t>{};
+        for (std::uint32_t i = 0; i < file.header.blocks; ++i)
+        {
+            if (!file.decompress(i, block))
+            {
+                return false;
+            }
+            auto begin = std::uint64_t(i) * file.header.block_size;
+            std::memcpy(table.results.data() + begin, block.data(),
+                        std::min<std::uint64_t>(file.header.block_size, file.raw_size - begin));
+        }
+        return true;
+    }
+
+    // the name of the material of a piece list, white first
+    std::string material_name(side_key white_side, side_key black_side)
+    {
+        auto name = std::string{};
+        for (auto key : {white_side, black_side})
+        {
+            name += name.empty() ? "K" : "vK";
+            for (int type = queen; type >= pawn; --type)
+            {
+                name.append((key >> (type * 4)) & 15, piece_letters[type]);
+            }
+        }
+        return name;
+    }
+
+    enum state : std::uint8_t
+    {
+        state_unknown,
+        state_win,
+        state_loss,
+        state_draw,
+        state_illegal,
+        // every move loses, the loss resolves at `loss_at`
+        state_losing,
+    };
+
+    constexpr std::uint16_t no_level = 0xffff;
+    // no position has more distinct moves or predecessors
+    constexpr std::size_t max_neighbours = 192;
+
+    // retrograde analysis: the mates and conversions are found first, then
+    // level by level every position one ply from a resolved one. A
+    // position is won one ply after a lost successor, and lost when its
+    // last successor turns out won
+    class generator
+    {
+    public:
+        generator(const layout &shape, const std::unordered_map<std::uint64_t, loaded_table> &subtables, int threads)
+            : m_shape{shape}, m_subtables{subtables}, m_threads{std::max(threads, 1)}
+        {
+        }
+
+        bool run(generate_stats &stats);
+        std::vector<std::uint8_t> results() const;
+        std::vector<std::uint8_t> distances(std::uint32_t bits) const;
+
+    private:
+        template <typename F>
+        void parallel(F &&body);
+
+        void initialize(std::uint64_t index);
+        void propagate(std::uint64_t index, int level);
+
+        bool valid(const squares &board, color side, std::uint64_t index) const;
+        // successors within the table, false when the conversions are not
+        // all in the subtables
+        int successors(const squares &board, color side, std::array<std::uint64_t, max_neighbours> &out,
+                       int &escapes, bool &wins, bool &loses, bool &legal, bool &missing) const;
+        int predecessors(const squares &board, color side, std::array<std::uint64_t, max_neighbours> &out) const;
+        int conversion(const piece_list &list, bool &missing) const;
+
+        const layout &m_shape;
+        const std::unordered_map<std::uint64_t, loaded_table> &m_subtables;
+        int m_threads;
+
+        std::unique_ptr<std::atomic<std::uint8_t>[]> m_state;
+        // successors not yet known to win for the opponent
+        std::unique_ptr<std::atomic<std::uint8_t>[]> m_remaining;
+        std::unique_ptr<std::atomic<std::uint16_t>[]> m_win_at;
+        std::unique_ptr<std::uint16_t[]> m_loss_at;
+        std::atomic<bool> m_missing{false};
+    };
+
+    template <typename F>
+    void generator::parallel(F &&body)
+    {
+        constexpr std::uint64_t chunk = 1 << 16;
+        auto next = std::atomic<std::uint64_t>{0};
+        auto work = [&]()
+        {
+            for (auto begin = next.fetch_add(chunk); begin < m_shape.entries; begin = next.fetch_add(chunk))
+            {
+                for (auto index = begin; index < std::min(begin + chunk, m_shape.entries); ++index)
+                {
+                    body(index);
+                }
+            }
+        };
+
+        auto workers = std::vector<std::thread>{};
+        for (int i = 1; i < m_threads; ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    bool generator::valid(const squares &board, color side, std::uint64_t index) const
+    {
+        bitboard occupied = 0;
+        for (int i = 0; i < m_shape.count; ++i)
+        {
+            if ((occupied & square_bb(board[i])) != 0 ||
+                (type_of(m_shape.slots[i]) == pawn && (rank_of(board[i]) == 0 || rank_of(board[i]) == 7)))
+            {
+                return false;
+            }
+            occupied |= square_bb(board[i]);
+        }
+        // the side which just moved cannot be in check
+        return canonical_index(m_shape, board, side) == index &&
+               !attacked(m_shape, board, -1, board[~side], side, occupied);
+    }
+
+    int generator::conversion(const piece_list &list, bool &missing) const
+    {
+        if (list.count == 2)
+        {
+            return code_draw;
+        }
+        auto white_side = key_of(list, white);
+        auto black_side = key_of(list, black);
+        auto found = m_subtables.find(table_key(white_side, black_side));
+        auto flipped = found == m_subtables.end();
+        if (flipped)
+        {
+            found = m_subtables.find(table_key(black_side, white_side));
+        }
+        if (found == m_subtables.end())
+        {
+            missing = true;
+            return code_draw;
+        }
+        return found->second.code(index_in(found->second.shape, list, flipped));
+    }
+
+    int generator::successors(const squares &board, color side, std::array<std::uint64_t, max_neighbours> &out,
+                              int &escapes, bool &wins, bool &loses, bool &legal, bool &missing) const
+    {
+        auto occupied = occupancy(m_shape, board);
+        bitboard own = 0;
+        for (int i = 0; i < m_shape.count; ++i)
+        {
+            own |= color_of(m_shape.slots[i]) == side ? square_bb(board[i]) : 0;
+        }
+
+        int count = 0;
+        for (int k = 0; k < m_shape.count; ++k)
+        {
+            auto p = m_shape.slots[k];
+            if (color_of(p) != side)
+            {
+                continue;
+            }
+            auto from = board[k];
+            bitboard targets;
+            if (type_of(p) == pawn)
+            {
+                targets = pawn_attacks(side, from) & occupied & ~own;
+                auto push = side == white ? from + 8 : from - 8;
+                if ((occupied & square_bb(push)) == 0)
+                {
+                    targets |= square_bb(push);
+                    auto double_push = side == white ? push + 8 : push - 8;
+                    if (relative_rank(side, from) == 1 && (occupied & square_bb(double_push)) == 0)
+                    {
+                        targets |= square_bb(double_push);
+                    }
+                }
+            }
+            else
+            {
+                targets = piece_attacks(p, from, occupied) & ~own;
+            }
+
+            while (targets != 0)
+            {
+                auto to = pop_lsb(targets);
+                auto captured = -1;
+                for (int i = 0; i < m_shape.count; ++i)
+                {
+                    captured = board[i] == to ? i : captured;
+                }
+
+                auto next = board;
+                next[k] = to;
+                auto next_occupied = (occupied & ~square_bb(from)) | square_bb(to);
+                auto king_at = next[side];
+                if (attacked(m_shape, next, captured, king_at, ~side, next_occupied))
+                {
+                    continue;
+                }
+                legal = true;
+
+                auto promotes = type_of(p) == pawn && relative_rank(side, to) == 7;
+                if (captured < 0 && !promotes)
+                {
+                    out[std::size_t(count++)] = canonical_index(m_shape, next, ~side);
+                    continue;
+                }
+
+                // into a smaller table, or another one of as many pieces
+                auto list = piece_list{.pieces = {}, .squares = {}, .count = 0, .side = ~side};
+                for (int i = 0; i < m_shape.count; ++i)
+                {
+                    if (i != captured)
+                    {
+                        list.pieces[std::size_t(list.count)] = m_shape.slots[i];
+                        list.squares[std::size_t(list.count++)] = next[i];
+                    }
+                }
+                auto moved = std::find(list.squares.begin(), list.squares.begin() + list.count, to) - list.squares.begin();
+                for (int type = promotes ? knight : pawn; type <= (promotes ? queen : pawn); ++type)
+                {
+                    if (promotes)
+                    {
+                        list.pieces[std::size_t(moved)] = make_piece(side, piece_type(type));
+                    }
+                    auto code = conversion(list, missing);
+                    wins |= code == code_loss;
+                    loses |= code == code_win;
+                    escapes += code == code_draw || code == code_illegal || code == code_loss ? 1 : 0;
+                }
+            }
+        }
+
+        std::sort(out.begin(), out.begin() + count);
+        return int(std::unique(out.begin(), out.begin() + count) - out.begin());
+    }
+
+    int generator::predecessors(const squares &board, color side, std::array<std::uint64_t, max_neighbours> &out) const
+    {
+        auto occupied = occupancy(m_shape, board);
+        auto mover = ~side;
+
+        int count = 0;
+        for (int k = 0; k < m_shape.count; ++k)
+        {
+            auto p = m_shape.slots[k];
+            if (color_of(p) != mover)
+            {
+                continue;
+            }
+            auto to = board[k];
+            bitboard origins;
+            if (type_of(p) == pawn)
+            {
+                origins = 0;
+                auto back = mover == white ? to - 8 : to + 8;
+                if (relative_rank(mover, to) >= 2 && (occupied & square_bb(back)) == 0)
+                {
+                    origins |= square_bb(back);
+                    auto double_back = mover == white ? back - 8 : back + 8;
+                    if (relative_rank(mover, to) == 3 && (occupied & square_bb(double_back)) == 0)
+                    {
+                        origins |= square_bb(double_back);
+                    }
+                }
+            }
+            else
+            {
+                // the moves of a piece are their own reverse
+                origins = piece_attacks(p, to, occupied) & ~occupied;
+            }
+
+            while (origins != 0)
+            {
+                auto from = pop_lsb(origins);
+                auto previous = board;
+                previous[k] = from;
+                auto previous_occupied = (occupied & ~square_bb(to)) | square_bb(from);
+                // the side to move here did not move into check
+                if (!attacked(m_shape, previous, -1, previous[side], mover, previous_occupied))
+                {
+                    out[std::size_t(count++)] = canonical_index(m_shape, previous, mover);
+                }
+            }
+        }
+
+        std::sort(out.begin(), out.begin() + count);
+        return int(std::unique(out.begin(), out.begin() + count) - out.begin());
+    }
+
+    void generator::initialize(std::uint64_t index)
+    {
+        squares board{};
+        color side;
+        decode(m_shape, index, board, side);
+        m_win_at[index].store(no_level, std::memory_order_relaxed);
+        m_loss_at[index] = 0;
+        m_remaining[index].store(0, std::memory_order_relaxed);
+        if (!valid(board, side, index))
+        {
+            m_state[index].store(state_illegal, std::memory_order_relaxed);
+            return;
+        }
+
+        std::array<std::uint64_t, max_neighbours> next;
+        auto escapes = 0;
+        auto wins = false;
+        auto loses = false;
+        auto legal = false;
+        auto missing = false;
+        auto count = successors(board, side, next, escapes, wins, loses, legal, missing);
+        if (missing)
+        {
+            m_missing.store(true, std::memory_order_relaxed);
+        }
+
+        if (!legal)
+        {
+            auto occupied = occupancy(m_shape, board);
+            auto mated = attacked(m_shape, board, -1, board[side], ~side, occupied);
+            m_state[index].store(mated ? state_losing : state_draw, std::memory_order_relaxed);
+            return;
+        }
+
+        // a conversion losing for the opponent wins in one ply, one keeping
+        // the draw at least saves the position
+        m_win_at[index].store(wins ? 1 : no_level, std::memory_order_relaxed);
+        m_remaining[index].store(std::uint8_t(count + escapes), std::memory_order_relaxed);
+        m_loss_at[index] = loses || count == 0 ? 1 : 0;
+        m_state[index].store(count + escapes == 0 ? state_losing : state_unknown, std::memory_order_relaxed);
+    }
+
+    void generator::propagate(std::uint64_t index, int level)
+    {
+        squares board{};
+        color side;
+        decode(m_shape, index, board, side);
+
+        std::array<std::uint64_t, max_neighbours> previous;
+        auto count = predecessors(board, side, previous);
+        auto lost = m_state[index].load(std::memory_order_relaxed) == state_loss;
+        for (int i = 0; i < count; ++i)
+        {
+            auto q = previous[std::size_t(i)];
+            if (m_state[q].load(std::memory_order_relaxed) != state_unknown)
+            {
+                continue;
+            }
+
+            if (lost)
+            {
+                auto at = m_win_at[q].load(std::memory_order_relaxed);
+                while (at > level + 1 && !m_win_at[q].compare_exchange_weak(at, std::uint16_t(level + 1)))
+                {
+                }
+            }
+            else if (m_remaining[q].fetch_sub(1) == 1)
+            {
+                // the last successor lost: only this thread gets here
+                m_loss_at[q] = std::max<std::uint16_t>(m_loss_at[q], std::uint16_t(level + 1));
+                m_state[q].store(state_losing, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool generator::run(generate_stats &stats)
+    {
+        m_state = std::make_unique<std::atomic<std::uint8_t>[]>(m_shape.entries);
+        m_remaining = std::make_unique<std::atomic<std::uint8_t>[]>(m_shape.entries);
+        m_win_at = std::make_unique<std::atomic<std::uint16_t>[]>(m_shape.entries);
+        m_loss_at = std::make_unique<std::uint16_t[]>(m_shape.entries);
+
+        parallel([this](std::uint64_t index)
+                 { initialize(index); });
+        if (m_missing.load())
+        {
+            return false;
+        }
+
+        for (int level = 0; level < no_level - 1; ++level)
+        {
+            auto resolved = std::atomic<std::uint64_t>{0};
+            auto pending = std::atomic<bool>{false};
+            parallel([&](std::uint64_t index)
+                     {
+                         auto s = m_state[index].load(std::memory_order_relaxed);
+                         if (s == state_unknown && m_win_at[index].load(std::memory_order_relaxed) != no_level)
+                         {
+                             if (m_win_at[index].load(std::memory_order_relaxed) == level)
+                             {
+                                 m_state[index].store(state_win, std::memory_order_relaxed);
+                                 resolved.fetch_add(1, std::memory_order_relaxed);
+                             }
+                             else
+                             {
+                                 pending.store(true, std::memory_order_relaxed);
+                             }
+                         }
+                         else if (s == state_losing)
+                         {
+                             if (m_loss_at[index] == level)
+                             {
+                                 m_state[index].store(state_loss, std::memory_order_relaxed);
+                                 resolved.fetch_add(1, std::memory_order_relaxed);
+                             }
+                             else
+                             {
+                                 pending.store(true, std::memory_order_relaxed);
+                             }
+                         } });
+            if (resolved.load() == 0)
+            {
+                if (!pending.load())
+                {
+                    break;
+                }
+                continue;
+            }
+
+            parallel([&](std::uint64_t index)
+                     {
+                         auto s = m_state[index].load(std::memory_order_relaxed);
+                         if ((s == state_win && m_win_at[index].load(std::memory_order_relaxed) == level) ||
+                             (s == state_loss && m_loss_at[index] == level))
+                         {
+                             propagate(index, level);
+                         } });
+        }
+
+        stats = generate_stats{.entries = m_shape.entries};
+        for (std::uint64_t index = 0; index < m_shape.entries; ++index)
+        {
+            switch (m_state[index].load(std::memory_order_relaxed))
+            {
+            case state_win:
+                ++stats.wins;
+                stats.max_distance = std::max<int>(stats.max_distance, m_win_at[index].load(std::memory_order_relaxed));
+                break;
+            case state_loss:
+                ++stats.losses;
+                stats.max_distance = std::max<int>(stats.max_distance, m_loss_at[index]);
+                break;
+            case state_illegal:
+                break;
+            default:
+                // no forced result
+                m_state[index].store(state_draw, std::memory_order_relaxed);
+                ++stats.draws;
+                break;
+            }
+        }
+        stats.legal = stats.wins + stats.draws + stats.losses;
+        return true;
+    }
+
+    std::vector<std::uint8_t> generator::results() const
+    {
+        auto raw = std::vector<std::uint8_t>((m_shape.entries + 3) / 4, 0);
+        for (std::uint64_t index = 0; index < m_shape.entries; ++index)
+        {
+            auto s = m_state[index].load(std::memory_order_relaxed);
+            auto code = s == state_win ? code_win : s == state_loss ? code_loss
+                                                : s == state_illegal ? code_illegal
+                                                                     : code_draw;
+            raw[index / 4] |= std::uint8_t(code << ((index % 4) * 2));
+        }
+        return raw;
+    }
+
+    std::vector<std::uint8_t> generator::distances(std::uint32_t bits) const
+    {
+        auto raw = std::vector<std::uint8_t>(m_shape.entries * bits / 8, 0);
+        for (std::uint64_t index = 0; index < m_shape.entries; ++index)
+        {
+            auto s = m_state[index].load(std::memory_order_relaxed);
+            auto distance = s == state_win ? m_win_at[index].load(std::memory_order_relaxed) : s == state_loss ? m_loss_at[index]
+                                                                                                                : 0;
+            if (bits == 8)
+            {
+                raw[index] = std::uint8_t(distance);
+            }
+            else
+            {
+                raw[index * 2] = std::uint8_t(distance);
+                raw[index * 2 + 1] = std::uint8_t(distance >> 8);
+            }
+        }
+        return raw;
+    }
+
+    // probing
+
+    struct probe_table
+    {
+        layout shape;
+        table_file results;
+        table_file distances;
+        std::uint32_t id{0};
+    };
+
+    // most recently used decompressed blocks of every table. The blocks are
+    // spread over shards by key, each with its own lock and LRU ring: the
+    // threads probing different blocks rarely wait on each other
+    class block_cache
+    {
+    public:
+        void reset(std::size_t bytes)
+        {
+            auto slots = std::max<std::size_t>(bytes / block_size, 1);
+            for (std::size_t i = 0; i < shard_count; ++i)
+            {
+                // the first shards take the remainder, every shard a slot
+                m_shards[i].reset(std::max<std::size_t>(slots / shard_count + (i < slots % shard_count ? 1 : 0), 1));
+            }
+        }
+
+        // the value of entry `index` of the file
+        bool read(std::uint64_t key, const table_file &file, std::uint64_t index, int &value)
+        {
+            auto block = std::uint32_t(index / file.entries_per_block());
+            key |= std::uint64_t(block);
+            auto &shard = m_shards[std::size_t((key * 0x9e3779b97f4a7c15ull) >> 60) % shard_count];
+            if (shard.find(key, file, index, value))
+            {
+                m_hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // outside of the lock, the other threads keep probing
+            thread_local std::vector<std::uint8_t> scratch;
+            if (!file.decompress(block, scratch))
+            {
+                return false;
+            }
+            value = file.value(scratch.data(), index);
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            shard.insert(key, scratch.data());
+            return true;
+        }
+
+        cache_stats stats() const
+        {
+            return cache_stats{.hits = m_hits.load(), .misses = m_misses.load()};
+        }
+
+    private:
+        static constexpr std::size_t shard_count = 16;
+
+        class shard
+        {
+        public:
+            void reset(std::size_t slots)
+            {
+                auto lock = std::lock_guard{m_mutex};
+                m_slots = slots;
+                m_data.assign(m_slots * block_size, 0);
+                m_keys.assign(m_slots, ~std::uint64_t{0});
+                m_previous.assign(m_slots, 0);
+                m_next.assign(m_slots, 0);
+                // a ring of the slots, the most recent at `m_head`
+                for (std::size_t i = 0; i < m_slots; ++i)
+                {
+                    m_previous[i] = (i + m_slots - 1) % m_slots;
+                    m_next[i] = (i + 1) % m_slots;
+                }
+                m_head = 0;
+                m_lookup.clear();
+                m_lookup.reserve(m_slots * 2);
+            }
+
+            bool find(std::uint64_t key, const table_file &file, std::uint64_t index, int &value)
+            {
+                auto lock = std::lock_guard{m_mutex};
+                auto found = m_lookup.find(key);
+                if (found == m_lookup.end())
+                {
+                    return false;
+                }
+                touch(found->second);
+                value = file.value(m_data.data() + found->second * block_size, index);
+                return true;
+            }
+
+            void insert(std::uint64_t key, const std::uint8_t *data)
+            {
+                auto lock = std::lock_guard{m_mutex};
+                if (m_lookup.count(key) != 0)
+                {
+                    return;
+                }
+                // the least recent slot is before the head
+                auto slot = m_previous[m_head];
+                if (m_keys[slot] != ~std::uint64_t{0})
+                {
+                    m_lookup.erase(m_keys[slot]);
+                }
+                m_keys[slot] = key;
+                std::memcpy(m_data.data() + slot * block_size, data, block_size);
+                m_lookup.emplace(key, slot);
+                touch(slot);
+            }
+
+        private:
+            void touch(std::size_t slot)
+            {
+                if (slot == m_head)
+                {
+                    return;
+                }
+                // unlinked, then inserted before the head
+                m_next[m_previous[slot]] = m_next[slot];
+                m_previous[m_next[slot]] = m_previous[slot];
+                m_previous[slot] = m_previous[m_head];
+                m_next[slot] = m_head;
+                m_next[m_previous[m_head]] = slot;
+                m_previous[m_head] = slot;
+                m_head = slot;
+            }
+
+            std::mutex m_mutex;
+            std::size_t m_slots{0};
+            std::vector<std::uint8_t> m_data;
+            std::vector<std::uint64_t> m_keys;
+            std::vector<std::size_t> m_previous;
+            std::vector<std::size_t> m_next;
+            std::size_t m_head{0};
+            std::unordered_map<std::uint64_t, std::size_t> m_lookup;
+        };
+
+        std::array<shard, shard_count> m_shards;
+        std::atomic<std::uint64_t> m_hits{0};
+        std::atomic<std::uint64_t> m_misses{0};
+    };
+
+    struct tablebase_storage
+    {
+        std::vector<std::unique_ptr<probe_table>> tables;
+        std::unordered_map<std::uint64_t, const probe_table *> by_key;
+        block_cache cache;
+        int largest{0};
+    };
+
+    tablebase_storage &get_storage()
+    {
+        static tablebase_storage storage;
+        return storage;
+    }
+
+    // cache keys: the table, the file and the block
+    std::uint64_t block_key(const probe_table &table, bool distances)
+    {
+        return (std::uint64_t(table.id) << 40) | (std::uint64_t(distances) << 39);
+    }
+
+    // false when the tables cannot hold the position
+    bool to_piece_list(const position &pos, piece_list &list)
+    {
+        auto occupied = pos.pieces();
+        if (popcount(occupied) > get_storage().largest || pos.castling_rights() != no_castling)
+        {
+            return false;
+        }
+        list.count = 0;
+        list.side = pos.side_to_move();
+        while (occupied != 0)
+        {
+            auto s = pop_lsb(occupied);
+            list.pieces[std::size_t(list.count)] = pos.piece_on(s);
+            list.squares[std::size_t(list.count++)] = s;
+        }
+        return true;
+    }
+
+    bool probe_list(const piece_list &list, probe_result &result, bool with_distance)
+    {
+        result = probe_result{};
+        if (list.count == 2)
+        {
+            return true;
+        }
+
+        auto &storage = get_storage();
+        auto white_side = key_of(list, white);
+        auto black_side = key_of(list, black);
+        auto found = storage.by_key.find(table_key(white_side, black_side));
+        auto flipped = found == storage.by_key.end();
+        if (flipped)
+        {
+            found = storage.by_key.find(table_key(black_side, white_side));
+            if (found == storage.by_key.end())
+            {
+                return false;
+            }
+        }
+
+        const auto &table = *found->second;
+        auto index = index_in(table.shape, list, flipped);
+        int code;
+        if (!storage.cache.read(block_key(table, false), table.results, index, code))
+        {
+            return false;
+        }
+        result.value = code == code_win ? wdl::win : code == code_loss ? wdl::loss
+                                                                       : wdl::draw;
+        if (with_distance && result.value != wdl::draw &&
+            !storage.cache.read(block_key(table, true), table.distances, index, result.distance))
+        {
+            return false;
+        }
+        return true;
+    }
+
+    // the tables have no en passant rights: a capture en passant is
+    // compared to the result of the position without the right
+    bool probe_position(const position &pos, probe_result &result, bool with_distance)
+    {
+        piece_list list;
+        if (!to_piece_list(pos, list) || !probe_list(list, result, with_distance))
+        {
+            return false;
+        }
+        if (pos.ep_square() == no_square)
+        {
+            return true;
+        }
+
+        move_list moves;
+        generate_legal(pos, moves);
+        for (auto m : moves)
+        {
+            if (m.flags() != en_passant)
+            {
+                continue;
+            }
+            auto child = list;
+            child.side = ~list.side;
+            child.count = 0;
+            for (int i = 0; i < list.count; ++i)
+            {
+                if (list.squares[std::size_t(i)] != (m.to() ^ 8))
+                {
+                    child.pieces[std::size_t(child.count)] = list.pieces[std::size_t(i)];
+                    child.squares[std::size_t(child.count++)] = list.squares[std::size_t(i)] == m.from() ? m.to() : list.squares[std::size_t(i)];
+                }
+            }
+
+            auto reply = probe_result{};
+            if (!probe_list(child, reply, false))
+            {
+                return false;
+            }
+            // a conversion, one ply from zeroing
+            auto value = wdl(-int(reply.value));
+            if (value > result.value || (value == wdl::win && result.value == wdl::win))
+            {
+                result.distance = value == wdl::draw ? 0 : 1;
+                result.value = value;
+            }
+        }
+        return true;
+    }
+}
+
+int chess::tb::load(const std::string &directory, std::size_t cache_mb)
+{
+    unload();
+    auto &storage = get_storage();
+    storage.cache.reset(std::max<std::size_t>(cache_mb, 1) * 1024 * 1024);
+
+    auto error = std::error_code{};
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        auto path = entry.path();
+        if (path.extension() != results_extension)
+        {
+            continue;
+        }
+
+        auto table = std::make_unique<probe_table>();
+        auto distances = path;
+        distances.replace_extension(distances_extension);
+        if (!parse_material(path.stem().string(), table->shape) || table->shape.name != path.stem().string() ||
+            !table->results.open(path.string(), table->shape) || table->results.header.bits != 2 ||
+            !table->distances.open(distances.string(), table->shape) || table->distances.header.bits == 2)
+        {
+            continue;
+        }
+        table->id = std::uint32_t(storage.tables.size());
+        storage.by_key[table->shape.key] = table.get();
+        storage.largest = std::max(storage.largest, table->shape.count);
+        storage.tables.push_back(std::move(table));
+    }
+    return int(storage.tables.size());
+}
+
+void chess::tb::unload()
+{
+    auto &storage = get_storage();
+    storage.by_key.clear();
+    storage.tables.clear();
+    storage.largest = 0;
+    storage.cache.reset(block_size);
+}
+
+int chess::tb::largest()
+{
+    return get_storage().largest;
+}
+
+bool chess::tb::probe_wdl(const position &pos, wdl &value)
+{
+    auto result = probe_result{};
+    if (!probe_position(pos, result, false))
+    {
+        return false;
+    }
+    value = result.value;
+    return true;
+}
+
+bool chess::tb::probe(const position &pos, probe_result &result)
+{
+    return probe_position(pos, result, true);
+}
+
+move chess::tb::best_move(position &pos, probe_result &result)
+{
+    if (!probe(pos, result))
+    {
+        return no_move;
+    }
+
+    move_list list;
+    generate_legal(pos, list);
+    auto best = no_move;
+    // plies to the conversion, then the distance in the table converted to
+    auto best_rank = std::pair<int, int>{};
+    for (auto m : list)
+    {
+        pos.make_move(m);
+        auto child = probe_result{};
+        auto found = probe(pos, child);
+        pos.unmake_move(m);
+        if (!found)
+        {
+            return no_move;
+        }
+
+        auto converts = m.is_capture() || m.is_promotion();
+        auto rank = std::pair<int, int>{converts ? 1 : child.distance + 1, converts ? child.distance : 0};
+        if (result.value == wdl::win && child.value == wdl::loss)
+        {
+            if (best == no_move || rank < best_rank)
+            {
+                best = m;
+                best_rank = rank;
+            }
+        }
+        else if (result.value == wdl::loss)
+        {
+            if (best == no_move || rank > best_rank)
+            {
+                best = m;
+                best_rank = rank;
+            }
+        }
+        else if (result.value == wdl::draw && child.value == wdl::draw && best == no_move)
+        {
+            best = m;
+        }
+    }
+    return best;
+}
+
+cache_stats chess::tb::get_cache_stats()
+{
+    return get_storage().cache.stats();
+}
+
+std::vector<std::string> chess::tb::materials(int pieces)
+{
+    // every multiset of piece types on each side, the stronger side first
+    auto sides = std::vector<std::vector<side_key>>(std::size_t(std::max(pieces - 1, 1)));
+    sides[0].push_back(0);
+    for (std::size_t count = 1; count < sides.size(); ++count)
+    {
+        for (auto key : sides[count - 1])
+        {
+            // types never decrease, each multiset is built once
+            auto highest = 0;
+            for (int type = 0; type < 5; ++type)
+            {
+                highest = ((key >> (type * 4)) & 15) != 0 ? type : highest;
+            }
+            for (int type = highest; type < 5; ++type)
+            {
+                sides[count].push_back(key + (side_key(1) << (type * 4)));
+            }
+        }
+    }
+
+    auto strength = [](side_key key)
+    {
+        auto value = 0;
+        for (int type = 0; type < 5; ++type)
+        {
+            value += int((key >> (type * 4)) & 15) * material_values[type];
+        }
+        return std::pair<int, side_key>{value, key};
+    };
+
+    auto names = std::vector<std::pair<int, std::string>>{};
+    auto others = pieces - 2;
+    for (int strong = others; strong >= 0 && others >= 1 && pieces <= max_pieces; --strong)
+    {
+        auto weak = others - strong;
+        if (weak > strong)
+        {
+            break;
+        }
+        for (auto white_side : sides[std::size_t(strong)])
+        {
+            for (auto black_side : sides[std::size_t(weak)])
+            {
+                if (strength(white_side) < strength(black_side))
+                {
+                    continue;
+                }
+                auto pawns = int(white_side & 15) + int(black_side & 15);
+                names.emplace_back(pawns, material_name(white_side, black_side));
+            }
+        }
+    }
+    std::sort(names.begin(), names.end());
+
+    auto result = std::vector<std::string>{};
+    for (auto &name : names)
+    {
+        result.push_back(std::move(name.second));
+    }
+    return result;
+}
+
+bool chess::tb::generate(std::string_view material, const std::string &directory, const generate_options &options,
+                         generate_stats &stats)
+{
+    init_attacks();
+    auto shape = layout{};
+    if (!parse_material(material, shape))
+    {
+        return false;
+    }
+
+    // the tables of one piece less, and those a promotion leads to
+    auto pawns = [](std::uint64_t key)
+    {
+        return int(key & 15) + int((key >> 20) & 15);
+    };
+    auto subtables = std::unordered_map<std::uint64_t, loaded_table>{};
+    for (int pieces = std::max(shape.count - 1, 3); pieces <= shape.count; ++pieces)
+    {
+        for (const auto &name : materials(pieces))
+        {
+            auto table = loaded_table{};
+            if (!parse_material(name, table.shape) ||
+                (pieces == shape.count && pawns(table.shape.key) != pawns(shape.key) - 1))
+            {
+                continue;
+            }
+            if (load_results(directory, name, table))
+            {
+                subtables.emplace(table.shape.key, std::move(table));
+            }
+        }
+    }
+
+    auto work = generator{shape, subtables, options.threads};
+    if (!work.run(stats))
+    {
+        return false;
+    }
+
+    auto base = (std::filesystem::path(directory) / shape.name).string();
+    auto bits = stats.max_distance < 256 ? 8u : 16u;
+    return write_table_file(base + std::string(results_extension), shape, 2, work.results(), stats.max_distance,
+                            stats.wdl_bytes) &&
+           write_table_file(base + std::string(distances_extension), shape, bits, work.distances(bits),
+                            stats.max_distance, stats.distance_bytes);
+}
@@ -0,0 +1,136 @@
+#include "game/chess/tt.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    using namespace chess;
+
+    // data word: move (16 bits), score (16), static eval (16), depth (8),
+    // bound (2) and search age (6)
+    std::uint64_t pack(move best, int score, int eval, int depth, tt_bound bound, std::uint8_t age)
+    {
+        return std::uint64_t{best.data()} |
+               std::uint64_t{static_cast<std::uint16_t>(score)} << 16 |
+               std::uint64_t{static_cast<std::uint16_t>(eval)} << 32 |
+               std::uint64_t{static_cast<std::uint8_t>(depth)} << 48 |
+               std::uint64_t{static_cast<std::uint8_t>(bound)} << 56 |
+               std::uint64_t{age} << 58;
+    }
+
+    int data_depth(std::uint64_t data)
+    {
+        return static_cast<std::int8_t>(data >> 48);
+    }
+
+    tt_bound data_bound(std::uint64_t data)
+    {
+        return tt_bound((data >> 56) & 3);
+    }
+
+    std::uint8_t data_age(std::uint64_t data)
+    {
+        return static_cast<std::uint8_t>(data >> 58);
+    }
+
+    constexpr std::uint8_t age_mask = 63;
+}
+
+transposition_table::transposition_table()
+{
+    resize(default_mb);
+}
+
+void transposition_table::resize(std::size_t mb)
+{
+    auto bytes = std::max<std::size_t>(mb, 1) * 1024 * 1024;
+    auto count = std::size_t{1};
+    while (count * 2 * sizeof(slot) <= bytes)
+    {
+        count *= 2;
+    }
+
+    if (count != m_count)
+    {
+        m_slots.reset(new slot[count]);
+        m_count = count;
+        m_mask = count - 1;
+    }
+    clear();
+}
+
+std::size_t transposition_table::size_mb() const
+{
+    return m_count * sizeof(slot) / (1024 * 1024);
+}
+
+void transposition_table::clear()
+{
+    for (std::size_t i = 0; i < m_count; ++i)
+    {
+        m_slots[i].key.store(0, std::memory_order_relaxed);
+        m_slots[i].data.store(0, std::memory_order_relaxed);
+    }
+    m_age = 0;
+}
+
+void transposition_table::new_search()
+{
+    m_age = (m_age + 1) & age_mask;
+}
+
+bool transposition_table::probe(std::uint64_t key, tt_entry &entry) const
+{
+    const auto &s = slot_for(key);
+    auto data = s.data.load(std::memory_order_relaxed);
+    if ((s.key.load(std::memory_order_relaxed) ^ data) != key || data == 0)
+    {
+        return false;
+    }
+
+    entry.best = move{static_cast<std::uint16_t>(data)};
+    entry.score = static_cast<std::int16_t>(data >> 16);
+    entry.eval = static_cast<std::int16_t>(data >> 32);
+    entry.depth = data_depth(data);
+    entry.bound = data_bound(data);
+    return true;
+}
+
+void transposition_table::store(std::uint64_t key, move best, int score, int eval, int depth, tt_bound bound)
+{
+    auto &s = slot_for(key);
+    auto old = s.data.load(std::memory_order_relaxed);
+    auto same = (s.key.load(std::memory_order_relaxed) ^ old) == key;
+
+    // keep the deeper result of the current search for another position
+    if (!same && data_age(old) == m_age && data_depth(old) > depth + 2 && bound != tt_bound::exact)
+    {
+        return;
+    }
+    // a shallower bound does not replace an entry of the same position,
+    // its move is still better than none
+    if (same && bound != tt_bound::exact && data_depth(old) > depth + 2)
+    {
+        return;
+    }
+    if (same && best == no_move)
+    {
+        best = move{static_cast<std::uint16_t>(old)};
+    }
+
+    auto data = pack(best, score, eval, depth, bound, m_age);
+    s.key.store(key ^ data, std::memory_order_relaxed);
+    s.data.store(data, std::memory_order_relaxed);
+}
+
+int transposition_table::hashfull() const
+{
+    auto samples = std::min<std::size_t>(m_count, 1000);
+    auto used = 0;
+    for (std::size_t i = 0; i < samples; ++i)
+    {
+        auto data = m_slots[i].data.load(std::memory_order_relaxed);
+        used += data != 0 && data_age(data) == m_age ? 1 : 0;
+    }
+    return int(used * 1000 / std::max<std::size_t>(samples, 1));
+}
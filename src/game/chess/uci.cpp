@@ -0,0 +1,435 @@
+#include "game/chess/uci.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "game/chess/book.hpp"
+#include "game/chess/tablebase.hpp"
+#include "game/chess/nnue.hpp"
+
+namespace
+{
+    using namespace chess;
+
+    // the GUI and the pipes take their share of the clock
+    constexpr std::int64_t move_overhead_ms = 30;
+    // moves assumed left when the GUI does not send movestogo
+    constexpr std::int64_t default_moves_to_go = 30;
+
+    std::vector<std::string_view> split(std::string_view line)
+    {
+        auto tokens = std::vector<std::string_view>{};
+        while (!line.empty())
+        {
+            auto begin = line.find_first_not_of(" \t\r\n");
+            if (begin == std::string_view::npos)
+            {
+                break;
+            }
+            line.remove_prefix(begin);
+            auto end = std::min(line.find_first_of(" \t\r\n"), line.size());
+            tokens.push_back(line.substr(0, end));
+            line.remove_prefix(end);
+        }
+        return tokens;
+    }
+
+    std::int64_t to_int(std::string_view token)
+    {
+        return std::strtoll(std::string(token).c_str(), nullptr, 10);
+    }
+
+    bool equals_ignore_case(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                                                  { return std::tolower(x) == std::tolower(y); });
+    }
+
+    // a share of the remaining time, never more than what is left
+    std::int64_t time_for_move(std::int64_t time_left, std::int64_t increment, std::int64_t moves_to_go)
+    {
+        auto moves = moves_to_go > 0 ? moves_to_go : default_moves_to_go;
+        auto budget = time_left / moves + increment * 3 / 4;
+        budget = std::min(budget, time_left - move_overhead_ms);
+        return std::max<std::int64_t>(budget, 1);
+    }
+}
+
+uci_session::uci_session(std::FILE *out) : m_out{out}
+{
+    // without a book in the working directory the engine searches every move
+    load_book(std::string(default_book_file));
+    // nor tablebases, the search then plays endgames out
+    tb::load(std::string(tb::default_directory));
+}
+
+bool uci_session::handle(std::string_view line)
+{
+    auto tokens = split(line);
+    if (tokens.empty())
+    {
+        return true;
+    }
+    auto command = tokens[0];
+
+    if (command == "uci")
+    {
+        send("id name cpp_chess");
+        send("id author cpp_chess authors");
+        send("option name Hash type spin default " + std::to_string(transposition_table::default_mb) +
+             " min 1 max " + std::to_string(max_hash_mb));
+        send("option name Threads type spin default 1 min 1 max " + std::to_string(max_threads));
+        send("option name Ponder type check default false");
+        send("option name EvalFile type string default " + std::string(nnue::default_file));
+        send("option name UseNNUE type check default true");
+        send("option name OwnBook type check default true");
+        send("option name BookFile type string default " + std::string(default_book_file));
+        send("option name TablebasePath type string default " + std::string(tb::default_directory));
+        send("uciok");
+        send_network();
+    }
+    else if (command == "isready")
+    {
+        send("readyok");
+    }
+    else if (command == "setoption")
+    {
+        set_option(line);
+    }
+    else if (command == "ucinewgame")
+    {
+        m_service.new_game();
+        m_position.set_fen(position::start_fen);
+    }
+    else if (command == "position")
+    {
+        set_position(line);
+    }
+    else if (command == "go")
+    {
+        go(line);
+    }
+    else if (command == "stop")
+    {
+        m_stop_received = true;
+        m_service.stop();
+        if (m_has_deferred)
+        {
+            m_has_deferred = false;
+            send_bestmove(m_deferred);
+        }
+    }
+    else if (command == "ponderhit")
+    {
+        m_service.ponderhit();
+    }
+    else if (command == "quit")
+    {
+        m_service.stop();
+        return false;
+    }
+    else if (command == "d")
+    {
+        // not UCI, handy from a terminal
+        send("fen " + m_position.fen());
+    }
+    else
+    {
+        send("info string unknown command " + std::string(command));
+    }
+
+    return true;
+}
+
+bool uci_session::poll()
+{
+    auto any = false;
+    while (m_service.poll(m_event))
+    {
+        any = true;
+        if (m_event.type == engine_event::kind::info)
+        {
+            if (m_event.search_id == m_service.current_search())
+            {
+                send_info(m_event.info);
+            }
+        }
+        else if (m_infinite && !m_stop_received && m_event.search_id == m_service.current_search())
+        {
+            m_deferred = m_event.result;
+            m_has_deferred = true;
+        }
+        else
+        {
+            send_bestmove(m_event.result);
+        }
+    }
+    return any;
+}
+
+void uci_session::set_option(std::string_view line)
+{
+    // setoption name <id> [value <x>], names may contain spaces
+    auto name_at = line.find(" name ");
+    if (name_at == std::string_view::npos)
+    {
+        return;
+    }
+    auto value_at = line.find(" value ");
+    auto name = line.substr(name_at + 6, value_at == std::string_view::npos ? std::string_view::npos : value_at - name_at - 6);
+    auto value = value_at == std::string_view::npos ? std::string_view{} : line.substr(value_at + 7);
+
+    while (!name.empty() && name.back() == ' ')
+    {
+        name.remove_suffix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\r' || value.back() == '\n'))
+    {
+        value.remove_suffix(1);
+    }
+
+    if (equals_ignore_case(name, "Hash"))
+    {
+        m_service.set_hash(std::size_t(std::clamp<std::int64_t>(to_int(value), 1, max_hash_mb)));
+    }
+    else if (equals_ignore_case(name, "Threads"))
+    {
+        m_service.set_threads(int(std::clamp<std::int64_t>(to_int(value), 1, max_threads)));
+    }
+    else if (equals_ignore_case(name, "Ponder"))
+    {
+        m_ponder_option = value == "true";
+    }
+    else if (equals_ignore_case(name, "EvalFile"))
+    {
+        // the GUI only sets options between searches
+        if (value.empty() || value == "<bundled>")
+        {
+            nnue::use_bundled_network();
+        }
+        else if (!nnue::load_network(std::string(value)))
+        {
+            send("info string cannot load network " + std::string(value) + ", keeping " + nnue::network_name());
+            return;
+        }
+        send_network();
+    }
+    else if (equals_ignore_case(name, "UseNNUE"))
+    {
+        nnue::set_enabled(value == "true");
+    }
+    else if (equals_ignore_case(name, "OwnBook"))
+    {
+        m_own_book = value == "true";
+    }
+    else if (equals_ignore_case(name, "BookFile"))
+    {
+        if (value.empty() || value == "<empty>")
+        {
+            m_service.set_book(nullptr);
+        }
+        else if (!load_book(std::string(value)))
+        {
+            send("info string cannot open book " + std::string(value));
+        }
+    }
+    else if (equals_ignore_case(name, "TablebasePath"))
+    {
+        if (value.empty() || value == "<empty>")
+        {
+            tb::unload();
+            return;
+        }
+        auto tables = tb::load(std::string(value));
+        send("info string " + std::to_string(tables) + " tablebases in " + std::string(value) +
+             ", up to " + std::to_string(tb::largest()) + " pieces");
+    }
+    else
+    {
+        send("info string unknown option " + std::string(name));
+    }
+}
+
+void uci_session::set_position(std::string_view line)
+{
+    auto tokens = split(line);
+    std::size_t i = 1;
+
+    if (i < tokens.size() && tokens[i] == "startpos")
+    {
+        m_position.set_fen(position::start_fen);
+        ++i;
+    }
+    else if (i < tokens.size() && tokens[i] == "fen")
+    {
+        auto fen = std::string{};
+        for (++i; i < tokens.size() && tokens[i] != "moves"; ++i)
+        {
+            fen += std::string(tokens[i]) + " ";
+        }
+        if (!m_position.set_fen(fen))
+        {
+            send("info string invalid fen " + fen);
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    if (i < tokens.size() && tokens[i] == "moves")
+    {
+        for (++i; i < tokens.size(); ++i)
+        {
+            auto m = parse_uci(m_position, tokens[i]);
+            if (m == no_move)
+            {
+                send("info string illegal move " + std::string(tokens[i]));
+                return;
+            }
+            m_position.make_move(m);
+        }
+    }
+}
+
+bool uci_session::load_book(const std::string &path)
+{
+    auto book = std::make_shared<opening_book>();
+    if (!book->open(path))
+    {
+        return false;
+    }
+    return m_service.set_book(std::move(book));
+}
+
+void uci_session::go(std::string_view line)
+{
+    auto tokens = split(line);
+    auto limits = search_limits{};
+    std::int64_t time[2] = {0, 0};
+    std::int64_t increment[2] = {0, 0};
+    std::int64_t moves_to_go = 0;
+    auto has_clock = false;
+
+    m_infinite = false;
+    for (std::size_t i = 1; i < tokens.size(); ++i)
+    {
+        auto token = tokens[i];
+        auto has_value = i + 1 < tokens.size();
+
+        if (token == "infinite")
+        {
+            m_infinite = true;
+        }
+        else if (token == "ponder")
+        {
+            limits.ponder = true;
+        }
+        else if (!has_value)
+        {
+            break;
+        }
+        else if (token == "wtime" || token == "btime")
+        {
+            time[token == "wtime" ? white : black] = to_int(tokens[++i]);
+            has_clock = true;
+        }
+        else if (token == "winc" || token == "binc")
+        {
+            increment[token == "winc" ? white : black] = to_int(tokens[++i]);
+        }
+        else if (token == "movestogo")
+        {
+            moves_to_go = to_int(tokens[++i]);
+        }
+        else if (token == "depth")
+        {
+            limits.depth = int(std::clamp<std::int64_t>(to_int(tokens[++i]), 1, max_search_ply - 1));
+        }
+        else if (token == "nodes")
+        {
+            limits.nodes = std::uint64_t(std::max<std::int64_t>(to_int(tokens[++i]), 1));
+        }
+        else if (token == "movetime")
+        {
+            limits.movetime = std::chrono::milliseconds{std::max<std::int64_t>(to_int(tokens[++i]), 1)};
+        }
+    }
+
+    if (has_clock && limits.movetime.count() == 0)
+    {
+        auto us = m_position.side_to_move();
+        limits.movetime = std::chrono::milliseconds{time_for_move(time[us], increment[us], moves_to_go)};
+    }
+
+    // an infinite or ponder search is for analysis, the GUI wants lines
+    limits.book = m_own_book && !m_infinite && !limits.ponder;
+    limits.tablebase = !m_infinite && !limits.ponder;
+
+    m_stop_received = false;
+    m_has_deferred = false;
+    if (m_service.go(m_position, limits) == 0)
+    {
+        send("info string engine busy, go ignored");
+    }
+}
+
+void uci_session::send(const std::string &line)
+{
+    std::fputs(line.c_str(), m_out);
+    std::fputc('\n', m_out);
+    std::fflush(m_out);
+}
+
+void uci_session::send_network()
+{
+    if (nnue::enabled())
+    {
+        send("info string evaluation nnue " + nnue::network_name() + " " +
+             nnue::simd_level_name(nnue::active_simd_level()));
+    }
+    else
+    {
+        send("info string evaluation handcrafted");
+    }
+}
+
+void uci_session::send_info(const search_info &info)
+{
+    auto line = "info depth " + std::to_string(info.depth) +
+                " seldepth " + std::to_string(info.seldepth) +
+                (is_mate_score(info.score) ? " score mate " + std::to_string(mate_in(info.score))
+                                           : " score cp " + std::to_string(info.score)) +
+                " nodes " + std::to_string(info.nodes) +
+                " nps " + std::to_string(info.nps) +
+                " hashfull " + std::to_string(info.hashfull) +
+                " tbhits " + std::to_string(info.tbhits) +
+                " time " + std::to_string(info.time.count()) +
+                " pv";
+    for (auto m : info.pv)
+    {
+        line += " " + to_uci(m);
+    }
+    send(line);
+}
+
+void uci_session::send_bestmove(const search_result &result)
+{
+    if (result.from_book)
+    {
+        send("info string book move " + to_uci(result.best));
+    }
+    else if (result.from_tablebase)
+    {
+        send("info string tablebase move " + to_uci(result.best));
+    }
+    auto line = "bestmove " + (result.best == no_move ? std::string("0000") : to_uci(result.best));
+    if (result.ponder != no_move)
+    {
+        line += " ponder " + to_uci(result.ponder);
+    }
+    send(line);
+}
@@ -0,0 +1,246 @@
+#include "game/chess/match.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "game/chess/nnue.hpp"
+#include "game/chess/tablebase.hpp"
+
+// plays the engine against itself, both sides in this process.
+//
+//   cpp_chess_match [--games n] [--concurrency n] [--openings file.epd|file.pgn]
+//                   [--plies n] [--max-plies n] [--tablebases dir]
+//                   [--sprt elo0 elo1] [--alpha a] [--beta b]
+//                   [--engine1 key=value,...] [--engine2 key=value,...]
+//
+// An engine is set with `name`, `nodes`, `movetime` (ms), `depth`, `hash`
+// (MB), `eval` (nnue or classic) and `tb` (on or off), e.g.
+// `--engine1 name=classic,eval=classic --engine2 name=nnue,nodes=20000`.
+// The default is 10000 nodes per move. `--plies` is how far the games of a
+// PGN of openings are played, 8 by default.
+
+namespace
+{
+    using namespace chess;
+
+    // the whole argument as a number, false on anything else
+    template <typename T>
+    bool parse_number(std::string_view text, T &value)
+    {
+        auto end = text.data() + text.size();
+        auto [last, error] = std::from_chars(text.data(), end, value);
+        return error == std::errc{} && last == end;
+    }
+
+    int usage()
+    {
+        std::fprintf(stderr, "usage: cpp_chess_match [--games n] [--concurrency n] [--openings file] [--plies n] "
+                             "[--max-plies n] [--tablebases dir] [--sprt elo0 elo1] [--alpha a] [--beta b] "
+                             "[--engine1 key=value,...] [--engine2 key=value,...]\n");
+        return 1;
+    }
+
+    bool set_engine(std::string_view settings, match_engine &engine)
+    {
+        while (!settings.empty())
+        {
+            auto comma = std::min(settings.find(','), settings.size());
+            auto setting = settings.substr(0, comma);
+            settings.remove_prefix(std::min(comma + 1, settings.size()));
+
+            auto equals = setting.find('=');
+            if (equals == std::string_view::npos)
+            {
+                return false;
+            }
+            auto key = setting.substr(0, equals);
+            auto value = setting.substr(equals + 1);
+            auto number = 0LL;
+            if (key == "name")
+            {
+                engine.name = std::string(value);
+            }
+            else if (key == "nodes" && parse_number(value, number))
+            {
+                engine.limits.nodes = std::uint64_t(std::max(number, 1LL));
+            }
+            else if (key == "movetime" && parse_number(value, number))
+            {
+                engine.limits.movetime = std::chrono::milliseconds{std::max(number, 1LL)};
+            }
+            else if (key == "depth" && parse_number(value, number))
+            {
+                engine.limits.depth = int(std::clamp<long long>(number, 1, max_search_ply - 1));
+            }
+            else if (key == "hash" && parse_number(value, number))
+            {
+                engine.hash_mb = std::size_t(std::max(number, 1LL));
+            }
+            else if (key == "eval")
+            {
+                engine.limits.nnue = value != "classic";
+            }
+            else if (key == "tb")
+            {
+                engine.limits.tablebase = value != "off";
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // every limit given replaces the default node budget
+    void clear_default_budget(std::string_view settings, match_engine &engine)
+    {
+        if (settings.find("nodes=") == std::string_view::npos &&
+            (settings.find("movetime=") != std::string_view::npos || settings.find("depth=") != std::string_view::npos))
+        {
+            engine.limits.nodes = 0;
+        }
+    }
+
+    void print_score(const match_stats &stats, const match_options &options)
+    {
+        std::printf("games %5d  +%d =%d -%d  elo %+.1f +- %.1f", stats.games, stats.wins, stats.draws, stats.losses,
+                    elo_difference(stats), elo_error(stats));
+        if (options.sprt)
+        {
+            std::printf("  llr %.2f (%.2f, %.2f)", stats.llr, sprt_lower(options.bounds), sprt_upper(options.bounds));
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto options = match_options{.concurrency = int(std::max(std::thread::hardware_concurrency(), 1u))};
+    options.engines[0].name = "engine1";
+    options.engines[1].name = "engine2";
+    auto openings_file = std::string{};
+    auto plies = 8;
+    auto tablebases = std::string(tb::default_directory);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        auto has_value = i + 1 < argc;
+        if (arg == "--games" && has_value && parse_number(argv[++i], options.games))
+        {
+            options.games = std::max(options.games, 1);
+        }
+        else if (arg == "--concurrency" && has_value && parse_number(argv[++i], options.concurrency))
+        {
+            options.concurrency = std::max(options.concurrency, 1);
+        }
+        else if (arg == "--openings" && has_value)
+        {
+            openings_file = argv[++i];
+        }
+        else if (arg == "--plies" && has_value && parse_number(argv[++i], plies))
+        {
+            plies = std::max(plies, 0);
+        }
+        else if (arg == "--max-plies" && has_value && parse_number(argv[++i], options.max_plies))
+        {
+            options.max_plies = std::max(options.max_plies, 1);
+        }
+        else if (arg == "--tablebases" && has_value)
+        {
+            tablebases = argv[++i];
+        }
+        else if (arg == "--sprt" && i + 2 < argc && parse_number(argv[i + 1], options.bounds.elo0) &&
+                 parse_number(argv[i + 2], options.bounds.elo1))
+        {
+            options.sprt = true;
+            i += 2;
+        }
+        else if (arg == "--alpha" && has_value && parse_number(argv[++i], options.bounds.alpha))
+        {
+            options.bounds.alpha = std::clamp(options.bounds.alpha, 1e-6, 0.5);
+        }
+        else if (arg == "--beta" && has_value && parse_number(argv[++i], options.bounds.beta))
+        {
+            options.bounds.beta = std::clamp(options.bounds.beta, 1e-6, 0.5);
+        }
+        else if ((arg == "--engine1" || arg == "--engine2") && has_value)
+        {
+            auto &engine = options.engines[arg == "--engine1" ? 0 : 1];
+            auto settings = std::string_view(argv[++i]);
+            clear_default_budget(settings, engine);
+            if (!set_engine(settings, engine))
+            {
+                std::fprintf(stderr, "invalid engine settings %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
+    init_attacks();
+    nnue::load_network(std::string(nnue::default_file));
+    auto tables = tb::load(tablebases);
+
+    if (!openings_file.empty() && !load_openings(openings_file, plies, options.openings))
+    {
+        std::fprintf(stderr, "cannot read openings %s\n", openings_file.c_str());
+        return 1;
+    }
+    if (options.openings.empty())
+    {
+        // with node budgets the games of a pair of colors repeat each other
+        std::fprintf(stderr, "no openings, every game starts from the start position\n");
+    }
+
+    std::printf("%s vs %s: %d games, %d at a time, %zu openings, %d tablebases\n",
+                options.engines[0].name.c_str(), options.engines[1].name.c_str(), options.games, options.concurrency,
+                options.openings.size(), tables);
+    if (options.sprt)
+    {
+        std::printf("sprt elo0 %.1f elo1 %.1f alpha %.3f beta %.3f\n", options.bounds.elo0, options.bounds.elo1,
+                    options.bounds.alpha, options.bounds.beta);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto report_every = std::max(options.games / 50, 1);
+    auto stats = play_match(options, [&](const match_stats &current)
+                            {
+                                if (current.games % report_every == 0)
+                                {
+                                    print_score(current, options);
+                                } });
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    print_score(stats, options);
+    if (options.sprt)
+    {
+        std::printf("sprt: %s\n", stats.sprt == sprt_state::accept_h1   ? "H1 accepted"
+                                  : stats.sprt == sprt_state::accept_h0 ? "H0 accepted"
+                                                                        : "inconclusive");
+    }
+    std::printf("%d games in %.1f s (%.2f games/s), %d adjudicated\n", stats.games, seconds,
+                double(stats.games) / std::max(seconds, 1e-9), stats.adjudicated);
+
+    std::printf("%-12s %10s %12s %10s %10s %10s %8s\n", "engine", "moves", "nodes/move", "nps", "ms/move", "max ms", "depth");
+    for (std::size_t i = 0; i < stats.engines.size(); ++i)
+    {
+        const auto &engine = stats.engines[i];
+        auto moves = double(std::max<std::uint64_t>(engine.moves, 1));
+        std::printf("%-12s %10llu %12.0f %10.0f %10.2f %10.2f %8.1f\n", options.engines[i].name.c_str(),
+                    static_cast<unsigned long long>(engine.moves), double(engine.nodes) / moves,
+                    double(engine.nodes) * 1e6 / double(std::max<std::uint64_t>(engine.microseconds, 1)),
+                    double(engine.microseconds) / moves / 1e3, double(engine.max_microseconds) / 1e3,
+                    double(engine.depth) / moves);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "game/chess/uci.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "engine/spsc_queue.hpp"
+#include "game/chess/nnue.hpp"
+
+// UCI engine over stdin/stdout, for GUIs and batch analysis.
+//
+// stdin is read by its own thread, the main thread never blocks on input:
+// it forwards each line to the session as soon as it arrives and prints the
+// search results in between, so `stop` reaches a running search within a
+// fraction of a millisecond.
+
+namespace
+{
+    // between the reader thread and the main thread
+    spsc_queue<std::string, 256> input;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+
+    void read_input()
+    {
+        auto line = std::string{};
+        auto quit = false;
+
+        while (!quit)
+        {
+            // end of input is a quit
+            if (!std::getline(std::cin, line))
+            {
+                line = "quit";
+            }
+            quit = line.rfind("quit", 0) == 0;
+
+            while (!input.try_push(std::move(line)))
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+            wake.notify_one();
+        }
+    }
+}
+
+int main()
+{
+    std::ios::sync_with_stdio(false);
+
+    // a trained network next to the engine replaces the bundled one
+    chess::nnue::load_network(std::string(chess::nnue::default_file));
+
+    auto session = chess::uci_session{stdout};
+    auto reader = std::thread{read_input};
+
+    auto line = std::string{};
+    auto running = true;
+    while (running)
+    {
+        auto busy = false;
+        while (running && input.try_pop(line))
+        {
+            running = session.handle(line);
+            busy = true;
+        }
+        busy |= session.poll();
+
+        if (!busy)
+        {
+            // woken at once by input, the timeout bounds the latency of the
+            // search results
+            auto lock = std::unique_lock{wake_mutex};
+            wake.wait_for(lock, std::chrono::microseconds{200});
+        }
+    }
+
+    reader.join();
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "game/chess/game_db.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// builds and queries the game database.
+//
+//   game_db build <file.pgn> <name> [--threads n] [--memory mb] [--temp dir]
+//   game_db query <name> [startpos | fen <fen>] [moves <uci moves>]
+//
+// `build` writes <name>.cdb and <name>.cdx, `query` lists the games
+// reaching the position.
+
+namespace
+{
+    using namespace chess;
+
+    constexpr std::size_t listed_games = 10;
+
+    // the whole argument as a number, false on anything else
+    template <typename T>
+    bool parse_number(std::string_view text, T &value)
+    {
+        auto end = text.data() + text.size();
+        auto [last, error] = std::from_chars(text.data(), end, value);
+        return error == std::errc{} && last == end;
+    }
+
+    const char *result_name(game_result result)
+    {
+        switch (result)
+        {
+        case game_result::white_wins:
+            return "1-0";
+        case game_result::black_wins:
+            return "0-1";
+        case game_result::draw:
+            return "1/2-1/2";
+        default:
+            return "*";
+        }
+    }
+
+    int build(int argc, char *argv[])
+    {
+        auto usage = [] {
+            std::fprintf(stderr, "usage: game_db build <file.pgn> <name> [--threads n] [--memory mb] [--temp dir]\n");
+            return 1;
+        };
+        if (argc < 4)
+        {
+            return usage();
+        }
+
+        auto options = game_db_build_options{.threads = int(std::max(std::thread::hardware_concurrency(), 1u))};
+        for (int i = 4; i + 1 < argc; i += 2)
+        {
+            auto arg = std::string(argv[i]);
+            if (arg == "--threads" && parse_number(argv[i + 1], options.threads))
+            {
+                options.threads = std::max(options.threads, 1);
+            }
+            else if (arg == "--memory" && parse_number(argv[i + 1], options.memory_mb))
+            {
+                options.memory_mb = std::max<std::size_t>(options.memory_mb, 1);
+            }
+            else if (arg == "--temp")
+            {
+                options.temp_dir = argv[i + 1];
+            }
+            else
+            {
+                return usage();
+            }
+        }
+
+        init_attacks();
+        auto start = std::chrono::steady_clock::now();
+
+        auto pgn = mapped_file{};
+        if (!pgn.open(argv[2]))
+        {
+            std::fprintf(stderr, "cannot map %s\n", argv[2]);
+            return 1;
+        }
+
+        auto stats = game_db_build_stats{};
+        if (!build_game_database(pgn.text(), argv[3], options, stats))
+        {
+            std::fprintf(stderr, "cannot write %s\n", argv[3]);
+            return 1;
+        }
+
+        auto seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-9);
+        auto megabytes = double(pgn.size()) / (1024.0 * 1024.0);
+        std::printf("%s: %.1f MB of PGN, %d threads, %zu MB for the index runs\n",
+                    argv[2], megabytes, options.threads, options.memory_mb);
+        std::printf("games      %12llu  (%llu skipped)\n",
+                    static_cast<unsigned long long>(stats.games), static_cast<unsigned long long>(stats.skipped));
+        std::printf("positions  %12llu  in %llu sorted runs\n",
+                    static_cast<unsigned long long>(stats.positions), static_cast<unsigned long long>(stats.runs));
+        std::printf("games file %12.1f MB  (%.1f%% of the PGN)\n",
+                    double(stats.games_bytes) / (1024.0 * 1024.0), 100.0 * double(stats.games_bytes) / double(std::max<std::size_t>(pgn.size(), 1)));
+        std::printf("index file %12.1f MB\n", double(stats.index_bytes) / (1024.0 * 1024.0));
+        std::printf("time       %12.3f s  (%.0f games/s, %.1f MB/s)\n", seconds, double(stats.games) / seconds, megabytes / seconds);
+        return 0;
+    }
+
+    int query(int argc, char *argv[])
+    {
+        if (argc < 3)
+        {
+            std::fprintf(stderr, "usage: game_db query <name> [startpos | fen <fen>] [moves <uci moves>]\n");
+            return 1;
+        }
+
+        auto name = std::string(argv[2]);
+        auto games = game_database{};
+        auto index = position_index{};
+        if (!games.open(name + ".cdb") || !index.open(name + ".cdx"))
+        {
+            std::fprintf(stderr, "cannot open %s.cdb and %s.cdx\n", name.c_str(), name.c_str());
+            return 1;
+        }
+
+        auto pos = std::make_unique<position>();
+        int i = 3;
+        if (i < argc && std::string(argv[i]) == "fen")
+        {
+            auto fen = std::string{};
+            for (++i; i < argc && std::string(argv[i]) != "moves"; ++i)
+            {
+                fen += std::string(argv[i]) + " ";
+            }
+            if (!pos->set_fen(fen))
+            {
+                std::fprintf(stderr, "invalid fen %s\n", fen.c_str());
+                return 1;
+            }
+        }
+        else if (i < argc && std::string(argv[i]) == "startpos")
+        {
+            ++i;
+        }
+        if (i < argc && std::string(argv[i]) == "moves")
+        {
+            for (++i; i < argc; ++i)
+            {
+                auto m = parse_uci(*pos, argv[i]);
+                if (m == no_move)
+                {
+                    std::fprintf(stderr, "illegal move %s\n", argv[i]);
+                    return 1;
+                }
+                pos->make_move(m);
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto range = index.find(pos->key());
+        auto micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%s\n%zu of %u games reach the position, found in %.1f us\n",
+                    pos->fen().c_str(), range.size(), games.size(), micros);
+
+        auto game = game_record{};
+        auto replayed = std::make_unique<position>();
+        for (auto entry = range.begin; entry < range.end && entry < range.begin + listed_games; ++entry)
+        {
+            auto number = index.game_at(entry);
+            if (!games.read_game(number, game, *replayed))
+            {
+                std::printf("  #%u: corrupt\n", number);
+                continue;
+            }
+            std::printf("  #%u %s - %s, %s %s, %zu plies, %s\n", number, game.white.c_str(), game.black.c_str(),
+                        game.event.c_str(), game.date.c_str(), game.moves.size(), result_name(game.result));
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto command = argc > 1 ? std::string(argv[1]) : std::string{};
+    if (command == "build")
+    {
+        return build(argc, argv);
+    }
+    if (command == "query")
+    {
+        return query(argc, argv);
+    }
+
+    std::fprintf(stderr, "usage: game_db build <file.pgn> <name> [options] | game_db query <name> [position]\n");
+    return 1;
+}
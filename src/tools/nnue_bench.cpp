@@ -0,0 +1,221 @@
+#include "game/chess/eval.hpp"
+#include "game/chess/movegen.hpp"
+#include "game/chess/nnue.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// evaluations per second of the network for each instruction set the CPU
+// supports, next to the handcrafted evaluation. The positions are the
+// leaves of random games: every legal move of every ply is made, evaluated
+// and unmade, as in the last ply of a search.
+//
+// Every instruction set must give the scores of the scalar code, and the
+// incremental updates the scores from scratch: the bench exits with 1
+// otherwise.
+//
+//   nnue_bench [--file network] [--write path] [--evals count]
+
+namespace
+{
+    using namespace chess;
+
+    constexpr const char *bench_fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+    };
+    constexpr int games_per_fen = 8;
+    constexpr int plies_per_game = 60;
+
+    struct game
+    {
+        const char *fen;
+        std::vector<move> moves;
+    };
+
+    enum class method
+    {
+        handcrafted,
+        refresh,
+        incremental,
+    };
+
+    // the same games on every run
+    std::vector<game> random_games()
+    {
+        auto rng = std::mt19937_64{20240601};
+        auto games = std::vector<game>{};
+        auto pos = std::make_unique<position>();
+
+        for (const auto *fen : bench_fens)
+        {
+            for (int g = 0; g < games_per_fen; ++g)
+            {
+                pos->set_fen(fen);
+                auto &played = games.emplace_back(game{.fen = fen, .moves = {}});
+
+                move_list list;
+                for (int ply = 0; ply < plies_per_game; ++ply)
+                {
+                    generate_legal(*pos, list);
+                    if (list.empty() || pos->is_draw())
+                    {
+                        break;
+                    }
+                    auto m = list[rng() % list.size()];
+                    pos->make_move(m);
+                    played.moves.push_back(m);
+                }
+            }
+        }
+        return games;
+    }
+
+    // scores of every leaf, in order
+    void walk(const std::vector<game> &games, method how, nnue::evaluator &evaluator, position &pos, std::vector<int> &scores)
+    {
+        move_list list;
+        for (const auto &played : games)
+        {
+            pos.set_fen(played.fen);
+            evaluator.reset(pos);
+
+            for (auto next : played.moves)
+            {
+                generate_legal(pos, list);
+                for (auto m : list)
+                {
+                    pos.make_move(m);
+                    evaluator.push(pos);
+                    switch (how)
+                    {
+                    case method::handcrafted:
+                        scores.push_back(evaluate(pos));
+                        break;
+                    case method::refresh:
+                        scores.push_back(nnue::evaluate(pos));
+                        break;
+                    case method::incremental:
+                        scores.push_back(evaluator.evaluate(pos));
+                        break;
+                    }
+                    evaluator.pop();
+                    pos.unmake_move(m);
+                }
+
+                pos.make_move(next);
+                evaluator.push(pos);
+            }
+        }
+    }
+
+    // evaluations per second over at least `min_evals` evaluations
+    double measure(const std::vector<game> &games, method how, nnue::evaluator &evaluator, position &pos,
+                   std::size_t min_evals, std::vector<int> &scores)
+    {
+        auto evals = std::size_t{0};
+        auto start = std::chrono::steady_clock::now();
+        while (evals < min_evals)
+        {
+            scores.clear();
+            walk(games, how, evaluator, pos, scores);
+            evals += scores.size();
+        }
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return double(evals) / std::max(seconds, 1e-9);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto file = std::string{};
+    std::size_t min_evals = 2'000'000;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        auto arg = std::string(argv[i]);
+        if (arg == "--file")
+        {
+            file = argv[i + 1];
+        }
+        else if (arg == "--write")
+        {
+            if (!nnue::write_bundled_network(argv[i + 1]))
+            {
+                std::fprintf(stderr, "cannot write %s\n", argv[i + 1]);
+                return 1;
+            }
+            std::printf("bundled network written to %s\n", argv[i + 1]);
+            return 0;
+        }
+        else if (arg == "--evals")
+        {
+            min_evals = std::stoull(argv[i + 1]);
+        }
+    }
+
+    if (!file.empty() && !nnue::load_network(file))
+    {
+        std::fprintf(stderr, "cannot load network %s\n", file.c_str());
+        return 1;
+    }
+
+    auto games = random_games();
+    // both are too large for the stack
+    auto pos = std::make_unique<position>();
+    auto evaluator = std::make_unique<nnue::evaluator>();
+
+    auto reference = std::vector<int>{};
+    auto scores = std::vector<int>{};
+    nnue::set_simd_level(nnue::simd_level::scalar);
+    walk(games, method::refresh, *evaluator, *pos, reference);
+
+    auto handcrafted = std::vector<int>{};
+    auto handcrafted_rate = measure(games, method::handcrafted, *evaluator, *pos, min_evals, handcrafted);
+    double difference = 0.0;
+    for (std::size_t i = 0; i < reference.size(); ++i)
+    {
+        difference += std::abs(reference[i] - handcrafted[i]);
+    }
+
+    std::printf("network: %s, %zu leaves of %zu random games\n", nnue::network_name().c_str(), reference.size(), games.size());
+    std::printf("mean difference to the handcrafted evaluation: %.1f cp\n\n", difference / double(reference.size()));
+    std::printf("%-12s %16s %16s %9s\n", "evaluation", "refresh/s", "incremental/s", "speedup");
+    std::printf("%-12s %16s %16.0f\n", "handcrafted", "-", handcrafted_rate);
+
+    auto failed = false;
+    double scalar_rate = 0.0;
+    for (auto level : {nnue::simd_level::scalar, nnue::simd_level::sse41, nnue::simd_level::avx2})
+    {
+        if (!nnue::set_simd_level(level))
+        {
+            std::printf("%-12s %16s\n", nnue::simd_level_name(level), "unsupported");
+            continue;
+        }
+
+        auto refresh_rate = measure(games, method::refresh, *evaluator, *pos, min_evals / 4, scores);
+        auto refresh_ok = scores == reference;
+        auto incremental_rate = measure(games, method::incremental, *evaluator, *pos, min_evals, scores);
+        auto incremental_ok = scores == reference;
+        if (level == nnue::simd_level::scalar)
+        {
+            scalar_rate = incremental_rate;
+        }
+
+        std::printf("%-12s %16.0f %16.0f %8.2fx%s\n", nnue::simd_level_name(level), refresh_rate, incremental_rate,
+                    incremental_rate / std::max(scalar_rate, 1.0),
+                    refresh_ok && incremental_ok ? "" : "  MISMATCH");
+        failed |= !refresh_ok || !incremental_ok;
+    }
+
+    return failed ? 1 : 0;
+}
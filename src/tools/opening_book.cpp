@@ -0,0 +1,155 @@
+#include "game/chess/book.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+// builds and probes the opening book.
+//
+//   opening_book build <file.pgn> <book.bin> [--threads n] [--plies n] [--min-games n]
+//   opening_book probe <book.bin> [startpos | fen <fen>] [moves <uci moves>]
+//
+// `probe` lists the book moves of the position with their weights and the
+// time the lookup took.
+
+namespace
+{
+    using namespace chess;
+
+    int build(int argc, char *argv[])
+    {
+        if (argc < 4)
+        {
+            std::fprintf(stderr, "usage: opening_book build <file.pgn> <book.bin> [--threads n] [--plies n] [--min-games n]\n");
+            return 1;
+        }
+
+        auto options = book_build_options{.threads = int(std::max(std::thread::hardware_concurrency(), 1u))};
+        for (int i = 4; i + 1 < argc; i += 2)
+        {
+            auto arg = std::string(argv[i]);
+            if (arg == "--threads")
+            {
+                options.threads = std::max(std::stoi(argv[i + 1]), 1);
+            }
+            else if (arg == "--plies")
+            {
+                options.max_ply = std::max(std::stoi(argv[i + 1]), 1);
+            }
+            else if (arg == "--min-games")
+            {
+                options.min_games = std::uint32_t(std::max(std::stoi(argv[i + 1]), 1));
+            }
+        }
+
+        init_attacks();
+        auto start = std::chrono::steady_clock::now();
+
+        auto pgn = mapped_file{};
+        if (!pgn.open(argv[2]))
+        {
+            std::fprintf(stderr, "cannot map %s\n", argv[2]);
+            return 1;
+        }
+
+        auto stats = book_build_stats{};
+        if (!build_opening_book(pgn.text(), argv[3], options, stats))
+        {
+            std::fprintf(stderr, "cannot write %s\n", argv[3]);
+            return 1;
+        }
+
+        auto seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-9);
+        std::printf("%s: %.1f MB of PGN, %d threads, first %d plies, moves of %u games or more\n",
+                    argv[2], double(pgn.size()) / (1024.0 * 1024.0), options.threads, options.max_ply, options.min_games);
+        std::printf("games      %12llu  (%llu with an illegal move)\n",
+                    static_cast<unsigned long long>(stats.games), static_cast<unsigned long long>(stats.skipped));
+        std::printf("positions  %12llu\n", static_cast<unsigned long long>(stats.positions));
+        std::printf("entries    %12llu  (%.1f MB)\n", static_cast<unsigned long long>(stats.entries),
+                    double(stats.entries * 16) / (1024.0 * 1024.0));
+        std::printf("time       %12.3f s  (%.0f games/s)\n", seconds, double(stats.games) / seconds);
+        return 0;
+    }
+
+    int probe(int argc, char *argv[])
+    {
+        if (argc < 3)
+        {
+            std::fprintf(stderr, "usage: opening_book probe <book.bin> [startpos | fen <fen>] [moves <uci moves>]\n");
+            return 1;
+        }
+
+        auto book = opening_book{};
+        if (!book.open(argv[2]))
+        {
+            std::fprintf(stderr, "cannot open book %s\n", argv[2]);
+            return 1;
+        }
+
+        init_attacks();
+        auto pos = std::make_unique<position>();
+        int i = 3;
+        if (i < argc && std::string(argv[i]) == "fen")
+        {
+            auto fen = std::string{};
+            for (++i; i < argc && std::string(argv[i]) != "moves"; ++i)
+            {
+                fen += std::string(argv[i]) + " ";
+            }
+            if (!pos->set_fen(fen))
+            {
+                std::fprintf(stderr, "invalid fen %s\n", fen.c_str());
+                return 1;
+            }
+        }
+        else if (i < argc && std::string(argv[i]) == "startpos")
+        {
+            ++i;
+        }
+        if (i < argc && std::string(argv[i]) == "moves")
+        {
+            for (++i; i < argc; ++i)
+            {
+                auto m = parse_uci(*pos, argv[i]);
+                if (m == no_move)
+                {
+                    std::fprintf(stderr, "illegal move %s\n", argv[i]);
+                    return 1;
+                }
+                pos->make_move(m);
+            }
+        }
+
+        auto moves = book_moves{};
+        auto start = std::chrono::steady_clock::now();
+        book.probe(*pos, moves);
+        auto micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%s\n%zu book moves of %zu entries, found in %.1f us\n", pos->fen().c_str(), moves.size(), book.size(), micros);
+        for (const auto &entry : moves)
+        {
+            std::printf("  %-8s %-6s weight %5u  %5.1f%%  %u games\n", to_san(*pos, entry.m).c_str(), to_uci(entry.m).c_str(),
+                        entry.weight, 100.0 * entry.weight / moves.total_weight, entry.games);
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto command = argc > 1 ? std::string(argv[1]) : std::string{};
+    if (command == "build")
+    {
+        return build(argc, argv);
+    }
+    if (command == "probe")
+    {
+        return probe(argc, argv);
+    }
+
+    std::fprintf(stderr, "usage: opening_book build <file.pgn> <book.bin> [options] | opening_book probe <book.bin> [position]\n");
+    return 1;
+}
@@ -0,0 +1,175 @@
+#include "game/chess/movegen.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// validates the move generator against the published perft counts of the
+// standard test positions and reports nodes per second.
+//
+//   perft [depth] [--backend magic|pext]     standard positions up to depth
+//   perft --fen "<fen>" <depth>              nodes below each root move
+
+namespace
+{
+    using namespace chess;
+
+    // the whole argument as a number, false on anything else
+    template <typename T>
+    bool parse_number(std::string_view text, T &value)
+    {
+        auto end = text.data() + text.size();
+        auto [last, error] = std::from_chars(text.data(), end, value);
+        return error == std::errc{} && last == end;
+    }
+
+    int usage()
+    {
+        std::fprintf(stderr, "usage: perft [depth] [--backend magic|pext] | perft --fen \"<fen>\" <depth>\n");
+        return 1;
+    }
+
+    struct perft_position
+    {
+        const char *name;
+        const char *fen;
+        std::vector<std::uint64_t> nodes;
+    };
+
+    const std::vector<perft_position> &standard_positions()
+    {
+        static const auto positions = std::vector<perft_position>{
+            {"start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+             {20, 400, 8'902, 197'281, 4'865'609, 119'060'324}},
+            {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+             {48, 2'039, 97'862, 4'085'603, 193'690'690}},
+            {"pos3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+             {14, 191, 2'812, 43'238, 674'624, 11'030'083}},
+            {"pos4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+             {6, 264, 9'467, 422'333, 15'833'292}},
+            {"pos5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+             {44, 1'486, 62'379, 2'103'487, 89'941'194}},
+            {"pos6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+             {46, 2'079, 89'890, 3'894'594, 164'075'551}},
+        };
+        return positions;
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    int divide(const std::string &fen, int depth)
+    {
+        auto pos = position{};
+        if (!pos.set_fen(fen))
+        {
+            std::fprintf(stderr, "invalid FEN: %s\n", fen.c_str());
+            return 1;
+        }
+
+        move_list list;
+        generate_legal(pos, list);
+
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t total = 0;
+        for (auto m : list)
+        {
+            pos.make_move(m);
+            auto nodes = perft(pos, depth - 1);
+            pos.unmake_move(m);
+
+            total += nodes;
+            std::printf("%s: %llu\n", to_uci(m).c_str(), static_cast<unsigned long long>(nodes));
+        }
+        auto elapsed = seconds_since(start);
+
+        std::printf("\nnodes %llu  %.3f s  %.0f nodes/s\n",
+                    static_cast<unsigned long long>(total), elapsed, double(total) / std::max(elapsed, 1e-9));
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int max_depth = 5;
+    std::string fen;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        if (arg == "--backend" && i + 1 < argc)
+        {
+            auto name = std::string(argv[++i]);
+            auto backend = name == "pext" ? slider_backend::pext : slider_backend::magic;
+            if (!set_slider_backend(backend))
+            {
+                std::fprintf(stderr, "the %s backend is not supported by this CPU\n", name.c_str());
+                return 1;
+            }
+        }
+        else if (arg == "--fen" && i + 1 < argc)
+        {
+            fen = argv[++i];
+        }
+        else if (parse_number(arg, max_depth))
+        {
+            max_depth = std::max(max_depth, 1);
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
+    init_attacks();
+    std::printf("slider backend: %s\n", slider_backend_name(active_slider_backend()));
+
+    if (!fen.empty())
+    {
+        return divide(fen, max_depth);
+    }
+
+    std::printf("\n%-9s %5s %14s %14s %10s %14s\n", "position", "depth", "nodes", "expected", "seconds", "nodes/s");
+
+    auto failures = 0;
+    std::uint64_t total_nodes = 0;
+    double total_seconds = 0.0;
+
+    for (const auto &p : standard_positions())
+    {
+        auto pos = position{};
+        pos.set_fen(p.fen);
+
+        auto depths = std::min<std::size_t>(max_depth, p.nodes.size());
+        for (std::size_t depth = 1; depth <= depths; ++depth)
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto nodes = perft(pos, int(depth));
+            auto elapsed = seconds_since(start);
+
+            auto expected = p.nodes[depth - 1];
+            auto ok = nodes == expected;
+            failures += ok ? 0 : 1;
+            total_nodes += nodes;
+            total_seconds += elapsed;
+
+            std::printf("%-9s %5zu %14llu %14llu %10.3f %14.0f  %s\n",
+                        p.name, depth,
+                        static_cast<unsigned long long>(nodes), static_cast<unsigned long long>(expected),
+                        elapsed, double(nodes) / std::max(elapsed, 1e-9),
+                        ok ? "ok" : "MISMATCH");
+        }
+    }
+
+    std::printf("\n%llu nodes in %.3f s, %.0f nodes/s, %d mismatches\n",
+                static_cast<unsigned long long>(total_nodes), total_seconds,
+                double(total_nodes) / std::max(total_seconds, 1e-9), failures);
+
+    return failures == 0 ? 0 : 1;
+}
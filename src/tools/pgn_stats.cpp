@@ -0,0 +1,160 @@
+#include "game/chess/mapped_file.hpp"
+#include "game/chess/pgn.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// throughput of the PGN reader over a file. The file is mapped and cut at
+// game boundaries, each thread reads its part and plays every move.
+//
+//   pgn_stats <file> [--threads n] [--scan]
+//
+// `--scan` only splits the games and reads their tags, without the moves.
+
+namespace
+{
+    using namespace chess;
+
+    struct part_stats
+    {
+        std::uint64_t games{0};
+        std::uint64_t plies{0};
+        std::uint64_t errors{0};
+        // 1-0, 0-1, 1/2-1/2 and the rest
+        std::uint64_t results[4]{};
+        // offset and move of the first bad game
+        std::size_t first_error_offset{0};
+        std::string first_error;
+    };
+
+    void read_part(std::string_view text, std::size_t base_offset, bool scan, part_stats &stats)
+    {
+        auto reader = pgn_reader{text};
+        auto game = pgn_game{};
+        auto pos = std::make_unique<position>();
+
+        while (reader.next(game))
+        {
+            ++stats.games;
+
+            auto result = game.tag("Result");
+            stats.results[result == "1-0" ? 0 : result == "0-1" ? 1 : result == "1/2-1/2" ? 2 : 3]++;
+            if (scan)
+            {
+                continue;
+            }
+
+            auto replay = replay_game(game, *pos);
+            stats.plies += std::uint64_t(replay.plies);
+            if (!replay.ok)
+            {
+                if (stats.errors++ == 0)
+                {
+                    stats.first_error_offset = base_offset + game.offset;
+                    stats.first_error = replay.error.empty() ? std::string("bad FEN tag") : "bad move " + std::string(replay.error);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: pgn_stats <file> [--threads n] [--scan]\n");
+        return 1;
+    }
+
+    auto path = std::string(argv[1]);
+    int threads = int(std::max(std::thread::hardware_concurrency(), 1u));
+    auto scan = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = std::max(std::stoi(argv[++i]), 1);
+        }
+        else if (arg == "--scan")
+        {
+            scan = true;
+        }
+    }
+
+    // the attack tables take a moment to build, not part of the reading
+    init_attacks();
+    auto start = std::chrono::steady_clock::now();
+
+    auto file = mapped_file{};
+    if (!file.open(path))
+    {
+        std::fprintf(stderr, "cannot map %s\n", path.c_str());
+        return 1;
+    }
+    auto text = file.text();
+
+    auto parts = split_games(text, std::size_t(threads));
+    auto stats = std::vector<part_stats>(parts.size());
+    auto workers = std::vector<std::thread>{};
+    for (std::size_t i = 0; i < parts.size(); ++i)
+    {
+        workers.emplace_back([&, i]()
+                             { read_part(parts[i], std::size_t(parts[i].data() - text.data()), scan, stats[i]); });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    seconds = std::max(seconds, 1e-9);
+
+    auto total = part_stats{};
+    for (const auto &part : stats)
+    {
+        total.games += part.games;
+        total.plies += part.plies;
+        for (int r = 0; r < 4; ++r)
+        {
+            total.results[r] += part.results[r];
+        }
+        if (part.errors > 0 && total.errors == 0)
+        {
+            total.first_error_offset = part.first_error_offset;
+            total.first_error = part.first_error;
+        }
+        total.errors += part.errors;
+    }
+
+    auto megabytes = double(text.size()) / (1024.0 * 1024.0);
+    std::printf("%s: %.1f MB, %zu threads%s\n", path.c_str(), megabytes, parts.size(), scan ? ", tags only" : "");
+    std::printf("games     %12llu  (white %llu, black %llu, draw %llu, other %llu)\n",
+                static_cast<unsigned long long>(total.games),
+                static_cast<unsigned long long>(total.results[0]), static_cast<unsigned long long>(total.results[1]),
+                static_cast<unsigned long long>(total.results[2]), static_cast<unsigned long long>(total.results[3]));
+    if (!scan)
+    {
+        std::printf("plies     %12llu\n", static_cast<unsigned long long>(total.plies));
+        std::printf("errors    %12llu", static_cast<unsigned long long>(total.errors));
+        if (total.errors > 0)
+        {
+            std::printf("  (first at byte %zu: %s)", total.first_error_offset, total.first_error.c_str());
+        }
+        std::printf("\n");
+    }
+    std::printf("time      %12.3f s\n", seconds);
+    std::printf("games/s   %12.0f\n", double(total.games) / seconds);
+    std::printf("MB/s      %12.1f\n", megabytes / seconds);
+    if (!scan)
+    {
+        std::printf("plies/s   %12.0f\n", double(total.plies) / seconds);
+    }
+
+    return total.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#include "game/chess/search.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// nodes per second of the Lazy SMP search from 1 to N threads. Every
+// thread count searches the same positions for a fixed time on a cleared
+// table, the speedup is relative to the single thread.
+//
+//   search_bench [--time ms] [--hash mb] [--threads max]
+
+namespace
+{
+    using namespace chess;
+
+    constexpr const char *bench_fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+    };
+
+    struct bench_row
+    {
+        int threads;
+        std::uint64_t nodes;
+        double seconds;
+        int depth;
+    };
+
+    bench_row run(search_engine &engine, int threads, std::chrono::milliseconds movetime)
+    {
+        engine.set_threads(threads);
+
+        auto row = bench_row{.threads = threads, .nodes = 0, .seconds = 0.0, .depth = 0};
+        for (const auto *fen : bench_fens)
+        {
+            auto pos = position{};
+            pos.set_fen(fen);
+            engine.clear();
+
+            auto result = engine.search(pos, search_limits{.movetime = movetime});
+            row.nodes += result.nodes;
+            row.seconds += double(result.time.count()) / 1000.0;
+            row.depth += result.depth;
+        }
+        return row;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto movetime = std::chrono::milliseconds{1000};
+    std::size_t hash_mb = 64;
+    int max_threads = int(std::max(std::thread::hardware_concurrency(), 1u));
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        auto arg = std::string(argv[i]);
+        if (arg == "--time")
+        {
+            movetime = std::chrono::milliseconds{std::max(std::stoi(argv[i + 1]), 1)};
+        }
+        else if (arg == "--hash")
+        {
+            hash_mb = std::stoul(argv[i + 1]);
+        }
+        else if (arg == "--threads")
+        {
+            max_threads = std::max(std::stoi(argv[i + 1]), 1);
+        }
+    }
+
+    auto engine = search_engine{};
+    engine.set_hash_size(hash_mb);
+
+    std::printf("slider backend: %s, hash %zu MB, %lld ms per position\n\n",
+                slider_backend_name(active_slider_backend()), engine.hash_size(),
+                static_cast<long long>(movetime.count()));
+    std::printf("%-7s %14s %14s %9s %11s %10s\n", "threads", "nodes", "nodes/s", "speedup", "efficiency", "avg depth");
+
+    // powers of two, and the core count when it is not one
+    auto counts = std::vector<int>{};
+    for (int t = 1; t < max_threads; t *= 2)
+    {
+        counts.push_back(t);
+    }
+    counts.push_back(max_threads);
+
+    double single_nps = 0.0;
+    for (auto threads : counts)
+    {
+        auto row = run(engine, threads, movetime);
+        auto nps = double(row.nodes) / std::max(row.seconds, 1e-9);
+        if (threads == 1)
+        {
+            single_nps = nps;
+        }
+
+        auto speedup = nps / std::max(single_nps, 1.0);
+        std::printf("%-7d %14llu %14.0f %8.2fx %10.0f%% %10.1f\n",
+                    threads, static_cast<unsigned long long>(row.nodes), nps,
+                    speedup, 100.0 * speedup / threads,
+                    double(row.depth) / double(std::size(bench_fens)));
+    }
+
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include "game/chess/tablebase.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include "game/chess/movegen.hpp"
+
+// generates and probes the endgame tablebases.
+//
+//   tablebase generate <dir> [--pieces n] [--threads n] [material ...]
+//   tablebase probe <dir> [startpos | fen <fen>] [moves <uci moves>]
+//   tablebase bench <dir> [--probes n] [--threads n]
+//
+// `generate` writes every table of 3 to n pieces (4 by default) missing in
+// the directory, or the materials given, smaller tables first. `bench`
+// times probes of random positions, with the block cache cold and warm,
+// then warm from several threads at once.
+
+namespace
+{
+    using namespace chess;
+
+    const char *wdl_name(tb::wdl value)
+    {
+        return value == tb::wdl::win ? "win" : value == tb::wdl::loss ? "loss"
+                                                                      : "draw";
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    int generate(int argc, char *argv[])
+    {
+        if (argc < 3)
+        {
+            std::fprintf(stderr, "usage: tablebase generate <dir> [--pieces n] [--threads n] [material ...]\n");
+            return 1;
+        }
+
+        auto directory = std::string(argv[2]);
+        auto pieces = 4;
+        auto options = tb::generate_options{.threads = int(std::max(std::thread::hardware_concurrency(), 1u))};
+        auto requested = std::vector<std::string>{};
+        for (int i = 3; i < argc; ++i)
+        {
+            auto arg = std::string(argv[i]);
+            if (arg == "--pieces" && i + 1 < argc)
+            {
+                pieces = std::clamp(std::stoi(argv[++i]), 3, tb::max_pieces);
+            }
+            else if (arg == "--threads" && i + 1 < argc)
+            {
+                options.threads = std::max(std::stoi(argv[++i]), 1);
+            }
+            else
+            {
+                requested.push_back(arg);
+            }
+        }
+
+        auto error = std::error_code{};
+        std::filesystem::create_directories(directory, error);
+
+        auto materials = requested;
+        if (materials.empty())
+        {
+            for (int count = 3; count <= pieces; ++count)
+            {
+                for (auto &name : tb::materials(count))
+                {
+                    if (!std::filesystem::exists(std::filesystem::path(directory) / (name + ".ctw")))
+                    {
+                        materials.push_back(std::move(name));
+                    }
+                }
+            }
+        }
+
+        std::printf("%-8s %12s %10s %10s %10s %5s %10s %10s %9s\n",
+                    "table", "positions", "wins", "draws", "losses", "max", "wdl KB", "dtz KB", "time s");
+        auto total_start = std::chrono::steady_clock::now();
+        for (const auto &name : materials)
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto stats = tb::generate_stats{};
+            if (!tb::generate(name, directory, options, stats))
+            {
+                std::fprintf(stderr, "cannot generate %s: malformed, a smaller table is missing or the directory is not writable\n",
+                             name.c_str());
+                return 1;
+            }
+            std::printf("%-8s %12llu %10llu %10llu %10llu %5d %10.1f %10.1f %9.2f\n", name.c_str(),
+                        static_cast<unsigned long long>(stats.legal), static_cast<unsigned long long>(stats.wins),
+                        static_cast<unsigned long long>(stats.draws), static_cast<unsigned long long>(stats.losses),
+                        stats.max_distance, double(stats.wdl_bytes) / 1024.0, double(stats.distance_bytes) / 1024.0,
+                        seconds_since(start));
+            std::fflush(stdout);
+        }
+        std::printf("%zu tables in %.2f s, %d threads\n", materials.size(), seconds_since(total_start), options.threads);
+        return 0;
+    }
+
+    int probe(int argc, char *argv[])
+    {
+        if (argc < 3)
+        {
+            std::fprintf(stderr, "usage: tablebase probe <dir> [startpos | fen <fen>] [moves <uci moves>]\n");
+            return 1;
+        }
+
+        init_attacks();
+        auto tables = tb::load(argv[2]);
+        auto pos = std::make_unique<position>();
+        int i = 3;
+        if (i < argc && std::string(argv[i]) == "fen")
+        {
+            auto fen = std::string{};
+            for (++i; i < argc && std::string(argv[i]) != "moves"; ++i)
+            {
+                fen += std::string(argv[i]) + " ";
+            }
+            if (!pos->set_fen(fen))
+            {
+                std::fprintf(stderr, "invalid fen %s\n", fen.c_str());
+                return 1;
+            }
+        }
+        else if (i < argc && std::string(argv[i]) == "startpos")
+        {
+            ++i;
+        }
+        if (i < argc && std::string(argv[i]) == "moves")
+        {
+            for (++i; i < argc; ++i)
+            {
+                auto m = parse_uci(*pos, argv[i]);
+                if (m == no_move)
+                {
+                    std::fprintf(stderr, "illegal move %s\n", argv[i]);
+                    return 1;
+                }
+                pos->make_move(m);
+            }
+        }
+
+        std::printf("%s\n%d tables, up to %d pieces\n", pos->fen().c_str(), tables, tb::largest());
+        auto result = tb::probe_result{};
+        auto start = std::chrono::steady_clock::now();
+        auto found = tb::probe(*pos, result);
+        auto cold = seconds_since(start) * 1e6;
+        start = std::chrono::steady_clock::now();
+        tb::probe(*pos, result);
+        auto warm = seconds_since(start) * 1e6;
+        if (!found)
+        {
+            std::printf("not in the tables\n");
+            return 1;
+        }
+        std::printf("%s, %d plies to mate or conversion (probe %.1f us cold, %.2f us cached)\n",
+                    wdl_name(result.value), result.distance, cold, warm);
+
+        // the line of best moves
+        auto line = std::string{};
+        for (int ply = 0; ply < 200; ++ply)
+        {
+            auto m = tb::best_move(*pos, result);
+            if (m == no_move || result.value == tb::wdl::draw)
+            {
+                break;
+            }
+            line += to_uci(m) + " ";
+            pos->make_move(m);
+        }
+        std::printf("line %s\n", line.c_str());
+        return 0;
+    }
+
+    // a random legal position of the material, without castling
+    bool random_position(std::string_view material, std::mt19937_64 &random, position &pos)
+    {
+        auto split = material.find('v');
+        char board[64];
+        std::fill(std::begin(board), std::end(board), '\0');
+        for (std::size_t i = 0; i < material.size(); ++i)
+        {
+            if (i == split)
+            {
+                continue;
+            }
+            auto letter = i < split ? material[i] : char(material[i] - 'A' + 'a');
+            square s;
+            do
+            {
+                s = square(random() % 64);
+            } while (board[s] != '\0' || ((letter == 'P' || letter == 'p') && (s < 8 || s >= 56)));
+            board[s] = letter;
+        }
+
+        auto fen = std::string{};
+        for (int rank = 7; rank >= 0; --rank)
+        {
+            auto empty = 0;
+            for (int file = 0; file < 8; ++file)
+            {
+                auto letter = board[make_square(file, rank)];
+                if (letter == '\0')
+                {
+                    ++empty;
+                    continue;
+                }
+                fen += empty > 0 ? std::to_string(empty) : "";
+                fen += letter;
+                empty = 0;
+            }
+            fen += empty > 0 ? std::to_string(empty) : "";
+            fen += rank > 0 ? "/" : "";
+        }
+        fen += random() % 2 == 0 ? " w - - 0 1" : " b - - 0 1";
+        if (!pos.set_fen(fen))
+        {
+            return false;
+        }
+        // the side which just moved is not in check
+        auto them = ~pos.side_to_move();
+        return (pos.attackers_to(pos.king_square(them), pos.pieces()) & pos.pieces(pos.side_to_move())) == 0;
+    }
+
+    int bench(int argc, char *argv[])
+    {
+        if (argc < 3)
+        {
+            std::fprintf(stderr, "usage: tablebase bench <dir> [--probes n] [--threads n]\n");
+            return 1;
+        }
+        auto probes = 100000;
+        auto threads = int(std::max(std::thread::hardware_concurrency(), 2u));
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            if (std::string(argv[i]) == "--probes")
+            {
+                probes = std::max(std::stoi(argv[i + 1]), 1);
+            }
+            else if (std::string(argv[i]) == "--threads")
+            {
+                threads = std::max(std::stoi(argv[i + 1]), 1);
+            }
+        }
+
+        init_attacks();
+        auto start = std::chrono::steady_clock::now();
+        auto tables = tb::load(argv[2]);
+        std::printf("%d tables, up to %d pieces, loaded in %.2f ms\n", tables, tb::largest(), seconds_since(start) * 1e3);
+        if (tables == 0)
+        {
+            return 1;
+        }
+
+        auto materials = std::vector<std::string>{};
+        for (int count = 3; count <= tb::largest(); ++count)
+        {
+            for (auto &name : tb::materials(count))
+            {
+                if (std::filesystem::exists(std::filesystem::path(argv[2]) / (name + ".ctw")))
+                {
+                    materials.push_back(std::move(name));
+                }
+            }
+        }
+
+        auto random = std::mt19937_64{2024};
+        auto positions = std::vector<std::unique_ptr<position>>{};
+        while (int(positions.size()) < std::min(probes, 4096))
+        {
+            auto pos = std::make_unique<position>();
+            if (random_position(materials[random() % materials.size()], random, *pos))
+            {
+                positions.push_back(std::move(pos));
+            }
+        }
+
+        for (auto pass : {"cold", "warm"})
+        {
+            auto before = tb::get_cache_stats();
+            auto found = 0;
+            auto wins = 0;
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < probes; ++i)
+            {
+                auto value = tb::wdl::draw;
+                found += tb::probe_wdl(*positions[std::size_t(i) % positions.size()], value) ? 1 : 0;
+                wins += value == tb::wdl::win ? 1 : 0;
+            }
+            auto micros = seconds_since(start) * 1e6 / probes;
+            auto after = tb::get_cache_stats();
+            std::printf("%s: %d probes, %d found, %d wins, %.3f us per probe, %llu block hits, %llu misses\n",
+                        pass, probes, found, wins, micros,
+                        static_cast<unsigned long long>(after.hits - before.hits),
+                        static_cast<unsigned long long>(after.misses - before.misses));
+        }
+
+        // the same probes shared by the threads, each from its own offset:
+        // the cost of the cache lock under contention
+        auto before = tb::get_cache_stats();
+        auto found = std::vector<int>(std::size_t(threads), 0);
+        auto workers = std::vector<std::thread>{};
+        start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t] {
+                for (int i = t; i < probes; i += threads)
+                {
+                    auto value = tb::wdl::draw;
+                    found[std::size_t(t)] += tb::probe_wdl(*positions[std::size_t(i) % positions.size()], value) ? 1 : 0;
+                }
+            });
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        auto micros = seconds_since(start) * 1e6 / probes;
+        auto after = tb::get_cache_stats();
+        std::printf("%d threads: %d probes, %d found, %.3f us per probe, %llu block hits, %llu misses\n",
+                    threads, probes, std::accumulate(found.begin(), found.end(), 0), micros,
+                    static_cast<unsigned long long>(after.hits - before.hits),
+                    static_cast<unsigned long long>(after.misses - before.misses));
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto command = argc > 1 ? std::string(argv[1]) : std::string{};
+    if (command == "generate")
+    {
+        return generate(argc, argv);
+    }
+    if (command == "probe")
+    {
+        return probe(argc, argv);
+    }
+    if (command == "bench")
+    {
+        return bench(argc, argv);
+    }
+
+    std::fprintf(stderr, "usage: tablebase generate <dir> [options] | tablebase probe <dir> [position] | tablebase bench <dir>\n");
+    return 1;
+}